@@ -0,0 +1,777 @@
+﻿#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include "../CompilerC++/SourceManager.cpp" // Таблица строк исходного текста
+#include "../CompilerC++/Arena.cpp" // Арены узлов и кадров
+#include "../CompilerC++/Scanner.cpp" // Реализация лексера
+#include "../CompilerC++/Tree.cpp" // Реализация семантического дерева
+#include "../CompilerC++/Kernels.cpp" // Ядра бинарных операций
+#include "../CompilerC++/Ast.cpp" // Узлы AST
+#include "../CompilerC++/Diagram.cpp" // Синтаксический анализатор (строит AST)
+#include "../CompilerC++/Executor.cpp" // Исполнитель AST
+#include "../CompilerC++/Inliner.cpp" // Встраивание функций
+#include "../CompilerC++/ConstFolder.cpp" // Свёртка и распространение констант
+#include "../CompilerC++/ConstProp.cpp" // Межпроцедурное распространение констант
+#include "../CompilerC++/Specializer.cpp" // Специализация функций по константным аргументам
+#include "../CompilerC++/DeadCode.cpp" // Удаление недостижимого кода
+#include "../CompilerC++/DefAssign.cpp" // Анализ определённого присваивания
+#include "../CompilerC++/Ranges.cpp" // Анализ диапазонов значений
+#include "../CompilerC++/Simplify.cpp" // Алгебраические упрощения
+#include "../CompilerC++/Ssa.cpp" // Промежуточное представление SSA
+#include "../CompilerC++/Cse.cpp" // Устранение общих подвыражений
+#include "../CompilerC++/Effects.cpp" // Анализ чтения и записи глобальных переменных
+#include "../CompilerC++/MemoCache.cpp" // Мемоизация вызовов
+#include "../CompilerC++/Bytecode.cpp" // Байт-код
+#include "../CompilerC++/Peephole.cpp" // Суперинструкции и удаление лишних приведений
+#include "../CompilerC++/BytecodeCompiler.cpp" // Компилятор AST в байт-код
+#include "../CompilerC++/VM.cpp" // Интерпретатор байт-кода
+#include "../CompilerC++/X86Emitter.cpp" // Шаблоны машинного кода x86-64
+#include "../CompilerC++/Jit.cpp" // JIT-компилятор байт-кода в машинный код
+#include "../CompilerC++/Aot.cpp" // AOT-компиляция через C++ и разделяемую библиотеку
+
+using namespace std;
+
+// Счётчик обращений к системному распределителю (все new/delete программы)
+static size_t heapAllocations = 0;
+
+void* operator new(size_t size) {
+    heapAllocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Микробенчмарки транслятора.
+// Запуск: CompilerBench [имя набора]; без аргумента выполняются все наборы.
+
+typedef chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point from) {
+    return (double)chrono::duration_cast<chrono::nanoseconds>(Clock::now() - from).count();
+}
+
+// Корневая область видимости, как её создаёт Diagram
+static void resetTree() {
+    Tree::reset();
+    SemNode* rootNode = new SemNode();
+    rootNode->id = "<глобальная область видимости>";
+    rootNode->DataType = TYPE_SCOPE;
+    Tree::Root = new Tree(rootNode, nullptr);
+    Tree::Cur = Tree::Root;
+}
+
+// Поиск в областях видимости: N глобальных описаний, обращения из блока глубины 3.
+// При хеш-индексе стоимость одного поиска не должна расти с N.
+static void benchScopes() {
+    cout << "scopes: semInclude / semGetVar (нс на операцию)" << endl;
+    cout << setw(10) << "N" << setw(14) << "include" << setw(14) << "lookup" << endl;
+
+    const int lookups = 1000000;
+    const int sizes[] = { 100, 1000, 10000, 100000 };
+    volatile uintptr_t sink = 0;
+
+    for (int n : sizes) {
+        vector<string> names(n);
+        for (int i = 0; i < n; i++) names[i] = "v" + to_string(i);
+
+        resetTree();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < n; i++) Tree::Cur->semInclude(names[i], TYPE_INT, SrcLoc());
+        double includeNs = elapsedNs(start) / n;
+
+        for (int depth = 0; depth < 3; depth++) Tree::Cur->semEnterBlock(SrcLoc());
+
+        // Псевдослучайный порядок обращений (LCG), одинаковый для всех N
+        uint32_t seed = 12345;
+        start = Clock::now();
+        for (int i = 0; i < lookups; i++) {
+            seed = seed * 1103515245u + 12345u;
+            Tree* v = Tree::Cur->semGetVar(names[(seed >> 8) % n], SrcLoc());
+            sink = sink + (uintptr_t)v;
+        }
+        double lookupNs = elapsedNs(start) / lookups;
+
+        cout << setw(10) << n << fixed << setprecision(1)
+            << setw(14) << includeNs << setw(14) << lookupNs << endl;
+    }
+    Tree::reset();
+}
+
+// Арены: число обращений к системному распределителю при построении дерева
+// и занятость арены кадров при многократном выполнении рекурсивной программы
+static void benchArena() {
+    cout << "arena: узлы дерева (выделений из арены / блоков у системы)" << endl;
+    cout << setw(10) << "N" << setw(14) << "allocs" << setw(10) << "chunks" << setw(14) << "bytes" << setw(12) << "parse ms" << endl;
+
+    const int sizes[] = { 1000, 10000, 100000 };
+    for (int n : sizes) {
+        string source;
+        for (int i = 0; i < n; i++) source += "int v" + to_string(i) + " = " + to_string(i) + ";\n";
+        source += "void main() { v0 = v1; }\n";
+
+        Tree::reset();
+        Scanner sc;
+        sc.loadFromString(source);
+        Diagram dg(&sc);
+        size_t allocsBefore = nodeArena().allocationCount();
+        Clock::time_point start = Clock::now();
+        dg.Parse();
+        double ms = elapsedNs(start) / 1e6;
+
+        const Arena& a = nodeArena();
+        cout << setw(10) << n << setw(14) << a.allocationCount() - allocsBefore << setw(10) << a.chunkCount()
+            << setw(14) << a.bytesUsed() << setw(12) << fixed << setprecision(2) << ms << endl;
+    }
+
+    cout << "arena: кадры вызовов при повторных запусках (байт)" << endl;
+    cout << setw(10) << "run" << setw(14) << "peak" << setw(14) << "after run" << setw(14) << "reserved" << endl;
+
+    Tree::reset();
+    Scanner sc;
+    sc.loadFromString(
+        "long acc = 0;"
+        "void f(int n) { int t = n; { long u = t * 3; acc = acc + u; }"
+        "  switch (n) { case 0: break; default: f(n - 1); } }"
+        "void main() { f(45); }");
+    Diagram dg(&sc);
+    ProgramNode* program = dg.Parse();
+    Tree::disableDebug();
+    Executor executor(program);
+    for (int run = 1; run <= 5; run++) {
+        executor.run();
+        const Arena& a = executor.frameStats();
+        cout << setw(10) << run << setw(14) << a.peakBytes() << setw(14) << a.bytesUsed()
+            << setw(14) << a.bytesReserved() << endl;
+    }
+    Tree::reset();
+}
+
+static size_t countNodes(ExprNode* e) {
+    if (e == nullptr) return 0;
+    return 1 + countNodes(e->left) + countNodes(e->right);
+}
+
+// Вычисление выражений обходом AST: обращения к распределителю и время на один
+// вычисленный узел выражения (без отладочного вывода)
+static void benchValues() {
+    const int depth = 40;
+    const int runs = 2000;
+
+    Tree::reset();
+    Scanner sc;
+    sc.loadFromString(
+        "long acc = 0;"
+        "void f(int n, int a, short b) {"
+        "  acc = acc + (a + b) * (a - b) / (b + 1) + (n << 2) % 7 - (-a);"
+        "  switch (n) { case 0: break; default: f(n - 1, a + 1, b + 2); } }"
+        "void main() { f(40, 3, 5); }");
+    Diagram dg(&sc);
+    ProgramNode* program = dg.Parse();
+    Tree::disableDebug();
+
+    // Узлов выражений, вычисляемых за один запуск: присваивание и селектор в каждом вызове,
+    // аргументы — во всех вызовах, кроме последнего
+    StmtNode* body = program->functions[0]->body;
+    StmtNode* sw = body->body[1];
+    StmtNode* call = sw->cases[1]->body[0];
+    size_t argNodes = 0;
+    for (ExprNode* a : call->args) argNodes += countNodes(a);
+    size_t perRun = (depth + 1) * (countNodes(body->body[0]->value) + countNodes(sw->value)) + depth * argNodes;
+
+    Executor executor(program);
+    executor.run(); // прогрев: арены и массивы получают рабочий размер
+
+    size_t allocsBefore = heapAllocations;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < runs; i++) executor.run();
+    double ns = elapsedNs(start);
+    size_t allocs = heapAllocations - allocsBefore;
+
+    double nodes = (double)perRun * runs;
+    cout << "values: " << perRun << " узлов выражений за запуск, " << runs << " запусков" << endl;
+    cout << fixed << setprecision(3)
+        << "  обращений к распределителю на узел: " << allocs / nodes << endl
+        << "  обращений к распределителю на вызов: " << allocs / ((double)(depth + 1) * runs) << endl
+        << setprecision(1)
+        << "  нс на узел: " << ns / nodes << endl;
+    Tree::reset();
+}
+
+// Стоимость выбора ветви switch в зависимости от числа ветвей: плотные метки (0, 1, 2, ...)
+// и разреженные (0, 1000, 2000, ...); селектор попадает в разные ветви
+static void benchSwitch() {
+    const int depth = 40;
+    const int runs = 500;
+    const int sizes[] = { 4, 64, 1024 };
+    const int steps[] = { 1, 1000 };
+
+    cout << "switch: нс на оператор switch (AST / VM), " << runs << " запусков" << endl;
+    for (int step : steps) {
+        for (int n : sizes) {
+            string src = "int acc = 0; void f(int n) { switch ((n * 37) % " + to_string(n) + " * " + to_string(step) + ") {";
+            for (int i = 0; i < n; i++) src += " case " + to_string(i * step) + ": acc = acc + 1; break;";
+            src += " } switch (n) { case 0: break; default: f(n - 1); } } void main() { f(" + to_string(depth) + "); }";
+
+            Tree::reset();
+            Scanner sc;
+            sc.loadFromString(src);
+            Diagram dg(&sc);
+            ProgramNode* program = dg.Parse();
+            Tree::disableDebug();
+
+            // на каждый вызов — switch по ветвям и switch рекурсии
+            double switches = 2.0 * (depth + 1) * runs;
+
+            Executor executor(program);
+            executor.run();
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < runs; i++) executor.run();
+            double astNs = elapsedNs(start) / switches;
+
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(program);
+            VM vm(bytecode);
+            vm.run();
+            start = Clock::now();
+            for (int i = 0; i < runs; i++) vm.run();
+            double vmNs = elapsedNs(start) / switches;
+            delete bytecode;
+
+            cout << fixed << setprecision(1) << "  " << setw(5) << n << " ветвей, "
+                << (step == 1 ? "плотные" : "разреженные") << ": " << astNs << " / " << vmNs << endl;
+        }
+    }
+    Tree::reset();
+}
+
+// VM без JIT и с JIT: нс на вызов функции для рекурсии с ветвлением (fib) и для цикла
+// с арифметикой в теле. Первый запуск прогревает счётчики вызовов, дальше работает машинный код
+static void benchJit() {
+    const int runs = 20;
+    const struct { const char* name; const char* src; double calls; } scripts[] = {
+        { "fib(20)",
+          "int res = 0; void fib(int k) { switch (k) { case 0: break; case 1: res = res + 1; break;"
+          " default: fib(k - 1); fib(k - 2); } } void main() { fib(20); }", 21891 },
+        { "арифметика",
+          "long acc = 0; void loop(long i, long n) { long t = i * 3 + 7; switch (n - i) { case 0: break;"
+          " default: acc = acc + t % 11 - (t << 2) / 5 + (t >> 1) * t; loop(i + 1, n); } }"
+          " void main() { loop(0, 20000); }", 20002 },
+    };
+
+    cout << "jit: нс на вызов (VM / JIT), " << runs << " запусков"
+        << (JitCode::supported() ? "" : " (JIT недоступен на этой платформе)") << endl;
+    for (const auto& script : scripts) {
+        Tree::reset();
+        Scanner sc;
+        sc.loadFromString(script.src);
+        Diagram dg(&sc);
+        ProgramNode* program = dg.Parse();
+        Tree::disableDebug();
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+
+        double ns[2];
+        for (int jit = 0; jit < 2; jit++) {
+            VM vm(bytecode, jit != 0);
+            vm.run();
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < runs; i++) vm.run();
+            ns[jit] = elapsedNs(start) / (script.calls * runs);
+        }
+        delete bytecode;
+
+        cout << fixed << setprecision(1) << "  " << script.name << ": " << ns[0] << " / " << ns[1] << endl;
+    }
+    Tree::reset();
+}
+
+// AOT против интерпретаторов: время сборки библиотеки (первая загрузка) и загрузки из кеша,
+// затем нс на вызов на AST / VM / AOT для тех же сценариев, что и в наборе jit
+static void benchAot() {
+    if (!AotModule::supported()) {
+        cout << "aot: AOT-компиляция недоступна на этой платформе" << endl;
+        return;
+    }
+    const int runs = 20;
+    const struct { const char* name; const char* src; double calls; } scripts[] = {
+        { "fib(20)",
+          "int res = 0; void fib(int k) { switch (k) { case 0: break; case 1: res = res + 1; break;"
+          " default: fib(k - 1); fib(k - 2); } } void main() { fib(20); }", 21891 },
+        { "арифметика",
+          "long acc = 0; void loop(long i, long n) { long t = i * 3 + 7; switch (n - i) { case 0: break;"
+          " default: acc = acc + t % 11 - (t << 2) / 5 + (t >> 1) * t; loop(i + 1, n); } }"
+          " void main() { loop(0, 20000); }", 20002 },
+    };
+
+    cout << "aot: сборка / загрузка из кеша (мс), нс на вызов (AST / VM / AOT), " << runs << " запусков" << endl;
+    for (const auto& script : scripts) {
+        Tree::reset();
+        Scanner sc;
+        sc.loadFromString(script.src);
+        Diagram dg(&sc);
+        ProgramNode* program = dg.Parse();
+        Tree::disableDebug();
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+
+        string error;
+        Clock::time_point start = Clock::now();
+        AotModule* first = AotModule::load(bytecode, error);
+        double buildMs = elapsedNs(start) / 1e6;
+        if (!first) {
+            cout << "  " << script.name << ": " << error << endl;
+            delete bytecode;
+            continue;
+        }
+        bool wasCached = first->fromCache();
+        delete first;
+        start = Clock::now();
+        AotModule* aot = AotModule::load(bytecode, error);
+        double loadMs = elapsedNs(start) / 1e6;
+
+        double perRun = script.calls * runs;
+        Executor executor(program);
+        executor.run();
+        start = Clock::now();
+        for (int i = 0; i < runs; i++) executor.run();
+        double astNs = elapsedNs(start) / perRun;
+
+        VM vm(bytecode);
+        vm.run();
+        start = Clock::now();
+        for (int i = 0; i < runs; i++) vm.run();
+        double vmNs = elapsedNs(start) / perRun;
+
+        aot->run();
+        start = Clock::now();
+        for (int i = 0; i < runs; i++) aot->run();
+        double aotNs = elapsedNs(start) / perRun;
+        delete aot;
+        delete bytecode;
+
+        cout << fixed << setprecision(1) << "  " << script.name << ": " << buildMs
+            << (wasCached ? " (уже в кеше)" : "") << " / " << loadMs << " мс; "
+            << astNs << " / " << vmNs << " / " << aotNs << endl;
+    }
+    Tree::reset();
+}
+
+// Свёртка констант: нс на вызов на AST / VM без прохода и после него для функции, где
+// селектор и большая часть арифметики зависят только от констант и неизменяемых переменных
+static void benchFold() {
+    const int runs = 50;
+    const double calls = 20002;
+    const char* src =
+        "int base = 40; short step = 3; long acc = 0;"
+        "void loop(long i, long n) { short mode = step * 2 - 5; long k = base * 1000 + (-(step));"
+        " switch (mode - 1) { case 0: acc = acc + i * (k - 39990) + (base << step) / (step + 1); break;"
+        " default: acc = 0; }"
+        " switch (n - i) { case 0: break; default: loop(i + 1, n); } }"
+        " void main() { loop(0, 20000); }";
+
+    cout << "fold: нс на вызов (AST / VM) без свёртки и со свёрткой, " << runs << " запусков" << endl;
+    for (int fold = 0; fold < 2; fold++) {
+        Tree::reset();
+        Scanner sc;
+        sc.loadFromString(src);
+        Diagram dg(&sc);
+        ProgramNode* program = dg.Parse();
+        Tree::disableDebug();
+        ConstFolder folder;
+        if (fold) folder.run(program);
+
+        Executor executor(program);
+        executor.run();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < runs; i++) executor.run();
+        double astNs = elapsedNs(start) / (calls * runs);
+
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+        VM vm(bytecode);
+        vm.run();
+        start = Clock::now();
+        for (int i = 0; i < runs; i++) vm.run();
+        double vmNs = elapsedNs(start) / (calls * runs);
+        size_t instructions = 0;
+        for (const BcFunction& f : bytecode->functions) instructions += f.code.size();
+        delete bytecode;
+
+        cout << fixed << setprecision(1) << "  " << (fold ? "со свёрткой" : "без свёртки") << ": "
+            << astNs << " / " << vmNs << " (инструкций байт-кода: " << instructions;
+        if (fold) cout << "; свёрнуто выражений: " << folder.foldedExpressions()
+            << ", подставлено переменных: " << folder.propagatedUses();
+        cout << ")" << endl;
+    }
+    Tree::reset();
+}
+
+// Встраивание: нс на вызов рекурсивной функции, которая на каждом шаге вызывает несколько
+// однооператорных функций над глобальными переменными (как add / mult / sub в примерах),
+// на AST / VM без встраивания и с ним
+static void benchInline() {
+    const int runs = 50;
+    const double calls = 20002;
+    const char* src =
+        "long a = 2; long b = 0;"
+        "void add(int n) { a = a + n; }"
+        "void mult(int n) { a = a * n % 1000003; }"
+        "void sub(int n, short m) { b = b - (n + m); }"
+        "void loop(long i, long n) { add(3); mult(7); sub(i % 100, 5);"
+        " switch (n - i) { case 0: break; default: loop(i + 1, n); } }"
+        " void main() { loop(0, 20000); }";
+
+    cout << "inline: нс на вызов loop (AST / VM) без встраивания и со встраиванием, " << runs << " запусков" << endl;
+    for (int budget = 0; budget <= Inliner::DEFAULT_BUDGET; budget += Inliner::DEFAULT_BUDGET) {
+        Tree::reset();
+        Scanner sc;
+        sc.loadFromString(src);
+        Diagram dg(&sc);
+        ProgramNode* program = dg.Parse();
+        Tree::disableDebug();
+        Inliner inliner(budget);
+        inliner.run(program);
+
+        Executor executor(program);
+        executor.run();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < runs; i++) executor.run();
+        double astNs = elapsedNs(start) / (calls * runs);
+
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+        VM vm(bytecode);
+        vm.run();
+        start = Clock::now();
+        for (int i = 0; i < runs; i++) vm.run();
+        double vmNs = elapsedNs(start) / (calls * runs);
+        delete bytecode;
+
+        cout << fixed << setprecision(1) << "  предел " << budget << ": " << astNs << " / " << vmNs
+            << " (встроено вызовов: " << inliner.inlinedCalls() << ")" << endl;
+    }
+    Tree::reset();
+}
+
+// Специализация: нс на шаг цикла, который вызывает функцию-диспетчер (switch по первому
+// параметру) с константным режимом, на AST / VM после свёртки констант без специализации и с ней
+static void benchSpecialize() {
+    const int runs = 50;
+    const double calls = 20002;
+    const char* src =
+        "long acc = 1;"
+        "void step(int mode, long x) { switch (mode) { case 0: acc = acc + x; break; case 1: acc = acc - x; break;"
+        " case 2: acc = acc * x % 1000003; break; case 3: acc = acc / (x + 1); break; default: acc = acc + x * x; } }"
+        "void loop(long i, long n) { step(2, i + 1); step(0, i); step(4, 3);"
+        " switch (n - i) { case 0: break; default: loop(i + 1, n); } }"
+        " void main() { loop(0, 20000); }";
+
+    cout << "specialize: нс на шаг цикла (AST / VM) без специализации и с ней, " << runs << " запусков" << endl;
+    for (int spec = 0; spec < 2; spec++) {
+        Tree::reset();
+        Scanner sc;
+        sc.loadFromString(src);
+        Diagram dg(&sc);
+        ProgramNode* program = dg.Parse();
+        Tree::disableDebug();
+        ConstFolder folder;
+        folder.run(program);
+        Specializer specializer;
+        if (spec) {
+            for (int round = 0; round < Specializer::MAX_ROUNDS && specializer.run(program) > 0; round++) {
+                ConstFolder refold;
+                refold.run(program);
+            }
+        }
+        DeadCodeEliminator dce;
+        dce.run(program);
+
+        Executor executor(program);
+        executor.run();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < runs; i++) executor.run();
+        double astNs = elapsedNs(start) / (calls * runs);
+
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+        VM vm(bytecode);
+        vm.run();
+        start = Clock::now();
+        for (int i = 0; i < runs; i++) vm.run();
+        double vmNs = elapsedNs(start) / (calls * runs);
+        delete bytecode;
+
+        cout << fixed << setprecision(1) << "  " << (spec ? "со специализацией" : "без специализации") << ": "
+            << astNs << " / " << vmNs << " (копий: " << specializer.clonesCreated()
+            << ", переадресовано вызовов: " << specializer.callsRedirected() << ")" << endl;
+    }
+    Tree::reset();
+}
+
+// Мемоизация вызовов: fib(N) с ветвящейся рекурсией — экспоненциальное число вызовов без
+// мемоизации и линейное с ней
+static void benchMemo() {
+    const int sizes[] = { 16, 22, 28 };
+    cout << "memo: мкс на запуск fib(N) (AST / VM) без мемоизации и с ней" << endl;
+    cout << setw(6) << "N" << setw(22) << "off" << setw(22) << "on" << setw(12) << "hits" << endl;
+
+    for (int n : sizes) {
+        string src =
+            "long r;"
+            "void fib(int n) { switch (n) { case 0: r = 0; break; case 1: r = 1; break;"
+            " default: { long a; fib(n - 1); a = r; fib(n - 2); r = a + r; } } }"
+            "void main() { fib(" + to_string(n) + "); }";
+
+        double ast[2], vmUs[2];
+        uint64_t hits = 0;
+        for (int memo = 0; memo < 2; memo++) {
+            Tree::reset();
+            Scanner sc;
+            sc.loadFromString(src);
+            Diagram dg(&sc);
+            dg.setMemoization(memo != 0, false);
+            ProgramNode* program = dg.Parse();
+            Tree::disableDebug();
+            dg.Optimize(false);
+            int runs = memo ? 200 : 3;
+
+            Executor executor(program);
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < runs; i++) executor.run();
+            ast[memo] = elapsedNs(start) / runs / 1000;
+
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(program);
+            VM vm(bytecode);
+            start = Clock::now();
+            for (int i = 0; i < runs; i++) vm.run();
+            vmUs[memo] = elapsedNs(start) / runs / 1000;
+            if (memo) hits = vm.memoStats().hits();
+            delete bytecode;
+        }
+
+        ostringstream plain, memoized;
+        plain << fixed << setprecision(1) << ast[0] << " / " << vmUs[0];
+        memoized << fixed << setprecision(1) << ast[1] << " / " << vmUs[1];
+        cout << setw(6) << n << setw(22) << plain.str() << setw(22) << memoized.str() << setw(12) << hits << endl;
+    }
+    Tree::reset();
+}
+
+// Алгебраические упрощения: нс на шаг цикла с делением и остатком на 2^k, умножением на 2^k,
+// отрицанием и операциями с нейтральной константой (AST / VM / JIT) без Simplifier и с ним
+static void benchSimplify() {
+    const int runs = 50;
+    const double calls = 20002;
+    const char* src =
+        "long acc = 0; int m = 0;"
+        "void loop(long i, long n) { long t = i * 3 - 30000; int x = i - 10000; switch (n - i) { case 0: break;"
+        " default: acc = acc + t / 8 - t % 16 + t * 4 + (0 - t) / 2 + (t + 0) * 1 - t / 1024;"
+        " m = m + x % 32 + x / 4 * (-1); loop(i + 1, n); } }"
+        " void main() { loop(0, 20000); }";
+
+    cout << "simplify: нс на шаг цикла (AST / VM / JIT) без упрощений и с ними, " << runs << " запусков" << endl;
+    for (int simplify = 0; simplify < 2; simplify++) {
+        Tree::reset();
+        Scanner sc;
+        sc.loadFromString(src);
+        Diagram dg(&sc);
+        ProgramNode* program = dg.Parse();
+        Tree::disableDebug();
+        ConstFolder folder;
+        folder.run(program);
+        DefiniteAssignment assignment;
+        assignment.run(program);
+        Simplifier simplifier;
+        if (simplify) simplifier.run(program);
+
+        Executor executor(program);
+        executor.run();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < runs; i++) executor.run();
+        double astNs = elapsedNs(start) / (calls * runs);
+
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+        double ns[2];
+        for (int jit = 0; jit < 2; jit++) {
+            VM vm(bytecode, jit != 0);
+            vm.run();
+            start = Clock::now();
+            for (int i = 0; i < runs; i++) vm.run();
+            ns[jit] = elapsedNs(start) / (calls * runs);
+        }
+        delete bytecode;
+
+        cout << fixed << setprecision(1) << "  " << (simplify ? "с упрощениями" : "без упрощений") << ": "
+            << astNs << " / " << ns[0] << " / " << ns[1] << " (упрощено операций: "
+            << simplifier.identities() + simplifier.negations() + simplifier.shifts() + simplifier.pow2Divisions()
+            << ")" << endl;
+    }
+    Tree::reset();
+}
+
+// Общие подвыражения: нс на шаг цикла, в теле которого (i + n) и чтения глобальных переменных
+// повторяются в соседних присваиваниях (AST / VM / JIT), без CommonSubexpressions и с ним
+static void benchCse() {
+    const int runs = 50;
+    const double calls = 20002;
+    const char* src =
+        "long acc = 0; long sq = 0; int k = 3; int m = 0;"
+        "void loop(long i, long n) { switch (n - i) { case 0: break;"
+        " default: acc = acc + (i + n) * k; sq = sq + (i + n) * (i + n) - k;"
+        " m = m + (n + i) % 7 + k * k; acc = acc - (i + n) * k + m; loop(i + 1, n); } }"
+        " void main() { loop(0, 20000); }";
+
+    cout << "cse: нс на шаг цикла (AST / VM / JIT) без устранения общих подвыражений и с ним, " << runs << " запусков" << endl;
+    for (int cse = 0; cse < 2; cse++) {
+        Tree::reset();
+        Scanner sc;
+        sc.loadFromString(src);
+        Diagram dg(&sc);
+        ProgramNode* program = dg.Parse();
+        Tree::disableDebug();
+        DefiniteAssignment assignment;
+        assignment.run(program);
+        CommonSubexpressions pass;
+        if (cse) pass.run(program);
+
+        Executor executor(program);
+        executor.run();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < runs; i++) executor.run();
+        double astNs = elapsedNs(start) / (calls * runs);
+
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+        double ns[2];
+        for (int jit = 0; jit < 2; jit++) {
+            VM vm(bytecode, jit != 0);
+            vm.run();
+            start = Clock::now();
+            for (int i = 0; i < runs; i++) vm.run();
+            ns[jit] = elapsedNs(start) / (calls * runs);
+        }
+        size_t size = bytecode->functions[0].code.size();
+        delete bytecode;
+
+        cout << fixed << setprecision(1) << "  " << (cse ? "с устранением" : "без устранения") << ": "
+            << astNs << " / " << ns[0] << " / " << ns[1] << " (инструкций в loop: " << size
+            << ", выражений: " << pass.eliminatedExpressions() << ", чтений: " << pass.eliminatedLoads() << ")" << endl;
+    }
+    Tree::reset();
+}
+
+// Суперинструкции: исполненные VM инструкции (диспетчеризации) на программах наборов jit,
+// simplify и cse после всех проходов — сколько их было бы без объединения и сколько осталось,
+// нс на вызов; в конце — самые частые пары инструкций по всем программам (по ним выбран набор)
+static void benchDispatch() {
+    const int runs = 20;
+    const struct { const char* name; const char* src; double calls; } scripts[] = {
+        { "fib(20)",
+          "int res = 0; void fib(int k) { switch (k) { case 0: break; case 1: res = res + 1; break;"
+          " default: fib(k - 1); fib(k - 2); } } void main() { fib(20); }", 21891 },
+        { "арифметика",
+          "long acc = 0; void loop(long i, long n) { long t = i * 3 + 7; switch (n - i) { case 0: break;"
+          " default: acc = acc + t % 11 - (t << 2) / 5 + (t >> 1) * t; loop(i + 1, n); } }"
+          " void main() { loop(0, 20000); }", 20002 },
+        { "упрощения",
+          "long acc = 0; int m = 0;"
+          "void loop(long i, long n) { long t = i * 3 - 30000; int x = i - 10000; switch (n - i) { case 0: break;"
+          " default: acc = acc + t / 8 - t % 16 + t * 4 + (0 - t) / 2 + (t + 0) * 1 - t / 1024;"
+          " m = m + x % 32 + x / 4 * (-1); loop(i + 1, n); } }"
+          " void main() { loop(0, 20000); }", 20002 },
+        { "подвыражения",
+          "long acc = 0; long sq = 0; int k = 3; int m = 0;"
+          "void loop(long i, long n) { switch (n - i) { case 0: break;"
+          " default: acc = acc + (i + n) * k; sq = sq + (i + n) * (i + n) - k;"
+          " m = m + (n + i) % 7 + k * k; acc = acc - (i + n) * k + m; loop(i + 1, n); } }"
+          " void main() { loop(0, 20000); }", 20002 },
+    };
+
+    cout << "dispatch: исполнено инструкций VM без объединения / с суперинструкциями, нс на вызов, "
+        << runs << " запусков" << endl;
+    DispatchProfile total;
+    for (const auto& script : scripts) {
+        Tree::reset();
+        Scanner sc;
+        sc.loadFromString(script.src);
+        Diagram dg(&sc);
+        ProgramNode* program = dg.Parse();
+        Tree::disableDebug();
+        dg.Optimize(false);
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+
+        DispatchProfile profile;
+        VM counted(bytecode, false);
+        counted.setProfile(&profile);
+        counted.run();
+        counted.setProfile(&total);
+        counted.run();
+
+        VM vm(bytecode, false);
+        vm.run();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < runs; i++) vm.run();
+        double ns = elapsedNs(start) / (script.calls * runs);
+        delete bytecode;
+
+        cout << fixed << setprecision(1) << "  " << script.name << ": " << profile.original << " / "
+            << profile.dispatches << " (-" << 100.0 * (profile.original - profile.dispatches) / profile.original
+            << "%), " << ns << " нс" << endl;
+    }
+    total.printStats("всего", cout, 8);
+    Tree::reset();
+}
+
+struct BenchSuite {
+    const char* name;
+    void (*run)();
+};
+
+static const BenchSuite suites[] = {
+    { "scopes", benchScopes },
+    { "arena", benchArena },
+    { "values", benchValues },
+    { "switch", benchSwitch },
+    { "jit", benchJit },
+    { "aot", benchAot },
+    { "fold", benchFold },
+    { "inline", benchInline },
+    { "specialize", benchSpecialize },
+    { "memo", benchMemo },
+    { "simplify", benchSimplify },
+    { "cse", benchCse },
+    { "dispatch", benchDispatch },
+};
+
+int main(int argc, char** argv) {
+#ifdef _WIN32
+    SetConsoleCP(1251);
+    SetConsoleOutputCP(1251);
+#endif
+
+    string only = argc > 1 ? argv[1] : "";
+    bool found = false;
+    for (const BenchSuite& s : suites) {
+        if (!only.empty() && only != s.name) continue;
+        found = true;
+        s.run();
+    }
+    if (!found) {
+        cerr << "Неизвестный набор: " << only << endl;
+        return 1;
+    }
+    return 0;
+}
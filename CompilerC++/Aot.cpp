@@ -0,0 +1,556 @@
+﻿#include "Aot.h"
+#include "Tree.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define AOT_POSIX 1
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Интерфейс между транслятором и библиотекой; в сгенерированном тексте описан так же
+struct AotHost {
+    int64_t* globals;
+    uint8_t* globalInits;
+    int64_t maxDepth;
+    void* module;
+    void (*fail)(void* module, int fn, int pc);
+    void (*truncated)(void* module, int fn, int pc, int64_t value);
+};
+
+// Начало сгенерированного текста: интерфейс и те же операции, что в Value.h
+static const char* const AOT_PRELUDE =
+    "#include <cstdint>\n"
+    "typedef int64_t i64;\n"
+    "struct AotHost {\n"
+    "    i64* globals;\n"
+    "    uint8_t* globalInits;\n"
+    "    i64 maxDepth;\n"
+    "    void* module;\n"
+    "    void (*fail)(void* module, int fn, int pc);\n"
+    "    void (*truncated)(void* module, int fn, int pc, i64 value);\n"
+    "};\n"
+    "static AotHost H;\n"
+    "static i64* G;\n"
+    "static uint8_t* GI;\n"
+    "static i64 depth;\n"
+    "static inline i64 toShort(i64 v) { return static_cast<int16_t>(static_cast<uint16_t>(v)); }\n"
+    "static inline i64 toInt(i64 v) { return static_cast<int32_t>(static_cast<uint32_t>(v)); }\n"
+    "static inline i64 wrapAdd(i64 a, i64 b) { return static_cast<i64>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)); }\n"
+    "static inline i64 wrapSub(i64 a, i64 b) { return static_cast<i64>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)); }\n"
+    "static inline i64 wrapMul(i64 a, i64 b) { return static_cast<i64>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)); }\n"
+    "static inline i64 wrapShl(i64 a, i64 n) { return static_cast<i64>(static_cast<uint64_t>(a) << n); }\n"
+    "static inline i64 divLong(i64 a, i64 b) { return (b == -1) ? wrapSub(0, a) : a / b; }\n"
+    "static inline i64 modLong(i64 a, i64 b) { return (b == -1) ? 0 : a % b; }\n"
+    "static inline i64 divPow2(i64 a, int k) { return (a + ((a >> 63) & ((i64(1) << k) - 1))) >> k; }\n"
+    "static inline i64 modPow2(i64 a, int k) { return wrapSub(a, wrapShl(divPow2(a, k), k)); }\n"
+    "#define FAIL(fn, pc) H.fail(H.module, fn, pc)\n";
+
+// Целая константа C++ (INT64_MIN не записывается литералом)
+static string literal(int64_t v) {
+    if (v == INT64_MIN) return "(-9223372036854775807LL - 1)";
+    return to_string(v) + "LL";
+}
+
+static string reg(int r) { return "r" + to_string(r); }
+
+static string funcName(int index) { return "f" + to_string(index); }
+
+// Аргументы вызова: регистры first .. first + count - 1
+static string argList(int first, int count) {
+    string s;
+    for (int i = 0; i < count; ++i) {
+        if (i) s += ", ";
+        s += reg(first + i);
+    }
+    return s;
+}
+
+// Выражение для арифметики, сдвига или сравнения (деление с проверкой делителя — отдельно)
+static string binaryExpr(const Instr& in) {
+    string b = reg(in.b);
+    string c = reg(in.c);
+    string k = literal(in.c);
+    switch (in.op) {
+    case OP_ADD_S: return "toShort(" + b + " + " + c + ")";
+    case OP_ADD_I: return "toInt(" + b + " + " + c + ")";
+    case OP_ADD_L: return "wrapAdd(" + b + ", " + c + ")";
+    case OP_SUB_S: return "toShort(" + b + " - " + c + ")";
+    case OP_SUB_I: return "toInt(" + b + " - " + c + ")";
+    case OP_SUB_L: return "wrapSub(" + b + ", " + c + ")";
+    case OP_MUL_S: return "toShort(" + b + " * " + c + ")";
+    case OP_MUL_I: return "toInt(" + b + " * " + c + ")";
+    case OP_MUL_L: return "wrapMul(" + b + ", " + c + ")";
+    case OP_DIV_S: case OP_QUO_S: return "toShort(" + b + " / " + c + ")";
+    case OP_DIV_I: case OP_QUO_I: return "toInt(" + b + " / " + c + ")";
+    case OP_DIV_L: case OP_QUO_L: return "divLong(" + b + ", " + c + ")";
+    case OP_MOD_S: case OP_REM_S: return "toShort(" + b + " % " + c + ")";
+    case OP_MOD_I: case OP_REM_I: return "toInt(" + b + " % " + c + ")";
+    case OP_MOD_L: case OP_REM_L: return "modLong(" + b + ", " + c + ")";
+    case OP_SHL_S: return "toShort(wrapShl(" + b + ", " + c + " & 31))";
+    case OP_SHL_I: return "toInt(wrapShl(" + b + ", " + c + " & 31))";
+    case OP_SHL_L: return "wrapShl(" + b + ", " + c + " & 63)";
+    case OP_SHR_S: return "toShort(" + b + " >> (" + c + " & 31))";
+    case OP_SHR_I: return "toInt(" + b + " >> (" + c + " & 31))";
+    case OP_SHR_L: return b + " >> (" + c + " & 63)";
+    case OP_SHLK_S: return "toShort(wrapShl(" + b + ", " + to_string(in.c) + "))";
+    case OP_SHLK_I: return "toInt(wrapShl(" + b + ", " + to_string(in.c) + "))";
+    case OP_SHLK_L: return "wrapShl(" + b + ", " + to_string(in.c) + ")";
+    case OP_NEG_S: return "toShort(-" + b + ")";
+    case OP_NEG_I: return "toInt(-" + b + ")";
+    case OP_NEG_L: return "wrapSub(0, " + b + ")";
+    case OP_DIVP2: return "divPow2(" + b + ", " + to_string(in.c) + ")";
+    case OP_MODP2: return "modPow2(" + b + ", " + to_string(in.c) + ")";
+    case OP_ADDK_S: return "toShort(" + b + " + " + k + ")";
+    case OP_ADDK_I: return "toInt(" + b + " + " + k + ")";
+    case OP_ADDK_L: return "wrapAdd(" + b + ", " + k + ")";
+    case OP_MULK_S: return "toShort(" + b + " * " + k + ")";
+    case OP_MULK_I: return "toInt(" + b + " * " + k + ")";
+    case OP_MULK_L: return "wrapMul(" + b + ", " + k + ")";
+    case OP_QUOK_S: return "toShort(" + b + " / " + k + ")";
+    case OP_QUOK_I: return "toInt(" + b + " / " + k + ")";
+    case OP_QUOK_L: return "divLong(" + b + ", " + k + ")";
+    case OP_REMK_S: return "toShort(" + b + " % " + k + ")";
+    case OP_REMK_I: return "toInt(" + b + " % " + k + ")";
+    case OP_REMK_L: return "modLong(" + b + ", " + k + ")";
+    case OP_ADDG_S: return "toShort(" + b + " + " + c + ")";
+    case OP_ADDG_I: return "toInt(" + b + " + " + c + ")";
+    case OP_ADDG_L: return "wrapAdd(" + b + ", " + c + ")";
+    case OP_SUBG_S: return "toShort(" + b + " - " + c + ")";
+    case OP_SUBG_I: return "toInt(" + b + " - " + c + ")";
+    case OP_SUBG_L: return "wrapSub(" + b + ", " + c + ")";
+    case OP_EQ: return b + " == " + c;
+    case OP_NE: return b + " != " + c;
+    case OP_LT: return b + " < " + c;
+    case OP_LE: return b + " <= " + c;
+    case OP_GT: return b + " > " + c;
+    default: return b + " >= " + c;
+    }
+}
+
+// Тело функции index: регистры — локальные переменные, признаки инициализации заводятся
+// только для переменных, которые проверяет CHKL
+static void generateFunction(const BcProgram& program, int index, ostream& out) {
+    const BcFunction& fn = program.functions[index];
+    size_t n = fn.code.size();
+
+    vector<bool> target(n + 1, false);
+    vector<bool> checked(fn.numRegs, false);
+    for (const Instr& in : fn.code) {
+        if (in.op == OP_JMP) target[in.a] = true;
+        else if (in.op == OP_JT || in.op == OP_JF) target[in.b] = true;
+        else if (in.op >= OP_JEQ && in.op <= OP_JNEK) target[in.c] = true;
+        else if (in.op == OP_SWITCH) {
+            const SwitchTable& table = fn.switches[in.b];
+            for (int t : table.jump) target[t] = true;
+            for (int t : table.targets) target[t] = true;
+            target[table.defaultTarget] = true;
+        }
+        else if (in.op == OP_CHKL) checked[in.a] = true;
+    }
+
+    out << "// " << (index == program.entry ? "<init>" : fn.name) << "\n";
+    out << "static void " << funcName(index) << "(";
+    for (int i = 0; i < fn.numParams; ++i) out << (i ? ", " : "") << "i64 " << reg(i);
+    out << ") {\n";
+    for (int r = fn.numParams; r < fn.numRegs; ++r) out << "    i64 " << reg(r) << " = 0;\n";
+    for (int r = 0; r < fn.numRegs; ++r) {
+        if (checked[r]) out << "    bool i" << r << " = " << (r < fn.numParams ? "true" : "false") << ";\n";
+    }
+    out << "start:;\n";
+
+    for (size_t pc = 0; pc < n; ++pc) {
+        const Instr& in = fn.code[pc];
+        if (target[pc]) out << "L" << pc << ":;\n";
+        string at = to_string(index) + ", " + to_string(pc);
+        out << "    ";
+        switch (in.op) {
+        case OP_LOADK: out << reg(in.a) << " = " << literal(fn.consts[in.b]) << ";"; break;
+        case OP_MOV: out << reg(in.a) << " = " << reg(in.b) << ";"; break;
+        case OP_LOADG: out << reg(in.a) << " = G[" << in.b << "];"; break;
+        case OP_STL:
+            out << reg(in.a) << " = " << reg(in.b) << ";";
+            if (checked[in.a]) out << " i" << in.a << " = true;";
+            break;
+        case OP_STG: out << "G[" << in.a << "] = " << reg(in.b) << "; GI[" << in.a << "] = 1;"; break;
+        case OP_CHKL: out << "if (!i" << in.a << ") FAIL(" << at << ");"; break;
+        case OP_CHKG: out << "if (!GI[" << in.a << "]) FAIL(" << at << ");"; break;
+
+        case OP_DIV_S: case OP_DIV_I: case OP_DIV_L:
+        case OP_MOD_S: case OP_MOD_I: case OP_MOD_L:
+            out << "if (" << reg(in.c) << " == 0) FAIL(" << at << "); ";
+            out << reg(in.a) << " = " << binaryExpr(in) << ";";
+            break;
+
+        case OP_ADDG_S: case OP_ADDG_I: case OP_ADDG_L:
+        case OP_SUBG_S: case OP_SUBG_I: case OP_SUBG_L:
+            out << "G[" << in.a << "] = " << binaryExpr(in) << "; GI[" << in.a << "] = 1;";
+            break;
+
+        case OP_CAST_S: out << reg(in.a) << " = toShort(" << reg(in.b) << ");"; break;
+        case OP_CAST_I: out << reg(in.a) << " = toInt(" << reg(in.b) << ");"; break;
+        case OP_NARROW_S:
+        case OP_NARROW_I:
+            out << "{ i64 v = " << (in.op == OP_NARROW_S ? "toShort(" : "toInt(") << reg(in.b) << "); "
+                << "if (v != " << reg(in.b) << ") H.truncated(H.module, " << at << ", " << reg(in.b) << "); "
+                << reg(in.a) << " = v; }";
+            break;
+
+        case OP_JMP: out << "goto L" << in.a << ";"; break;
+        case OP_JT: out << "if (" << reg(in.a) << ") goto L" << in.b << ";"; break;
+        case OP_JF: out << "if (!" << reg(in.a) << ") goto L" << in.b << ";"; break;
+        case OP_JEQ: out << "if (" << reg(in.a) << " == " << reg(in.b) << ") goto L" << in.c << ";"; break;
+        case OP_JNE: out << "if (" << reg(in.a) << " != " << reg(in.b) << ") goto L" << in.c << ";"; break;
+        case OP_JEQK: out << "if (" << reg(in.a) << " == " << literal(in.b) << ") goto L" << in.c << ";"; break;
+        case OP_JNEK: out << "if (" << reg(in.a) << " != " << literal(in.b) << ") goto L" << in.c << ";"; break;
+        case OP_SWITCH: {
+            // Выбор ветви остаётся компилятору C++ (таблица переходов или дерево сравнений)
+            const SwitchTable& table = fn.switches[in.b];
+            out << "switch (" << reg(in.a) << ") {";
+            if (table.dense) {
+                for (size_t i = 0; i < table.jump.size(); ++i) {
+                    if (table.jump[i] == table.defaultTarget) continue;
+                    out << " case " << literal(table.minLabel + static_cast<long long>(i)) << ": goto L" << table.jump[i] << ";";
+                }
+            }
+            else {
+                for (size_t i = 0; i < table.labels.size(); ++i) {
+                    out << " case " << literal(table.labels[i]) << ": goto L" << table.targets[i] << ";";
+                }
+            }
+            out << " default: goto L" << table.defaultTarget << "; }";
+            break;
+        }
+
+        case OP_CALL: {
+            const BcFunction& callee = program.functions[in.a];
+            string call = funcName(in.a) + "(" + argList(in.b, callee.numParams) + ");";
+            if (fn.sites[in.c].countDepth) {
+                out << "if (++depth > H.maxDepth) FAIL(" << at << "); " << call << " --depth;";
+            }
+            else out << call;
+            break;
+        }
+        case OP_TAILCALL: {
+            const BcFunction& callee = program.functions[in.a];
+            if (in.a != index) {
+                // Вызов в хвостовой позиции компилятор C++ превращает в переход (sibling call)
+                out << funcName(in.a) << "(" << argList(in.b, callee.numParams) << "); return;";
+                break;
+            }
+            // Рекурсия на себя — цикл: параметры заменяются аргументами, локальные переменные
+            // снова не инициализированы
+            out << "{ ";
+            for (int i = 0; i < fn.numParams; ++i) out << "i64 a" << i << " = " << reg(in.b + i) << "; ";
+            for (int i = 0; i < fn.numParams; ++i) out << reg(i) << " = a" << i << "; ";
+            for (int r = fn.numParams; r < fn.numRegs; ++r) {
+                if (checked[r]) out << "i" << r << " = false; ";
+            }
+            out << "goto start; }";
+            break;
+        }
+        case OP_RET: out << "return;"; break;
+
+        default:
+            if (in.op >= OP_TRACE_ASSIGN) out << ";"; // отладочный вывод в AOT не поддерживается
+            else out << reg(in.a) << " = " << binaryExpr(in) << ";";
+            break;
+        }
+        out << "\n";
+    }
+    if (target[n]) out << "L" << n << ":;\n";
+    out << "}\n\n";
+}
+
+string AotModule::generate(const BcProgram& program) {
+    ostringstream out;
+    out << AOT_PRELUDE << "\n";
+    for (size_t i = 0; i < program.functions.size(); ++i) {
+        out << "static void " << funcName(static_cast<int>(i)) << "(";
+        for (int p = 0; p < program.functions[i].numParams; ++p) out << (p ? ", " : "") << "i64";
+        out << ");\n";
+    }
+    out << "\n";
+    for (size_t i = 0; i < program.functions.size(); ++i) {
+        generateFunction(program, static_cast<int>(i), out);
+    }
+    out << "extern \"C\" void aot_main(const void* host) {\n"
+        << "    H = *static_cast<const AotHost*>(host);\n"
+        << "    G = H.globals;\n"
+        << "    GI = H.globalInits;\n"
+        << "    depth = 0;\n"
+        << "    " << funcName(program.entry) << "();\n"
+        << "}\n";
+    return out.str();
+}
+
+// Ошибка в сгенерированном коде: сообщение выбирается по инструкции, как в VM
+void AotModule::fail(void* module, int fn, int pc) {
+    const BcFunction& f = static_cast<AotModule*>(module)->program->functions[fn];
+    const Instr& in = f.code[pc];
+    if (in.op == OP_CHKL || in.op == OP_CHKG) {
+        const string& name = f.sites[in.b].name;
+        Tree::interpError("использование неинициализированной переменной '" + name + "'", name, f.locs[pc]);
+    }
+    if (in.op == OP_CALL) {
+        const SiteInfo& site = f.sites[in.c];
+        Tree::interpError("превышение глубины рекурсии", site.name, site.loc);
+    }
+    Tree::interpError("деление на ноль", "", f.locs[pc]);
+}
+
+void AotModule::truncated(void* module, int fn, int pc, int64_t value) {
+    const BcFunction& f = static_cast<AotModule*>(module)->program->functions[fn];
+    const SiteInfo& site = f.sites[f.code[pc].c];
+    Tree::printTruncationWarning(value, site.type2, site.loc);
+}
+
+Value AotModule::globalValue(const string& name) const {
+    for (size_t i = 0; i < program->globalNames.size(); ++i) {
+        if (program->globalNames[i] == name && i < globals.size()) {
+            Value value(program->globalTypes[i], globals[i]);
+            value.hasValue = globalInits[i] != 0;
+            return value;
+        }
+    }
+    return Value();
+}
+
+#ifdef AOT_POSIX
+
+bool AotModule::supported() { return true; }
+
+// FNV-1a: имя файла в кеше
+static uint64_t hashText(const string& text) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char ch : text) {
+        h ^= ch;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Каталог кеша пользователя: $XDG_CACHE_HOME/translator-aot или $HOME/.cache/translator-aot.
+// Библиотеки из него загружаются без пересборки, поэтому он используется, только если это
+// каталог (не ссылка) текущего пользователя с правами 0700
+static bool cacheDir(string& dir, string& error) {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    string root;
+    if (xdg && *xdg == '/') {
+        root = xdg;
+    }
+    else if (home && *home == '/') {
+        root = string(home) + "/.cache";
+        mkdir(root.c_str(), 0700);
+    }
+    else {
+        error = "не задан каталог кеша ($XDG_CACHE_HOME или $HOME)";
+        return false;
+    }
+
+    dir = root + "/translator-aot";
+    if (mkdir(dir.c_str(), 0700) == 0) chmod(dir.c_str(), 0700); // без учёта umask
+    struct stat st;
+    if (lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 0777) != 0700) {
+        error = "каталог кеша " + dir + " не принадлежит пользователю или доступен другим (нужны права 0700)";
+        return false;
+    }
+    return true;
+}
+
+// Содержимое обычного файла (ссылки не читаются)
+static bool readFile(const string& path, string& text) {
+    int fd = open(path.c_str(), O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) return false;
+    text.clear();
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) text.append(buffer, static_cast<size_t>(n));
+    close(fd);
+    return n == 0;
+}
+
+// Новый временный файл в каталоге кеша (mkstemp: O_CREAT | O_EXCL, ссылки не переходит);
+// имя — в temp
+static int createTemp(const string& dir, string& temp) {
+    vector<char> name(dir.begin(), dir.end());
+    const char* pattern = "/tmp.XXXXXX";
+    name.insert(name.end(), pattern, pattern + strlen(pattern) + 1);
+    int fd = mkstemp(name.data());
+    temp = name.data();
+    return fd;
+}
+
+static bool writeAll(int fd, const string& text) {
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t n = write(fd, text.data() + done, text.size() - done);
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+AotModule* AotModule::load(BcProgram* program, string& error) {
+    const char* cxxEnv = getenv("CXX");
+    string cxx = (cxxEnv && *cxxEnv) ? cxxEnv : "c++";
+    // Компилятор — в первой строке текста: другой компилятор даёт другую библиотеку
+    string source = "// " + cxx + "\n" + generate(*program);
+
+    string dir;
+    if (!cacheDir(dir, error)) return nullptr;
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hashText(source)));
+    string base = dir + "/aot_" + key;
+    string sourcePath = base + ".cpp";
+    string library = base + ".so";
+
+    // Хеш только выбирает имя: библиотека берётся из кеша, если сохранённый рядом текст
+    // совпадает с нужным побайтно
+    string stored;
+    struct stat st;
+    bool cached = readFile(sourcePath, stored) && stored == source
+        && lstat(library.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == geteuid();
+    if (!cached) {
+        // Текст и библиотека собираются во временных файлах и переименовываются на место:
+        // параллельный запуск не увидит неполный файл. Библиотека — раньше текста, поэтому
+        // совпавший текст означает собранную по нему библиотеку
+        unlink(sourcePath.c_str());
+        string sourceTemp, libraryTemp;
+        int sourceFd = createTemp(dir, sourceTemp);
+        if (sourceFd < 0) {
+            error = "не удалось создать файл в " + dir;
+            return nullptr;
+        }
+        bool written = writeAll(sourceFd, source);
+        if (close(sourceFd) != 0 || !written) {
+            unlink(sourceTemp.c_str());
+            error = "не удалось записать " + sourceTemp;
+            return nullptr;
+        }
+        int libraryFd = createTemp(dir, libraryTemp);
+        if (libraryFd < 0) {
+            unlink(sourceTemp.c_str());
+            error = "не удалось создать файл в " + dir;
+            return nullptr;
+        }
+        close(libraryFd);
+
+        string log = base + ".log";
+        string command = cxx + " -std=c++17 -O2 -fPIC -shared -w -o \"" + libraryTemp + "\" -x c++ \"" + sourceTemp + "\" 2>\"" + log + "\"";
+        bool built = system(command.c_str()) == 0 && rename(libraryTemp.c_str(), library.c_str()) == 0
+            && rename(sourceTemp.c_str(), sourcePath.c_str()) == 0;
+        if (!built) {
+            unlink(libraryTemp.c_str());
+            unlink(sourceTemp.c_str());
+            error = "ошибка компиляции (" + command + ")";
+            return nullptr;
+        }
+    }
+
+    void* handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        const char* reason = dlerror();
+        error = string("не удалось загрузить ") + library + ": " + (reason ? reason : "");
+        return nullptr;
+    }
+    void* symbol = dlsym(handle, "aot_main");
+    if (!symbol) {
+        dlclose(handle);
+        error = "в " + library + " нет aot_main";
+        return nullptr;
+    }
+
+    AotModule* module = new AotModule();
+    module->program = program;
+    module->handle = handle;
+    module->entry = reinterpret_cast<Entry>(symbol);
+    module->cached = cached;
+    return module;
+}
+
+AotModule::~AotModule() {
+    if (handle) dlclose(handle);
+}
+
+struct AotRun {
+    void (*entry)(const void* host);
+    const AotHost* host;
+    exception_ptr error;
+};
+
+static void* aotThread(void* arg) {
+    AotRun* run = static_cast<AotRun*>(arg);
+    try {
+        run->entry(run->host);
+    }
+    catch (...) {
+        run->error = current_exception();
+    }
+    return nullptr;
+}
+
+void AotModule::run() {
+    Tree::enableInterpretation();
+
+    globals.assign(program->globalNames.size(), 0);
+    globalInits.assign(program->globalNames.size(), 0);
+
+    AotHost host;
+    host.globals = globals.data();
+    host.globalInits = globalInits.data();
+    host.maxDepth = Tree::getMaxRecursionDepth();
+    host.module = this;
+    host.fail = &AotModule::fail;
+    host.truncated = &AotModule::truncated;
+
+    // Вызовы сгенерированного кода идут по стеку C++: он выделяется отдельному потоку
+    // с запасом на --max-depth вложенных вызовов самой большой функции
+    int maxRegs = 0;
+    for (const BcFunction& f : program->functions) {
+        if (f.numRegs > maxRegs) maxRegs = f.numRegs;
+    }
+    size_t frame = 64 + 16 * static_cast<size_t>(maxRegs);
+    size_t stack = (static_cast<size_t>(host.maxDepth) + 16) * frame + (1 << 20);
+
+    AotRun run;
+    run.entry = entry;
+    run.host = &host;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_t thread;
+    bool started = pthread_attr_setstacksize(&attr, stack) == 0
+        && pthread_create(&thread, &attr, aotThread, &run) == 0;
+    pthread_attr_destroy(&attr);
+    if (!started) {
+        Tree::interpError("не удалось выделить стек на " + to_string(stack) + " байт для --max-depth");
+    }
+    pthread_join(thread, nullptr);
+    if (run.error) rethrow_exception(run.error);
+}
+
+#else
+
+// Другие платформы: загрузка библиотек не поддерживается
+bool AotModule::supported() { return false; }
+
+AotModule* AotModule::load(BcProgram*, string& error) {
+    error = "AOT-компиляция недоступна на этой платформе";
+    return nullptr;
+}
+
+AotModule::~AotModule() {}
+
+void AotModule::run() {}
+
+#endif
@@ -0,0 +1,57 @@
+﻿#pragma once
+#include "Bytecode.h"
+#include "Value.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Опережающая (AOT) компиляция: байт-код программы (без отладочного вывода) переводится
+// в эквивалентный текст на C++, который собирается установленным компилятором в разделяемую
+// библиотеку и загружается через dlopen.
+// Каждая функция языка становится функцией C++, регистры — её локальными переменными,
+// переходы — goto, SWITCH — оператором switch. Обрезка и переполнение повторяют
+// castToType / Value.h, проверки деления на ноль, инициализации переменных и глубины
+// рекурсии сохранены; сообщения об ошибках и предупреждения печатает транслятор (обратным
+// вызовом), поэтому они совпадают с VM.
+// Библиотека кешируется в каталоге пользователя ($XDG_CACHE_HOME или ~/.cache) под хешем
+// сгенерированного текста; текст хранится рядом и сравнивается перед повторным использованием.
+// Повторный запуск той же программы компилятор не вызывает.
+class AotModule {
+public:
+    // Доступна ли AOT-компиляция на этой платформе (dlopen)
+    static bool supported();
+
+    // Текст C++ для программы; bytecode должен быть скомпилирован без debug
+    static std::string generate(const BcProgram& program);
+
+    // Сборка (или поиск в кеше) и загрузка библиотеки. При ошибке — nullptr и описание в error
+    static AotModule* load(BcProgram* program, std::string& error);
+
+    ~AotModule();
+    AotModule(const AotModule&) = delete;
+    AotModule& operator=(const AotModule&) = delete;
+
+    // Инициализация глобальных переменных и выполнение main
+    void run();
+
+    // Значение глобальной переменной после выполнения (для тестов)
+    Value globalValue(const std::string& name) const;
+
+    // Библиотека взята из кеша (компилятор не запускался)
+    bool fromCache() const { return cached; }
+
+private:
+    typedef void (*Entry)(const void* host);
+
+    BcProgram* program;
+    void* handle;
+    Entry entry;
+    bool cached;
+    std::vector<int64_t> globals;
+    std::vector<uint8_t> globalInits;
+
+    AotModule() : program(nullptr), handle(nullptr), entry(nullptr), cached(false) {}
+
+    static void fail(void* module, int fn, int pc);
+    static void truncated(void* module, int fn, int pc, int64_t value);
+};
@@ -0,0 +1,68 @@
+﻿#include "Arena.h"
+#include <cstdint>
+
+Arena::Arena(size_t chunkSize)
+    : chunkSize(chunkSize), current(0), offset(0), used(0), peak(0), allocations(0) {}
+
+Arena::~Arena() {
+    for (Chunk& c : chunks) delete[] c.data;
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    for (;;) {
+        if (current < chunks.size()) {
+            Chunk& c = chunks[current];
+            uintptr_t base = reinterpret_cast<uintptr_t>(c.data);
+            size_t start = static_cast<size_t>(((base + offset + align - 1) & ~(uintptr_t)(align - 1)) - base);
+            if (start + size <= c.size) {
+                used += start - offset + size;
+                offset = start + size;
+                if (used > peak) peak = used;
+                allocations++;
+                return c.data + start;
+            }
+            // Остаток блока не подходит — переходим к следующему (сохранённому или новому)
+            if (current + 1 < chunks.size() && chunks[current + 1].size >= size + align) {
+                current++;
+                offset = 0;
+                continue;
+            }
+        }
+
+        size_t bytes = size + align > chunkSize ? size + align : chunkSize;
+        Chunk c = { new char[bytes], bytes };
+        size_t at = chunks.empty() ? 0 : current + 1;
+        chunks.insert(chunks.begin() + at, c);
+        current = at;
+        offset = 0;
+    }
+}
+
+void Arena::release(const Mark& m) {
+    current = m.chunk;
+    offset = m.offset;
+    used = m.used;
+}
+
+void Arena::reset() {
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+size_t Arena::bytesReserved() const {
+    size_t total = 0;
+    for (const Chunk& c : chunks) total += c.size;
+    return total;
+}
+
+void Arena::printStats(const string& title, ostream& out) const {
+    out << title << ": занято " << used << " байт, пик " << peak
+        << " байт, зарезервировано " << bytesReserved() << " байт в " << chunks.size()
+        << " блоках, выделений " << allocations << endl;
+}
+
+Arena& nodeArena() {
+    static Arena arena;
+    return arena;
+}
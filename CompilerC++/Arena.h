@@ -0,0 +1,56 @@
+﻿#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Арена с выделением сдвигом указателя: память берётся подряд из крупных блоков.
+// Отдельные объекты не освобождаются — арена откатывается к отметке (release) или
+// очищается целиком (reset) за O(1); блоки при этом остаются для повторного использования
+class Arena {
+public:
+    // Состояние арены, к которому можно откатиться
+    struct Mark {
+        size_t chunk;
+        size_t offset;
+        size_t used;
+    };
+
+    explicit Arena(size_t chunkSize = 64 * 1024);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(max_align_t));
+
+    Mark mark() const { return Mark{ current, offset, used }; }
+    void release(const Mark& m);
+    void reset();
+
+    size_t bytesUsed() const { return used; } // занято сейчас
+    size_t peakBytes() const { return peak; } // наибольшая занятость за всё время
+    size_t bytesReserved() const; // получено у системы (сумма размеров блоков)
+    size_t chunkCount() const { return chunks.size(); } // обращений к системному распределителю
+    size_t allocationCount() const { return allocations; } // выделений из арены
+
+    void printStats(const string& title, ostream& out) const;
+
+private:
+    struct Chunk {
+        char* data;
+        size_t size;
+    };
+
+    vector<Chunk> chunks;
+    size_t chunkSize;
+    size_t current; // блок, из которого идёт выделение
+    size_t offset; // занятая часть текущего блока
+    size_t used;
+    size_t peak;
+    size_t allocations;
+};
+
+// Арена узлов семантического дерева (Tree и SemNode); очищается в Tree::reset
+Arena& nodeArena();
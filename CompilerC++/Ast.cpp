@@ -0,0 +1,70 @@
+﻿#include "Ast.h"
+
+// Деструкторы: узлы AST владеют своими потомками.
+// Копии нужны оптимизациям, которые размножают код (встраивание и специализация функций)
+
+ExprNode::~ExprNode() {
+    delete left;
+    delete right;
+}
+
+StmtNode::~StmtNode() {
+    for (StmtNode* s : body) delete s;
+    delete value;
+    for (ExprNode* a : args) delete a;
+    for (CaseNode* c : cases) delete c;
+    delete table;
+}
+
+CaseNode::~CaseNode() {
+    for (StmtNode* s : body) delete s;
+}
+
+FuncNode::~FuncNode() {
+    delete body;
+}
+
+ProgramNode::~ProgramNode() {
+    for (FuncNode* f : functions) delete f;
+    for (StmtNode* s : globals) delete s;
+}
+
+ExprNode* ExprNode::clone() const {
+    ExprNode* copy = new ExprNode(kind, type, loc);
+    copy->value = value;
+    copy->name = name;
+    copy->decl = decl;
+    copy->slot = slot;
+    copy->checkInit = checkInit;
+    copy->op = op;
+    copy->group = group;
+    copy->kernel = kernel;
+    copy->checkZero = checkZero;
+    copy->fits = fits;
+    copy->left = left ? left->clone() : nullptr;
+    copy->right = right ? right->clone() : nullptr;
+    return copy;
+}
+
+StmtNode* StmtNode::clone() const {
+    StmtNode* copy = new StmtNode(kind, loc);
+    for (StmtNode* s : body) copy->body.push_back(s->clone());
+    copy->name = name;
+    copy->declType = declType;
+    copy->decl = decl;
+    copy->slot = slot;
+    copy->value = value ? value->clone() : nullptr;
+    copy->fits = fits;
+    for (ExprNode* a : args) copy->args.push_back(a->clone());
+    copy->callee = callee;
+    copy->tail = tail;
+    for (CaseNode* c : cases) copy->cases.push_back(c->clone());
+    copy->table = table ? new SwitchTable(*table) : nullptr;
+    return copy;
+}
+
+CaseNode* CaseNode::clone() const {
+    CaseNode* copy = new CaseNode(isDefault, value, loc);
+    for (StmtNode* s : body) copy->body.push_back(s->clone());
+    return copy;
+}
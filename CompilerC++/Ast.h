@@ -0,0 +1,166 @@
+﻿#pragma once
+#include "SemNode.h"
+#include "DataType.h"
+#include "Value.h"
+#include "Kernels.h"
+#include "SwitchTable.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Tree;
+
+// Абстрактное синтаксическое дерево (AST) программы.
+// Строится один раз за проход ParseProgram (вместе с семантическим анализом),
+// после чего исполняется Executor'ом без повторного разбора исходного текста.
+
+// Виды выражений
+enum EXPR_KIND {
+    EXPR_CONST, // константа (значение вычислено при разборе)
+    EXPR_VAR, // обращение к переменной
+    EXPR_NEG, // унарный минус над выражением (не константой)
+    EXPR_BINARY, // бинарная операция
+    EXPR_CAST // приведение операнда к типу узла (castToType, без предупреждения) — при встраивании
+};
+
+// Группа бинарной операции (определяет, какой из Tree::execute*Op вызывать)
+enum OP_GROUP {
+    OP_ARITHMETIC, // + - * / %
+    OP_SHIFT, // << >>
+    OP_COMPARISON // == != < <= > >=
+};
+
+struct ExprNode {
+    EXPR_KIND kind;
+    DATA_TYPE type; // тип результата (вычислен при семантическом анализе)
+    SrcLoc loc; // позиция для сообщений и отладочного вывода
+
+    Value value; // EXPR_CONST: значение константы
+
+    string name; // EXPR_VAR: имя переменной
+    Tree* decl; // EXPR_VAR: узел описания переменной в семантическом дереве
+    VarSlot slot; // EXPR_VAR: ячейка переменной
+    // EXPR_VAR: проверять при чтении, что переменная инициализирована (DefiniteAssignment
+    // снимает проверку там, где присваивание заведомо выполнено)
+    bool checkInit;
+
+    BIN_OP op; // EXPR_BINARY: операция; EXPR_NEG: BOP_MUL — умножение на -1, BOP_SUB — вычитание из 0 (Simplifier)
+    OP_GROUP group; // EXPR_BINARY: группа операции
+    // EXPR_BINARY / EXPR_NEG: ядро операции для типов операндов, выбранное при проверке типов
+    BinKernel kernel;
+    // EXPR_BINARY (/ и %): делитель может быть равен 0 (RangeAnalysis снимает проверку, доказав обратное)
+    bool checkZero;
+    // EXPR_CAST: значение операнда заведомо помещается в тип узла — приведение ничего не меняет
+    bool fits;
+    ExprNode* left; // EXPR_BINARY: левый операнд; EXPR_NEG / EXPR_CAST: операнд
+    ExprNode* right; // EXPR_BINARY: правый операнд
+
+    ExprNode(EXPR_KIND k, DATA_TYPE t, SrcLoc l)
+        : kind(k), type(t), loc(l), decl(nullptr), checkInit(true),
+        op(BOP_ADD), group(OP_ARITHMETIC), kernel(nullptr), checkZero(true), fits(false),
+        left(nullptr), right(nullptr) {}
+    ~ExprNode();
+    ExprNode* clone() const; // глубокая копия
+    ExprNode(const ExprNode&) = delete;
+    ExprNode& operator=(const ExprNode&) = delete;
+};
+
+// Виды операторов
+enum STMT_KIND {
+    STMT_EMPTY, // ';'
+    STMT_BLOCK, // '{' ... '}'
+    STMT_VAR_DECL, // описание одной переменной (IdInit) с необязательной инициализацией
+    STMT_ASSIGN, // IDENT '=' Expr
+    STMT_CALL, // IDENT '(' ArgListOpt ')'
+    STMT_SWITCH, // switch
+    STMT_BREAK // break (допустим только непосредственно в ветке switch)
+};
+
+struct FuncNode;
+struct CaseNode;
+
+struct StmtNode {
+    STMT_KIND kind;
+    SrcLoc loc;
+
+    vector<StmtNode*> body; // STMT_BLOCK: операторы блока
+
+    string name; // STMT_VAR_DECL / STMT_ASSIGN: имя переменной; STMT_CALL: имя функции
+    DATA_TYPE declType; // STMT_VAR_DECL: тип описываемой переменной
+    Tree* decl; // узел описания переменной (или функции для STMT_CALL)
+    VarSlot slot; // STMT_VAR_DECL / STMT_ASSIGN: ячейка переменной
+    ExprNode* value; // STMT_VAR_DECL: инициализатор (может отсутствовать); STMT_ASSIGN: правая часть;
+                     // STMT_SWITCH: выражение-селектор
+    // STMT_VAR_DECL / STMT_ASSIGN: значение заведомо помещается в тип переменной (RangeAnalysis) —
+    // присваивание без проверки обрезки и приведения
+    bool fits;
+
+    vector<ExprNode*> args; // STMT_CALL: фактические параметры
+    FuncNode* callee; // STMT_CALL: вызываемая функция
+    bool tail; // STMT_CALL: хвостовой вызов — после него функция завершается
+
+    vector<CaseNode*> cases; // STMT_SWITCH: ветви (default, если есть, — последняя)
+    SwitchTable* table; // STMT_SWITCH: номер ветви, с которой начинается исполнение (cases.size() — ни одной)
+
+    StmtNode(STMT_KIND k, SrcLoc l)
+        : kind(k), loc(l), declType(TYPE_INT), decl(nullptr),
+        value(nullptr), fits(false), callee(nullptr), tail(false), table(nullptr) {}
+    ~StmtNode();
+    StmtNode* clone() const; // глубокая копия (вызовы ссылаются на те же функции)
+    StmtNode(const StmtNode&) = delete;
+    StmtNode& operator=(const StmtNode&) = delete;
+};
+
+// Ветвь switch: case Const ':' Stmt* или default ':' Stmt*
+struct CaseNode {
+    bool isDefault;
+    long long value; // значение case-метки
+    SrcLoc loc;
+    vector<StmtNode*> body;
+
+    CaseNode(bool def, long long v, SrcLoc l) : isDefault(def), value(v), loc(l) {}
+    ~CaseNode();
+    CaseNode* clone() const;
+    CaseNode(const CaseNode&) = delete;
+    CaseNode& operator=(const CaseNode&) = delete;
+};
+
+// Описание функции
+struct FuncNode {
+    string name;
+    Tree* decl; // узел функции в семантическом дереве
+    vector<string> paramNames;
+    vector<DATA_TYPE> paramTypes;
+    vector<Tree*> paramDecls; // узлы описаний параметров в семантическом дереве
+    // Типы ячеек кадра: сначала параметры, затем локальные переменные всех вложенных
+    // блоков в порядке описания (блоки уплощаются в кадр функции)
+    vector<DATA_TYPE> slotTypes;
+    StmtNode* body; // тело функции (STMT_BLOCK)
+    SrcLoc loc;
+
+    // Мемоизация вызовов (EffectAnalysis): номер таблицы в MemoCache (-1 — вызовы не запоминаются).
+    // Ключ — аргументы и значения глобальных переменных memoReads при входе, результат —
+    // значения глобальных переменных memoWrites после вызова (индексы — VarSlot::index)
+    int memoId;
+    vector<int> memoReads;
+    vector<int> memoWrites;
+
+    FuncNode(const string& n, Tree* d, SrcLoc l) : name(n), decl(d), body(nullptr), loc(l), memoId(-1) {}
+    ~FuncNode();
+    FuncNode(const FuncNode&) = delete;
+    FuncNode& operator=(const FuncNode&) = delete;
+};
+
+// Программа целиком
+struct ProgramNode {
+    vector<FuncNode*> functions; // функции в порядке описания
+    vector<StmtNode*> globals; // описания глобальных переменных (STMT_VAR_DECL) в порядке следования
+    FuncNode* main; // void main() — точка входа (может отсутствовать)
+    size_t mainAfter; // число глобальных описаний, предшествующих main
+
+    ProgramNode() : main(nullptr), mainAfter(0) {}
+    ~ProgramNode();
+    ProgramNode(const ProgramNode&) = delete;
+    ProgramNode& operator=(const ProgramNode&) = delete;
+};
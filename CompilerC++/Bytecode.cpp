@@ -0,0 +1,144 @@
+﻿#include "Bytecode.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+const char* opcodeName(OPCODE op) {
+    switch (op) {
+    case OP_LOADK: return "LOADK";
+    case OP_MOV: return "MOV";
+    case OP_LOADG: return "LOADG";
+    case OP_STL: return "STL";
+    case OP_STG: return "STG";
+    case OP_CHKL: return "CHKL";
+    case OP_CHKG: return "CHKG";
+    case OP_ADD_S: return "ADD_S";
+    case OP_ADD_I: return "ADD_I";
+    case OP_ADD_L: return "ADD_L";
+    case OP_SUB_S: return "SUB_S";
+    case OP_SUB_I: return "SUB_I";
+    case OP_SUB_L: return "SUB_L";
+    case OP_MUL_S: return "MUL_S";
+    case OP_MUL_I: return "MUL_I";
+    case OP_MUL_L: return "MUL_L";
+    case OP_DIV_S: return "DIV_S";
+    case OP_DIV_I: return "DIV_I";
+    case OP_DIV_L: return "DIV_L";
+    case OP_MOD_S: return "MOD_S";
+    case OP_MOD_I: return "MOD_I";
+    case OP_MOD_L: return "MOD_L";
+    case OP_QUO_S: return "QUO_S";
+    case OP_QUO_I: return "QUO_I";
+    case OP_QUO_L: return "QUO_L";
+    case OP_REM_S: return "REM_S";
+    case OP_REM_I: return "REM_I";
+    case OP_REM_L: return "REM_L";
+    case OP_SHL_S: return "SHL_S";
+    case OP_SHL_I: return "SHL_I";
+    case OP_SHL_L: return "SHL_L";
+    case OP_SHR_S: return "SHR_S";
+    case OP_SHR_I: return "SHR_I";
+    case OP_SHR_L: return "SHR_L";
+    case OP_NEG_S: return "NEG_S";
+    case OP_NEG_I: return "NEG_I";
+    case OP_NEG_L: return "NEG_L";
+    case OP_SHLK_S: return "SHLK_S";
+    case OP_SHLK_I: return "SHLK_I";
+    case OP_SHLK_L: return "SHLK_L";
+    case OP_DIVP2: return "DIVP2";
+    case OP_MODP2: return "MODP2";
+    case OP_ADDK_S: return "ADDK_S";
+    case OP_ADDK_I: return "ADDK_I";
+    case OP_ADDK_L: return "ADDK_L";
+    case OP_MULK_S: return "MULK_S";
+    case OP_MULK_I: return "MULK_I";
+    case OP_MULK_L: return "MULK_L";
+    case OP_QUOK_S: return "QUOK_S";
+    case OP_QUOK_I: return "QUOK_I";
+    case OP_QUOK_L: return "QUOK_L";
+    case OP_REMK_S: return "REMK_S";
+    case OP_REMK_I: return "REMK_I";
+    case OP_REMK_L: return "REMK_L";
+    case OP_ADDG_S: return "ADDG_S";
+    case OP_ADDG_I: return "ADDG_I";
+    case OP_ADDG_L: return "ADDG_L";
+    case OP_SUBG_S: return "SUBG_S";
+    case OP_SUBG_I: return "SUBG_I";
+    case OP_SUBG_L: return "SUBG_L";
+    case OP_EQ: return "EQ";
+    case OP_NE: return "NE";
+    case OP_LT: return "LT";
+    case OP_LE: return "LE";
+    case OP_GT: return "GT";
+    case OP_GE: return "GE";
+    case OP_CAST_S: return "CAST_S";
+    case OP_CAST_I: return "CAST_I";
+    case OP_NARROW_S: return "NARROW_S";
+    case OP_NARROW_I: return "NARROW_I";
+    case OP_JMP: return "JMP";
+    case OP_JT: return "JT";
+    case OP_JF: return "JF";
+    case OP_JEQ: return "JEQ";
+    case OP_JNE: return "JNE";
+    case OP_JEQK: return "JEQK";
+    case OP_JNEK: return "JNEK";
+    case OP_SWITCH: return "SWITCH";
+    case OP_CALL: return "CALL";
+    case OP_TAILCALL: return "TAILCALL";
+    case OP_RET: return "RET";
+    case OP_TRACE_ASSIGN: return "TRACE_ASSIGN";
+    case OP_TRACE_CONV: return "TRACE_CONV";
+    case OP_TRACE_ARITH: return "TRACE_ARITH";
+    case OP_TRACE_CALL: return "TRACE_CALL";
+    case OP_COUNT: break;
+    }
+    return "?";
+}
+
+DispatchProfile::DispatchProfile() {
+    clear();
+}
+
+void DispatchProfile::clear() {
+    dispatches = 0;
+    original = 0;
+    ops.assign(OP_COUNT, 0);
+    pairs.assign(static_cast<size_t>(OP_COUNT) * OP_COUNT, 0);
+    last = OP_RET;
+}
+
+void DispatchProfile::printStats(const string& title, ostream& out, size_t top) const {
+    out << title << ": исполнено инструкций " << dispatches << ", без объединения было бы " << original << endl;
+    vector<size_t> order;
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        if (pairs[i]) order.push_back(i);
+    }
+    sort(order.begin(), order.end(), [this](size_t a, size_t b) { return pairs[a] > pairs[b]; });
+    if (order.size() > top) order.resize(top);
+    for (size_t i : order) {
+        out << "  " << opcodeName(static_cast<OPCODE>(i / OP_COUNT)) << " -> " << opcodeName(static_cast<OPCODE>(i % OP_COUNT))
+            << ": " << pairs[i] << " (" << fixed << setprecision(1) << 100.0 * pairs[i] / dispatches << "%)" << endl;
+    }
+    out.unsetf(ios::floatfield);
+}
+
+void dumpBytecode(const BcProgram& program, ostream& out) {
+    for (size_t f = 0; f < program.functions.size(); ++f) {
+        const BcFunction& fn = program.functions[f];
+        out << "function " << f << " " << fn.name << " (параметров: " << fn.numParams
+            << ", регистров: " << fn.numRegs << ")" << endl;
+        for (size_t pc = 0; pc < fn.code.size(); ++pc) {
+            const Instr& in = fn.code[pc];
+            out << "  " << pc << ": " << opcodeName(in.op) << " " << in.a << " " << in.b << " " << in.c;
+            if (in.op == OP_LOADK) out << "    ; " << fn.consts[in.b];
+            if (in.op == OP_SWITCH) {
+                const SwitchTable& table = fn.switches[in.b];
+                out << "    ; ";
+                if (table.dense) out << "таблица [" << table.minLabel << ", " << table.minLabel + (long long)table.jump.size() << ")";
+                else out << "двоичный поиск по " << table.labels.size() << " меткам";
+                out << ", иначе " << table.defaultTarget;
+            }
+            out << endl;
+        }
+    }
+}
@@ -0,0 +1,169 @@
+﻿#pragma once
+#include "DataType.h"
+#include "SourceManager.h"
+#include "SwitchTable.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Tree;
+
+// Регистровый байт-код для VM.
+// Все значения хранятся в 64-битных регистрах в канонической форме: знаково расширенными
+// из разрядности своего типа (short — 16 бит, int — 32, long — 64, bool — 0/1).
+// Благодаря этому расширяющие приведения (getMaxType) ничего не стоят, а сужающие
+// (castToType) сводятся к знаковому расширению младших разрядов.
+// Суффиксы кодов операций: _S — short, _I — int, _L — long.
+enum OPCODE : uint8_t {
+    OP_LOADK, // r[a] = consts[b]
+    OP_MOV, // r[a] = r[b]
+    OP_LOADG, // r[a] = globals[b]
+    OP_STL, // r[a] = r[b], переменная r[a] помечается инициализированной (если её проверяет OP_CHKL)
+    OP_STG, // globals[a] = r[b], глобальная переменная помечается инициализированной
+    OP_CHKL, // ошибка, если локальная переменная r[a] не инициализирована (sites[b])
+    OP_CHKG, // ошибка, если глобальная переменная globals[a] не инициализирована (sites[b])
+
+    OP_ADD_S, OP_ADD_I, OP_ADD_L, // r[a] = r[b] + r[c]
+    OP_SUB_S, OP_SUB_I, OP_SUB_L, // r[a] = r[b] - r[c]
+    OP_MUL_S, OP_MUL_I, OP_MUL_L, // r[a] = r[b] * r[c]
+    OP_DIV_S, OP_DIV_I, OP_DIV_L, // r[a] = r[b] / r[c] (с проверкой деления на ноль)
+    OP_MOD_S, OP_MOD_I, OP_MOD_L, // r[a] = r[b] % r[c] (с проверкой деления на ноль)
+    OP_QUO_S, OP_QUO_I, OP_QUO_L, // r[a] = r[b] / r[c], делитель заведомо не 0 (RangeAnalysis)
+    OP_REM_S, OP_REM_I, OP_REM_L, // r[a] = r[b] % r[c], делитель заведомо не 0
+    OP_SHL_S, OP_SHL_I, OP_SHL_L, // r[a] = r[b] << r[c]
+    OP_SHR_S, OP_SHR_I, OP_SHR_L, // r[a] = r[b] >> r[c]
+    OP_NEG_S, OP_NEG_I, OP_NEG_L, // r[a] = -r[b]
+    OP_SHLK_S, OP_SHLK_I, OP_SHLK_L, // r[a] = r[b] << c (счётчик — константа, уже ограничен разрядностью)
+    OP_DIVP2, // r[a] = r[b] / 2^c сдвигом с округлением к нулю (для всех типов)
+    OP_MODP2, // r[a] = r[b] % 2^c
+    // Суперинструкции Peephole: второй операнд — константа c (LOADK перед операцией)
+    OP_ADDK_S, OP_ADDK_I, OP_ADDK_L, // r[a] = r[b] + c (и r[b] - k как r[b] + (-k))
+    OP_MULK_S, OP_MULK_I, OP_MULK_L, // r[a] = r[b] * c
+    OP_QUOK_S, OP_QUOK_I, OP_QUOK_L, // r[a] = r[b] / c, c != 0
+    OP_REMK_S, OP_REMK_I, OP_REMK_L, // r[a] = r[b] % c, c != 0
+    // Суперинструкции Peephole: результат сразу в глобальную переменную (операция перед OP_STG)
+    OP_ADDG_S, OP_ADDG_I, OP_ADDG_L, // globals[a] = r[b] + r[c], переменная помечается инициализированной
+    OP_SUBG_S, OP_SUBG_I, OP_SUBG_L, // globals[a] = r[b] - r[c]
+
+    OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, // r[a] = (r[b] op r[c]) — результат bool
+
+    OP_CAST_S, // r[a] = (short)r[b]
+    OP_CAST_I, // r[a] = (int)r[b]
+    OP_NARROW_S, // r[a] = (short)r[b] с предупреждением об обрезке при присваивании (sites[c])
+    OP_NARROW_I, // r[a] = (int)r[b] с предупреждением об обрезке при присваивании (sites[c])
+
+    OP_JMP, // pc = a
+    OP_JT, // if (r[a]) pc = b
+    OP_JF, // if (!r[a]) pc = b
+    // Сравнение с переходом (Peephole: switch с одной меткой, перед ним вычитание)
+    OP_JEQ, // if (r[a] == r[b]) pc = c
+    OP_JNE, // if (r[a] != r[b]) pc = c
+    OP_JEQK, // if (r[a] == b) pc = c
+    OP_JNEK, // if (r[a] != b) pc = c
+    OP_SWITCH, // pc = switches[b].find(r[a])
+
+    OP_CALL, // вызов functions[a]; аргументы (уже приведённые к типам параметров) в r[b..]; sites[c]
+    OP_TAILCALL, // хвостовой вызов functions[a] в окне и кадре текущей функции; аргументы в r[b..]
+    OP_RET, // возврат из функции
+
+    // Отладочный вывод (генерируется только при включённом debug)
+    OP_TRACE_ASSIGN, // присваивание (sites[a])
+    OP_TRACE_CONV, // предупреждение о неявном преобразовании (sites[a])
+    OP_TRACE_ARITH, // арифметическая операция (sites[a])
+    OP_TRACE_CALL, // вызов функции (sites[a])
+
+    OP_COUNT // число кодов операций (не инструкция)
+};
+
+struct Instr {
+    OPCODE op;
+    int32_t a;
+    int32_t b;
+    int32_t c;
+};
+
+// Описание места программы: для сообщений об ошибках и отладочного вывода.
+// Используется только на медленных путях, поэтому не экономится.
+struct SiteInfo {
+    string name; // имя переменной / функции или знак операции
+    string context; // контекст предупреждения о преобразовании типа
+    SrcLoc loc;
+    DATA_TYPE type1; // тип значения (источник преобразования, левый операнд...)
+    DATA_TYPE type2; // тип назначения (приёмник преобразования, тип результата...)
+    int reg1; // регистры/индексы, на которые ссылается отладочный вывод
+    int reg2;
+    int reg3;
+    bool global; // reg1 — индекс глобальной переменной, а не регистр
+    bool warnConversion; // OP_NARROW_*: при отсутствии обрезки печатать предупреждение о преобразовании
+    bool countDepth; // OP_CALL: учитывать вызов в глубине рекурсии (false для вызова main)
+    vector<DATA_TYPE> types; // OP_TRACE_CALL: типы аргументов
+
+    SiteInfo() : type1(TYPE_INT), type2(TYPE_INT), reg1(0), reg2(0), reg3(0),
+        global(false), warnConversion(false), countDepth(true) {}
+};
+
+struct BcFunction {
+    string name;
+    Tree* decl; // узел функции в семантическом дереве (для отладочного контекста); nullptr для <init>
+    int numParams;
+    int numRegs; // параметры, затем локальные переменные, затем временные регистры
+    vector<Instr> code;
+    vector<SrcLoc> locs; // позиция в исходном тексте для каждой инструкции
+    vector<int64_t> consts;
+    vector<SiteInfo> sites;
+    vector<SwitchTable> switches; // таблицы переходов OP_SWITCH (цели — адреса инструкций)
+    // Мемоизация вызовов (как FuncNode::memoId / memoReads / memoWrites; -1 — нет)
+    int memoId;
+    vector<int> memoReads;
+    vector<int> memoWrites;
+    // Регистры, которые проверяет OP_CHKL: только у них признак инициализации сбрасывается
+    // при входе (у остальных он не читается, и OP_STL для них заменён на OP_MOV)
+    vector<int> checkedLocals;
+    // Сколько инструкций исходного байт-кода заменяет каждая инструкция после Peephole
+    // (объединение и удаление); пусто — по одной
+    vector<uint8_t> merged;
+
+    BcFunction() : decl(nullptr), numParams(0), numRegs(0), memoId(-1) {}
+};
+
+struct BcProgram {
+    vector<BcFunction> functions; // функции программы в порядке описания, последней — <init>
+    int entry; // индекс <init>: инициализация глобальных переменных и вызов main
+    vector<string> globalNames;
+    vector<DATA_TYPE> globalTypes;
+
+    BcProgram() : entry(-1) {}
+};
+
+// Профиль исполнения байт-кода интерпретатором VM: число выбранных циклом диспетчеризации
+// инструкций, число инструкций исходного байт-кода, которые они заменяют (BcFunction::merged),
+// и частоты кодов операций и пар подряд исполненных кодов (по ним выбран набор суперинструкций)
+struct DispatchProfile {
+    uint64_t dispatches;
+    uint64_t original;
+    vector<uint64_t> ops; // [op]
+    vector<uint64_t> pairs; // [предыдущий * OP_COUNT + следующий]
+    OPCODE last; // код предыдущей исполненной инструкции
+
+    DispatchProfile();
+    void clear();
+    void count(const BcFunction& fn, size_t pc) {
+        OPCODE op = fn.code[pc].op;
+        dispatches++;
+        original += fn.merged.empty() ? 1 : fn.merged[pc];
+        ops[op]++;
+        pairs[last * OP_COUNT + op]++;
+        last = op;
+    }
+
+    // Итог и top самых частых пар с долей от всех исполненных инструкций
+    void printStats(const string& title, ostream& out, size_t top) const;
+};
+
+const char* opcodeName(OPCODE op);
+
+// Текстовый листинг байт-кода (для отладки компилятора)
+void dumpBytecode(const BcProgram& program, ostream& out);
@@ -0,0 +1,467 @@
+﻿#include "BytecodeCompiler.h"
+#include "Simplify.h"
+#include "Tree.h"
+
+static OPCODE typedOp(OPCODE shortOp, DATA_TYPE type) {
+    // Коды для short/int/long идут подряд
+    switch (type) {
+    case TYPE_SHORT_INT: return shortOp;
+    case TYPE_INT: return static_cast<OPCODE>(shortOp + 1);
+    default: return static_cast<OPCODE>(shortOp + 2);
+    }
+}
+
+BytecodeCompiler::BytecodeCompiler(bool debug)
+    : debug(debug), out(nullptr), fn(nullptr), firstTemp(0), nextTemp(0) {}
+
+BcProgram* BytecodeCompiler::compile(ProgramNode* program) {
+    out = new BcProgram();
+    funcIndex.clear();
+    peephole = Peephole();
+
+    // Глобальные переменные нумеруются при разборе в порядке описания
+    for (StmtNode* g : program->globals) {
+        out->globalNames.push_back(g->name);
+        out->globalTypes.push_back(g->declType);
+    }
+
+    // Индексы назначаются заранее: вызов может ссылаться на ещё не скомпилированную функцию
+    out->functions.resize(program->functions.size() + 1);
+    for (size_t i = 0; i < program->functions.size(); ++i) {
+        funcIndex[program->functions[i]] = static_cast<int>(i);
+    }
+
+    for (size_t i = 0; i < program->functions.size(); ++i) {
+        compileFunction(program->functions[i], out->functions[i]);
+    }
+
+    out->entry = static_cast<int>(program->functions.size());
+    compileInit(program, out->functions[out->entry]);
+
+    BcProgram* result = out;
+    out = nullptr;
+    fn = nullptr;
+    return result;
+}
+
+void BytecodeCompiler::compileFunction(FuncNode* func, BcFunction& target) {
+    fn = &target;
+    fn->name = func->name;
+    fn->decl = func->decl;
+    fn->numParams = static_cast<int>(func->paramDecls.size());
+    // Повтор запомненного вызова пропустил бы отладочный вывод внутри него
+    if (!debug) {
+        fn->memoId = func->memoId;
+        fn->memoReads = func->memoReads;
+        fn->memoWrites = func->memoWrites;
+    }
+
+    int next = static_cast<int>(func->slotTypes.size());
+    firstTemp = next;
+    nextTemp = next;
+    fn->numRegs = next;
+
+    compileStmt(func->body, nullptr);
+    emit(OP_RET, 0, 0, 0, func->loc);
+
+    // Признак инициализации нужен только переменным, которые проверяет OP_CHKL:
+    // запись остальных — простая пересылка
+    std::vector<bool> checked(fn->numRegs, false);
+    for (const Instr& in : fn->code) {
+        if (in.op == OP_CHKL && !checked[in.a]) {
+            checked[in.a] = true;
+            fn->checkedLocals.push_back(in.a);
+        }
+    }
+    for (Instr& in : fn->code) {
+        if (in.op == OP_STL && !checked[in.a]) in.op = OP_MOV;
+    }
+
+    // Суперинструкции и удаление лишних приведений; отладочный вывод ссылается на регистры
+    // выражений, поэтому с debug байт-код остаётся как есть
+    if (!debug) peephole.run(*fn, func->slotTypes, out->globalTypes);
+}
+
+// Псевдофункция <init>: глобальные инициализаторы в порядке описания и вызов main между ними
+void BytecodeCompiler::compileInit(ProgramNode* program, BcFunction& target) {
+    fn = &target;
+    fn->name = "<init>";
+    fn->decl = nullptr;
+    fn->numParams = 0;
+
+    firstTemp = 0;
+    nextTemp = 0;
+    fn->numRegs = 0;
+
+    for (size_t i = 0; i <= program->globals.size(); ++i) {
+        if (i == program->mainAfter && program->main) {
+            SiteInfo site;
+            site.name = program->main->name;
+            site.loc = program->main->loc;
+            site.countDepth = false;
+            emit(OP_CALL, funcIndex[program->main], nextTemp, addSite(site), site.loc);
+        }
+        if (i == program->globals.size()) break;
+
+        StmtNode* g = program->globals[i];
+        if (g->value) {
+            nextTemp = firstTemp;
+            compileStore(g->slot, g->name, g->declType, g->value, g->fits, g->loc);
+        }
+    }
+
+    emit(OP_RET, 0, 0, 0, SrcLoc());
+    if (!debug) peephole.run(*fn, std::vector<DATA_TYPE>(), out->globalTypes);
+}
+
+void BytecodeCompiler::compileStmt(StmtNode* s, std::vector<int>* breaks) {
+    // Временные регистры живут в пределах одного оператора
+    nextTemp = firstTemp;
+
+    switch (s->kind) {
+    case STMT_EMPTY:
+        break;
+    case STMT_BLOCK:
+        for (StmtNode* item : s->body) compileStmt(item, breaks);
+        break;
+    case STMT_VAR_DECL:
+        if (s->value) compileStore(s->slot, s->name, s->declType, s->value, s->fits, s->loc);
+        break;
+    case STMT_ASSIGN:
+        compileStore(s->slot, s->name, s->decl->n->DataType, s->value, s->fits, s->loc);
+        break;
+    case STMT_CALL:
+        compileCall(s);
+        break;
+    case STMT_SWITCH:
+        compileSwitch(s);
+        break;
+    case STMT_BREAK:
+        if (breaks) breaks->push_back(emit(OP_JMP, -1, 0, 0, s->loc));
+        break;
+    }
+}
+
+// Присваивание (или инициализация) с семантикой Tree::setVarValue:
+// предупреждение об обрезке, приведение к типу переменной и отладочный вывод.
+// fits — значение заведомо помещается в тип переменной: без отладочного вывода сужение не нужно
+void BytecodeCompiler::compileStore(const VarSlot& slot, const string& name, DATA_TYPE varType, ExprNode* value,
+    bool fits, SrcLoc loc) {
+    int src = compileExpr(value);
+    DATA_TYPE valueType = value->type;
+
+    if (valueType != varType) {
+        SiteInfo site;
+        site.name = name + " = ...";
+        site.context = "присваивании";
+        site.loc = loc;
+        site.type1 = valueType;
+        site.type2 = varType;
+
+        bool narrowing = (varType == TYPE_SHORT_INT) || (varType == TYPE_INT && valueType == TYPE_LONG_INT);
+        if (narrowing && (debug || !fits)) {
+            site.warnConversion = debug;
+            int t = newTemp();
+            emit(varType == TYPE_SHORT_INT ? OP_NARROW_S : OP_NARROW_I, t, src, addSite(site), loc);
+            src = t;
+        }
+        else if (debug) {
+            emit(OP_TRACE_CONV, addSite(site), 0, 0, loc);
+        }
+    }
+
+    SiteInfo trace;
+    trace.name = name;
+    trace.loc = loc;
+    trace.type1 = varType;
+
+    if (slot.index < 0) {
+        Tree::semError("внутренняя ошибка: переменная не размещена", name, loc);
+    }
+    if (!slot.global) {
+        emit(OP_STL, slot.index, src, 0, loc);
+        trace.reg1 = slot.index;
+    }
+    else {
+        emit(OP_STG, slot.index, src, 0, loc);
+        trace.reg1 = slot.index;
+        trace.global = true;
+    }
+
+    if (debug) emit(OP_TRACE_ASSIGN, addSite(trace), 0, 0, loc);
+}
+
+void BytecodeCompiler::compileCall(StmtNode* s) {
+    FuncNode* callee = s->callee;
+    size_t argc = s->args.size();
+
+    std::vector<int> raw;
+    raw.reserve(argc);
+    for (ExprNode* arg : s->args) raw.push_back(compileExpr(arg));
+
+    // Аргументы собираются в подряд идущих регистрах: отсюда их забирает OP_CALL
+    int base = nextTemp;
+    for (size_t i = 0; i < argc; ++i) {
+        int reg = newTemp();
+        emit(OP_MOV, reg, raw[i], 0, s->loc);
+    }
+
+    if (debug) {
+        SiteInfo site;
+        site.name = s->name;
+        site.loc = s->loc;
+        site.reg1 = base;
+        site.reg2 = static_cast<int>(argc);
+        for (ExprNode* arg : s->args) site.types.push_back(arg->type);
+        emit(OP_TRACE_CALL, addSite(site), 0, 0, s->loc);
+    }
+
+    // Приведение аргументов к типам параметров (castToType, без предупреждения об обрезке)
+    for (size_t i = 0; i < argc && i < callee->paramTypes.size(); ++i) {
+        DATA_TYPE from = s->args[i]->type;
+        DATA_TYPE to = callee->paramTypes[i];
+        if (from == to) continue;
+
+        if (debug) {
+            SiteInfo site;
+            site.name = callee->paramNames[i] + " в " + s->name + "()";
+            site.context = "передаче параметра";
+            site.loc = s->loc;
+            site.type1 = from;
+            site.type2 = to;
+            emit(OP_TRACE_CONV, addSite(site), 0, 0, s->loc);
+        }
+
+        int reg = base + static_cast<int>(i);
+        if (to == TYPE_SHORT_INT) emit(OP_CAST_S, reg, reg, 0, s->loc);
+        else if (to == TYPE_INT && from == TYPE_LONG_INT) emit(OP_CAST_I, reg, reg, 0, s->loc);
+    }
+
+    SiteInfo site;
+    site.name = s->name;
+    site.loc = s->loc;
+    emit(s->tail ? OP_TAILCALL : OP_CALL, funcIndex[callee], base, addSite(site), s->loc);
+}
+
+// switch: переход по таблице (SWITCH), затем тела ветвей подряд (с проваливанием).
+// Константный селектор (после свёртки констант) даёт безусловный переход к ветви
+void BytecodeCompiler::compileSwitch(StmtNode* s) {
+    int table = -1;
+    int jump = -1;
+    if (s->value->kind == EXPR_CONST) {
+        jump = emit(OP_JMP, -1, 0, 0, s->loc);
+    }
+    else {
+        // Один переход по таблице switch из AST; номера ветвей заменяются их адресами
+        int disc = compileExpr(s->value);
+        table = static_cast<int>(fn->switches.size());
+        fn->switches.push_back(*s->table);
+        emit(OP_SWITCH, disc, table, 0, s->loc);
+    }
+
+    std::vector<int> starts; // адрес начала каждой ветви, последний — выход из switch
+    std::vector<int> breaks;
+    for (CaseNode* c : s->cases) {
+        starts.push_back(static_cast<int>(fn->code.size()));
+        for (StmtNode* item : c->body) compileStmt(item, &breaks);
+    }
+
+    int end = static_cast<int>(fn->code.size());
+    starts.push_back(end);
+    if (table >= 0) fn->switches[table].remap(starts);
+    else patchJump(jump, starts[s->table->find(s->value->value.v)]);
+    for (int b : breaks) patchJump(b, end);
+}
+
+int BytecodeCompiler::compileExpr(ExprNode* e) {
+    switch (e->kind) {
+    case EXPR_CONST: {
+        int r = newTemp();
+        emit(OP_LOADK, r, addConst(e->value.v), 0, e->loc);
+        return r;
+    }
+
+    case EXPR_VAR: {
+        SiteInfo site;
+        site.name = e->name;
+        site.loc = e->loc;
+
+        if (e->slot.index < 0) {
+            Tree::semError("внутренняя ошибка: переменная не размещена", e->name, e->loc);
+        }
+        if (!e->slot.global) {
+            // Параметры всегда инициализированы; локальные переменные проверяются при чтении,
+            // если присваивание не доказано (DefiniteAssignment)
+            if (e->slot.index >= fn->numParams && e->checkInit) {
+                emit(OP_CHKL, e->slot.index, addSite(site), 0, e->loc);
+            }
+            return e->slot.index;
+        }
+
+        if (e->checkInit) emit(OP_CHKG, e->slot.index, addSite(site), 0, e->loc);
+        int r = newTemp();
+        emit(OP_LOADG, r, e->slot.index, 0, e->loc);
+        return r;
+    }
+
+    case EXPR_NEG: {
+        int x = compileExpr(e->left);
+        if (e->op == BOP_SUB) {
+            int r = newTemp();
+            emit(typedOp(OP_NEG_S, e->type), r, x, 0, e->loc);
+            return r;
+        }
+        // Как и в интерпретаторе: умножение на -1 того же типа (с отладочным выводом)
+        int k = newTemp();
+        emit(OP_LOADK, k, addConst(-1), 0, e->loc);
+        int r = newTemp();
+        compileArith(BOP_MUL, e->type, r, x, k, e->left->type, e->left->type, true, e->loc);
+        return r;
+    }
+
+    case EXPR_CAST: {
+        // Как при передаче параметра: расширение бесплатно, сужение — знаковое расширение
+        int x = compileExpr(e->left);
+        DATA_TYPE from = e->left->type;
+        if (e->fits && !debug) return x;
+        if (e->type == TYPE_SHORT_INT && from != TYPE_SHORT_INT) {
+            int r = newTemp();
+            emit(OP_CAST_S, r, x, 0, e->loc);
+            return r;
+        }
+        if (e->type == TYPE_INT && from == TYPE_LONG_INT) {
+            int r = newTemp();
+            emit(OP_CAST_I, r, x, 0, e->loc);
+            return r;
+        }
+        return x;
+    }
+
+    case EXPR_BINARY: {
+        int left = compileExpr(e->left);
+
+        // Деление и остаток на 2^k, которым Simplifier выбрал ядро-сдвиг, и сдвиг влево на
+        // константу — число разрядов в самой инструкции
+        int k = Simplifier::powerOfTwo(e->right);
+        if (k > 0 && e->group == OP_ARITHMETIC && e->kernel == selectPow2Kernel(e->op, k) && !debug) {
+            int r = newTemp();
+            emit(e->op == BOP_DIV ? OP_DIVP2 : OP_MODP2, r, left, k, e->loc);
+            return r;
+        }
+        if (e->op == BOP_SHL && e->right->kind == EXPR_CONST) {
+            int count = static_cast<int>(e->right->value.v & (e->type == TYPE_LONG_INT ? 63 : 31));
+            int r = newTemp();
+            emit(typedOp(OP_SHLK_S, e->type), r, left, count, e->loc);
+            return r;
+        }
+
+        int right = compileExpr(e->right);
+        if (e->group == OP_ARITHMETIC) {
+            int r = newTemp();
+            compileArith(e->op, e->type, r, left, right, e->left->type, e->right->type, e->checkZero, e->loc);
+            return r;
+        }
+
+        if (e->group == OP_SHIFT) {
+            // Правый операнд сдвига приводится к int
+            if (e->right->type == TYPE_LONG_INT) {
+                int t = newTemp();
+                emit(OP_CAST_I, t, right, 0, e->loc);
+                right = t;
+            }
+            int r = newTemp();
+            OPCODE op = typedOp(e->op == BOP_SHL ? OP_SHL_S : OP_SHR_S, e->type);
+            emit(op, r, left, right, e->loc);
+            return r;
+        }
+
+        // Сравнение канонических значений не зависит от типа операндов
+        OPCODE op = OP_EQ;
+        switch (e->op) {
+        case BOP_NE: op = OP_NE; break;
+        case BOP_LT: op = OP_LT; break;
+        case BOP_LE: op = OP_LE; break;
+        case BOP_GT: op = OP_GT; break;
+        case BOP_GE: op = OP_GE; break;
+        default: break;
+        }
+        int r = newTemp();
+        emit(op, r, left, right, e->loc);
+        return r;
+    }
+    }
+
+    Tree::semError("внутренняя ошибка: неизвестный вид выражения", "", e->loc);
+    return 0;
+}
+
+// Арифметическая операция с отладочным выводом как в Tree::executeArithmeticOp;
+// checkZero == false — делитель заведомо не 0 (OP_QUO_* / OP_REM_*)
+void BytecodeCompiler::compileArith(BIN_OP op, DATA_TYPE type, int dst, int left, int right,
+    DATA_TYPE leftType, DATA_TYPE rightType, bool checkZero, SrcLoc loc) {
+    if (debug && leftType != rightType) {
+        SiteInfo site;
+        site.context = "арифметической операции";
+        site.loc = loc;
+        site.type1 = leftType;
+        site.type2 = rightType;
+        emit(OP_TRACE_CONV, addSite(site), 0, 0, loc);
+    }
+
+    OPCODE base = OP_ADD_S;
+    switch (op) {
+    case BOP_SUB: base = OP_SUB_S; break;
+    case BOP_MUL: base = OP_MUL_S; break;
+    case BOP_DIV: base = checkZero ? OP_DIV_S : OP_QUO_S; break;
+    case BOP_MOD: base = checkZero ? OP_MOD_S : OP_REM_S; break;
+    default: break;
+    }
+    emit(typedOp(base, type), dst, left, right, loc);
+
+    if (debug) {
+        SiteInfo site;
+        site.name = binOpName(op);
+        site.loc = loc;
+        site.type2 = type;
+        site.reg1 = left;
+        site.reg2 = right;
+        site.reg3 = dst;
+        emit(OP_TRACE_ARITH, addSite(site), 0, 0, loc);
+    }
+}
+
+int BytecodeCompiler::newTemp() {
+    int r = nextTemp++;
+    if (nextTemp > fn->numRegs) fn->numRegs = nextTemp;
+    return r;
+}
+
+int BytecodeCompiler::emit(OPCODE op, int a, int b, int c, SrcLoc loc) {
+    Instr in;
+    in.op = op;
+    in.a = a;
+    in.b = b;
+    in.c = c;
+    fn->code.push_back(in);
+    fn->locs.push_back(loc);
+    return static_cast<int>(fn->code.size()) - 1;
+}
+
+int BytecodeCompiler::addConst(int64_t value) {
+    for (size_t i = 0; i < fn->consts.size(); ++i) {
+        if (fn->consts[i] == value) return static_cast<int>(i);
+    }
+    fn->consts.push_back(value);
+    return static_cast<int>(fn->consts.size()) - 1;
+}
+
+int BytecodeCompiler::addSite(const SiteInfo& site) {
+    fn->sites.push_back(site);
+    return static_cast<int>(fn->sites.size()) - 1;
+}
+
+void BytecodeCompiler::patchJump(int at, int target) {
+    Instr& in = fn->code[at];
+    if (in.op == OP_JMP) in.a = target;
+    else in.b = target;
+}
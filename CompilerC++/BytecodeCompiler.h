@@ -0,0 +1,51 @@
+﻿#pragma once
+#include "Ast.h"
+#include "Bytecode.h"
+#include "Peephole.h"
+#include <unordered_map>
+#include <vector>
+
+// Компилятор проверенной программы (AST) в регистровый байт-код.
+// Каждая функция получает собственное окно регистров: сначала ячейки кадра, назначенные при
+// разборе (параметры, затем локальные переменные всех вложенных блоков), затем временные
+// регистры выражений. Глобальные переменные адресуются индексами в отдельном массиве.
+class BytecodeCompiler {
+public:
+    // debug — генерировать инструкции отладочного вывода (OP_TRACE_*)
+    explicit BytecodeCompiler(bool debug);
+
+    // Возвращает новую программу; владение переходит вызывающему
+    BcProgram* compile(ProgramNode* program);
+
+    // Статистика оконной оптимизации (без debug) по всем функциям последней компиляции
+    const Peephole& peepholeStats() const { return peephole; }
+
+private:
+    bool debug;
+    BcProgram* out;
+    BcFunction* fn; // компилируемая функция
+    Peephole peephole;
+
+    std::unordered_map<FuncNode*, int> funcIndex; // функция -> индекс в BcProgram::functions
+
+    int firstTemp; // первый временный регистр текущей функции
+    int nextTemp; // следующий свободный временный регистр
+
+    void compileFunction(FuncNode* func, BcFunction& target);
+    void compileInit(ProgramNode* program, BcFunction& target);
+
+    void compileStmt(StmtNode* s, std::vector<int>* breaks);
+    void compileStore(const VarSlot& slot, const string& name, DATA_TYPE varType, ExprNode* value,
+        bool fits, SrcLoc loc);
+    void compileCall(StmtNode* s);
+    void compileSwitch(StmtNode* s);
+    int compileExpr(ExprNode* e);
+    void compileArith(BIN_OP op, DATA_TYPE type, int dst, int left, int right,
+        DATA_TYPE leftType, DATA_TYPE rightType, bool checkZero, SrcLoc loc);
+
+    int newTemp();
+    int emit(OPCODE op, int a, int b, int c, SrcLoc loc);
+    int addConst(int64_t value);
+    int addSite(const SiteInfo& site);
+    void patchJump(int at, int target);
+};
@@ -1,17 +1,79 @@
 ﻿#include <iostream>
 #include <string>
+#include <cstdlib>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include "Diagram.h"
+#include "BytecodeCompiler.h"
+#include "ElfEmitter.h"
+#include "Inliner.h"
 
 using namespace std;
 
 int main(int argc, char** argv) {
+#ifdef _WIN32
     // Корректно отображаем русский язык в консоли
     SetConsoleCP(1251);
     SetConsoleOutputCP(1251);
+#endif
 
+    // Аргументы: [--engine=ast|vm|jit|aot] [--no-debug] [--mem-stats] [--max-depth=N]
+    //            [--inline-budget=N] [--inline-report] [--no-memo] [--memo-stats] [--dump-ssa]
+    //            [--dispatch-stats]
+    //            [--emit-obj=ФАЙЛ | --emit-exe=ФАЙЛ] [файл]
     string fname = "input.txt";
-    if (argc > 1) fname = argv[1];
+    ENGINE_KIND engine = ENGINE_AST;
+    bool debug = true;
+    bool memStats = false;
+    int inlineBudget = Inliner::DEFAULT_BUDGET;
+    bool inlineReport = false;
+    bool memoize = true;
+    bool memoReport = false;
+    bool ssaDump = false;
+    bool dispatchStats = false;
+    string objPath, exePath; // запись объектного / исполняемого файла вместо выполнения
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--engine=ast") engine = ENGINE_AST;
+        else if (arg == "--engine=vm") engine = ENGINE_VM;
+        else if (arg == "--engine=jit") engine = ENGINE_JIT;
+        else if (arg == "--engine=aot") engine = ENGINE_AOT;
+        else if (arg == "--no-debug") debug = false;
+        else if (arg == "--mem-stats") memStats = true;
+        else if (arg.rfind("--max-depth=", 0) == 0) {
+            // Предел глубины рекурсии (вложенных не хвостовых вызовов)
+            char* end = nullptr;
+            long depth = strtol(arg.c_str() + 12, &end, 10);
+            if (*end != '\0' || depth < 1 || depth > 1000000000L) {
+                cerr << "Ошибка: неверная глубина рекурсии: " << arg << endl;
+                return -1;
+            }
+            Tree::setMaxRecursionDepth(static_cast<int>(depth));
+        }
+        else if (arg.rfind("--inline-budget=", 0) == 0) {
+            // Предел размера встраиваемой функции в узлах AST (0 — не встраивать)
+            char* end = nullptr;
+            long budget = strtol(arg.c_str() + 16, &end, 10);
+            if (*end != '\0' || budget < 0 || budget > 1000000L) {
+                cerr << "Ошибка: неверный предел встраивания: " << arg << endl;
+                return -1;
+            }
+            inlineBudget = static_cast<int>(budget);
+        }
+        else if (arg == "--inline-report") inlineReport = true;
+        else if (arg == "--no-memo") memoize = false;
+        else if (arg == "--memo-stats") memoReport = true;
+        else if (arg == "--dump-ssa") ssaDump = true;
+        else if (arg == "--dispatch-stats") dispatchStats = true;
+        else if (arg.rfind("--emit-obj=", 0) == 0) objPath = arg.substr(11);
+        else if (arg.rfind("--emit-exe=", 0) == 0) exePath = arg.substr(11);
+        else if (arg.rfind("--", 0) == 0) {
+            cerr << "Ошибка: неизвестный параметр: " << arg << endl;
+            return -1;
+        }
+        else fname = arg;
+    }
 
     Scanner sc;
     if (!sc.loadFile(fname)) {
@@ -21,7 +83,30 @@ int main(int argc, char** argv) {
 
     // Разбор
     Diagram dg(&sc);
-    dg.ParseProgram(true, true);
+    dg.setInlining(inlineBudget, inlineReport);
+    dg.setMemoization(memoize, memoReport);
+    dg.setSsaDump(ssaDump);
+    dg.setDispatchStats(dispatchStats);
+    if (!objPath.empty() || !exePath.empty()) {
+        // Компиляция в машинный код x86-64 без выполнения (отладочный вывод не поддерживается)
+        Tree::disableDebug();
+        ProgramNode* program = dg.Parse();
+        dg.Optimize(false);
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+        string error;
+        bool ok = exePath.empty()
+            ? ElfEmitter::writeObject(*bytecode, Tree::getMaxRecursionDepth(), objPath, error)
+            : ElfEmitter::writeExecutable(*bytecode, Tree::getMaxRecursionDepth(), exePath, error);
+        delete bytecode;
+        if (!ok) {
+            cerr << "Ошибка: " << error << endl;
+            return -1;
+        }
+        return 0;
+    }
+    dg.ParseProgram(true, debug, engine, memStats);
+    if (memStats) nodeArena().printStats("Арена узлов дерева", cout);
 
     return 0;
 }
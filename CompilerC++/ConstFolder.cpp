@@ -0,0 +1,150 @@
+﻿#include "ConstFolder.h"
+
+// Замена узла выражения константой: потомки больше не нужны
+static void replaceWithConstant(ExprNode* e, const Value& value) {
+    delete e->left;
+    delete e->right;
+    e->left = nullptr;
+    e->right = nullptr;
+    e->kind = EXPR_CONST;
+    e->kernel = nullptr;
+    e->decl = nullptr;
+    e->value = value;
+}
+
+ConstFolder::ConstFolder() : folded(0), propagated(0), resolved(0) {}
+
+void ConstFolder::run(ProgramNode* program) {
+    assigned.clear();
+    known.clear();
+    scope.clear();
+    for (FuncNode* f : program->functions) {
+        if (f->body) collectAssigned(f->body);
+    }
+
+    // Глобальные описания до main выполняются раньше любой функции, поэтому их значения
+    // известны во всех функциях; описания после main — только в следующих за ними описаниях
+    // (main и вызываемые из неё функции видят их неинициализированными).
+    // Без main функции не выполняются вовсе
+    size_t split = program->main ? program->mainAfter : program->globals.size();
+    size_t i = 0;
+    for (; i < split && i < program->globals.size(); ++i) foldDecl(program->globals[i]);
+
+    size_t globalsKnown = scope.size();
+    for (FuncNode* f : program->functions) {
+        if (!f->body) continue;
+        foldStmt(f->body);
+        leaveScope(globalsKnown);
+    }
+
+    for (; i < program->globals.size(); ++i) foldDecl(program->globals[i]);
+}
+
+void ConstFolder::collectAssigned(StmtNode* s) {
+    if (s->kind == STMT_ASSIGN) assigned.insert(s->decl);
+    for (StmtNode* item : s->body) collectAssigned(item);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) collectAssigned(item);
+    }
+}
+
+void ConstFolder::leaveScope(size_t mark) {
+    while (scope.size() > mark) {
+        known.erase(scope.back());
+        scope.pop_back();
+    }
+}
+
+// Описание переменной: после него значение известно, если инициализатор свернулся
+// в константу, а присваиваний переменной нет
+void ConstFolder::foldDecl(StmtNode* s) {
+    if (!s->value) return;
+    foldExpr(s->value);
+    if (s->value->kind != EXPR_CONST || !s->decl || assigned.count(s->decl)) return;
+
+    // Значение ячейки — как после Tree::storeValue: приведённое к типу переменной
+    Value value = s->value->value;
+    if (s->declType != TYPE_BOOL) value = Value(s->declType, truncateTo(s->declType, value.v));
+    known[s->decl] = value;
+    scope.push_back(s->decl);
+}
+
+void ConstFolder::foldStmt(StmtNode* s) {
+    switch (s->kind) {
+    case STMT_EMPTY:
+    case STMT_BREAK:
+        break;
+    case STMT_BLOCK: {
+        size_t mark = scope.size();
+        for (StmtNode* item : s->body) foldStmt(item);
+        leaveScope(mark);
+        break;
+    }
+    case STMT_VAR_DECL:
+        foldDecl(s);
+        break;
+    case STMT_ASSIGN:
+        foldExpr(s->value);
+        break;
+    case STMT_CALL:
+        for (ExprNode* a : s->args) foldExpr(a);
+        break;
+    case STMT_SWITCH: {
+        foldExpr(s->value);
+        if (s->value->kind == EXPR_CONST) {
+            s->table->resolve(s->table->find(s->value->value.v));
+            resolved++;
+        }
+        // Исполнение входит в ветвь только с её начала, поэтому описание в ветви выполнено
+        // для всех следующих за ним операторов этой ветви, но не для следующих ветвей
+        for (CaseNode* c : s->cases) {
+            size_t mark = scope.size();
+            for (StmtNode* item : c->body) foldStmt(item);
+            leaveScope(mark);
+        }
+        break;
+    }
+    }
+}
+
+void ConstFolder::foldExpr(ExprNode* e) {
+    switch (e->kind) {
+    case EXPR_CONST:
+        break;
+
+    case EXPR_VAR: {
+        auto it = known.find(e->decl);
+        if (it != known.end()) {
+            replaceWithConstant(e, it->second);
+            propagated++;
+        }
+        break;
+    }
+
+    case EXPR_NEG:
+        foldExpr(e->left);
+        if (e->left->kind == EXPR_CONST) {
+            replaceWithConstant(e, Value(e->type, e->kernel(e->left->value.v, -1, e->loc)));
+            folded++;
+        }
+        break;
+
+    case EXPR_CAST:
+        foldExpr(e->left);
+        if (e->left->kind == EXPR_CONST) {
+            replaceWithConstant(e, Value(e->type, truncateTo(e->type, e->left->value.v)));
+            folded++;
+        }
+        break;
+
+    case EXPR_BINARY:
+        foldExpr(e->left);
+        foldExpr(e->right);
+        if (e->left->kind != EXPR_CONST || e->right->kind != EXPR_CONST) break;
+        // Деление на ноль остаётся ошибкой времени выполнения (в том числе в недостижимом коде)
+        if ((e->op == BOP_DIV || e->op == BOP_MOD) && e->right->value.v == 0) break;
+        replaceWithConstant(e, Value(e->type, e->kernel(e->left->value.v, e->right->value.v, e->loc)));
+        folded++;
+        break;
+    }
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include "Ast.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Свёртка и распространение констант в проверенной программе (AST).
+// Константные подвыражения (включая унарный минус) вычисляются один раз при трансляции тем же
+// ядром операции, что выбрано при проверке типов, поэтому разрядность, переполнение и тип
+// результата совпадают с исполнением (Tree::getMaxType / castToType). Деление на константный
+// ноль не сворачивается — ошибка по-прежнему возникает при исполнении.
+// Переменная, которой нигде не присваивается, с константным инициализатором заменяется своим
+// значением (приведённым к её типу) там, где описание заведомо уже выполнено: глобальная,
+// описанная до main, — всюду; локальная — до конца своего блока или ветви switch.
+// Switch с константным селектором сразу получает ветвь, с которой начинается исполнение.
+// Отладочный вывод арифметики при этом пропал бы, поэтому проход применяется только без debug
+class ConstFolder {
+public:
+    ConstFolder();
+
+    void run(ProgramNode* program);
+
+    // Статистика прохода (для тестов и бенчмарков)
+    int foldedExpressions() const { return folded; }
+    int propagatedUses() const { return propagated; }
+    int resolvedSwitches() const { return resolved; }
+
+private:
+    std::unordered_set<Tree*> assigned; // переменные, которым что-то присваивается
+    std::unordered_map<Tree*, Value> known; // переменные с известным значением в текущей точке
+    std::vector<Tree*> scope; // порядок добавления в known (для выхода из блока)
+
+    int folded;
+    int propagated;
+    int resolved;
+
+    void collectAssigned(StmtNode* s);
+    void foldStmt(StmtNode* s);
+    void foldDecl(StmtNode* s);
+    void foldExpr(ExprNode* e);
+    void leaveScope(size_t mark);
+};
@@ -0,0 +1,305 @@
+﻿#include "ConstProp.h"
+#include "Tree.h"
+
+// Ячейки параметров, которым что-то присваивается
+static void collectAssignedParams(const StmtNode* s, vector<bool>& assigned) {
+    if (s->kind == STMT_ASSIGN && !s->slot.global && s->slot.index >= 0
+        && static_cast<size_t>(s->slot.index) < assigned.size()) {
+        assigned[s->slot.index] = true;
+    }
+    for (StmtNode* item : s->body) collectAssignedParams(item, assigned);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) collectAssignedParams(item, assigned);
+    }
+}
+
+// Обращение к переменной становится константой (потомков у EXPR_VAR нет)
+static void makeImmediate(ExprNode* e, const Value& value) {
+    e->kind = EXPR_CONST;
+    e->value = value;
+    e->decl = nullptr;
+}
+
+ConstPropagator::ConstPropagator() : program(nullptr), params(0), onceAssigned(0), replaced(0) {}
+
+int ConstPropagator::run(ProgramNode* prog) {
+    program = prog;
+    int before = replaced;
+    propagateParams();
+    propagateGlobals();
+    return replaced - before;
+}
+
+// Решётка значений параметров: от «не известно» к константе и к «не константа»,
+// пока значения на всех местах вызова не перестанут меняться
+void ConstPropagator::propagateParams() {
+    paramStates.clear();
+    for (FuncNode* f : program->functions) {
+        vector<ParamState>& states = paramStates[f];
+        states.assign(f->paramTypes.size(), ParamState{ LAT_TOP, 0 });
+        vector<bool> assigned(f->paramTypes.size(), false);
+        if (f->body) collectAssignedParams(f->body, assigned);
+        for (size_t i = 0; i < states.size(); ++i) {
+            // switch по bool выбирает ветвь не по значению, поэтому bool не заменяется
+            if (assigned[i] || f->paramTypes[i] == TYPE_BOOL) states[i].state = LAT_BOTTOM;
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (FuncNode* f : program->functions) {
+            if (f->body) meetArgs(f, f->body, changed);
+        }
+    }
+
+    // Параметр учитывается в статистике один раз — когда заменено первое обращение к нему
+    for (FuncNode* f : program->functions) {
+        const vector<ParamState>& states = paramStates[f];
+        for (size_t i = 0; i < states.size() && f->body; ++i) {
+            if (states[i].state != LAT_CONST) continue;
+            vector<ParamState> only(states.size(), ParamState{ LAT_BOTTOM, 0 });
+            only[i] = states[i];
+            int was = replaced;
+            substituteParams(f->body, only, f->paramTypes);
+            if (replaced > was && countedParams.insert(f->paramDecls[i]).second) params++;
+        }
+    }
+}
+
+// Значение аргумента для параметра типа type: константа или известный параметр вызывающей функции
+ConstPropagator::ParamState ConstPropagator::argState(FuncNode* caller, ExprNode* arg, DATA_TYPE type) {
+    if (arg->kind == EXPR_CONST && arg->type != TYPE_BOOL) {
+        return ParamState{ LAT_CONST, truncateTo(type, arg->value.v) };
+    }
+    if (arg->kind == EXPR_VAR && !arg->slot.global && arg->slot.index >= 0
+        && static_cast<size_t>(arg->slot.index) < caller->paramTypes.size()) {
+        ParamState p = paramStates[caller][arg->slot.index];
+        if (p.state == LAT_CONST) p.value = truncateTo(type, p.value);
+        return p;
+    }
+    return ParamState{ LAT_BOTTOM, 0 };
+}
+
+void ConstPropagator::meetArgs(FuncNode* caller, StmtNode* s, bool& changed) {
+    if (s->kind == STMT_CALL && s->callee) {
+        vector<ParamState>& states = paramStates[s->callee];
+        for (size_t i = 0; i < states.size() && i < s->args.size(); ++i) {
+            ParamState& p = states[i];
+            if (p.state == LAT_BOTTOM) continue;
+            ParamState a = argState(caller, s->args[i], s->callee->paramTypes[i]);
+            if (a.state == LAT_TOP) continue;
+            if (a.state == LAT_BOTTOM || (p.state == LAT_CONST && p.value != a.value)) {
+                p.state = LAT_BOTTOM;
+                changed = true;
+            }
+            else if (p.state == LAT_TOP) {
+                p = a;
+                changed = true;
+            }
+        }
+    }
+    for (StmtNode* item : s->body) meetArgs(caller, item, changed);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) meetArgs(caller, item, changed);
+    }
+}
+
+void ConstPropagator::substituteParams(ExprNode* e, const vector<ParamState>& states, const vector<DATA_TYPE>& types) {
+    if (!e) return;
+    if (e->kind == EXPR_VAR && !e->slot.global && e->slot.index >= 0
+        && static_cast<size_t>(e->slot.index) < states.size() && states[e->slot.index].state == LAT_CONST) {
+        makeImmediate(e, Value(types[e->slot.index], states[e->slot.index].value));
+        replaced++;
+        return;
+    }
+    substituteParams(e->left, states, types);
+    substituteParams(e->right, states, types);
+}
+
+void ConstPropagator::substituteParams(StmtNode* s, const vector<ParamState>& states, const vector<DATA_TYPE>& types) {
+    substituteParams(s->value, states, types);
+    for (ExprNode* a : s->args) substituteParams(a, states, types);
+    for (StmtNode* item : s->body) substituteParams(item, states, types);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) substituteParams(item, states, types);
+    }
+}
+
+// Присваивания глобальным переменным: одна и та же константа (после приведения к типу
+// переменной, как Tree::storeValue) или что-то другое
+void ConstPropagator::collectAssignments(StmtNode* s, vector<ParamState>& values) {
+    if (s->kind == STMT_ASSIGN && s->slot.global) {
+        ParamState& v = values[s->slot.index];
+        DATA_TYPE type = s->decl->n->DataType;
+        if (s->value->kind != EXPR_CONST || s->value->type == TYPE_BOOL || type == TYPE_BOOL) {
+            v.state = LAT_BOTTOM;
+        }
+        else if (v.state == LAT_TOP) {
+            v = ParamState{ LAT_CONST, truncateTo(type, s->value->value.v) };
+        }
+        else if (v.state == LAT_CONST && v.value != truncateTo(type, s->value->value.v)) {
+            v.state = LAT_BOTTOM;
+        }
+    }
+    for (StmtNode* item : s->body) collectAssignments(item, values);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) collectAssignments(item, values);
+    }
+}
+
+void ConstPropagator::propagateGlobals() {
+    size_t n = program->globals.size();
+    once.assign(n, 0);
+    onceValue.assign(n, 0);
+    countedGlobals.resize(n, 0);
+    // Без main функции не выполняются вовсе
+    if (!program->main) return;
+
+    // Встраивание размножает присваивание, поэтому «однократное» — все присваивания одной константы
+    vector<ParamState> values(n, ParamState{ LAT_TOP, 0 });
+    for (FuncNode* f : program->functions) {
+        if (f->body) collectAssignments(f->body, values);
+    }
+
+    // Описания после main выполняются после неё и перезаписали бы значение
+    bool any = false;
+    for (size_t i = 0; i < program->mainAfter && i < n; ++i) {
+        int index = program->globals[i]->slot.index;
+        if (values[index].state != LAT_CONST) continue;
+        once[index] = 1;
+        onceValue[index] = values[index].value;
+        any = true;
+    }
+    if (!any) return;
+
+    // Присваивания, которые вызов выполняет на любом пути (наибольшая неподвижная точка:
+    // завершившийся рекурсивный вызов в конце концов прошёл ветвь без рекурсии)
+    mustWrite.clear();
+    for (FuncNode* f : program->functions) mustWrite[f].assign(n, 1);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (FuncNode* f : program->functions) {
+            if (!f->body) continue;
+            GlobalSet defined(n, 0);
+            flowStmt(f->body, defined, FLOW_SUMMARY);
+            if (defined != mustWrite[f]) {
+                mustWrite[f] = defined;
+                changed = true;
+            }
+        }
+    }
+
+    // Присваивания, выполненные при входе в функцию: пересечение по всем местам вызова
+    // (main вызывается до любого присваивания)
+    entry.clear();
+    for (FuncNode* f : program->functions) entry[f].assign(n, 1);
+    entry[program->main].assign(n, 0);
+    changed = true;
+    while (changed) {
+        nextEntry.clear();
+        for (FuncNode* f : program->functions) nextEntry[f].assign(n, 1);
+        nextEntry[program->main].assign(n, 0);
+        for (FuncNode* f : program->functions) {
+            if (!f->body) continue;
+            GlobalSet defined = entry[f];
+            flowStmt(f->body, defined, FLOW_ENTRY);
+        }
+        changed = nextEntry != entry;
+        entry.swap(nextEntry);
+    }
+
+    for (FuncNode* f : program->functions) {
+        if (!f->body) continue;
+        GlobalSet defined = entry[f];
+        flowStmt(f->body, defined, FLOW_REWRITE);
+    }
+    GlobalSet afterMain = mustWrite[program->main];
+    for (size_t i = program->mainAfter; i < n; ++i) {
+        if (program->globals[i]->value) rewriteExpr(program->globals[i]->value, afterMain);
+    }
+}
+
+// Оператор в порядке исполнения; defined — присваивания из once, выполненные на каждом пути
+// до этой точки. Возвращает false после break (путь дальше по ветви не идёт)
+bool ConstPropagator::flowStmt(StmtNode* s, GlobalSet& defined, FLOW_MODE mode) {
+    switch (s->kind) {
+    case STMT_EMPTY:
+        return true;
+    case STMT_BLOCK:
+        for (StmtNode* item : s->body) {
+            if (!flowStmt(item, defined, mode)) return false;
+        }
+        return true;
+    case STMT_VAR_DECL:
+        if (s->value && mode == FLOW_REWRITE) rewriteExpr(s->value, defined);
+        return true;
+    case STMT_ASSIGN:
+        if (mode == FLOW_REWRITE) rewriteExpr(s->value, defined);
+        if (s->slot.global && once[s->slot.index]) defined[s->slot.index] = 1;
+        return true;
+    case STMT_CALL: {
+        if (mode == FLOW_REWRITE) {
+            for (ExprNode* a : s->args) rewriteExpr(a, defined);
+        }
+        if (mode == FLOW_ENTRY) {
+            GlobalSet& callee = nextEntry[s->callee];
+            for (size_t i = 0; i < defined.size(); ++i) callee[i] &= defined[i];
+        }
+        const GlobalSet& writes = mustWrite[s->callee];
+        for (size_t i = 0; i < defined.size(); ++i) defined[i] |= writes[i];
+        return true;
+    }
+    case STMT_SWITCH:
+        flowSwitch(s, defined, mode);
+        return true;
+    case STMT_BREAK:
+        return false;
+    }
+    return true;
+}
+
+// Исполнение начинается с любой ветви (или ни с какой, если нет default) и проваливается
+// в следующие до break; на входе в ветвь выполнено не меньше, чем перед switch
+void ConstPropagator::flowSwitch(StmtNode* s, GlobalSet& defined, FLOW_MODE mode) {
+    if (mode == FLOW_REWRITE) rewriteExpr(s->value, defined);
+    GlobalSet start = defined;
+    GlobalSet out(defined.size(), 1);
+
+    bool hasDefault = false;
+    for (CaseNode* c : s->cases) {
+        if (c->isDefault) hasDefault = true;
+    }
+    if (!hasDefault) out = start;
+
+    for (size_t i = 0; i < s->cases.size(); ++i) {
+        GlobalSet d = start;
+        bool falls = true;
+        for (StmtNode* item : s->cases[i]->body) {
+            if (!flowStmt(item, d, mode)) {
+                falls = false;
+                break;
+            }
+        }
+        if (!falls || i + 1 == s->cases.size()) {
+            for (size_t k = 0; k < out.size(); ++k) out[k] &= d[k];
+        }
+    }
+    defined = out;
+}
+
+void ConstPropagator::rewriteExpr(ExprNode* e, const GlobalSet& defined) {
+    if (!e) return;
+    if (e->kind == EXPR_VAR && e->slot.global && once[e->slot.index] && defined[e->slot.index]) {
+        makeImmediate(e, Value(e->type, onceValue[e->slot.index]));
+        replaced++;
+        if (!countedGlobals[e->slot.index]) {
+            countedGlobals[e->slot.index] = 1;
+            onceAssigned++;
+        }
+        return;
+    }
+    rewriteExpr(e->left, defined);
+    rewriteExpr(e->right, defined);
+}
@@ -0,0 +1,81 @@
+﻿#pragma once
+#include "Ast.h"
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Межпроцедурное распространение констант в проверенной программе (AST) по графу вызовов.
+// Параметры: если при каждом вызове функции параметр получает одно и то же значение —
+// константу или параметр вызывающей функции, который сам известен (до неподвижной точки,
+// включая рекурсивные вызовы), — обращения к нему в теле заменяются этим значением,
+// приведённым к типу параметра (как castToType при вызове). Параметры, которым в теле
+// присваивается, и параметры bool не рассматриваются. Сигнатура функции не меняется.
+// Глобальные переменные, описанные до main, которым во всей программе присваивается одна
+// и та же константа (обычно — единственное присваивание и его встроенные копии): после того
+// как присваивание заведомо выполнено (на любом пути от main, с учётом вызовов — какие
+// присваивания вызов выполняет всегда и что выполнено при входе в функцию из каждого места
+// вызова), значение переменной известно, и обращения к ней заменяются константой.
+// Переменные, которым не присваивается вовсе, распространяет ConstFolder.
+// Замены видит следующий проход ConstFolder; проход работает с AST, поэтому результат
+// получают все способы исполнения. Отладочный вывод вычислений пропал бы после свёртки,
+// поэтому проход применяется только без debug
+class ConstPropagator {
+public:
+    // Проходов «распространение + свёртка»: свёртка может сделать константными аргументы
+    // вызовов и правые части присваиваний
+    static const int MAX_ROUNDS = 4;
+
+    ConstPropagator();
+
+    // Один проход; возвращает число заменённых обращений
+    int run(ProgramNode* program);
+
+    // Статистика всех проходов (для тестов и бенчмарков): параметры и однократно
+    // присваиваемые глобальные переменные, обращения к которым заменены, и число замен
+    int constantParams() const { return params; }
+    int onceAssignedGlobals() const { return onceAssigned; }
+    int replacedUses() const { return replaced; }
+
+private:
+    // Значение в решётке: ещё не известно (нет вызовов или присваиваний), константа, не константа
+    enum LATTICE { LAT_TOP, LAT_CONST, LAT_BOTTOM };
+    struct ParamState {
+        LATTICE state;
+        int64_t value;
+    };
+
+    // Множество глобальных переменных (индекс — VarSlot::index)
+    typedef std::vector<char> GlobalSet;
+
+    // Что делает обход тела: только сводка, сбор фактов на входе в вызываемые, замена обращений
+    enum FLOW_MODE { FLOW_SUMMARY, FLOW_ENTRY, FLOW_REWRITE };
+
+    ProgramNode* program;
+    std::unordered_map<FuncNode*, std::vector<ParamState>> paramStates;
+
+    std::vector<char> once; // глобальной переменной присваивается только одна константа
+    std::vector<int64_t> onceValue; // её значение после присваивания
+    std::unordered_map<FuncNode*, GlobalSet> mustWrite; // присваивания, выполняемые вызовом всегда
+    std::unordered_map<FuncNode*, GlobalSet> entry; // присваивания, выполненные при входе в функцию
+    std::unordered_map<FuncNode*, GlobalSet> nextEntry;
+
+    std::unordered_set<Tree*> countedParams; // параметры (paramDecls), учтённые в params
+    std::vector<char> countedGlobals; // глобальные переменные, учтённые в onceAssigned
+
+    int params;
+    int onceAssigned;
+    int replaced;
+
+    void propagateParams();
+    ParamState argState(FuncNode* caller, ExprNode* arg, DATA_TYPE type);
+    void meetArgs(FuncNode* caller, StmtNode* s, bool& changed);
+    void substituteParams(ExprNode* e, const std::vector<ParamState>& states, const std::vector<DATA_TYPE>& types);
+    void substituteParams(StmtNode* s, const std::vector<ParamState>& states, const std::vector<DATA_TYPE>& types);
+
+    void propagateGlobals();
+    void collectAssignments(StmtNode* s, std::vector<ParamState>& values);
+    bool flowStmt(StmtNode* s, GlobalSet& defined, FLOW_MODE mode);
+    void flowSwitch(StmtNode* s, GlobalSet& defined, FLOW_MODE mode);
+    void rewriteExpr(ExprNode* e, const GlobalSet& defined);
+};
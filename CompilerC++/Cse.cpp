@@ -0,0 +1,183 @@
+﻿#include "Cse.h"
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <string>
+
+// Вычисление без ошибок исполнения и предупреждений
+static bool isPureExpr(const ExprNode* e) {
+    switch (e->kind) {
+    case EXPR_CONST:
+        return true;
+    case EXPR_VAR:
+        return !e->checkInit;
+    case EXPR_NEG:
+        return isPureExpr(e->left);
+    case EXPR_CAST: {
+        DATA_TYPE from = e->left->type;
+        bool narrowing = (e->type == TYPE_SHORT_INT && from != TYPE_SHORT_INT && from != TYPE_BOOL)
+            || (e->type == TYPE_INT && from == TYPE_LONG_INT);
+        return (e->fits || !narrowing) && isPureExpr(e->left);
+    }
+    case EXPR_BINARY:
+        if ((e->op == BOP_DIV || e->op == BOP_MOD) && e->checkZero) return false;
+        return isPureExpr(e->left) && isPureExpr(e->right);
+    }
+    return false;
+}
+
+static size_t exprNodes(const ExprNode* e) {
+    if (!e) return 0;
+    return 1 + exprNodes(e->left) + exprNodes(e->right);
+}
+
+// Вычисление a выполнено раньше b на любом пути, ведущем к b
+static bool computedBefore(const SsaUse& a, const SsaUse& b) {
+    if (a.block != b.block) return a.block->dominates(b.block);
+    return a.order < b.order || (a.order == b.order && a.pre < b.pre);
+}
+
+static ExprNode* tempRead(const StmtNode* decl, SrcLoc loc) {
+    ExprNode* read = new ExprNode(EXPR_VAR, decl->declType, loc);
+    read->name = decl->name;
+    read->slot = decl->slot;
+    read->checkInit = false;
+    return read;
+}
+
+// Глобальные переменные, присваиваемые в операторе (без учёта вызовов), и вызываемые функции
+static void collectWrites(const StmtNode* s, vector<char>& writes, vector<FuncNode*>& callees) {
+    if (s->kind == STMT_ASSIGN && s->slot.global && s->slot.index >= 0) writes[s->slot.index] = 1;
+    if (s->kind == STMT_CALL && s->callee) callees.push_back(s->callee);
+    for (const StmtNode* item : s->body) collectWrites(item, writes, callees);
+    for (const CaseNode* c : s->cases) {
+        for (const StmtNode* item : c->body) collectWrites(item, writes, callees);
+    }
+}
+
+CommonSubexpressions::CommonSubexpressions() : expressions(0), loads(0), temps(0) {}
+
+void CommonSubexpressions::run(ProgramNode* program, ostream* dump) {
+    expressions = 0;
+    loads = 0;
+    temps = 0;
+    computeWrites(program);
+
+    for (FuncNode* f : program->functions) {
+        if (!f->body) continue;
+        SsaFunction ssa(f, program->globals.size(), mayWrite);
+        ssa.numberValues();
+        if (dump) ssa.print(*dump, program);
+        rewrite(f, ssa);
+    }
+}
+
+// Записи вызываемых функций добавляются к записям вызывающих, пока множества растут
+void CommonSubexpressions::computeWrites(ProgramNode* program) {
+    mayWrite.clear();
+    unordered_map<FuncNode*, vector<FuncNode*>> calls;
+    for (FuncNode* f : program->functions) {
+        vector<char>& writes = mayWrite[f];
+        writes.assign(program->globals.size(), 0);
+        if (f->body) collectWrites(f->body, writes, calls[f]);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (FuncNode* f : program->functions) {
+            vector<char>& writes = mayWrite[f];
+            for (FuncNode* callee : calls[f]) {
+                const vector<char>& other = mayWrite[callee];
+                for (size_t g = 0; g < writes.size() && g < other.size(); ++g) {
+                    if (other[g] && !writes[g]) {
+                        writes[g] = 1;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Узлы обходятся сверху вниз: повтор внешнего выражения заменяется целиком, и его операнды
+// уже не рассматриваются. Первое вычисление класса (значение SSA и тип узла) становится
+// представителем; вычисление, которому предшествует представитель, — повтором
+void CommonSubexpressions::rewrite(FuncNode* f, const SsaFunction& ssa) {
+    const vector<SsaUse>& uses = ssa.uses();
+    vector<size_t> byPre(uses.size());
+    iota(byPre.begin(), byPre.end(), size_t(0));
+    sort(byPre.begin(), byPre.end(), [&uses](size_t a, size_t b) { return uses[a].pre < uses[b].pre; });
+
+    vector<Occurrence> occurrences;
+    map<pair<const SsaValue*, int>, vector<size_t>> classes;
+    size_t k = 0;
+    while (k < byPre.size()) {
+        size_t i = byPre[k];
+        const SsaUse& u = uses[i];
+        ExprNode* e = u.expr;
+        bool global = e->kind == EXPR_VAR && e->slot.global;
+        bool candidate = e->kind == EXPR_BINARY || e->kind == EXPR_NEG || global;
+        if (!candidate || !isPureExpr(e)) {
+            k++;
+            continue;
+        }
+
+        if (global && u.value->leader->kind == SSA_CONST) {
+            ExprNode* c = new ExprNode(EXPR_CONST, e->type, e->loc);
+            c->value = Value(e->type, u.value->leader->konst);
+            *u.ref = c;
+            delete e;
+            loads++;
+            k++;
+            continue;
+        }
+
+        vector<size_t>& leaders = classes[make_pair(u.value->leader, static_cast<int>(e->type))];
+        auto found = find_if(leaders.rbegin(), leaders.rend(),
+            [&](size_t j) { return computedBefore(uses[occurrences[j].use], u); });
+        if (found != leaders.rend()) {
+            occurrences[*found].followers.push_back(i);
+            k += exprNodes(e);
+            continue;
+        }
+        leaders.push_back(occurrences.size());
+        occurrences.push_back(Occurrence{ i, {} });
+        k++;
+    }
+
+    // Описания временных переменных — перед операторами первых вычислений; у одного оператора
+    // в порядке вычисления (вложенный представитель раньше содержащего его)
+    vector<pair<size_t, Insertion>> insertions;
+    for (Occurrence& o : occurrences) {
+        if (o.followers.empty()) continue;
+        const SsaUse& u = uses[o.use];
+        ExprNode* e = u.expr;
+
+        StmtNode* decl = new StmtNode(STMT_VAR_DECL, u.stmt->loc);
+        decl->name = "$t" + to_string(temps++);
+        decl->declType = e->type;
+        decl->slot = VarSlot(false, static_cast<int>(f->slotTypes.size()));
+        decl->fits = true;
+        f->slotTypes.push_back(e->type);
+        decl->value = e;
+        *u.ref = tempRead(decl, e->loc);
+
+        for (size_t fi : o.followers) {
+            ExprNode* old = *uses[fi].ref;
+            *uses[fi].ref = tempRead(decl, old->loc);
+            if (old->kind == EXPR_VAR) loads++;
+            else expressions++;
+            delete old;
+        }
+        insertions.push_back(make_pair(o.use, Insertion{ u.list, u.stmt, decl }));
+    }
+
+    sort(insertions.begin(), insertions.end(),
+        [](const pair<size_t, Insertion>& a, const pair<size_t, Insertion>& b) { return a.first < b.first; });
+    for (const auto& item : insertions) {
+        vector<StmtNode*>& list = *item.second.list;
+        auto at = find(list.begin(), list.end(), item.second.before);
+        list.insert(at, item.second.decl);
+    }
+}
@@ -0,0 +1,55 @@
+﻿#pragma once
+#include "Ast.h"
+#include "Ssa.h"
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Устранение общих подвыражений и повторных чтений глобальных переменных (в проверенной
+// программе, AST) по нумерации значений в SSA (SsaFunction::numberValues).
+// Вычисление, значение которого уже получено раньше на любом пути исполнения (вычисление
+// представителя доминирует над ним), заменяется чтением временной переменной: перед
+// оператором с первым вычислением появляется описание $tN = выражение, а оба места читают $tN.
+// Так заменяются операции (a op b, -a) и чтения глобальных переменных: значение глобальной
+// переменной известно после её чтения или присваивания до вызова, который может её изменить.
+// Чтение глобальной переменной, которой присвоена константа, заменяется константой.
+// Временные переменные — новые ячейки кадра (FuncNode::slotTypes).
+// Переносятся и заменяются только выражения без ошибок исполнения: чтения без проверки
+// инициализации (DefiniteAssignment), деление без проверки делителя (RangeAnalysis,
+// Simplifier), без сужающих приведений с обрезкой. Вычисление раньше или вместо повтора
+// поэтому ничего не меняет. Отладочный вывод вычислений пропал бы — проход только без debug
+class CommonSubexpressions {
+public:
+    CommonSubexpressions();
+
+    // dump — куда выводить SSA функций (после нумерации значений), nullptr — не выводить
+    void run(ProgramNode* program, std::ostream* dump = nullptr);
+
+    // Статистика (для тестов): заменённые повторные операции и чтения глобальных переменных,
+    // заведённые временные переменные
+    int eliminatedExpressions() const { return expressions; }
+    int eliminatedLoads() const { return loads; }
+    int temporaries() const { return temps; }
+
+private:
+    // Представитель класса: место первого вычисления и места, где значение используется повторно
+    struct Occurrence {
+        size_t use; // индекс в SsaFunction::uses()
+        std::vector<size_t> followers;
+    };
+
+    // Вставка описания временной переменной перед оператором
+    struct Insertion {
+        std::vector<StmtNode*>* list;
+        StmtNode* before;
+        StmtNode* decl;
+    };
+
+    std::unordered_map<FuncNode*, std::vector<char>> mayWrite;
+    int expressions;
+    int loads;
+    int temps;
+
+    void computeWrites(ProgramNode* program);
+    void rewrite(FuncNode* f, const SsaFunction& ssa);
+};
@@ -0,0 +1,110 @@
+﻿#include "DeadCode.h"
+
+DeadCodeEliminator::DeadCodeEliminator() : statements(0), branches(0), functions(0) {}
+
+void DeadCodeEliminator::run(ProgramNode* program) {
+    for (FuncNode* f : program->functions) {
+        if (f->body) pruneStmt(f->body);
+    }
+
+    // Без main функции не выполняются вовсе
+    reachable.clear();
+    if (program->main) markReachable(program->main);
+
+    vector<FuncNode*> kept;
+    for (FuncNode* f : program->functions) {
+        if (reachable.count(f)) {
+            kept.push_back(f);
+        }
+        else {
+            delete f;
+            functions++;
+        }
+    }
+    program->functions = kept;
+}
+
+void DeadCodeEliminator::pruneStmt(StmtNode* s) {
+    switch (s->kind) {
+    case STMT_BLOCK:
+        for (StmtNode* item : s->body) pruneStmt(item);
+        break;
+    case STMT_SWITCH:
+        for (CaseNode* c : s->cases) {
+            // break стоит непосредственно в ветви: следующие за ним операторы ветви недостижимы
+            vector<StmtNode*>& body = c->body;
+            for (size_t j = 0; j < body.size(); ++j) {
+                if (body[j]->kind != STMT_BREAK) continue;
+                for (size_t k = j + 1; k < body.size(); ++k) {
+                    delete body[k];
+                    statements++;
+                }
+                body.resize(j + 1);
+                break;
+            }
+            for (StmtNode* item : body) pruneStmt(item);
+        }
+        if (s->value->kind == EXPR_CONST) flattenSwitch(s);
+        break;
+    default:
+        break;
+    }
+}
+
+// Switch с константным селектором: исполнение начинается с известной ветви и идёт по
+// следующим до break (он теперь может быть только последним оператором ветви) или конца
+// switch. Эти операторы без break становятся телом блока, остальные ветви удаляются
+void DeadCodeEliminator::flattenSwitch(StmtNode* s) {
+    size_t start = static_cast<size_t>(s->table->find(s->value->value.v));
+    vector<StmtNode*> items;
+    bool stopped = false;
+    for (size_t i = 0; i < s->cases.size(); ++i) {
+        CaseNode* c = s->cases[i];
+        if (i < start || stopped) {
+            branches++;
+        }
+        else {
+            for (StmtNode* item : c->body) {
+                if (item->kind == STMT_BREAK) {
+                    delete item;
+                    stopped = true;
+                }
+                else {
+                    items.push_back(item);
+                }
+            }
+            c->body.clear();
+        }
+        delete c;
+    }
+    s->cases.clear();
+
+    delete s->value;
+    s->value = nullptr;
+    delete s->table;
+    s->table = nullptr;
+    s->kind = STMT_BLOCK;
+    s->body = items;
+}
+
+void DeadCodeEliminator::markReachable(FuncNode* f) {
+    vector<FuncNode*> work(1, f);
+    reachable.insert(f);
+    while (!work.empty()) {
+        FuncNode* cur = work.back();
+        work.pop_back();
+        vector<FuncNode*> callees;
+        if (cur->body) collectCalls(cur->body, callees);
+        for (FuncNode* callee : callees) {
+            if (reachable.insert(callee).second) work.push_back(callee);
+        }
+    }
+}
+
+void DeadCodeEliminator::collectCalls(StmtNode* s, vector<FuncNode*>& out) {
+    if (s->kind == STMT_CALL && s->callee) out.push_back(s->callee);
+    for (StmtNode* item : s->body) collectCalls(item, out);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) collectCalls(item, out);
+    }
+}
@@ -0,0 +1,34 @@
+﻿#pragma once
+#include "Ast.h"
+#include <unordered_set>
+#include <vector>
+
+// Удаление недостижимого кода из проверенной программы (AST).
+// Удаляются операторы ветви switch после break, ветви switch, в которые исполнение не
+// попадает при константном селекторе (такой switch становится блоком из операторов
+// достижимых ветвей), и функции, не вызываемые (прямо или через другие функции) из main.
+// Семантические ошибки в удаляемом коде сообщаются при разборе, как и раньше; при исполнении
+// этот код ничего не стоит. Отладочный вывод не меняется: удаляемый код не исполняется
+class DeadCodeEliminator {
+public:
+    DeadCodeEliminator();
+
+    void run(ProgramNode* program);
+
+    // Статистика прохода (для тестов и бенчмарков)
+    int removedStatements() const { return statements; }
+    int removedBranches() const { return branches; }
+    int removedFunctions() const { return functions; }
+
+private:
+    std::unordered_set<FuncNode*> reachable;
+
+    int statements;
+    int branches;
+    int functions;
+
+    void pruneStmt(StmtNode* s);
+    void flattenSwitch(StmtNode* s);
+    void markReachable(FuncNode* f);
+    void collectCalls(StmtNode* s, std::vector<FuncNode*>& out);
+};
@@ -0,0 +1,201 @@
+﻿#include "DefAssign.h"
+#include "Tree.h"
+#include <unordered_set>
+
+// Функции, вызываемые из s (в том числе во вложенных операторах)
+static void collectCallees(const StmtNode* s, vector<FuncNode*>& callees) {
+    if (s->kind == STMT_CALL && s->callee) callees.push_back(s->callee);
+    for (StmtNode* item : s->body) collectCallees(item, callees);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) collectCallees(item, callees);
+    }
+}
+
+// Пересечение: присвоено и на пути into, и на пути from
+static void meetAssigned(vector<char>& into, const vector<char>& from) {
+    for (size_t i = 0; i < into.size(); ++i) into[i] &= from[i];
+}
+
+DefiniteAssignment::DefiniteAssignment() : program(nullptr), globalCount(0), proven(0), checked(0) {}
+
+void DefiniteAssignment::run(ProgramNode* prog) {
+    program = prog;
+    globalCount = program->globals.size();
+    proven = 0;
+    checked = 0;
+    size_t n = globalCount;
+
+    // Присваивания, которые вызов выполняет на любом пути (наибольшая неподвижная точка:
+    // завершившийся рекурсивный вызов в конце концов прошёл ветвь без рекурсии)
+    mustWrite.clear();
+    for (FuncNode* f : program->functions) mustWrite[f].assign(n, 1);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (FuncNode* f : program->functions) {
+            if (!f->body) continue;
+            VarSet defined = frameEntry(f, VarSet(n, 0));
+            flowStmt(f->body, defined, FLOW_SUMMARY);
+            defined.resize(n);
+            if (defined != mustWrite[f]) {
+                mustWrite[f] = defined;
+                changed = true;
+            }
+        }
+    }
+
+    // Функции, достижимые из main: только их места вызова сужают множества на входе
+    unordered_set<FuncNode*> reached;
+    vector<FuncNode*> work;
+    if (program->main) {
+        reached.insert(program->main);
+        work.push_back(program->main);
+    }
+    while (!work.empty()) {
+        FuncNode* f = work.back();
+        work.pop_back();
+        if (!f->body) continue;
+        vector<FuncNode*> callees;
+        collectCallees(f->body, callees);
+        for (FuncNode* callee : callees) {
+            if (reached.insert(callee).second) work.push_back(callee);
+        }
+    }
+
+    // Присвоенные при входе в функцию: пересечение по всем местам вызова
+    entry.clear();
+    for (FuncNode* f : program->functions) entry[f].assign(n, 1);
+    changed = true;
+    while (changed) {
+        nextEntry.clear();
+        for (FuncNode* f : program->functions) nextEntry[f].assign(n, 1);
+        flowInit(FLOW_ENTRY);
+        for (FuncNode* f : program->functions) {
+            if (!f->body || !reached.count(f)) continue;
+            VarSet defined = frameEntry(f, entry[f]);
+            flowStmt(f->body, defined, FLOW_ENTRY);
+        }
+        changed = nextEntry != entry;
+        entry.swap(nextEntry);
+    }
+
+    flowInit(FLOW_MARK);
+    for (FuncNode* f : program->functions) {
+        if (!f->body) continue;
+        VarSet defined = frameEntry(f, reached.count(f) ? entry[f] : VarSet(n, 0));
+        flowStmt(f->body, defined, FLOW_MARK);
+    }
+}
+
+// Состояние при входе в f: глобальные переменные globals, параметры присвоены, локальные — нет
+DefiniteAssignment::VarSet DefiniteAssignment::frameEntry(FuncNode* f, const VarSet& globals) const {
+    VarSet defined = globals;
+    defined.resize(globalCount + f->slotTypes.size(), 0);
+    for (size_t i = 0; i < f->paramTypes.size(); ++i) defined[globalCount + i] = 1;
+    return defined;
+}
+
+// <init>: инициализаторы глобальных описаний в порядке следования и вызов main между ними
+void DefiniteAssignment::flowInit(FLOW_MODE mode) {
+    VarSet defined(globalCount, 0);
+    for (size_t i = 0; i <= program->globals.size(); ++i) {
+        if (i == program->mainAfter && program->main) {
+            if (mode == FLOW_ENTRY) meetAssigned(nextEntry[program->main], defined);
+            const VarSet& writes = mustWrite[program->main];
+            for (size_t k = 0; k < globalCount; ++k) defined[k] |= writes[k];
+        }
+        if (i == program->globals.size()) break;
+
+        StmtNode* g = program->globals[i];
+        if (g->value) {
+            readExpr(g->value, defined, mode);
+            defined[cellOf(g->slot)] = 1;
+        }
+    }
+}
+
+// Оператор в порядке исполнения. Возвращает false после break (путь дальше по ветви не идёт)
+bool DefiniteAssignment::flowStmt(StmtNode* s, VarSet& defined, FLOW_MODE mode) {
+    switch (s->kind) {
+    case STMT_EMPTY:
+        return true;
+    case STMT_BLOCK:
+        for (StmtNode* item : s->body) {
+            if (!flowStmt(item, defined, mode)) return false;
+        }
+        return true;
+    case STMT_VAR_DECL:
+        if (s->value) readExpr(s->value, defined, mode);
+        defined[cellOf(s->slot)] = s->value ? 1 : 0;
+        return true;
+    case STMT_ASSIGN:
+        readExpr(s->value, defined, mode);
+        defined[cellOf(s->slot)] = 1;
+        return true;
+    case STMT_CALL: {
+        for (ExprNode* a : s->args) readExpr(a, defined, mode);
+        if (mode == FLOW_ENTRY) {
+            VarSet& callee = nextEntry[s->callee];
+            for (size_t i = 0; i < globalCount; ++i) callee[i] &= defined[i];
+        }
+        const VarSet& writes = mustWrite[s->callee];
+        for (size_t i = 0; i < globalCount; ++i) defined[i] |= writes[i];
+        return true;
+    }
+    case STMT_SWITCH:
+        flowSwitch(s, defined, mode);
+        return true;
+    case STMT_BREAK:
+        return false;
+    }
+    return true;
+}
+
+// Ветвь начинается либо переходом из switch (тогда присвоено то же, что перед ним), либо
+// провалом из предыдущей ветви без break; при константном селекторе переход — только в одну
+// ветвь, и остальные достижимы лишь провалом. На выходе — пересечение по всем путям: break,
+// конец последней ветви и обход всех ветвей (нет подходящей метки и нет default)
+void DefiniteAssignment::flowSwitch(StmtNode* s, VarSet& defined, FLOW_MODE mode) {
+    readExpr(s->value, defined, mode);
+    VarSet start = defined;
+    VarSet out(defined.size(), 1);
+
+    bool fixed = s->value->kind == EXPR_CONST && s->value->type != TYPE_BOOL && s->table;
+    size_t first = fixed ? static_cast<size_t>(s->table->find(s->value->value.v)) : 0;
+    bool hasDefault = false;
+    for (CaseNode* c : s->cases) {
+        if (c->isDefault) hasDefault = true;
+    }
+    if (fixed ? first >= s->cases.size() : !hasDefault) meetAssigned(out, start);
+
+    VarSet d;
+    bool falls = false; // предыдущая ветвь дошла до конца без break
+    for (size_t i = 0; i < s->cases.size(); ++i) {
+        bool jump = !fixed || i == first;
+        if (jump && falls) meetAssigned(d, start);
+        else if (jump) d = start;
+        else if (!falls) continue; // ветвь недостижима
+
+        falls = true;
+        for (StmtNode* item : s->cases[i]->body) {
+            if (!flowStmt(item, d, mode)) {
+                falls = false;
+                break;
+            }
+        }
+        if (!falls) meetAssigned(out, d);
+    }
+    if (falls) meetAssigned(out, d);
+    defined = out;
+}
+
+void DefiniteAssignment::readExpr(ExprNode* e, const VarSet& defined, FLOW_MODE mode) {
+    if (!e) return;
+    if (e->kind == EXPR_VAR && mode == FLOW_MARK && e->slot.index >= 0) {
+        e->checkInit = !defined[cellOf(e->slot)];
+        if (e->checkInit) checked++;
+        else proven++;
+    }
+    readExpr(e->left, defined, mode);
+    readExpr(e->right, defined, mode);
+}
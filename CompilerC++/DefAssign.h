@@ -0,0 +1,51 @@
+﻿#pragma once
+#include "Ast.h"
+#include <unordered_map>
+#include <vector>
+
+// Анализ определённого присваивания (в проверенной программе, AST): какие чтения переменных
+// заведомо идут после присваивания на любом пути исполнения. У таких чтений снимается
+// проверка инициализации при исполнении (ExprNode::checkInit): Executor не проверяет признак
+// ячейки, а BytecodeCompiler не выдаёт OP_CHKL / OP_CHKG. Проверка остаётся только там,
+// где переменная может быть не присвоена, поэтому настоящие ошибки сообщаются как прежде.
+// Анализ идёт по операторам в порядке исполнения: блоки, ветви switch с провалом в следующую
+// ветвь и break; при константном селекторе ветвь, с которой начинается исполнение, известна.
+// Параметры присвоены при входе, локальные переменные — после описания с инициализацией или
+// присваивания. Для глобальных переменных учитываются вызовы: какие переменные вызов
+// присваивает на любом пути (наибольшая неподвижная точка по графу вызовов) и какие уже
+// присвоены при входе в функцию из каждого места вызова (main — из <init>: инициализаторы
+// описаний до main). Чтения в функциях, недостижимых из main, проверяются как прежде
+class DefiniteAssignment {
+public:
+    DefiniteAssignment();
+
+    void run(ProgramNode* program);
+
+    // Статистика (для тестов): чтения без проверки и с проверкой
+    int provenReads() const { return proven; }
+    int checkedReads() const { return checked; }
+
+private:
+    // Признаки «присвоено на любом пути»: сначала глобальные переменные (VarSlot::index),
+    // затем ячейки кадра текущей функции
+    typedef std::vector<char> VarSet;
+
+    // Что делает обход: сводка присваиваний вызова, сбор фактов на входе в вызываемые, разметка чтений
+    enum FLOW_MODE { FLOW_SUMMARY, FLOW_ENTRY, FLOW_MARK };
+
+    ProgramNode* program;
+    size_t globalCount;
+    std::unordered_map<FuncNode*, VarSet> mustWrite; // глобальные переменные, присваиваемые вызовом всегда
+    std::unordered_map<FuncNode*, VarSet> entry; // глобальные переменные, присвоенные при входе
+    std::unordered_map<FuncNode*, VarSet> nextEntry;
+
+    int proven;
+    int checked;
+
+    size_t cellOf(const VarSlot& slot) const { return slot.global ? slot.index : globalCount + slot.index; }
+    VarSet frameEntry(FuncNode* f, const VarSet& globals) const;
+    void flowInit(FLOW_MODE mode);
+    bool flowStmt(StmtNode* s, VarSet& defined, FLOW_MODE mode);
+    void flowSwitch(StmtNode* s, VarSet& defined, FLOW_MODE mode);
+    void readExpr(ExprNode* e, const VarSet& defined, FLOW_MODE mode);
+};
@@ -1,15 +1,32 @@
 ﻿#include "Diagram.h"
 #include "Tree.h"
+#include "Executor.h"
+#include "BytecodeCompiler.h"
+#include "VM.h"
+#include "Aot.h"
+#include "Inliner.h"
+#include "ConstFolder.h"
+#include "ConstProp.h"
+#include "DefAssign.h"
+#include "Ranges.h"
+#include "Simplify.h"
+#include "Cse.h"
+#include "Specializer.h"
+#include "DeadCode.h"
+#include "Effects.h"
 #include <iostream>
+#include <algorithm>
 
 // Конструктор
-Diagram::Diagram(Scanner* scanner) : sc(scanner), curTok(0), curLex(), currentDeclType(TYPE_INT) {
-    pushTok.clear();
-    pushLex.clear();
+Diagram::Diagram(Scanner* scanner) : sc(scanner), tokPos(0), scanEnd(0), curIndex(0), curTok(0), curLex(), currentDeclType(TYPE_INT), program(nullptr), curFunc(nullptr),
+    inlineBudget(Inliner::DEFAULT_BUDGET), inlineReport(false), memoEnabled(true), memoReport(false), ssaDump(false), dispatchStats(false) {}
+
+Diagram::~Diagram() {
+    delete program;
 }
 
 void Diagram::synError(const string& msg) {
-    auto lc = sc->getLineCol();
+    auto lc = here().lineCol();
     std::cerr << "Синтаксическая ошибка: " << msg;
     if (!curLex.empty()) std::cerr << " (около '" << curLex << "')";
     std::cerr << std::endl << "(строка " << lc.first << ":" << lc.second << ")" << std::endl;
@@ -17,142 +34,227 @@ void Diagram::synError(const string& msg) {
 }
 
 void Diagram::lexError() {
-    auto lc = sc->getLineCol();
+    auto lc = here().lineCol();
     std::cerr << "Лексическая ошибка: неизвестная лексема '" << curLex << "'";
     std::cerr << std::endl << "(строка " << lc.first << ":" << lc.second << ")" << std::endl;
     throw std::runtime_error("Лексическая ошибка");
 }
 
 void Diagram::interpError(const string& msg) {
-    auto lc = sc->getLineCol();
-	Tree::interpError(msg, curLex, lc.first, lc.second);
+	Tree::interpError(msg, string(curLex), here());
 }
 
 void Diagram::semError(const string& msg) {
-    auto lc = sc->getLineCol();
-    Tree::semError(msg, curLex, lc.first, lc.second);
+    Tree::semError(msg, string(curLex), here());
 }
 
 int Diagram::nextToken() {
-    if (!pushTok.empty()) {
-        int t = pushTok.back();
-        pushTok.pop_back();
-        string lx = pushLex.back();
-        pushLex.pop_back();
-        curTok = t;
-        curLex = lx;
-        if (curTok == T_ERR) lexError();
-        return curTok;
-    }
+    int t = peekToken();
+    // T_END повторяется бесконечно, как у лексера
+    if (t != T_END) ++tokPos;
+    return t;
+}
+
+// Лексема читается (и проверяется) так же, как nextToken, но позиция не сдвигается
+int Diagram::peekToken() {
+    curIndex = tokPos;
+    curTok = tokens.kind[tokPos];
+    curLex = tokens.lexeme(tokPos);
 
-    string lex;
-    curTok = sc->getNextLex(lex);
-    curLex = lex;
+    size_t end = tokens.offset[tokPos] + tokens.length[tokPos];
+    if (end > scanEnd) scanEnd = end;
 
     if (curTok == T_ERR) lexError();
     return curTok;
 }
 
-int Diagram::peekToken() {
-    int t = nextToken();
-    pushBack(t, curLex);
-    return t;
+void Diagram::ungetToken() {
+    if (tokPos > 0) --tokPos;
 }
 
-void Diagram::pushBack(int tok, const string& lex) {
-    pushTok.push_back(tok);
-    pushLex.push_back(lex);
+// Позиция соответствует месту, до которого дочитал бы потоковый лексер;
+// строка и столбец по ней вычисляются только при выводе
+SrcLoc Diagram::here() const {
+    return SrcLoc(scanEnd);
 }
 
-// Вспомогательные методы для интерпретации
-void Diagram::pushValue(const SemNode& node) {
-    evalStack.push(node);
-}
+// Вспомогательные методы
 
-SemNode Diagram::popValue() {
-    if (evalStack.empty()) {
-        semError("внутренняя ошибка: стек вычислений пуст");
+// Узел числовой константы: тип — наименьший из short/int/long, вмещающий значение
+ExprNode* Diagram::makeConstant(uint64_t magnitude, bool negative) {
+    if (magnitude > static_cast<uint64_t>(INT64_MAX)) {
+        semError("неверный формат константы: значение вне диапазона long");
     }
-    SemNode node = evalStack.top();
-    evalStack.pop();
-    return node;
-}
-
-SemNode Diagram::evaluateConstant(const string& value, DATA_TYPE type) {
-    SemNode result;
-    result.DataType = type;
-    result.hasValue = true;
-
-    try {
-        if (type == TYPE_BOOL) {
-            result.Value.v_bool = (value == "true");
-        }
-        else {
-            // Обрабатываем отрицательные числа напрямую
-            string valueToParse = value;
-            bool isNegative = false;
+    long long val = static_cast<long long>(magnitude);
+    if (negative) val = -val;
 
-            if (!valueToParse.empty() && valueToParse[0] == '-') {
-                isNegative = true;
-                valueToParse = valueToParse.substr(1);
-            }
-
-            long long val = std::stoll(valueToParse, nullptr, 0);
-
-            if (isNegative) {
-                val = -val;
-            }
-
-            if (type == TYPE_SHORT_INT) {
-                result.Value.v_int16 = static_cast<int16_t>(val);
-            }
-            else if (type == TYPE_INT) {
-                result.Value.v_int32 = static_cast<int32_t>(val);
-            }
-            else if (type == TYPE_LONG_INT) {
-                result.Value.v_int64 = static_cast<int64_t>(val);
-            }
-        }
+    DATA_TYPE constType = TYPE_SHORT_INT;
+    // Если значение выходит за пределы short, автоматически делаем его int
+    if (val > 32767 || val < -32768) {
+        constType = TYPE_INT;
     }
-    catch (const std::exception& e) {
-        semError("неверный формат константы: " + string(e.what()));
+    // Если значение выходит за пределы int, автоматически делаем его long
+    if (val > 2147483647LL || val < -2147483648LL) {
+        constType = TYPE_LONG_INT;
     }
 
-    return result;
+    SrcLoc loc = here();
+    ExprNode* constNode = new ExprNode(EXPR_CONST, constType, loc);
+    constNode->value = Value(constType, val);
+    return constNode;
 }
 
-void Diagram::executeAssignment(const string& varName, DATA_TYPE exprType, int line, int col) {
-    SemNode value = popValue();
-    Tree* varNode = Tree::Cur->semGetVar(varName, line, col);
-    DATA_TYPE varType = varNode->n->DataType;
-
+void Diagram::checkAssignTypes(DATA_TYPE varType, DATA_TYPE exprType, const string& msg) {
     bool varIsInt = (varType == TYPE_INT || varType == TYPE_SHORT_INT || varType == TYPE_LONG_INT);
     bool exprIsInt = (exprType == TYPE_INT || exprType == TYPE_SHORT_INT || exprType == TYPE_LONG_INT);
 
     if (!((varIsInt && exprIsInt) || (varType == TYPE_BOOL && exprType == TYPE_BOOL))) {
-        semError("несоответствие типов при присваивании для '" + varName + "'");
+        semError(msg);
     }
+}
 
-    Tree::setVarValue(varName, value, line, col);
+// Узел бинарной операции; позиция берётся там же, где её брал интерпретатор при разборе.
+// Здесь же выбирается ядро операции: операнды приводятся к общему типу уже при проверке
+// типов (для канонических значений расширение ничего не стоит), поэтому при исполнении
+// достаточно вызвать ядро
+ExprNode* Diagram::makeBinary(ExprNode* left, ExprNode* right, BIN_OP op, OP_GROUP group, DATA_TYPE type) {
+    SrcLoc loc = here();
+    ExprNode* node = new ExprNode(EXPR_BINARY, type, loc);
+    node->op = op;
+    node->group = group;
+    node->left = left;
+    node->right = right;
+
+    DATA_TYPE opType = type; // арифметика: тип результата; сдвиг: тип левого операнда
+    if (group == OP_COMPARISON) {
+        opType = (left->type == TYPE_BOOL) ? TYPE_BOOL : Tree::getMaxType(left->type, right->type);
+    }
+    node->kernel = selectKernel(op, opType);
+    if (!node->kernel) semError(string("недопустимые типы операндов для '") + binOpName(op) + "'");
+    return node;
 }
 
-// Точка входа
-void Diagram::ParseProgram(bool isInterp, bool isDebug) {
+// Назначает описанной переменной ячейку: глобальные нумеруются в порядке описания,
+// параметры и локальные переменные получают следующую свободную ячейку кадра функции
+void Diagram::allocSlot(Tree* varNode) {
+    if (curFunc) {
+        varNode->n->Slot = VarSlot(false, static_cast<int>(curFunc->slotTypes.size()));
+        curFunc->slotTypes.push_back(varNode->n->DataType);
+    }
+    else {
+        // описание заносится в program->globals сразу после разбора IdInit
+        varNode->n->Slot = VarSlot(true, static_cast<int>(program->globals.size()));
+    }
+}
+
+// Синтаксический и семантический анализ: строит AST, ничего не исполняя
+ProgramNode* Diagram::Parse() {
     SemNode* rootNode = new SemNode();
     rootNode->id = "<глобальная область видимости>";
     rootNode->DataType = TYPE_SCOPE;
-    rootNode->line = 0;
-    rootNode->col = 0;
     Tree* rootTree = new Tree(rootNode, nullptr);
     Tree::setCur(rootTree);
 
-    if (isInterp) {
-        Tree::enableInterpretation();
+    delete program;
+    program = new ProgramNode();
+    funcByDecl.clear();
+    curFunc = nullptr;
+
+    // Весь текст разбирается на лексемы заранее; дальше парсер только индексирует поток
+    tokens = sc->tokenize();
+    tokPos = 0;
+    scanEnd = 0;
+
+    // Значения вычисляет только Executor; при разборе выполняется лишь семантика
+    Tree::disableInterpretation();
+
+    Program();
+
+    int t = nextToken();
+    if (t != T_END) synError("лишний текст в конце программы");
+
+    return program;
+}
+
+void Diagram::setInlining(int budget, bool report) {
+    inlineBudget = budget;
+    inlineReport = report;
+}
+
+void Diagram::setMemoization(bool enabled, bool report) {
+    memoEnabled = enabled;
+    memoReport = report;
+}
+
+void Diagram::setSsaDump(bool enabled) {
+    ssaDump = enabled;
+}
+
+void Diagram::setDispatchStats(bool enabled) {
+    dispatchStats = enabled;
+}
+
+void Diagram::Optimize(bool isDebug) {
+    // Встраивание и свёртка констант убрали бы отладочный вывод вызовов и вычислений.
+    // Свёртка идёт после встраивания: константные аргументы становятся константами в копиях тел
+    if (!isDebug) {
+        Inliner inliner(inlineBudget);
+        inliner.run(program);
+        if (inlineReport) {
+            cout << "Встроено вызовов: " << inliner.inlinedCalls() << endl;
+            for (const string& line : inliner.inlinedReport()) cout << "  " << line << endl;
+        }
+
+        ConstFolder folder;
+        folder.run(program);
+
+        // Константы через границы функций: параметры с одинаковым значением во всех вызовах
+        // и однократно присваиваемые глобальные переменные; их замены сворачивает ConstFolder
+        ConstPropagator propagator;
+        for (int round = 0; round < ConstPropagator::MAX_ROUNDS && propagator.run(program) > 0; ++round) {
+            ConstFolder refold;
+            refold.run(program);
+        }
+
+        // Копии функций по константным аргументам; их тела сворачивает следующая свёртка
+        Specializer specializer;
+        for (int round = 0; round < Specializer::MAX_ROUNDS && specializer.run(program) > 0; ++round) {
+            ConstFolder refold;
+            refold.run(program);
+        }
     }
-    else {
-        Tree::disableInterpretation();
+    DeadCodeEliminator dce;
+    dce.run(program);
+
+    // Чтения, перед которыми переменная заведомо присвоена, исполняются без проверки
+    // инициализации; анализ не меняет поведения, поэтому выполняется и с debug
+    DefiniteAssignment assignment;
+    assignment.run(program);
+
+    // Проверки обрезки и деления на 0, исход которых известен по диапазонам значений
+    if (!isDebug) {
+        RangeAnalysis ranges;
+        ranges.run(program);
+
+        // Отрицание, сдвиги вместо умножения и деления на 2^k, операции с нейтральной константой
+        Simplifier simplifier;
+        simplifier.run(program);
+
+        // Повторные вычисления и чтения глобальных переменных — по нумерации значений в SSA;
+        // после упрощений одинаковые выражения записаны одинаково
+        CommonSubexpressions cse;
+        cse.run(program, ssaDump ? &cout : nullptr);
     }
 
+    // Наборы чтения и записи считаются по окончательным телам функций
+    if (!isDebug && memoEnabled) {
+        EffectAnalysis effects;
+        effects.run(program);
+    }
+}
+
+// Точка входа
+void Diagram::ParseProgram(bool isInterp, bool isDebug, ENGINE_KIND engine, bool memStats) {
     if (isDebug) {
         Tree::enableDebug();
     }
@@ -160,12 +262,57 @@ void Diagram::ParseProgram(bool isInterp, bool isDebug) {
         Tree::disableDebug();
 	}
 
-    Program();
-
-    int t = nextToken();
-    if (t != T_END) synError("лишний текст в конце программы");
-
-    if (!isInterp) {
+    Parse();
+    Tree* rootTree = Tree::getCur();
+
+    // AOT отладочный вывод не печатает
+    if (isInterp) Optimize(isDebug && engine != ENGINE_AOT);
+
+    if (isInterp && (engine == ENGINE_VM || engine == ENGINE_JIT)) {
+        BytecodeCompiler compiler(isDebug);
+        BcProgram* bytecode = compiler.compile(program);
+        {
+            DispatchProfile profile;
+            VM vm(bytecode, engine == ENGINE_JIT);
+            if (dispatchStats) vm.setProfile(&profile);
+            vm.run();
+            if (memoReport) vm.memoStats().printStats("Мемоизация вызовов", cout);
+            if (dispatchStats) {
+                const Peephole& peephole = compiler.peepholeStats();
+                cout << "Суперинструкции: константа в операнде " << peephole.fusedConstants()
+                    << ", сравнение с переходом " << peephole.fusedBranches()
+                    << ", результат в переменную " << peephole.retargetedMoves()
+                    << ", в глобальную переменную " << peephole.fusedStores()
+                    << "; удалено приведений " << peephole.removedCasts() << endl;
+                profile.printStats("Диспетчеризация VM", cout, 10);
+            }
+        }
+        delete bytecode;
+    }
+    else if (isInterp && engine == ENGINE_AOT) {
+        // Отладочный вывод в AOT не поддерживается: программа собирается как с --no-debug
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+        string error;
+        AotModule* aot = AotModule::load(bytecode, error);
+        if (aot) {
+            aot->run();
+            delete aot;
+        }
+        else {
+            cerr << "Ошибка AOT: " << error << "; выполнение на VM" << endl;
+            VM vm(bytecode);
+            vm.run();
+        }
+        delete bytecode;
+    }
+    else if (isInterp) {
+        Executor executor(program);
+        executor.run();
+        if (memStats) executor.frameStats().printStats("Арена кадров", cout);
+        if (memoReport) executor.memoStats().printStats("Мемоизация вызовов", cout);
+    }
+    else {
         rootTree->print();
     }
 }
@@ -183,31 +330,43 @@ void Diagram::Program() {
 void Diagram::TopDecl() {
     int t = peekToken();
     if (t == KW_VOID) {
-        Function();
+        FuncNode* func = Function();
+
+        // Точкой входа служит void main() без параметров
+        if (func->name == "main" && func->paramTypes.empty()) {
+            program->main = func;
+            program->mainAfter = program->globals.size();
+        }
     }
     else {
-        VarDecl();
+        VarDecl(program->globals);
     }
 }
 
 // Function -> 'void' IDENT '(' ParamListOpt ')' Block
-void Diagram::Function() {
+FuncNode* Diagram::Function() {
     int t = nextToken();
     if (t != KW_VOID) synError("ожидался 'void' в определении функции");
 
     t = nextToken();
     if (t != IDENT && t != KW_MAIN) synError("ожидалось имя функции (IDENT)");
-    string funcName = curLex;
-    auto pos = sc->getLineCol();
+    string funcName(curLex);
+    SrcLoc loc = here();
 
-    Tree* funcNode = Tree::Cur->semInclude(funcName, TYPE_FUNCT, pos.first, pos.second);
+    Tree* funcNode = Tree::Cur->semInclude(funcName, TYPE_FUNCT, loc);
     Tree* savedCur = Tree::Cur;
 
+    // Функция регистрируется до разбора тела, чтобы рекурсивные вызовы ссылались на неё
+    FuncNode* func = new FuncNode(funcName, funcNode, loc);
+    program->functions.push_back(func);
+    funcByDecl[funcNode] = func;
+    curFunc = func;
+
     if (funcNode && funcNode->Left) {
         Tree::setCur(funcNode->Left);
     }
     else {
-        Tree::Cur->semEnterBlock(pos.first, pos.second);
+        Tree::Cur->semEnterBlock(loc);
     }
 
     t = nextToken();
@@ -229,14 +388,17 @@ void Diagram::Function() {
 
             t = nextToken();
             if (t != IDENT) synError("ожидалось имя параметра");
-            string paramName = curLex;
-            auto ppos = sc->getLineCol();
+            string paramName(curLex);
+            SrcLoc ploc = here();
 
-            Tree* paramNode = Tree::Cur->semInclude(paramName, ptype, ppos.first, ppos.second);
+            Tree* paramNode = Tree::Cur->semInclude(paramName, ptype, ploc);
             if (paramNode && paramNode->n) {
                 paramNode->n->hasValue = true; // Помечаем параметр как инициализированный
             }
             paramTypes.push_back(ptype);
+            func->paramNames.push_back(paramName);
+            func->paramDecls.push_back(paramNode);
+            allocSlot(paramNode);
             paramCount++;
 
             t = peekToken();
@@ -255,45 +417,25 @@ void Diagram::Function() {
 
     funcNode->semSetParam(funcNode, paramCount);
     funcNode->semSetParamTypes(funcNode, paramTypes);
+    func->paramTypes = paramTypes;
 
     // Устанавливаем текущую функцию
     Tree::setCurrentFunction(funcNode);
 
-    // Управление флагом интерпретации: выключаем для всех функций кроме main
-    bool wasInterpretationEnabled = Tree::isInterpretationEnabled();
-    if (funcName != "main" || paramCount != 0) {
-        Tree::disableInterpretation();
-    }
-
-    if (funcNode && funcNode->n) {
-        funcNode->n->bodyStartPos = sc->getPos();
-    }
-
     // Тело функции
-    Block();
-
-    if (funcNode && funcNode->n) {
-        funcNode->n->bodyEndPos = sc->getPos();
-    }
+    func->body = Block();
+    markTailCalls(func->body);
 
     // Сбрасываем текущую функцию
     Tree::setCurrentFunction(nullptr);
-
-    // Восстанавливаем предыдущее состояние флага интерпретации
-    if (funcName != "main" || paramCount != 0) {
-        if (wasInterpretationEnabled) {
-            Tree::enableInterpretation();
-        }
-        else {
-            Tree::disableInterpretation();
-        }
-    }
+    curFunc = nullptr;
 
     Tree::setCur(savedCur);
+    return func;
 }
 
 // VarDecl -> Type IdInitList ;
-void Diagram::VarDecl() {
+void Diagram::VarDecl(std::vector<StmtNode*>& out) {
     int t = nextToken();
     if (!(t == KW_INT || t == KW_SHORT || t == KW_LONG || t == KW_BOOL))
         synError("ожидался тип в объявлении переменных");
@@ -303,131 +445,118 @@ void Diagram::VarDecl() {
     else if (t == KW_BOOL) currentDeclType = TYPE_BOOL;
     else currentDeclType = TYPE_INT;
 
-    IdInitList();
+    IdInitList(out);
 
     t = nextToken();
     if (t != SEMI) synError("ожидался ';' в конце объявления переменных");
 }
 
 // IdInitList -> IdInit (',' IdInit)*
-void Diagram::IdInitList() {
-    IdInit();
+void Diagram::IdInitList(std::vector<StmtNode*>& out) {
+    out.push_back(IdInit());
     int t = peekToken();
     while (t == COMMA) {
         nextToken();
-        IdInit();
+        out.push_back(IdInit());
         t = peekToken();
     }
 }
 
 // IdInit -> IDENT [ = Expr ]
-void Diagram::IdInit() {
+StmtNode* Diagram::IdInit() {
     int t = nextToken();
     if (t != IDENT) synError("ожидался идентификатор в списке объявлений");
-    string varName = curLex;
-    auto pos = sc->getLineCol();
+    string varName(curLex);
+    SrcLoc loc = here();
+
+    Tree* varNode = Tree::Cur->semInclude(varName, currentDeclType, loc);
+    allocSlot(varNode);
 
-    Tree* varNode = Tree::Cur->semInclude(varName, currentDeclType, pos.first, pos.second);
+    StmtNode* decl = new StmtNode(STMT_VAR_DECL, loc);
+    decl->name = varName;
+    decl->declType = currentDeclType;
+    decl->decl = varNode;
+    decl->slot = varNode->n->Slot;
 
     t = peekToken();
     if (t == ASSIGN) {
         nextToken();
 
-        DATA_TYPE exprType = Expr();
-        SemNode value = popValue();
-
-        DATA_TYPE varType = varNode->n->DataType;
-        bool varIsInt = (varType == TYPE_INT || varType == TYPE_SHORT_INT || varType == TYPE_LONG_INT);
-        bool exprIsInt = (exprType == TYPE_INT || exprType == TYPE_SHORT_INT || exprType == TYPE_LONG_INT);
-
-        if (!((varIsInt && exprIsInt) || (varType == TYPE_BOOL && exprType == TYPE_BOOL))) {
-            semError("несоответствие типов при инициализации переменной '" + varName + "'");
-        }
+        ExprNode* init = Expr();
+        checkAssignTypes(varNode->n->DataType, init->type,
+            "несоответствие типов при инициализации переменной '" + varName + "'");
 
-        Tree::setVarValue(varName, value, pos.first, pos.second);
+        // Пометка "инициализирована" для семантики
+        varNode->n->hasValue = true;
+        decl->value = init;
     }
+    return decl;
 }
 
 // Block -> '{' BlockItems '}'
-void Diagram::Block() {
+StmtNode* Diagram::Block() {
     int t = nextToken();
     if (t != LBRACE) synError("ожидался '{' для начала блока");
 
-    // позиция сразу после '{' — начало тела блока
-    size_t posAfterLBrace = sc->getPos();
+    SrcLoc loc = here();
+    Tree::Cur->semEnterBlock(loc);
 
-    auto lc = sc->getLineCol();
-    Tree::Cur->semEnterBlock(lc.first, lc.second);
-
-    // Если мы парсим тело функции (currentFunction установлен), сохраняем начало тела корректно
-    Tree* curFunc = Tree::getCurrentFunction();
-    if (curFunc && curFunc->n) {
-        // записываем только если ранее не записано
-        if (curFunc->n->bodyStartPos == 0) curFunc->n->bodyStartPos = posAfterLBrace;
-    }
-
-    BlockItems();
+    StmtNode* block = new StmtNode(STMT_BLOCK, loc);
+    BlockItems(block->body);
 
     t = nextToken();
     if (t != RBRACE) synError("ожидался '}' для конца блока");
 
-    // корректная позиция конца тела (после '}')
-    if (curFunc && curFunc->n) {
-        curFunc->n->bodyEndPos = sc->getPos();
-    }
-
     Tree::Cur->semExitBlock();
+    return block;
 }
 
 // BlockItems -> ( VarDecl | Stmt )* 
-void Diagram::BlockItems() {
+void Diagram::BlockItems(std::vector<StmtNode*>& out) {
     int t = peekToken();
     while (t != RBRACE && t != T_END) {
         if (t == KW_INT || t == KW_SHORT || t == KW_LONG || t == KW_BOOL) {
-            VarDecl();
+            VarDecl(out);
         }
         else {
-            Stmt();
+            out.push_back(Stmt());
         }
         t = peekToken();
     }
 }
 
 // Stmt -> ';' | Block | Assign | SwitchStmt | CallStmt
-void Diagram::Stmt() {
+StmtNode* Diagram::Stmt() {
     int t = peekToken();
 
     if (t == SEMI) {
         nextToken(); // пустой оператор
-        return;
+        SrcLoc loc = here();
+        return new StmtNode(STMT_EMPTY, loc);
     }
 
     if (t == LBRACE) {
-        Block();
-        return;
+        return Block();
     }
 
     if (t == KW_SWITCH) {
-        SwitchStmt();
-        return;
+        return SwitchStmt();
     }
 
     if (t == IDENT) {
-        int tokIdent = nextToken();
-        string savedName = curLex;
+        nextToken();
         int t2 = peekToken();
 
-        pushBack(tokIdent, savedName);
+        ungetToken();
 
         if (t2 == ASSIGN) {
-            Assign();
+            StmtNode* assign = Assign();
             t = nextToken();
             if (t != SEMI) synError("ожидался ';' после оператора присваивания");
-            return;
+            return assign;
         }
         else if (t2 == LPAREN) {
-            CallStmt();
-            return;
+            return CallStmt();
         }
         else {
             synError("ожидалось '=' (присваивание) или '(' (вызов функции) после идентификатора");
@@ -435,24 +564,26 @@ void Diagram::Stmt() {
     }
 
     synError("неизвестная форма оператора");
+    return nullptr;
 }
 
 // CallStmt -> Call ;
-void Diagram::CallStmt() {
-    Call();
+StmtNode* Diagram::CallStmt() {
+    StmtNode* call = Call();
 
     int t = nextToken();
     if (t != SEMI) synError("ожидался ';' после вызова функции");
+    return call;
 }
 
 // Assign -> IDENT = Expr
-void Diagram::Assign() {
+StmtNode* Diagram::Assign() {
     int t = nextToken();
     if (t != IDENT) synError("ожидался идентификатор в присваивании");
-    string name = curLex;
-    auto lc = sc->getLineCol();
+    string name(curLex);
+    SrcLoc loc = here();
 
-    Tree* leftNode = Tree::Cur->semGetVar(name, lc.first, lc.second);
+    Tree* leftNode = Tree::Cur->semGetVar(name, loc);
     if (leftNode->n->DataType == TYPE_FUNCT) {
         semError("нельзя присваивать функции '" + name + "'");
     }
@@ -460,39 +591,37 @@ void Diagram::Assign() {
     t = nextToken();
     if (t != ASSIGN) synError("ожидался знак '=' в присваивании");
 
-    DATA_TYPE rtype = Expr();
-    DATA_TYPE ltype = leftNode->n->DataType;
+    ExprNode* rhs = Expr();
+    checkAssignTypes(leftNode->n->DataType, rhs->type, "несоответствие типов при присваивании для '" + name + "'");
 
-    bool lIsInt = (ltype == TYPE_INT || ltype == TYPE_SHORT_INT || ltype == TYPE_LONG_INT);
-    bool rIsInt = (rtype == TYPE_INT || rtype == TYPE_SHORT_INT || rtype == TYPE_LONG_INT);
+    // Пометка "инициализирована" для семантики
+    leftNode->n->hasValue = true;
 
-    if (!((lIsInt && rIsInt) || (ltype == TYPE_BOOL && rtype == TYPE_BOOL))) {
-        semError("несоответствие типов при присваивании для '" + name + "'");
-    }
-
-    // Выполняем присваивание
-    executeAssignment(name, rtype, lc.first, lc.second);
+    StmtNode* assign = new StmtNode(STMT_ASSIGN, loc);
+    assign->name = name;
+    assign->decl = leftNode;
+    assign->slot = leftNode->n->Slot;
+    assign->value = rhs;
+    return assign;
 }
 
 // SwitchStmt -> 'switch' '(' Expr ')' '{' CaseStmt* DefaultStmt? '}'
-void Diagram::SwitchStmt() {
+StmtNode* Diagram::SwitchStmt() {
     int t = nextToken();
     if (t != KW_SWITCH) synError("ожидался 'switch'");
+    SrcLoc loc = here();
 
     t = nextToken();
     if (t != LPAREN) synError("ожидался '(' после 'switch'");
 
-    DATA_TYPE stype = Expr();
+    ExprNode* cond = Expr();
+    DATA_TYPE stype = cond->type;
     if (!(stype == TYPE_INT || stype == TYPE_SHORT_INT || stype == TYPE_LONG_INT)) {
         semError("тип выражения в switch должен быть целым (int/short/long)");
     }
 
-    SemNode sVal = popValue();
-    if (!sVal.hasValue) interpError("выражение switch неинициализировано");
-    long long switchVal = 0;
-    if (sVal.DataType == TYPE_SHORT_INT) switchVal = sVal.Value.v_int16;
-    else if (sVal.DataType == TYPE_INT) switchVal = sVal.Value.v_int32;
-    else if (sVal.DataType == TYPE_LONG_INT) switchVal = sVal.Value.v_int64;
+    StmtNode* sw = new StmtNode(STMT_SWITCH, loc);
+    sw->value = cond;
 
     t = nextToken();
     if (t != RPAREN) synError("ожидался ')' после выражения switch");
@@ -500,49 +629,107 @@ void Diagram::SwitchStmt() {
     t = nextToken();
     if (t != LBRACE) synError("ожидался '{' для тела switch");
 
-    bool anyMatched = false;
-    bool endSwitch = false;
-
-    // Обрабатываем ВСЕ case-ветви, не прерываем цикл на первом break,
-    // но если endSwitch==true — разбираем дальнейшие ветви только семантически (не исполняем).
     int pk = peekToken();
     while (pk == KW_CASE) {
-        if (!endSwitch) {
-            // CaseStmt возвращает true, если в выполнявшейся ветке встретился break
-            if (CaseStmt(switchVal, anyMatched)) {
-                endSwitch = true;
-            }
-        }
-        else {
-            // уже было break — дальше только семантика: временно выключаем интерпретацию
-            bool saveInterp = Tree::isInterpretationEnabled();
-            if (saveInterp) Tree::disableInterpretation();
-            CaseStmt(switchVal, anyMatched);
-            if (saveInterp) Tree::enableInterpretation();
-        }
+        sw->cases.push_back(CaseStmt());
         pk = peekToken();
     }
 
     if (peekToken() == KW_DEFAULT) {
-        if (!endSwitch) {
-            if (DefaultStmt(anyMatched)) {
-                endSwitch = true;
+        sw->cases.push_back(DefaultStmt());
+    }
+
+    t = nextToken();
+    if (t != RBRACE) synError("ожидался '}' в конце switch");
+
+    buildSwitchTable(sw);
+    return sw;
+}
+
+// Следующий после body[j] ветви i оператор (с проваливанием в следующие ветви) —
+// break или конец switch; пустые операторы пропускаются
+static bool flowsToSwitchExit(StmtNode* sw, size_t i, size_t j) {
+    for (++j; i < sw->cases.size(); ++i, j = 0) {
+        for (; j < sw->cases[i]->body.size(); ++j) {
+            STMT_KIND kind = sw->cases[i]->body[j]->kind;
+            if (kind == STMT_BREAK) return true;
+            if (kind != STMT_EMPTY) return false;
+        }
+    }
+    return true;
+}
+
+// Отмечает вызовы в хвостовой позиции оператора s, который сам стоит в хвостовой позиции
+// функции: после такого вызова в функции больше ничего не исполняется
+void Diagram::markTailCalls(StmtNode* s) {
+    switch (s->kind) {
+    case STMT_CALL:
+        s->tail = true;
+        break;
+    case STMT_BLOCK:
+        for (size_t j = s->body.size(); j > 0; --j) {
+            if (s->body[j - 1]->kind == STMT_EMPTY) continue;
+            markTailCalls(s->body[j - 1]);
+            break;
+        }
+        break;
+    case STMT_SWITCH:
+        for (size_t i = 0; i < s->cases.size(); ++i) {
+            const vector<StmtNode*>& body = s->cases[i]->body;
+            for (size_t j = 0; j < body.size() && body[j]->kind != STMT_BREAK; ++j) {
+                if (flowsToSwitchExit(s, i, j)) markTailCalls(body[j]);
             }
         }
-        else {
-            bool saveInterp = Tree::isInterpretationEnabled();
-            if (saveInterp) Tree::disableInterpretation();
-            DefaultStmt(anyMatched);
-            if (saveInterp) Tree::enableInterpretation();
+        break;
+    default:
+        break;
+    }
+}
+
+// Таблица переходов switch. Метки сортируются; совпадающие метки оказываются рядом,
+// и повторная метка сообщается как ошибка в позиции второго вхождения.
+// Плотная таблица выбирается, если она заполнена хотя бы наполовину (короткие — всегда)
+void Diagram::buildSwitchTable(StmtNode* sw) {
+    const uint64_t DENSE_MIN_SIZE = 8;
+
+    SwitchTable* table = new SwitchTable();
+    sw->table = table;
+    int count = static_cast<int>(sw->cases.size());
+    table->defaultTarget = count;
+
+    vector<pair<long long, int>> sorted; // (метка, номер ветви)
+    for (int i = 0; i < count; ++i) {
+        if (sw->cases[i]->isDefault) table->defaultTarget = i;
+        else sorted.push_back(make_pair(sw->cases[i]->value, i));
+    }
+    sort(sorted.begin(), sorted.end());
+
+    for (size_t k = 1; k < sorted.size(); ++k) {
+        if (sorted[k].first == sorted[k - 1].first) {
+            Tree::semError("повторяющаяся метка case", to_string(sorted[k].first), sw->cases[sorted[k].second]->loc);
         }
     }
+    if (sorted.empty()) return; // плотная таблица нулевой длины: всегда defaultTarget
 
-    t = nextToken();
-    if (t != RBRACE) synError("ожидался '}' в конце switch");
+    // Метки неотрицательны (см. CaseStmt), поэтому разность помещается в uint64_t
+    uint64_t range = static_cast<uint64_t>(sorted.back().first - sorted.front().first) + 1;
+    table->dense = range <= max<uint64_t>(2 * sorted.size(), DENSE_MIN_SIZE);
+
+    if (table->dense) {
+        table->minLabel = sorted.front().first;
+        table->jump.assign(static_cast<size_t>(range), table->defaultTarget);
+        for (const auto& label : sorted) table->jump[label.first - table->minLabel] = label.second;
+    }
+    else {
+        for (const auto& label : sorted) {
+            table->labels.push_back(label.first);
+            table->targets.push_back(label.second);
+        }
+    }
 }
 
 // CaseStmt -> 'case' Const ':' Stmt*
-bool Diagram::CaseStmt(long long switchVal, bool& anyMatched) {
+CaseNode* Diagram::CaseStmt() {
     int t = nextToken();
     if (t != KW_CASE) synError("ожидался 'case'");
 
@@ -551,21 +738,16 @@ bool Diagram::CaseStmt(long long switchVal, bool& anyMatched) {
         semError("case принимает только числовую константу");
     }
 
-    long long caseVal = 0;
-    try {
-        caseVal = std::stoll(curLex, nullptr, 0);
-    }
-    catch (...) {
+    if (tokens.value[curIndex] > static_cast<uint64_t>(INT64_MAX)) {
         semError("неверная константа в case");
     }
+    long long caseVal = static_cast<long long>(tokens.value[curIndex]);
+    SrcLoc loc = here();
 
     t = nextToken();
     if (t != COLON) synError("ожидался ':' после case-значения");
 
-    bool matched = (!anyMatched && caseVal == switchVal);
-    if (matched) anyMatched = true;
-
-    bool branchBroken = false; // встретили break в этой ветке (выполняемой или нет)
+    CaseNode* branch = new CaseNode(false, caseVal, loc);
 
     for (;;) {
         int p = peekToken();
@@ -573,47 +755,31 @@ bool Diagram::CaseStmt(long long switchVal, bool& anyMatched) {
 
         if (p == KW_BREAK) {
             nextToken(); // съели KW_BREAK
+            SrcLoc bloc = here();
             int semi = nextToken();
             if (semi != SEMI) synError("ожидался ';' после break");
 
-            // независимо от matched — нужно продолжить синтаксический разбор
-            // но пометить, что break был (если matched==true — это остановит исполнение внешнего switch)
-            branchBroken = true;
-            // после break все оставшиеся операторы в этой ветке недостижимы,
-            // поэтому мы будем разбирать их только семантически (не исполняя)
+            // операторы после break недостижимы, но разбираются (и проверяются семантически) как обычно
+            branch->body.push_back(new StmtNode(STMT_BREAK, bloc));
             continue;
         }
 
-        // Обычный разбор оператора: исполнение только если matched и ещё не было break
-        if (Tree::isInterpretationEnabled()) {
-            if (matched && !branchBroken) {
-                Stmt(); // выполняем
-            }
-            else {
-                bool save = Tree::isInterpretationEnabled();
-                if (save) Tree::disableInterpretation();
-                Stmt(); // только семантика
-                if (save) Tree::enableInterpretation();
-            }
-        }
-        else {
-            Stmt(); // интерпретация выключена — только семантика
-        }
+        branch->body.push_back(Stmt());
     }
 
-    // вернём true только если совпавшая ветка включала break (тогда внешний Switch прекратит исполнение)
-    return (matched && branchBroken);
+    return branch;
 }
 
 // DefaultStmt -> 'default' ':' Stmt*
-bool Diagram::DefaultStmt(bool anyMatched) {
+CaseNode* Diagram::DefaultStmt() {
     int t = nextToken();
     if (t != KW_DEFAULT) synError("ожидался 'default'");
+    SrcLoc loc = here();
 
     t = nextToken();
     if (t != COLON) synError("ожидался ':' после default");
 
-    bool matched = !anyMatched;
+    CaseNode* branch = new CaseNode(true, 0, loc);
 
     while (true) {
         int p = peekToken();
@@ -621,160 +787,69 @@ bool Diagram::DefaultStmt(bool anyMatched) {
 
         if (p == KW_BREAK) {
             nextToken();
+            SrcLoc bloc = here();
             int semi = nextToken();
             if (semi != SEMI) synError("ожидался ';' после break");
-            return matched;
+            branch->body.push_back(new StmtNode(STMT_BREAK, bloc));
+            return branch;
         }
         else {
-            if (Tree::isInterpretationEnabled()) {
-                if (matched) Stmt();
-                else {
-                    bool saveInterp = Tree::isInterpretationEnabled();
-                    if (saveInterp) Tree::disableInterpretation();
-                    Stmt();
-                    if (saveInterp) Tree::enableInterpretation();
-                }
-            }
-            else {
-                Stmt();
-            }
+            branch->body.push_back(Stmt());
         }
     }
 
-    return false;
+    return branch;
 }
 
 // Call -> IDENT '(' ArgListOpt ')'
-void Diagram::Call() {
+StmtNode* Diagram::Call() {
     int t = nextToken();
     if (t != IDENT) synError("ожидалось имя функции при вызове");
-    string fname = curLex;
-    auto lc = sc->getLineCol();
+    string fname(curLex);
+    SrcLoc loc = here();
 
-    Tree* fnode = Tree::Cur->semGetFunct(fname, lc.first, lc.second);
+    Tree* fnode = Tree::Cur->semGetFunct(fname, loc);
 
     t = nextToken();
     if (t != LPAREN) synError("ожидался '(' после имени функции");
 
-    std::vector<SemNode> args;
-    ArgListOpt(args);
+    StmtNode* call = new StmtNode(STMT_CALL, loc);
+    call->name = fname;
+    call->decl = fnode;
+    ArgListOpt(call->args);
 
     t = nextToken();
     if (t != RPAREN) synError("ожидался ')' после списка аргументов");
 
     // Семантическая проверка типов параметров
     std::vector<DATA_TYPE> argTypes;
-    for (const auto& arg : args) argTypes.push_back(arg.DataType);
-    fnode->semControlParamTypes(fnode, argTypes, lc.first, lc.second);
-
-    // Лог вызова
-    Tree::printFunctionCall(fname, args, lc.first, lc.second);
-
-    // Если интерпретация выключена — не выполняем
-    if (!Tree::isInterpretationEnabled()) return;
-
-    // Проверка ограничения рекурсии (входим в вызов)
-    Tree::enterFunctionCall(fname, lc.first, lc.second);
-
-    // Получаем область функции (scope) — оригинальную (распарсенную при компиляции)
-    Tree* funcScope = fnode->Left;
-    if (!funcScope) interpError("отсутствует тело функции при вызове '" + fname + "'");
-
-    // Сохраняем состояние парсера / контекста
-    size_t savedPos = sc->getPos();
-    auto savedPushTok = pushTok;
-    auto savedPushLex = pushLex;
-    int savedCurTok = curTok;
-    string savedCurLex = curLex;
-    Tree* savedCurTree = Tree::getCur();
-    Tree* savedCurrentFunction = Tree::getCurrentFunction();
-
-    // ------- Создаём временную пустую область для выполнения (без копирования тела) -------
-    SemNode* tmpScopeNode = new SemNode();
-    tmpScopeNode->id = ""; tmpScopeNode->DataType = TYPE_SCOPE;
-    tmpScopeNode->Param = 0; tmpScopeNode->line = lc.first; tmpScopeNode->col = lc.second;
-    // Up у временной области должен указывать на оригинальную функцию
-    Tree* tmpScope = new Tree(tmpScopeNode, fnode);
-
-    // Скопируем ПАРАМЕТРЫ (если они есть) — только их описания и присвоим им значения из args
-    Tree* origP = funcScope->Left; // параметры в оригинальном scope
-    for (size_t i = 0; origP && i < args.size(); origP = origP->Right, ++i) {
-        if (!origP->n) continue;
-        SemNode* pcopy = new SemNode(*origP->n); // копируем id и тип (но не значение)
-        pcopy->hasValue = false;
-        pcopy->line = origP->n->line;
-        pcopy->col = origP->n->col;
-        // вставляем параметр в tmpScope как левый ребёнок списка (setLeft добавит как Right-соседа)
-        tmpScope->setLeft(pcopy);
-    }
-
-    // Установим значения параметров согласно args (по порядку)
-    Tree* copyP = tmpScope->Left;
-    for (size_t i = 0; copyP && i < args.size(); copyP = copyP->Right, ++i) {
-        if (!copyP->n) continue;
+    for (const ExprNode* arg : call->args) argTypes.push_back(arg->type);
+    fnode->semControlParamTypes(fnode, argTypes, loc);
 
-        // Приводим аргумент к типу формального параметра
-        SemNode converted = Tree::castToType(args[i], copyP->n->DataType, lc.first, lc.second);
+    auto it = funcByDecl.find(fnode);
+    if (it == funcByDecl.end()) semError("внутренняя ошибка: нет описания функции '" + fname + "'");
+    call->callee = it->second;
 
-        // Сохраняем значение и помечаем как инициализированное
-        copyP->n->hasValue = converted.hasValue;
-        copyP->n->Value = converted.Value;
-
-        // Печатаем предупреждение о неявном преобразовании при debug (как в setVarValue)
-        if (args[i].DataType != copyP->n->DataType && Tree::isDebugEnabled()) {
-            Tree::printTypeConversionWarning(args[i].DataType, copyP->n->DataType,
-                "передаче параметра", copyP->n->id + " в " + fname + "()", lc.first, lc.second);
-        }
-    }
-
-    // ------- Переключаемся на временную область и выполняем тело --------
-    Tree::setCur(tmpScope);
-    Tree::setCurrentFunction(fnode);
-
-    // Устанавливаем сканер на начало тела функции (bodyStartPos был сохранён при парсинге)
-    size_t bodyStart = (fnode->n) ? fnode->n->bodyStartPos : 0;
-    sc->setPos(bodyStart);
-
-    // Выполняем блок тела функции (он распарсится заново, но уже в контексте tmpScope)
-    Block();
-
-    // С выходом из тела функции — уменьшаем счётчик рекурсии
-    Tree::exitFunctionCall();
-
-    // Восстановка контекста
-    sc->setPos(savedPos);
-    pushTok = savedPushTok;
-    pushLex = savedPushLex;
-    curTok = savedCurTok;
-    curLex = savedCurLex;
-    Tree::setCur(savedCurTree);
-    Tree::setCurrentFunction(savedCurrentFunction);
-
-    // Удаляем временную область (оно рекурсивно удалит параметры и всё, что было создано при выполнении)
-    delete tmpScope;
+    return call;
 }
 
 // ArgListOpt -> [Expr (',' Expr)*]
-void Diagram::ArgListOpt(std::vector<SemNode>& args) {
+void Diagram::ArgListOpt(std::vector<ExprNode*>& args) {
     int t = peekToken();
     if (t != RPAREN) {
-        DATA_TYPE atype = Expr();
-        SemNode arg = popValue();
-        args.push_back(arg);
+        args.push_back(Expr());
 
         t = peekToken();
         while (t == COMMA) {
             nextToken();
-            atype = Expr();
-            arg = popValue();
-            args.push_back(arg);
+            args.push_back(Expr());
             t = peekToken();
         }
     }
 }
 
 // Expr -> ['+'|'-'] Rel ( ('==' | '!=') Rel )*
-DATA_TYPE Diagram::Expr() {
+ExprNode* Diagram::Expr() {
     int t = peekToken();
     bool hasUnary = false;
     string unaryOp = "";
@@ -784,12 +859,11 @@ DATA_TYPE Diagram::Expr() {
     if (t == PLUS || t == MINUS) {
         // Смотрим вперед, чтобы определить, константа ли это
         int savedTok = nextToken();
-        string savedLex = curLex;
         int nextTok = peekToken();
 
         // Если следующий токен - константа, то унарную операцию обработает Prim()
         if (nextTok == DEC_CONST || nextTok == HEX_CONST) {
-            pushBack(savedTok, savedLex);
+            ungetToken();
         }
         else {
             // Если не константа, то обрабатываем как унарную операцию
@@ -798,55 +872,36 @@ DATA_TYPE Diagram::Expr() {
         }
     }
 
-    DATA_TYPE left = Rel();
+    ExprNode* left = Rel();
 
     // Обработка унарной операции (только для не-констант)
     if (hasUnary) {
-        if (!(left == TYPE_INT || left == TYPE_SHORT_INT || left == TYPE_LONG_INT)) {
+        if (!(left->type == TYPE_INT || left->type == TYPE_SHORT_INT || left->type == TYPE_LONG_INT)) {
             semError("унарный '+'/'-' применим только к целым типам");
         }
 
-        SemNode operand = popValue();
-        SemNode result;
-
+        // Унарный плюс ничего не меняет; минус исполняется как умножение на -1 того же типа
         if (unaryOp == "-") {
-            SemNode minusOne;
-            minusOne.DataType = left;
-            minusOne.hasValue = true;
-
-            switch (left) {
-            case TYPE_SHORT_INT: minusOne.Value.v_int16 = -1; break;
-            case TYPE_INT: minusOne.Value.v_int32 = -1; break;
-            case TYPE_LONG_INT: minusOne.Value.v_int64 = -1; break;
-            default: break;
-            }
-
-            result = Tree::executeArithmeticOp(operand, minusOne, "*", sc->getLineCol().first, sc->getLineCol().second);
-        }
-        else {
-            result = operand;
+            SrcLoc loc = here();
+            ExprNode* neg = new ExprNode(EXPR_NEG, left->type, loc);
+            neg->op = BOP_MUL;
+            neg->kernel = selectKernel(BOP_MUL, left->type);
+            neg->left = left;
+            left = neg;
         }
-
-        pushValue(result);
-        left = result.DataType;
     }
 
     t = peekToken();
     while (t == EQ || t == NEQ) {
-        string op = (t == EQ) ? "==" : "!=";
+        BIN_OP op = (t == EQ) ? BOP_EQ : BOP_NE;
         nextToken();
-        DATA_TYPE right = Rel();
-
-        SemNode rightVal = popValue();
-        SemNode leftVal = popValue();
+        ExprNode* right = Rel();
 
-        bool leftIsInt = (left == TYPE_INT || left == TYPE_SHORT_INT || left == TYPE_LONG_INT);
-        bool rightIsInt = (right == TYPE_INT || right == TYPE_SHORT_INT || right == TYPE_LONG_INT);
+        bool leftIsInt = (left->type == TYPE_INT || left->type == TYPE_SHORT_INT || left->type == TYPE_LONG_INT);
+        bool rightIsInt = (right->type == TYPE_INT || right->type == TYPE_SHORT_INT || right->type == TYPE_LONG_INT);
 
-        if ((leftIsInt && rightIsInt) || (left == TYPE_BOOL && right == TYPE_BOOL)) {
-            SemNode result = Tree::executeComparisonOp(leftVal, rightVal, op, sc->getLineCol().first, sc->getLineCol().second);
-            pushValue(result);
-            left = TYPE_BOOL;
+        if ((leftIsInt && rightIsInt) || (left->type == TYPE_BOOL && right->type == TYPE_BOOL)) {
+            left = makeBinary(left, right, op, OP_COMPARISON, TYPE_BOOL);
         }
         else {
             semError("операнды для '=='/'!=' должны быть одного типа");
@@ -859,249 +914,177 @@ DATA_TYPE Diagram::Expr() {
 }
 
 // Rel -> Shift ( ('<' | '<=' | '>' | '>=') Shift )*
-DATA_TYPE Diagram::Rel() {
-    DATA_TYPE left = Shift();
+ExprNode* Diagram::Rel() {
+    ExprNode* left = Shift();
     int t = peekToken();
 
     while (t == LT || t == LE || t == GT || t == GE) {
-        string op;
+        BIN_OP op = BOP_LT;
         switch (t) {
-        case LT: op = "<"; break;
-        case LE: op = "<="; break;
-        case GT: op = ">"; break;
-        case GE: op = ">="; break;
+        case LE: op = BOP_LE; break;
+        case GT: op = BOP_GT; break;
+        case GE: op = BOP_GE; break;
         }
         nextToken();
-        DATA_TYPE right = Shift();
-
-        SemNode rightVal = popValue();
-        SemNode leftVal = popValue();
+        ExprNode* right = Shift();
 
-        bool lInt = (left == TYPE_INT || left == TYPE_SHORT_INT || left == TYPE_LONG_INT);
-        bool rInt = (right == TYPE_INT || right == TYPE_SHORT_INT || right == TYPE_LONG_INT);
+        bool lInt = (left->type == TYPE_INT || left->type == TYPE_SHORT_INT || left->type == TYPE_LONG_INT);
+        bool rInt = (right->type == TYPE_INT || right->type == TYPE_SHORT_INT || right->type == TYPE_LONG_INT);
 
         if (!(lInt && rInt)) {
             semError("операнды для '<, <=, >, >=' должны быть целыми (int/short/long)");
         }
 
-        SemNode result = Tree::executeComparisonOp(leftVal, rightVal, op, sc->getLineCol().first, sc->getLineCol().second);
-        pushValue(result);
-        left = TYPE_BOOL;
+        left = makeBinary(left, right, op, OP_COMPARISON, TYPE_BOOL);
         t = peekToken();
     }
     return left;
 }
 
 // Shift -> Add ( ('<<' | '>>') Add )*
-DATA_TYPE Diagram::Shift() {
-    DATA_TYPE left = Add();
+ExprNode* Diagram::Shift() {
+    ExprNode* left = Add();
     int t = peekToken();
 
     while (t == SHL || t == SHR) {
-        string op = (t == SHL) ? "<<" : ">>";
+        BIN_OP op = (t == SHL) ? BOP_SHL : BOP_SHR;
         nextToken();
-        DATA_TYPE right = Add();
+        ExprNode* right = Add();
 
-        SemNode rightVal = popValue();
-        SemNode leftVal = popValue();
-
-        bool lInt = (left == TYPE_INT || left == TYPE_SHORT_INT || left == TYPE_LONG_INT);
-        bool rInt = (right == TYPE_INT || right == TYPE_SHORT_INT || right == TYPE_LONG_INT);
+        bool lInt = (left->type == TYPE_INT || left->type == TYPE_SHORT_INT || left->type == TYPE_LONG_INT);
+        bool rInt = (right->type == TYPE_INT || right->type == TYPE_SHORT_INT || right->type == TYPE_LONG_INT);
 
         if (!(lInt && rInt)) {
             semError("операнды для сдвигов должны быть целыми (int/short/long)");
         }
 
-        SemNode result = Tree::executeShiftOp(leftVal, rightVal, op, sc->getLineCol().first, sc->getLineCol().second);
-        pushValue(result);
-        left = result.DataType;
+        // Результат сдвига имеет тип левого операнда
+        left = makeBinary(left, right, op, OP_SHIFT, left->type);
         t = peekToken();
     }
     return left;
 }
 
 // Add -> Mul ( ('+' | '-') Mul )*
-DATA_TYPE Diagram::Add() {
-    DATA_TYPE left = Mul();
+ExprNode* Diagram::Add() {
+    ExprNode* left = Mul();
     int t = peekToken();
 
     while (t == PLUS || t == MINUS) {
-        string op = (t == PLUS) ? "+" : "-";
+        BIN_OP op = (t == PLUS) ? BOP_ADD : BOP_SUB;
         nextToken();
-        DATA_TYPE right = Mul();
-
-        SemNode rightVal = popValue();
-        SemNode leftVal = popValue();
+        ExprNode* right = Mul();
 
-        bool lInt = (left == TYPE_INT || left == TYPE_SHORT_INT || left == TYPE_LONG_INT);
-        bool rInt = (right == TYPE_INT || right == TYPE_SHORT_INT || right == TYPE_LONG_INT);
+        bool lInt = (left->type == TYPE_INT || left->type == TYPE_SHORT_INT || left->type == TYPE_LONG_INT);
+        bool rInt = (right->type == TYPE_INT || right->type == TYPE_SHORT_INT || right->type == TYPE_LONG_INT);
 
         if (!(lInt && rInt)) {
             semError("операнды для '+'/'-' должны быть целыми (int/short/long)");
         }
 
-        SemNode result = Tree::executeArithmeticOp(leftVal, rightVal, op, sc->getLineCol().first, sc->getLineCol().second);
-        pushValue(result);
-        left = result.DataType;
+        left = makeBinary(left, right, op, OP_ARITHMETIC, Tree::getMaxType(left->type, right->type));
         t = peekToken();
     }
     return left;
 }
 
 // Mul -> Prim ( ('*' | '/' | '%') Prim )*
-DATA_TYPE Diagram::Mul() {
-    DATA_TYPE left = Prim();
+ExprNode* Diagram::Mul() {
+    ExprNode* left = Prim();
     int t = peekToken();
 
     while (t == MULT || t == DIV || t == MOD) {
-        string op;
+        BIN_OP op = BOP_MUL;
         switch (t) {
-        case MULT: op = "*"; break;
-        case DIV: op = "/"; break;
-        case MOD: op = "%"; break;
+        case DIV: op = BOP_DIV; break;
+        case MOD: op = BOP_MOD; break;
         }
         nextToken();
-        DATA_TYPE right = Prim();
-
-        SemNode rightVal = popValue();
-        SemNode leftVal = popValue();
+        ExprNode* right = Prim();
 
-        bool lInt = (left == TYPE_INT || left == TYPE_SHORT_INT || left == TYPE_LONG_INT);
-        bool rInt = (right == TYPE_INT || right == TYPE_SHORT_INT || right == TYPE_LONG_INT);
+        bool lInt = (left->type == TYPE_INT || left->type == TYPE_SHORT_INT || left->type == TYPE_LONG_INT);
+        bool rInt = (right->type == TYPE_INT || right->type == TYPE_SHORT_INT || right->type == TYPE_LONG_INT);
 
         if (!(lInt && rInt)) {
             semError("операнды для '*', '/', '%' должны быть целыми (int/short/long)");
         }
 
-        SemNode result = Tree::executeArithmeticOp(leftVal, rightVal, op, sc->getLineCol().first, sc->getLineCol().second);
-        pushValue(result);
-        left = result.DataType;
+        left = makeBinary(left, right, op, OP_ARITHMETIC, Tree::getMaxType(left->type, right->type));
         t = peekToken();
     }
     return left;
 }
 
 // Prim -> IDENT | Const | '(' Expr ')'
-DATA_TYPE Diagram::Prim() {
+ExprNode* Diagram::Prim() {
     int t = nextToken();
 
     // Сначала проверяем унарный минус для отрицательных констант
     if (t == MINUS) {
         t = nextToken();
         if (t == DEC_CONST || t == HEX_CONST) {
-            DATA_TYPE constType = TYPE_SHORT_INT;
-
-            // Определяем, нужно ли автоматически повышать тип до long
-            string valueStr = "-" + curLex;
-            try {
-                long long val = std::stoll(valueStr, nullptr, 0);
-
-                // Если значение выходит за пределы short, автоматически делаем его int
-                if (val > 32767 || val < -32768) {
-                    constType = TYPE_INT;
-                }
-
-                // Если значение выходит за пределы int, автоматически делаем его long
-                if (val > 2147483647LL || val < -2147483648LL) {
-                    constType = TYPE_LONG_INT;
-                }
-            }
-            catch (...) {
-                // Оставляем как TYPE_INT в случае ошибки
-            }
-
-            SemNode constNode = evaluateConstant("-" + curLex, constType);
-            pushValue(constNode);
-            return constType;
+            return makeConstant(tokens.value[curIndex], true);
         }
         else {
             // Если после минуса не константа, то это унарная операция над выражением
             // Помещаем токен обратно и обрабатываем как обычное выражение в скобках
-            pushBack(t, curLex);
-            pushBack(MINUS, "-");
+            ungetToken();
+            ungetToken();
             // Обрабатываем как выражение в скобках
             t = nextToken();
             if (t != LPAREN) {
                 synError("ожидалась константа или выражение в скобках после '-'");
             }
-            DATA_TYPE dt = Expr();
+            ExprNode* inner = Expr();
             t = nextToken();
             if (t != RPAREN) synError("ожидался ')' после выражения");
-            return dt;
+            return inner;
         }
     }
 
     if (t == DEC_CONST || t == HEX_CONST) {
-        DATA_TYPE constType = TYPE_SHORT_INT;
-
-        // Определяем, нужно ли автоматически повышать тип до long
-        string valueStr = curLex;
-        try {
-            long long val = std::stoll(valueStr, nullptr, 0);
-
-            // Если значение выходит за пределы short, автоматически делаем его int
-            if (val > 32767 || val < -32768) {
-                constType = TYPE_INT;
-            }
-
-            // Если значение выходит за пределы int, автоматически делаем его long
-            if (val > 2147483647LL || val < -2147483648LL) {
-                constType = TYPE_LONG_INT;
-            }
-        }
-        catch (...) {
-            // Оставляем как TYPE_INT в случае ошибки
-        }
-
-        SemNode constNode = evaluateConstant(curLex, constType);
-        pushValue(constNode);
-        return constType;
+        return makeConstant(tokens.value[curIndex], false);
     }
 
     if (t == KW_TRUE || t == KW_FALSE) {
-        DATA_TYPE boolType = TYPE_BOOL;
-        SemNode boolNode;
-        boolNode.DataType = TYPE_BOOL;
-        boolNode.hasValue = true;
-        boolNode.Value.v_bool = (t == KW_TRUE);
-        pushValue(boolNode);
-        return boolType;
+        SrcLoc loc = here();
+        ExprNode* boolNode = new ExprNode(EXPR_CONST, TYPE_BOOL, loc);
+        boolNode->value = Value(TYPE_BOOL, t == KW_TRUE ? 1 : 0);
+        return boolNode;
     }
 
     if (t == LPAREN) {
-        DATA_TYPE dt = Expr();
+        ExprNode* inner = Expr();
         t = nextToken();
         if (t != RPAREN) synError("ожидался ')' после выражения");
-        return dt;
+        return inner;
     }
 
     if (t == IDENT) {
-        string name = curLex;
+        string name(curLex);
         int t2 = peekToken();
 
         if (t2 == LPAREN) {
             semError("вызов функции внутри выражения невозможен: функции возвращают void");
         }
         else {
-            auto lc = sc->getLineCol();
-            Tree* v = Tree::Cur->semGetVar(name, lc.first, lc.second);
+            SrcLoc loc = here();
+            Tree* v = Tree::Cur->semGetVar(name, loc);
 
             if (!v->n->hasValue) {
                 interpError("использование неинициализированной переменной '" + name + "'");
             }
 
-            SemNode value;
-            value.DataType = v->n->DataType;
-            value.hasValue = true;
-            value.Value = v->n->Value;
-            pushValue(value);
-
-            return v->n->DataType;
+            ExprNode* var = new ExprNode(EXPR_VAR, v->n->DataType, loc);
+            var->name = name;
+            var->decl = v;
+            var->slot = v->n->Slot;
+            return var;
         }
     }
 
     synError("ожидалось первичное выражение (IDENT, константа или скобки)");
-    return TYPE_INT;
+    return nullptr;
 }
 
 // Const -> DEC_CONST | HEX_CONST | true | false
@@ -1115,4 +1098,4 @@ void Diagram::Const() {
 void Diagram::Name() {
     int t = nextToken();
     if (t != IDENT) synError("ожидался идентификатор (имя)");
-}
\ No newline at end of file
+}
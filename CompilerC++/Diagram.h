@@ -3,67 +3,121 @@
 #include "Defines.h"
 #include "DataType.h"
 #include "Tree.h"
+#include "Ast.h"
 #include <string>
 #include <vector>
-#include <stack>
+#include <unordered_map>
 
 using std::string;
 
+// Способ исполнения программы
+enum ENGINE_KIND {
+    ENGINE_AST, // обход AST (Executor)
+    ENGINE_VM, // компиляция в регистровый байт-код и выполнение на VM
+    ENGINE_JIT, // VM, часто вызываемые функции компилируются в машинный код x86-64
+    ENGINE_AOT // трансляция в C++, сборка разделяемой библиотеки и загрузка через dlopen
+};
+
 class Diagram {
 private:
     Scanner* sc;
-    std::vector<int> pushTok;
-    std::vector<string> pushLex;
+    TokenStream tokens; // все лексемы программы (Parse разбирает текст за один проход лексера)
+    size_t tokPos; // индекс следующей лексемы
+    size_t scanEnd; // конец самой дальней прочитанной лексемы — от него считаются строка и позиция
+    size_t curIndex; // индекс текущей лексемы в tokens
     int curTok;
-    string curLex;
+    std::string_view curLex;
     DATA_TYPE currentDeclType;
 
-    // Стек для вычисления выражений
-    std::stack<SemNode> evalStack;
+    // Строящееся AST программы
+    ProgramNode* program;
+    // Соответствие узла функции в семантическом дереве её описанию в AST
+    std::unordered_map<Tree*, FuncNode*> funcByDecl;
+    // Разбираемая функция (nullptr — глобальная область); в её кадре размещаются локальные переменные
+    FuncNode* curFunc;
+
+    int inlineBudget; // предел размера встраиваемой функции (узлов AST), 0 — без встраивания
+    bool inlineReport; // печатать список встроенных вызовов
+    bool memoEnabled; // мемоизация вызовов рекурсивных функций (EffectAnalysis)
+    bool memoReport; // после выполнения печатать попадания и промахи мемоизации
+    bool ssaDump; // печатать SSA функций перед устранением общих подвыражений
+    bool dispatchStats; // VM: после выполнения печатать число исполненных инструкций до и после объединения
+
+    void allocSlot(Tree* varNode);
 
     int nextToken();
     int peekToken();
-    void pushBack(int tok, const string& lex);
+    void ungetToken(); // вернуть последнюю прочитанную лексему
+    SrcLoc here() const; // текущая позиция для сообщений и узлов AST
     void lexError();
     void synError(const string& msg);
     void semError(const string& msg);
 	void interpError(const string& msg);
 
-    // Синтаксические процедуры с интерпретацией
+    // Синтаксические процедуры: семантический анализ + построение AST
     void Program();
     void TopDecl();
-    void Function();
-    void VarDecl();
-    void IdInitList();
-    void IdInit();
-    void Block();
-    void BlockItems();
-    void Stmt();
-    void Assign();
-    void CallStmt();
-    void SwitchStmt();
-    bool CaseStmt(long long switchVal, bool& anyMatched);
-    bool DefaultStmt(bool anyMatched);
+    FuncNode* Function();
+    void VarDecl(std::vector<StmtNode*>& out);
+    void IdInitList(std::vector<StmtNode*>& out);
+    StmtNode* IdInit();
+    StmtNode* Block();
+    void BlockItems(std::vector<StmtNode*>& out);
+    StmtNode* Stmt();
+    StmtNode* Assign();
+    StmtNode* CallStmt();
+    StmtNode* SwitchStmt();
+    CaseNode* CaseStmt();
+    void buildSwitchTable(StmtNode* sw);
+    void markTailCalls(StmtNode* s);
+    CaseNode* DefaultStmt();
     void Name();
 
-    // Выражения с интерпретацией
-    DATA_TYPE Expr();
-    DATA_TYPE Rel();
-    DATA_TYPE Shift();
-    DATA_TYPE Add();
-    DATA_TYPE Mul();
-    DATA_TYPE Prim();
-    void Call();
-    void ArgListOpt(std::vector<SemNode>& args);
+    // Выражения
+    ExprNode* Expr();
+    ExprNode* Rel();
+    ExprNode* Shift();
+    ExprNode* Add();
+    ExprNode* Mul();
+    ExprNode* Prim();
+    StmtNode* Call();
+    void ArgListOpt(std::vector<ExprNode*>& args);
     void Const();
 
-    // Вспомогательные методы интерпретации
-    void pushValue(const SemNode& node);
-    SemNode popValue();
-    SemNode evaluateConstant(const string& value, DATA_TYPE type);
-    void executeAssignment(const string& varName, DATA_TYPE exprType, int line, int col);
+    // Вспомогательные методы
+    ExprNode* makeConstant(uint64_t magnitude, bool negative);
+    void checkAssignTypes(DATA_TYPE varType, DATA_TYPE exprType, const string& msg);
+    ExprNode* makeBinary(ExprNode* left, ExprNode* right, BIN_OP op, OP_GROUP group, DATA_TYPE type);
 
 public:
     Diagram(Scanner* scanner);
-    void ParseProgram(bool isInterp = true, bool isDebug = false);
-};
\ No newline at end of file
+    ~Diagram();
+
+    // Синтаксический и семантический анализ всей программы; возвращает построенное AST
+    // (владение остаётся у Diagram)
+    ProgramNode* Parse();
+
+    // Оптимизация построенного AST перед исполнением: удаление недостижимого кода и
+    // (если отладочный вывод не нужен) встраивание функций, свёртка констант и
+    // специализация функций по константным аргументам, разметка функций для мемоизации вызовов
+    void Optimize(bool isDebug);
+
+    // Настройка встраивания: budget — предел размера функции в узлах AST (0 — не встраивать),
+    // report — после встраивания вывести, какие вызовы встроены
+    void setInlining(int budget, bool report);
+
+    // Настройка мемоизации: enabled — запоминать вызовы (AST, VM и JIT; без debug),
+    // report — после выполнения вывести попадания и промахи
+    void setMemoization(bool enabled, bool report);
+
+    // Вывод SSA каждой функции (с номерами значений) при устранении общих подвыражений (без debug)
+    void setSsaDump(bool enabled);
+
+    // Подсчёт исполненных инструкций байт-кода (VM; JIT при подсчёте не используется): итог
+    // с суперинструкциями и без них, частые пары инструкций, объединения оконной оптимизации
+    void setDispatchStats(bool enabled);
+
+    // Разбор и (если isInterp) исполнение программы выбранным способом
+    // memStats — после выполнения вывести занятость арен (узлов дерева и кадров вызовов)
+    void ParseProgram(bool isInterp = true, bool isDebug = false, ENGINE_KIND engine = ENGINE_AST, bool memStats = false);
+};
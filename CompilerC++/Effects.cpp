@@ -0,0 +1,171 @@
+﻿#include "Effects.h"
+#include "Tree.h"
+
+EffectAnalysis::EffectAnalysis() : current(nullptr), sum(nullptr), memoized(0) {}
+
+void EffectAnalysis::run(ProgramNode* program) {
+    globalTypes.assign(program->globals.size(), TYPE_INT);
+    for (StmtNode* g : program->globals) globalTypes[g->slot.index] = g->declType;
+    size_t n = globalTypes.size();
+
+    // Начальное приближение: вызов ничего не читает и не пишет, но записывает всё на любом
+    // пути. Для mustWrite нужна наибольшая неподвижная точка: завершившийся рекурсивный вызов
+    // в конце концов прошёл ветвь без рекурсии
+    summaries.clear();
+    for (FuncNode* f : program->functions) {
+        Summary& s = summaries[f];
+        s.mayWrite.assign(n, 0);
+        s.mustWrite.assign(n, 1);
+        s.exposed.assign(n, 0);
+        s.narrows = false;
+        s.selfCalls = 0;
+    }
+
+    // Итерации по всем функциям до неподвижной точки: наборы только растут (mustWrite — убывает)
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (FuncNode* f : program->functions) {
+            if (!f->body) continue;
+            Summary next;
+            next.mayWrite.assign(n, 0);
+            next.exposed.assign(n, 0);
+            next.narrows = false;
+            next.selfCalls = 0;
+            current = f;
+            sum = &next;
+            GlobalSet defined(n, 0);
+            flowStmt(f->body, defined);
+            next.mustWrite = defined;
+
+            Summary& old = summaries[f];
+            if (old.mayWrite != next.mayWrite || old.mustWrite != next.mustWrite
+                || old.exposed != next.exposed || old.narrows != next.narrows) {
+                changed = true;
+            }
+            old = next;
+        }
+    }
+
+    memoized = 0;
+    for (FuncNode* f : program->functions) {
+        f->memoId = -1;
+        f->memoReads.clear();
+        f->memoWrites.clear();
+        if (f != program->main && f->body) decide(f, summaries[f]);
+    }
+}
+
+// Оператор в порядке исполнения; defined — глобальные переменные, записанные на каждом пути
+// до этой точки. Возвращает false после break (путь дальше по ветви не идёт)
+bool EffectAnalysis::flowStmt(StmtNode* s, GlobalSet& defined) {
+    switch (s->kind) {
+    case STMT_EMPTY:
+        return true;
+    case STMT_BLOCK:
+        for (StmtNode* item : s->body) {
+            if (!flowStmt(item, defined)) return false;
+        }
+        return true;
+    case STMT_VAR_DECL:
+        if (s->value) {
+            readExpr(s->value, defined);
+            if (!s->fits) checkNarrowing(s->declType, s->value);
+        }
+        return true;
+    case STMT_ASSIGN:
+        readExpr(s->value, defined);
+        // Значение, которое заведомо помещается в тип переменной (RangeAnalysis), не обрезается
+        if (s->slot.global) {
+            if (!s->fits) checkNarrowing(globalTypes[s->slot.index], s->value);
+            defined[s->slot.index] = 1;
+            sum->mayWrite[s->slot.index] = 1;
+        }
+        else if (!s->fits) {
+            checkNarrowing(current->slotTypes[s->slot.index], s->value);
+        }
+        return true;
+    case STMT_CALL: {
+        for (ExprNode* a : s->args) readExpr(a, defined);
+        if (s->callee == current) sum->selfCalls++;
+        const Summary& callee = summaries[s->callee];
+        for (size_t i = 0; i < defined.size(); ++i) {
+            if (callee.exposed[i] && !defined[i]) sum->exposed[i] = 1;
+            if (callee.mayWrite[i]) sum->mayWrite[i] = 1;
+            if (callee.mustWrite[i]) defined[i] = 1;
+        }
+        if (callee.narrows) sum->narrows = true;
+        return true;
+    }
+    case STMT_SWITCH:
+        flowSwitch(s, defined);
+        return true;
+    case STMT_BREAK:
+        return false;
+    }
+    return true;
+}
+
+// Исполнение начинается с любой ветви (или ни с какой, если нет default) и проваливается
+// в следующие до break. На входе в каждую ветвь записано не меньше, чем перед switch, —
+// этого приближения достаточно; на выходе — пересечение по всем путям
+void EffectAnalysis::flowSwitch(StmtNode* s, GlobalSet& defined) {
+    readExpr(s->value, defined);
+    GlobalSet entry = defined;
+    GlobalSet out(defined.size(), 1);
+
+    bool hasDefault = false;
+    for (CaseNode* c : s->cases) {
+        if (c->isDefault) hasDefault = true;
+    }
+    if (!hasDefault) out = entry;
+
+    for (size_t i = 0; i < s->cases.size(); ++i) {
+        GlobalSet d = entry;
+        bool falls = true;
+        for (StmtNode* item : s->cases[i]->body) {
+            if (!flowStmt(item, d)) {
+                falls = false;
+                break;
+            }
+        }
+        if (!falls || i + 1 == s->cases.size()) {
+            for (size_t k = 0; k < out.size(); ++k) out[k] &= d[k];
+        }
+    }
+    defined = out;
+}
+
+void EffectAnalysis::readExpr(ExprNode* e, const GlobalSet& defined) {
+    if (!e) return;
+    if (e->kind == EXPR_VAR && e->slot.global && !defined[e->slot.index]) {
+        sum->exposed[e->slot.index] = 1;
+    }
+    readExpr(e->left, defined);
+    readExpr(e->right, defined);
+}
+
+// Присваивание значения более широкого типа может напечатать предупреждение об обрезке
+void EffectAnalysis::checkNarrowing(DATA_TYPE target, ExprNode* value) {
+    if (target == TYPE_BOOL || value->type == TYPE_BOOL) return;
+    if (Tree::getMaxType(value->type, target) != target) sum->narrows = true;
+}
+
+void EffectAnalysis::decide(FuncNode* f, const Summary& s) {
+    if (s.narrows || s.selfCalls < 2) return;
+
+    vector<int> reads, writes;
+    for (size_t i = 0; i < s.exposed.size(); ++i) {
+        // Переменная, которую вызов читает до записи и сам же меняет (счётчик, накопитель),
+        // делает ключ почти неповторяющимся: запоминание только тратило бы время и память
+        if (s.exposed[i] && s.mayWrite[i]) return;
+        if (s.exposed[i] || (s.mayWrite[i] && !s.mustWrite[i])) reads.push_back(static_cast<int>(i));
+        if (s.mayWrite[i]) writes.push_back(static_cast<int>(i));
+    }
+    if (f->paramTypes.size() + reads.size() > static_cast<size_t>(MAX_KEY)) return;
+    if (writes.size() > static_cast<size_t>(MAX_WRITES)) return;
+
+    f->memoId = memoized++;
+    f->memoReads = reads;
+    f->memoWrites = writes;
+}
@@ -0,0 +1,59 @@
+﻿#pragma once
+#include "Ast.h"
+#include <unordered_map>
+#include <vector>
+
+// Межпроцедурный анализ чтения и записи глобальных переменных (в проверенной программе, AST)
+// и выбор функций для мемоизации вызовов.
+// Функции ничего не возвращают: вызов влияет только на глобальные переменные, поэтому его
+// результат определяется аргументами и значениями глобальных переменных при входе.
+// Для каждой функции (с учётом вызываемых, до неподвижной точки по графу вызовов) вычисляются:
+//   mayWrite — глобальные переменные, которые вызов может изменить;
+//   mustWrite — записываемые на любом пути от входа до выхода;
+//   exposed — читаемые до того, как записаны на всех путях (значение при входе важно).
+// Ключ мемоизации — аргументы и exposed ∪ (mayWrite \ mustWrite): от значений вне ключа
+// результат не зависит, а непременно записываемые переменные не сохраняют значение при входе.
+// Запоминаются вызовы рекурсивных функций с ветвящейся рекурсией (не меньше двух вызовов
+// самой себя) — именно у них повторяются одинаковые вызовы, — кроме тех, что читают и сами
+// меняют одну и ту же переменную (счётчик): их ключи не повторяются. Исключаются функции, которые
+// (сами или через вызываемые) могут напечатать предупреждение об обрезке при присваивании:
+// повтор записанного результата его бы не напечатал. Ошибки исполнения зависят только от
+// ключа: вызов с ошибкой не завершается и не запоминается.
+// Мемоизированный вызов не печатает отладочный вывод, поэтому анализ применяется только без debug
+class EffectAnalysis {
+public:
+    static const int MAX_KEY = 8; // аргументов и глобальных переменных в ключе
+    static const int MAX_WRITES = 8; // глобальных переменных в записанном результате
+
+    EffectAnalysis();
+
+    // Вычисление наборов и разметка функций (FuncNode::memoId и др.)
+    void run(ProgramNode* program);
+
+    int memoizedFunctions() const { return memoized; }
+
+private:
+    // Множество глобальных переменных (индекс — VarSlot::index)
+    typedef std::vector<char> GlobalSet;
+
+    struct Summary {
+        GlobalSet mayWrite;
+        GlobalSet mustWrite;
+        GlobalSet exposed;
+        bool narrows; // присваивание с возможной обрезкой значения
+        int selfCalls; // вызовов самой себя в теле
+    };
+
+    std::unordered_map<FuncNode*, Summary> summaries;
+    std::vector<DATA_TYPE> globalTypes;
+    FuncNode* current; // анализируемая функция
+    Summary* sum; // её новая сводка
+    int memoized;
+
+    void analyze(FuncNode* f);
+    bool flowStmt(StmtNode* s, GlobalSet& defined);
+    void flowSwitch(StmtNode* s, GlobalSet& defined);
+    void readExpr(ExprNode* e, const GlobalSet& defined);
+    void checkNarrowing(DATA_TYPE target, ExprNode* value);
+    void decide(FuncNode* f, const Summary& s);
+};
@@ -0,0 +1,513 @@
+﻿#include "ElfEmitter.h"
+#include "X86Emitter.h"
+#include <cstdlib>
+#include <fstream>
+#include <map>
+
+using namespace std;
+
+// Секции объектного файла; символы 1..3 — символы секций .text, .rodata, .data
+enum {
+    SEC_NULL, SEC_TEXT, SEC_RODATA, SEC_DATA, SEC_NOTE, SEC_RELA, SEC_SYMTAB, SEC_STRTAB, SEC_SHSTRTAB,
+    SEC_COUNT
+};
+
+static const uint32_t R_X86_64_PC32 = 2;
+
+// Перемещение: 32-битное смещение от места в .text до section + offset
+struct ElfReloc {
+    size_t at;
+    int section;
+    size_t offset;
+};
+
+// Состояние генерации .text
+struct ObjectCode {
+    X86Assembler a;
+    string rodata;
+    map<string, size_t> messages; // одинаковые сообщения хранятся один раз
+    vector<ElfReloc> relocs;
+    vector<pair<size_t, size_t>> textJumps; // (место rel32, смещение цели в .text)
+    vector<pair<size_t, int>> calls; // (место rel32, индекс вызываемой функции)
+    size_t failRoutine = 0;
+    size_t warnRoutine = 0;
+
+    // rel32 на адрес в другой секции, для команд, где смещение — последнее поле
+    void ripRef(int section, size_t offset) {
+        relocs.push_back({ a.pos(), section, offset });
+        a.u32(0);
+    }
+
+    // rsi = адрес сообщения, edx = длина
+    void loadMessage(const string& text) {
+        auto it = messages.find(text);
+        if (it == messages.end()) {
+            it = messages.insert(make_pair(text, rodata.size())).first;
+            rodata += text;
+        }
+        a.bytes({ 0x48, 0x8D, 0x35 }); ripRef(SEC_RODATA, it->second); // lea rsi, [rip + msg]
+        a.byte(0xBA); a.u32(static_cast<uint32_t>(text.size())); // mov edx, len
+    }
+
+    void jumpText(uint8_t op, size_t target) {
+        a.byte(op);
+        textJumps.push_back(make_pair(a.pos(), target));
+        a.u32(0);
+    }
+
+    // Печать сообщения в stderr и завершение с кодом 1
+    void fail(const string& text) {
+        loadMessage(text);
+        jumpText(0xE9, failRoutine); // jmp rt_fail
+    }
+
+    void syscallWrite() {
+        a.byte(0xB8); a.u32(1); // mov eax, 1 (write)
+        a.byte(0xBF); a.u32(2); // mov edi, 2 (stderr)
+        a.bytes({ 0x0F, 0x05 }); // syscall
+    }
+};
+
+// Сообщения в том же виде, что печатают Tree::interpError и Tree::printTruncationWarning
+static string position(SrcLoc loc) {
+    auto lc = loc.lineCol();
+    return "\n(строка " + to_string(lc.first) + ":" + to_string(lc.second) + ")\n";
+}
+
+static string interpMessage(const string& msg, const string& id, SrcLoc loc) {
+    string text = "Ошибка при интерпретации: " + msg;
+    if (!id.empty()) text += " (около '" + id + "')";
+    return text + position(loc);
+}
+
+static const char* const TRUNCATION_PREFIX = "Предупреждение: значение ";
+
+static string truncationSuffix(DATA_TYPE to, SrcLoc loc) {
+    return string(" обрезается при преобразовании к ") + (to == TYPE_SHORT_INT ? "short" : "int") + position(loc);
+}
+
+// Размер кадра функции: регистры, затем по байту признака на регистр (с выравниванием на 8)
+static size_t flagBytes(const BcFunction& fn) { return (static_cast<size_t>(fn.numRegs) + 7) / 8 * 8; }
+static size_t frameBytes(const BcFunction& fn) { return 8 * static_cast<size_t>(fn.numRegs) + flagBytes(fn); }
+
+// Снятие кадра без возврата: add rsp, F; pop r12; pop rbx
+static void leaveFrame(X86Assembler& a, const BcFunction& fn) {
+    a.bytes({ 0x48, 0x81, 0xC4 }); a.u32(static_cast<uint32_t>(frameBytes(fn)));
+    a.bytes({ 0x41, 0x5C, 0x5B });
+}
+
+// Среда выполнения: rt_fail (rsi — сообщение, edx — длина) и rt_warn (rdi — значение,
+// rsi / edx — окончание предупреждения). rt_warn портит только временные регистры
+static void emitRuntime(ObjectCode& c) {
+    X86Assembler& a = c.a;
+
+    c.failRoutine = a.pos();
+    c.syscallWrite();
+    a.byte(0xB8); a.u32(60); // mov eax, 60 (exit)
+    a.byte(0xBF); a.u32(1); // mov edi, 1
+    a.bytes({ 0x0F, 0x05 });
+
+    c.warnRoutine = a.pos();
+    a.bytes({ 0x49, 0x89, 0xF0 }); // mov r8, rsi
+    a.bytes({ 0x49, 0x89, 0xD1 }); // mov r9, rdx
+    a.bytes({ 0x49, 0x89, 0xFA }); // mov r10, rdi
+    c.loadMessage(TRUNCATION_PREFIX);
+    c.syscallWrite();
+
+    // Десятичная запись значения в буфер на стеке, от младших цифр к старшим
+    a.bytes({ 0x48, 0x83, 0xEC, 0x20 }); // sub rsp, 32
+    a.bytes({ 0x48, 0x8D, 0x74, 0x24, 0x20 }); // lea rsi, [rsp + 32]
+    a.bytes({ 0x4C, 0x89, 0xD0 }); // mov rax, r10
+    a.bytes({ 0x48, 0x85, 0xC0 }); // test rax, rax
+    size_t positive = a.jump8(0x79); // jns
+    a.bytes({ 0x48, 0xF7, 0xD8 }); // neg rax (модуль LLONG_MIN верен как беззнаковое)
+    a.bind8(positive);
+    a.byte(0xB9); a.u32(10); // mov ecx, 10
+    size_t digit = a.pos();
+    a.bytes({ 0x31, 0xD2 }); // xor edx, edx
+    a.bytes({ 0x48, 0xF7, 0xF1 }); // div rcx
+    a.bytes({ 0x80, 0xC2, 0x30 }); // add dl, '0'
+    a.bytes({ 0x48, 0xFF, 0xCE }); // dec rsi
+    a.bytes({ 0x88, 0x16 }); // mov [rsi], dl
+    a.bytes({ 0x48, 0x85, 0xC0 }); // test rax, rax
+    a.byte(0x75); a.byte(static_cast<uint8_t>(digit - (a.pos() + 1))); // jnz digit
+    a.bytes({ 0x4D, 0x85, 0xD2 }); // test r10, r10
+    size_t unsigned_ = a.jump8(0x79); // jns
+    a.bytes({ 0x48, 0xFF, 0xCE }); // dec rsi
+    a.bytes({ 0xC6, 0x06, 0x2D }); // mov byte [rsi], '-'
+    a.bind8(unsigned_);
+    a.bytes({ 0x48, 0x8D, 0x54, 0x24, 0x20 }); // lea rdx, [rsp + 32]
+    a.bytes({ 0x48, 0x29, 0xF2 }); // sub rdx, rsi
+    c.syscallWrite();
+    a.bytes({ 0x48, 0x83, 0xC4, 0x20 }); // add rsp, 32
+
+    a.bytes({ 0x4C, 0x89, 0xC6 }); // mov rsi, r8
+    a.bytes({ 0x4C, 0x89, 0xCA }); // mov rdx, r9
+    c.syscallWrite();
+    a.byte(0xC3); // ret
+}
+
+// Выбор ветви среди разреженных меток: дерево сравнений (как двоичный поиск SwitchTable::find)
+static void emitSparseSwitch(ObjectCode& c, const SwitchTable& table, size_t lo, size_t hi,
+    vector<pair<size_t, size_t>>& branches) {
+    X86Assembler& a = c.a;
+    auto compare = [&](long long label) {
+        if (label >= INT32_MIN && label <= INT32_MAX) {
+            a.bytes({ 0x48, 0x3D }); a.u32(static_cast<uint32_t>(label)); // cmp rax, imm32
+        }
+        else {
+            a.movImm64(RCX, static_cast<uint64_t>(label));
+            a.bytes({ 0x48, 0x39, 0xC8 }); // cmp rax, rcx
+        }
+    };
+    auto branchTo = [&](uint8_t cc, int target) {
+        a.bytes({ 0x0F, cc });
+        branches.push_back(make_pair(a.pos(), static_cast<size_t>(target)));
+        a.u32(0);
+    };
+
+    if (hi - lo <= 4) {
+        for (size_t i = lo; i < hi; ++i) {
+            compare(table.labels[i]);
+            branchTo(0x84, table.targets[i]); // je
+        }
+        a.byte(0xE9);
+        branches.push_back(make_pair(a.pos(), static_cast<size_t>(table.defaultTarget)));
+        a.u32(0);
+        return;
+    }
+    size_t mid = (lo + hi) / 2;
+    compare(table.labels[mid]);
+    branchTo(0x84, table.targets[mid]); // je
+    a.bytes({ 0x0F, 0x8C }); // jl — левая половина
+    size_t left = a.pos();
+    a.u32(0);
+    emitSparseSwitch(c, table, mid + 1, hi, branches);
+    a.patch32(left, static_cast<int32_t>(a.pos() - (left + 4)));
+    emitSparseSwitch(c, table, lo, mid, branches);
+}
+
+static void emitFunction(ObjectCode& c, const BcProgram& program, int index, int maxDepth, size_t scratch) {
+    const BcFunction& fn = program.functions[index];
+    X86Assembler& a = c.a;
+    size_t n = fn.code.size();
+    size_t frame = frameBytes(fn);
+
+    // Пролог: кадр [rbx] — регистры, [r12] — признаки; аргументы копируются из [rsi]
+    a.bytes({ 0x53, 0x41, 0x54 }); // push rbx; push r12
+    a.bytes({ 0x48, 0x81, 0xEC }); a.u32(static_cast<uint32_t>(frame)); // sub rsp, F
+    a.bytes({ 0x48, 0x89, 0xE3 }); // mov rbx, rsp
+    a.bytes({ 0x4C, 0x8D, 0xA3 }); a.u32(static_cast<uint32_t>(8 * fn.numRegs)); // lea r12, [rbx + 8 * numRegs]
+    // Признаки читает только OP_CHKL (параметры он не проверяет)
+    for (size_t k = 0; k < flagBytes(fn) && !fn.checkedLocals.empty(); k += 8) {
+        a.bytes({ 0x49, 0xC7, 0x84, 0x24 }); a.u32(static_cast<uint32_t>(k)); a.u32(0); // mov qword [r12 + k], 0
+    }
+    for (int i = 0; i < fn.numParams; ++i) {
+        a.bytes({ 0x48, 0x8B, 0x86 }); a.u32(static_cast<uint32_t>(8 * i)); // mov rax, [rsi + 8i]
+        a.storeR(i, RAX);
+    }
+
+    vector<size_t> labels(n + 1);
+    vector<pair<size_t, size_t>> branches;
+    vector<pair<size_t, const SwitchTable*>> tables; // (место rel32 в lea rcx, таблица)
+
+    X86SlowPath slowPath = [&](uint8_t cc, size_t pc) {
+        const Instr& in = fn.code[pc];
+        size_t skip = a.jump8(cc);
+        if (in.op == OP_CHKL || in.op == OP_CHKG) {
+            const string& name = fn.sites[in.b].name;
+            c.fail(interpMessage("использование неинициализированной переменной '" + name + "'", name, fn.locs[pc]));
+        }
+        else if (in.op == OP_NARROW_S || in.op == OP_NARROW_I) {
+            const SiteInfo& site = fn.sites[in.c];
+            a.bytes({ 0x50, 0x51 }); // push rax; push rcx
+            a.bytes({ 0x48, 0x89, 0xC7 }); // mov rdi, rax
+            c.loadMessage(truncationSuffix(site.type2, site.loc));
+            c.jumpText(0xE8, c.warnRoutine); // call rt_warn
+            a.bytes({ 0x59, 0x58 }); // pop rcx; pop rax
+        }
+        else {
+            c.fail(interpMessage("деление на ноль", "", fn.locs[pc]));
+        }
+        a.bind8(skip);
+    };
+
+    for (size_t pc = 0; pc < n; ++pc) {
+        const Instr& in = fn.code[pc];
+        labels[pc] = a.pos();
+        if (emitX86Instruction(a, fn, pc, branches, slowPath)) continue;
+
+        if (in.op == OP_SWITCH) {
+            const SwitchTable& table = fn.switches[in.b];
+            a.loadR(RAX, in.a);
+            if (table.dense) {
+                // Индекс value - minLabel без знака: значения вне диапазона — ветвь по умолчанию
+                a.movImm64(RCX, static_cast<uint64_t>(table.minLabel));
+                a.bytes({ 0x48, 0x29, 0xC8 }); // sub rax, rcx
+                a.bytes({ 0x48, 0x3D }); a.u32(static_cast<uint32_t>(table.jump.size())); // cmp rax, size
+                a.bytes({ 0x0F, 0x83 }); // jae default
+                branches.push_back(make_pair(a.pos(), static_cast<size_t>(table.defaultTarget)));
+                a.u32(0);
+                a.bytes({ 0x48, 0x8D, 0x0D }); // lea rcx, [rip + table]
+                tables.push_back(make_pair(a.pos(), &table));
+                a.u32(0);
+                a.bytes({ 0x48, 0x63, 0x04, 0x81 }); // movsxd rax, dword [rcx + rax * 4]
+                a.bytes({ 0x48, 0x01, 0xC8 }); // add rax, rcx
+                a.bytes({ 0xFF, 0xE0 }); // jmp rax
+            }
+            else {
+                emitSparseSwitch(c, table, 0, table.labels.size(), branches);
+            }
+        }
+        else if (in.op == OP_CALL) {
+            const SiteInfo& site = fn.sites[in.c];
+            if (site.countDepth) {
+                a.bytes({ 0x49, 0xFF, 0xC7 }); // inc r15
+                a.bytes({ 0x49, 0x81, 0xFF }); a.u32(static_cast<uint32_t>(maxDepth)); // cmp r15, maxDepth
+                size_t ok = a.jump8(0x7E); // jle
+                c.fail(interpMessage("превышение глубины рекурсии", site.name, site.loc));
+                a.bind8(ok);
+            }
+            a.bytes({ 0x48, 0x8D, 0xB3 }); a.u32(static_cast<uint32_t>(8 * in.b)); // lea rsi, [rbx + 8b]
+            a.byte(0xE8);
+            c.calls.push_back(make_pair(a.pos(), in.a));
+            a.u32(0);
+            if (site.countDepth) a.bytes({ 0x49, 0xFF, 0xCF }); // dec r15
+        }
+        else if (in.op == OP_TAILCALL) {
+            // Кадр снимается до перехода, поэтому аргументы переносятся в общий буфер в .data
+            int count = program.functions[in.a].numParams;
+            for (int i = 0; i < count; ++i) {
+                a.loadR(RAX, in.b + i);
+                a.storeG(static_cast<int>(scratch) + i);
+            }
+            a.bytes({ 0x49, 0x8D, 0xB5 }); a.u32(static_cast<uint32_t>(8 * scratch)); // lea rsi, [r13 + scratch]
+            leaveFrame(a, fn);
+            a.byte(0xE9);
+            c.calls.push_back(make_pair(a.pos(), in.a));
+            a.u32(0);
+        }
+        else if (in.op == OP_RET) {
+            leaveFrame(a, fn);
+            a.byte(0xC3);
+        }
+        // Отладочные инструкции в байт-коде без debug не встречаются
+    }
+    labels[n] = a.pos();
+
+    for (const auto& b : branches) a.patch32(b.first, static_cast<int32_t>(labels[b.second] - (b.first + 4)));
+
+    // Таблицы переходов — за кодом функции: смещения целей от начала таблицы
+    for (const auto& t : tables) {
+        size_t start = a.pos();
+        a.patch32(t.first, static_cast<int32_t>(start - (t.first + 4)));
+        for (int target : t.second->jump) {
+            a.u32(static_cast<uint32_t>(static_cast<int32_t>(labels[target] - start)));
+        }
+    }
+}
+
+// Двоичная запись little-endian
+static void put(vector<uint8_t>& out, uint64_t v, int size) {
+    for (int i = 0; i < size; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+static void putSymbol(vector<uint8_t>& out, uint32_t name, uint8_t info, uint16_t section, uint64_t value, uint64_t size) {
+    put(out, name, 4);
+    out.push_back(info);
+    out.push_back(0);
+    put(out, section, 2);
+    put(out, value, 8);
+    put(out, size, 8);
+}
+
+static uint32_t addString(string& table, const string& s) {
+    uint32_t at = static_cast<uint32_t>(table.size());
+    table += s;
+    table += '\0';
+    return at;
+}
+
+vector<uint8_t> ElfEmitter::emitObject(const BcProgram& program, int maxDepth) {
+    ObjectCode c;
+    X86Assembler& a = c.a;
+
+    size_t numGlobals = program.globalNames.size();
+    int maxParams = 0;
+    size_t maxFrame = 0;
+    for (const BcFunction& fn : program.functions) {
+        if (fn.numParams > maxParams) maxParams = fn.numParams;
+        if (frameBytes(fn) > maxFrame) maxFrame = frameBytes(fn);
+    }
+    // .data: глобальные переменные, буфер аргументов хвостового вызова, признаки инициализации
+    size_t scratch = numGlobals;
+    size_t flagsOffset = 8 * (numGlobals + maxParams);
+    size_t dataSize = flagsOffset + numGlobals;
+
+    // Стек на maxDepth вложенных кадров (адрес возврата, rbx, r12, кадр) и запас для rt_warn
+    uint64_t stack = (static_cast<uint64_t>(maxDepth) + 16) * (maxFrame + 24) + 65536;
+    stack = (stack + 4095) & ~static_cast<uint64_t>(4095);
+
+    // _start: отдельный стек через mmap, закреплённые регистры, <init>, exit(0)
+    a.byte(0xB8); a.u32(9); // mov eax, 9 (mmap)
+    a.bytes({ 0x31, 0xFF }); // xor edi, edi
+    a.movImm64(RSI, stack);
+    a.byte(0xBA); a.u32(3); // mov edx, PROT_READ | PROT_WRITE
+    a.bytes({ 0x41, 0xBA }); a.u32(0x4022); // mov r10d, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE
+    a.bytes({ 0x49, 0xC7, 0xC0 }); a.u32(0xFFFFFFFF); // mov r8, -1
+    a.bytes({ 0x45, 0x31, 0xC9 }); // xor r9d, r9d
+    a.bytes({ 0x0F, 0x05 }); // syscall
+    a.bytes({ 0x48, 0x3D }); a.u32(0xFFFFF000); // cmp rax, -4096
+    size_t mapped = a.jump8(0x76); // jbe
+    size_t noStack = a.pos();
+    a.byte(0xE9); a.u32(0); // jmp к сообщению (ниже, после среды выполнения)
+    a.bind8(mapped);
+    a.bytes({ 0x48, 0x01, 0xF0 }); // add rax, rsi
+    a.bytes({ 0x48, 0x89, 0xC4 }); // mov rsp, rax
+    a.bytes({ 0x4C, 0x8D, 0x2D }); c.ripRef(SEC_DATA, 0); // lea r13, [rip + globals]
+    a.bytes({ 0x4C, 0x8D, 0x35 }); c.ripRef(SEC_DATA, flagsOffset); // lea r14, [rip + flags]
+    a.bytes({ 0x45, 0x31, 0xFF }); // xor r15d, r15d
+    a.byte(0xE8);
+    c.calls.push_back(make_pair(a.pos(), program.entry));
+    a.u32(0);
+    a.byte(0xB8); a.u32(60); // mov eax, 60 (exit)
+    a.bytes({ 0x31, 0xFF }); // xor edi, edi
+    a.bytes({ 0x0F, 0x05 });
+    size_t startSize = a.pos();
+
+    emitRuntime(c);
+    a.patch32(noStack + 1, static_cast<int32_t>(a.pos() - (noStack + 5)));
+    c.fail("Ошибка: не удалось выделить стек вызовов (" + to_string(stack) + " байт)\n");
+
+    vector<size_t> starts(program.functions.size());
+    vector<size_t> sizes(program.functions.size());
+    for (size_t i = 0; i < program.functions.size(); ++i) {
+        while (a.pos() % 16) a.byte(0xCC);
+        starts[i] = a.pos();
+        emitFunction(c, program, static_cast<int>(i), maxDepth, scratch);
+        sizes[i] = a.pos() - starts[i];
+    }
+    for (const auto& j : c.textJumps) a.patch32(j.first, static_cast<int32_t>(j.second - (j.first + 4)));
+    for (const auto& call : c.calls) a.patch32(call.first, static_cast<int32_t>(starts[call.second] - (call.first + 4)));
+
+    // Таблица символов: нулевой, символы секций, локальные (среда выполнения, <init>), глобальные
+    string strtab(1, '\0');
+    vector<uint8_t> symtab;
+    putSymbol(symtab, 0, 0, 0, 0, 0);
+    for (int s = SEC_TEXT; s <= SEC_DATA; ++s) putSymbol(symtab, 0, 0x03, static_cast<uint16_t>(s), 0, 0); // STB_LOCAL, STT_SECTION
+    putSymbol(symtab, addString(strtab, "__rt_fail"), 0x02, SEC_TEXT, c.failRoutine, c.warnRoutine - c.failRoutine);
+    putSymbol(symtab, addString(strtab, "__rt_warn"), 0x02, SEC_TEXT, c.warnRoutine, 0);
+    putSymbol(symtab, addString(strtab, "__program_init"), 0x02, SEC_TEXT, starts[program.entry], sizes[program.entry]);
+    uint32_t firstGlobal = static_cast<uint32_t>(symtab.size() / 24);
+    putSymbol(symtab, addString(strtab, "_start"), 0x12, SEC_TEXT, 0, startSize); // STB_GLOBAL, STT_FUNC
+    for (size_t i = 0; i < program.functions.size(); ++i) {
+        if (static_cast<int>(i) == program.entry) continue;
+        putSymbol(symtab, addString(strtab, program.functions[i].name), 0x12, SEC_TEXT, starts[i], sizes[i]);
+    }
+    for (size_t g = 0; g < numGlobals; ++g) {
+        putSymbol(symtab, addString(strtab, program.globalNames[g]), 0x11, SEC_DATA, 8 * g, 8); // STT_OBJECT
+    }
+
+    vector<uint8_t> rela;
+    for (const ElfReloc& r : c.relocs) {
+        put(rela, r.at, 8);
+        put(rela, (static_cast<uint64_t>(r.section) << 32) | R_X86_64_PC32, 8);
+        put(rela, static_cast<uint64_t>(static_cast<int64_t>(r.offset) - 4), 8);
+    }
+
+    string shstrtab(1, '\0');
+    uint32_t names[SEC_COUNT] = { 0 };
+    const char* sectionNames[SEC_COUNT] = {
+        "", ".text", ".rodata", ".data", ".note.GNU-stack", ".rela.text", ".symtab", ".strtab", ".shstrtab"
+    };
+    for (int s = 1; s < SEC_COUNT; ++s) names[s] = addString(shstrtab, sectionNames[s]);
+
+    // Файл: заголовок, содержимое секций (с выравниванием на 8), таблица заголовков секций
+    vector<uint8_t> out(64, 0);
+    uint64_t offsets[SEC_COUNT] = { 0 };
+    uint64_t sizesOf[SEC_COUNT] = { 0 };
+    auto append = [&](int s, const uint8_t* data, size_t size) {
+        while (out.size() % 16) out.push_back(0);
+        offsets[s] = out.size();
+        sizesOf[s] = size;
+        out.insert(out.end(), data, data + size);
+    };
+    vector<uint8_t> data(dataSize, 0);
+    append(SEC_TEXT, a.code.data(), a.code.size());
+    append(SEC_RODATA, reinterpret_cast<const uint8_t*>(c.rodata.data()), c.rodata.size());
+    append(SEC_DATA, data.data(), data.size());
+    append(SEC_NOTE, nullptr, 0);
+    append(SEC_RELA, rela.data(), rela.size());
+    append(SEC_SYMTAB, symtab.data(), symtab.size());
+    append(SEC_STRTAB, reinterpret_cast<const uint8_t*>(strtab.data()), strtab.size());
+    append(SEC_SHSTRTAB, reinterpret_cast<const uint8_t*>(shstrtab.data()), shstrtab.size());
+    while (out.size() % 8) out.push_back(0);
+    uint64_t sectionHeaders = out.size();
+
+    struct { uint32_t type; uint64_t flags; uint32_t link; uint32_t info; uint64_t align; uint64_t entsize; } kinds[SEC_COUNT] = {
+        { 0, 0, 0, 0, 0, 0 },
+        { 1, 0x6, 0, 0, 16, 0 }, // .text: PROGBITS, ALLOC | EXECINSTR
+        { 1, 0x2, 0, 0, 1, 0 }, // .rodata: ALLOC
+        { 1, 0x3, 0, 0, 8, 0 }, // .data: ALLOC | WRITE
+        { 1, 0, 0, 0, 1, 0 }, // .note.GNU-stack: стек без права исполнения
+        { 4, 0x40, SEC_SYMTAB, SEC_TEXT, 8, 24 }, // .rela.text: RELA, INFO_LINK
+        { 2, 0, SEC_STRTAB, firstGlobal, 8, 24 }, // .symtab
+        { 3, 0, 0, 0, 1, 0 }, // .strtab
+        { 3, 0, 0, 0, 1, 0 }, // .shstrtab
+    };
+    for (int s = 0; s < SEC_COUNT; ++s) {
+        put(out, names[s], 4);
+        put(out, kinds[s].type, 4);
+        put(out, kinds[s].flags, 8);
+        put(out, 0, 8); // sh_addr
+        put(out, offsets[s], 8);
+        put(out, sizesOf[s], 8);
+        put(out, kinds[s].link, 4);
+        put(out, kinds[s].info, 4);
+        put(out, kinds[s].align, 8);
+        put(out, kinds[s].entsize, 8);
+    }
+
+    // Заголовок ELF64: ET_REL, EM_X86_64
+    vector<uint8_t> header = { 0x7F, 'E', 'L', 'F', 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    put(header, 1, 2); // e_type
+    put(header, 62, 2); // e_machine
+    put(header, 1, 4); // e_version
+    put(header, 0, 8); // e_entry
+    put(header, 0, 8); // e_phoff
+    put(header, sectionHeaders, 8); // e_shoff
+    put(header, 0, 4); // e_flags
+    put(header, 64, 2); // e_ehsize
+    put(header, 0, 2); // e_phentsize
+    put(header, 0, 2); // e_phnum
+    put(header, 64, 2); // e_shentsize
+    put(header, SEC_COUNT, 2); // e_shnum
+    put(header, SEC_SHSTRTAB, 2); // e_shstrndx
+    copy(header.begin(), header.end(), out.begin());
+    return out;
+}
+
+bool ElfEmitter::writeObject(const BcProgram& program, int maxDepth, const string& path, string& error) {
+    vector<uint8_t> object = emitObject(program, maxDepth);
+    ofstream file(path, ios::binary);
+    file.write(reinterpret_cast<const char*>(object.data()), static_cast<streamsize>(object.size()));
+    file.close();
+    if (!file) {
+        error = "не удалось записать " + path;
+        return false;
+    }
+    return true;
+}
+
+bool ElfEmitter::writeExecutable(const BcProgram& program, int maxDepth, const string& path, string& error) {
+    string object = path + ".o";
+    if (!writeObject(program, maxDepth, object, error)) return false;
+    const char* ldEnv = getenv("LD");
+    string ld = (ldEnv && *ldEnv) ? ldEnv : "ld";
+    string command = ld + " -o \"" + path + "\" \"" + object + "\"";
+    if (system(command.c_str()) != 0) {
+        error = "ошибка компоновки (" + command + ")";
+        return false;
+    }
+    return true;
+}
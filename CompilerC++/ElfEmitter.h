@@ -0,0 +1,31 @@
+﻿#pragma once
+#include "Bytecode.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Запись программы в перемещаемый объектный файл ELF x86-64 без внешнего компилятора.
+// Машинный код строится по байт-коду (без отладочного вывода) теми же шаблонами, что и JIT
+// (X86Emitter.h), но вызовы и возвраты — обычные call / ret со своими кадрами на стеке.
+// Секции: .text — точка входа _start, функции программы (глобальные символы с именами
+// функций языка) и небольшая среда выполнения на системных вызовах Linux (вывод сообщений,
+// завершение), поэтому ни libc, ни crt не нужны; .data — глобальные переменные (символы с их
+// именами, по 8 байт в канонической форме) и признаки их инициализации; .rodata — тексты
+// сообщений об ошибках и предупреждений с уже вычисленными строкой и столбцом.
+// Функции программы используют собственное соглашение о вызовах (аргументы по адресу в rsi,
+// закреплённые r13 — глобальные переменные, r14 — их признаки, r15 — глубина рекурсии),
+// вызывать их из C нельзя.
+// Ошибка времени выполнения печатает то же сообщение, что и интерпретатор, и завершает
+// процесс с кодом 1; стек вызовов выделяется при запуске по пределу глубины рекурсии.
+class ElfEmitter {
+public:
+    // Содержимое объектного файла; maxDepth — предел глубины рекурсии (как --max-depth)
+    static std::vector<uint8_t> emitObject(const BcProgram& program, int maxDepth);
+
+    // Запись объектного файла. При ошибке — false и описание в error
+    static bool writeObject(const BcProgram& program, int maxDepth, const std::string& path, std::string& error);
+
+    // Объектный файл path + ".o" и компоновка в исполняемый файл системным компоновщиком
+    // ($LD, по умолчанию ld)
+    static bool writeExecutable(const BcProgram& program, int maxDepth, const std::string& path, std::string& error);
+};
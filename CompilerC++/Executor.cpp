@@ -0,0 +1,294 @@
+﻿#include "Executor.h"
+#include <iostream>
+
+Executor::Executor(ProgramNode* program) : program(program), globalScope(nullptr), frame(nullptr) {}
+
+void Executor::run() {
+    Tree::enableInterpretation();
+    globalScope = Tree::getCur();
+
+    // Глобальные переменные получают значения только по ходу выполнения программы
+    globals.assign(program->globals.size(), Value());
+    for (StmtNode* g : program->globals) {
+        globals[g->slot.index].type = g->declType;
+    }
+    frameArena.reset();
+    frame = nullptr;
+    calls.clear();
+    cursors.clear();
+    memo.reset();
+
+    // Глобальные описания до main, затем main, затем оставшиеся описания —
+    // в том же порядке, в каком их исполнял интерпретатор при разборе
+    size_t i = 0;
+    for (; i < program->mainAfter && i < program->globals.size(); ++i) {
+        execVarDecl(program->globals[i]);
+    }
+
+    if (program->main) {
+        enter(program->main, nullptr, 0, program->main->loc, frameArena.mark(), Tree::getCurrentFunction(), false);
+        execute();
+    }
+
+    for (; i < program->globals.size(); ++i) {
+        execVarDecl(program->globals[i]);
+    }
+}
+
+Value Executor::globalValue(const string& name) const {
+    if (globalScope) {
+        Tree* v = globalScope->findUpOneLevel(globalScope, name);
+        if (v && v->n && v->n->DataType != TYPE_FUNCT && v->n->Slot.index >= 0
+            && static_cast<size_t>(v->n->Slot.index) < globals.size()) {
+            return globals[v->n->Slot.index];
+        }
+    }
+    return Value();
+}
+
+// Цикл исполнения: операторы берутся из курсора на вершине стека. Блок и switch
+// добавляют курсор, вызов — активацию с курсором тела; исчерпанный курсор тела функции
+// означает возврат из неё
+void Executor::execute() {
+    while (!calls.empty()) {
+        StmtNode* s = nextStmt(cursors.back());
+        if (!s) {
+            cursors.pop_back();
+            if (cursors.size() == calls.back().cursorBase) leave();
+            continue;
+        }
+
+        switch (s->kind) {
+        case STMT_EMPTY:
+            break;
+        case STMT_BLOCK:
+            // Ячейки переменных блока уже есть в кадре функции — блок только исполняет свои операторы
+            cursors.push_back(Cursor{ s, 0, 0 });
+            break;
+        case STMT_VAR_DECL:
+            execVarDecl(s);
+            break;
+        case STMT_ASSIGN:
+            store(s, eval(s->value));
+            break;
+        case STMT_CALL:
+            execCall(s);
+            break;
+        case STMT_SWITCH:
+            execSwitch(s);
+            break;
+        case STMT_BREAK:
+            // break стоит непосредственно в ветви switch (иначе он не разбирается): выход из switch
+            cursors.pop_back();
+            break;
+        }
+    }
+}
+
+// Следующий оператор курсора или nullptr, если операторов больше нет
+StmtNode* Executor::nextStmt(Cursor& c) {
+    if (c.owner->kind == STMT_BLOCK) {
+        return c.index < c.owner->body.size() ? c.owner->body[c.index++] : nullptr;
+    }
+    while (c.branch < c.owner->cases.size()) {
+        const vector<StmtNode*>& body = c.owner->cases[c.branch]->body;
+        if (c.index < body.size()) return body[c.index++];
+        c.branch++;
+        c.index = 0;
+    }
+    return nullptr;
+}
+
+// Описание переменной: ячейка назначена при разборе, выполняется только инициализация
+void Executor::execVarDecl(StmtNode* s) {
+    if (s->value) store(s, eval(s->value));
+}
+
+// Присваивание; значение, которое заведомо помещается в тип переменной (RangeAnalysis),
+// записывается без проверки обрезки и приведения
+void Executor::store(StmtNode* s, const Value& value) {
+    Value& target = cell(s->slot);
+    if (s->fits && !Tree::isDebugEnabled()) {
+        target.v = value.v;
+        target.hasValue = true;
+        return;
+    }
+    Tree::storeValue(target, s->name, value, s->loc);
+}
+
+// Аргументы вычисляются прямо в арену кадров (перед кадром вызываемой функции)
+// и освобождаются вместе с ним — вызов не обращается к распределителю памяти
+void Executor::execCall(StmtNode* s) {
+    Arena::Mark mark = frameArena.mark();
+    size_t argc = s->args.size();
+    Value* args = static_cast<Value*>(frameArena.allocate(argc * sizeof(Value), alignof(Value)));
+    for (size_t i = 0; i < argc; ++i) {
+        args[i] = eval(s->args[i]);
+    }
+
+    // Лог вызова
+    if (Tree::isDebugEnabled()) {
+        Tree::printFunctionCall(s->name, std::vector<Value>(args, args + argc), s->loc);
+    }
+
+    if (!s->tail) {
+        // Запомненный вызов не исполняется: его результат уже в глобальных переменных
+        // (отладочный вывод вызовов внутри него пропал бы, поэтому при debug — без мемоизации)
+        FuncNode* memoized = s->callee->memoId >= 0 && !Tree::isDebugEnabled() ? s->callee : nullptr;
+        if (memoized && replayCall(s, args, argc)) {
+            frameArena.release(mark);
+            return;
+        }
+
+        // Проверка ограничения рекурсии (входим в вызов); выход — в leave()
+        Tree::enterFunctionCall(s->name, s->loc);
+        enter(s->callee, args, argc, s->loc, mark, Tree::getCurrentFunction(), true);
+        calls.back().memo = memoized;
+        return;
+    }
+
+    // Хвостовой вызов: после него вызывающей функции исполнять нечего, поэтому её кадр
+    // и курсоры освобождаются, а вызываемая функция наследует её активацию
+    Activation caller = calls.back();
+    calls.pop_back();
+    tailArgs.assign(args, args + argc);
+    cursors.resize(caller.cursorBase);
+    frameArena.release(caller.mark);
+    enter(s->callee, tailArgs.data(), argc, s->loc, caller.mark, caller.savedFunction, caller.counted);
+    calls.back().memo = caller.memo;
+}
+
+// Поиск вызова в memo по аргументам (приведённым к типам параметров) и глобальным переменным
+// memoReads. При попадании записанные значения memoWrites переносятся в глобальные переменные;
+// при промахе вызов начинается в memo, а его результат записывает leave()
+bool Executor::replayCall(StmtNode* s, const Value* args, size_t argc) {
+    FuncNode* f = s->callee;
+    memoKey.clear();
+    memoKey.push_back(f->memoId);
+    for (size_t i = 0; i < f->paramTypes.size() && i < argc; ++i) {
+        memoKey.push_back(truncateTo(f->paramTypes[i], args[i].v));
+    }
+    for (int g : f->memoReads) {
+        memoKey.push_back(globals[g].hasValue ? globals[g].v : 0);
+        memoKey.push_back(globals[g].hasValue);
+    }
+
+    if (const MemoCache::Entry* e = memo.find(memoKey)) {
+        for (size_t i = 0; i < f->memoWrites.size(); ++i) {
+            Value& g = globals[f->memoWrites[i]];
+            g.v = e->writes[2 * i];
+            g.hasValue = e->writes[2 * i + 1] != 0;
+        }
+        return true;
+    }
+    memo.begin(memoKey);
+    return false;
+}
+
+// Новая активация: параметры занимают первые ячейки кадра, остальные ячейки
+// (локальные переменные) не инициализированы. Кадр размещается в арене за аргументами
+void Executor::enter(FuncNode* func, const Value* args, size_t argc, SrcLoc loc,
+    Arena::Mark mark, Tree* savedFunction, bool counted) {
+    Tree* fnode = func->decl;
+    if (!fnode || !fnode->Left || !func->body) {
+        Tree::interpError("отсутствует тело функции при вызове '" + func->name + "'", func->name, loc);
+    }
+
+    size_t size = func->slotTypes.size();
+    Value* newFrame = static_cast<Value*>(frameArena.allocate(size * sizeof(Value), alignof(Value)));
+    for (size_t i = 0; i < size; ++i) {
+        newFrame[i] = Value();
+        newFrame[i].type = func->slotTypes[i];
+    }
+
+    // Параметры с приведёнными к типам формальных параметров значениями
+    for (size_t i = 0; i < func->paramTypes.size() && i < argc; ++i) {
+        Value& param = newFrame[i];
+        param = Tree::castToType(args[i], param.type, loc);
+
+        // Печатаем предупреждение о неявном преобразовании при debug (как в setVarValue)
+        if (args[i].type != param.type && Tree::isDebugEnabled()) {
+            Tree::printTypeConversionWarning(args[i].type, param.type,
+                "передаче параметра", func->paramNames[i] + " в " + func->name + "()", loc);
+        }
+    }
+
+    calls.push_back(Activation{ newFrame, mark, savedFunction, cursors.size(), counted, nullptr });
+    cursors.push_back(Cursor{ func->body, 0, 0 });
+    frame = newFrame;
+    Tree::setCurrentFunction(fnode);
+}
+
+// Возврат из функции: восстановление контекста вызывающей и освобождение кадра с аргументами
+void Executor::leave() {
+    Activation done = calls.back();
+    calls.pop_back();
+
+    if (done.memo) {
+        memoWrites.clear();
+        for (int g : done.memo->memoWrites) {
+            memoWrites.push_back(globals[g].v);
+            memoWrites.push_back(globals[g].hasValue);
+        }
+        memo.finish(memoWrites);
+    }
+
+    Tree::setCurrentFunction(done.savedFunction);
+    // С выходом из тела функции — уменьшаем счётчик рекурсии
+    if (done.counted) Tree::exitFunctionCall();
+    frameArena.release(done.mark);
+    frame = calls.empty() ? nullptr : calls.back().frame;
+}
+
+// switch: выполнение начинается с совпавшей ветви (или default) и продолжается
+// в следующих ветвях до break или конца switch
+void Executor::execSwitch(StmtNode* s) {
+    Value sVal = eval(s->value);
+    long long switchVal = sVal.type == TYPE_BOOL ? 0 : sVal.v;
+
+    // Ветвь, с которой начинается исполнение, — по таблице переходов, построенной при разборе
+    size_t start = static_cast<size_t>(s->table->find(switchVal));
+    if (start < s->cases.size()) cursors.push_back(Cursor{ s, start, 0 });
+}
+
+Value Executor::eval(ExprNode* e) {
+    switch (e->kind) {
+    case EXPR_CONST:
+        return e->value;
+
+    case EXPR_VAR: {
+        const Value& v = cell(e->slot);
+        if (e->checkInit && !v.hasValue) {
+            Tree::interpError("использование неинициализированной переменной '" + e->name + "'", e->name, e->loc);
+        }
+        return v;
+    }
+
+    case EXPR_NEG: {
+        Value operand = eval(e->left);
+        if (Tree::isDebugEnabled()) {
+            return Tree::executeArithmeticOp(operand, Value(operand.type, -1), BOP_MUL, e->loc);
+        }
+        return Value(e->type, e->kernel(operand.v, -1, e->loc));
+    }
+
+    case EXPR_CAST:
+        if (e->fits) return Value(e->type, eval(e->left).v);
+        return Tree::castToType(eval(e->left), e->type, e->loc);
+
+    case EXPR_BINARY: {
+        Value leftVal = eval(e->left);
+        Value rightVal = eval(e->right);
+
+        // Отладочный вывод есть только у арифметики; иначе операция — один вызов ядра,
+        // выбранного при проверке типов (операнды вычислены и инициализированы)
+        if (e->group == OP_ARITHMETIC && Tree::isDebugEnabled()) {
+            return Tree::executeArithmeticOp(leftVal, rightVal, e->op, e->loc);
+        }
+        return Value(e->type, e->kernel(leftVal.v, rightVal.v, e->loc));
+    }
+    }
+
+    Tree::interpError("внутренняя ошибка: неизвестный вид выражения", "", e->loc);
+    return Value();
+}
@@ -0,0 +1,85 @@
+﻿#pragma once
+#include "Ast.h"
+#include "Tree.h"
+#include "Arena.h"
+#include "MemoCache.h"
+#include <vector>
+
+// Исполнитель программы: обходит AST, построенное Diagram за один проход разбора.
+// Тела функций больше не разбираются повторно при каждом вызове — лексика, поиск
+// описаний и проверка типов выполнены один раз, при исполнении остаются только вычисления.
+// Переменные адресуются ячейками (VarSlot), назначенными при разборе: глобальные лежат
+// в массиве globals, кадр каждого вызова — область арены frameArena, которая
+// откатывается при возврате из функции.
+// Вызовы не используют стек C++: активации функций и позиции исполнения внутри блоков
+// и ветвей switch хранятся в собственных стеках (calls, cursors), поэтому глубина рекурсии
+// ограничена только Tree::getMaxRecursionDepth(). Хвостовой вызов (StmtNode::tail)
+// занимает место активации вызывающей функции, и глубина не растёт.
+// Вызовы функций, отмеченных EffectAnalysis, запоминаются в MemoCache (см. MemoCache.h);
+// хвостовой вызов наследует незавершённую запись активации, которую он заменяет.
+class Executor {
+public:
+    Executor(ProgramNode* program);
+
+    // Инициализация глобальных переменных (в порядке описания) и вызов main
+    void run();
+
+    // Значение глобальной переменной (после run); hasValue == false, если её нет или она не задана
+    Value globalValue(const string& name) const;
+
+    // Арена кадров: пик — наибольшая суммарная глубина вызовов, после run занятость нулевая
+    const Arena& frameStats() const { return frameArena; }
+
+    // Попадания и промахи мемоизации вызовов
+    const MemoCache& memoStats() const { return memo; }
+
+private:
+    ProgramNode* program;
+    Tree* globalScope; // корневая область семантического дерева
+
+    std::vector<Value> globals; // значения глобальных переменных (индекс — VarSlot::index)
+    Arena frameArena; // ячейки кадров активных вызовов
+    Value* frame; // кадр исполняемой функции
+
+    // Активация вызова функции
+    struct Activation {
+        Value* frame;
+        Arena::Mark mark; // состояние арены до аргументов и кадра вызова
+        Tree* savedFunction; // Tree::currentFunction вызывающей функции
+        size_t cursorBase; // число курсоров вызывающих функций (под телом этой)
+        bool counted; // вызов учтён в глубине рекурсии (main — нет)
+        FuncNode* memo; // функция, результат вызова которой записывается при возврате (или nullptr)
+    };
+
+    // Позиция исполнения: следующий оператор блока или ветвей switch
+    struct Cursor {
+        StmtNode* owner; // STMT_BLOCK или STMT_SWITCH
+        size_t branch; // STMT_SWITCH: текущая ветвь (с проваливанием в следующие)
+        size_t index; // номер следующего оператора
+    };
+
+    std::vector<Activation> calls;
+    std::vector<Cursor> cursors;
+    std::vector<Value> tailArgs; // аргументы хвостового вызова на время замены кадра
+
+    MemoCache memo;
+    std::vector<int64_t> memoKey; // ключ текущего поиска (буфер)
+    std::vector<int64_t> memoWrites; // результат завершённого вызова (буфер)
+
+    Value& cell(const VarSlot& slot) {
+        return slot.global ? globals[slot.index] : frame[slot.index];
+    }
+
+    void execute();
+    StmtNode* nextStmt(Cursor& c);
+    void execVarDecl(StmtNode* s);
+    void store(StmtNode* s, const Value& value);
+    void execCall(StmtNode* s);
+    bool replayCall(StmtNode* s, const Value* args, size_t argc);
+    void execSwitch(StmtNode* s);
+    void enter(FuncNode* func, const Value* args, size_t argc, SrcLoc loc,
+        Arena::Mark mark, Tree* savedFunction, bool counted);
+    void leave();
+
+    Value eval(ExprNode* e);
+};
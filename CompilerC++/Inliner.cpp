@@ -0,0 +1,119 @@
+﻿#include "Inliner.h"
+
+// Размер кода: число операторов и узлов выражений
+static int exprSize(const ExprNode* e) {
+    if (!e) return 0;
+    return 1 + exprSize(e->left) + exprSize(e->right);
+}
+
+static int stmtSize(const StmtNode* s) {
+    int size = 1 + exprSize(s->value);
+    for (StmtNode* item : s->body) size += stmtSize(item);
+    for (ExprNode* a : s->args) size += exprSize(a);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) size += stmtSize(item);
+    }
+    return size;
+}
+
+static bool callsFunction(const StmtNode* s, const FuncNode* f) {
+    if (s->kind == STMT_CALL && s->callee == f) return true;
+    for (StmtNode* item : s->body) {
+        if (callsFunction(item, f)) return true;
+    }
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) {
+            if (callsFunction(item, f)) return true;
+        }
+    }
+    return false;
+}
+
+// Ячейки кадра вызываемой функции сдвигаются на base в кадре вызывающей
+static void relocateExpr(ExprNode* e, int base) {
+    if (!e) return;
+    if (e->kind == EXPR_VAR && !e->slot.global) e->slot.index += base;
+    relocateExpr(e->left, base);
+    relocateExpr(e->right, base);
+}
+
+// keepTail — сам встраиваемый вызов хвостовой: хвостовые вызовы копии остаются хвостовыми
+static void relocateStmt(StmtNode* s, int base, bool keepTail) {
+    if ((s->kind == STMT_VAR_DECL || s->kind == STMT_ASSIGN) && !s->slot.global) s->slot.index += base;
+    if (!keepTail) s->tail = false;
+    relocateExpr(s->value, base);
+    for (ExprNode* a : s->args) relocateExpr(a, base);
+    for (StmtNode* item : s->body) relocateStmt(item, base, keepTail);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) relocateStmt(item, base, keepTail);
+    }
+}
+
+Inliner::Inliner(int budget) : budget(budget) {}
+
+void Inliner::run(ProgramNode* program) {
+    report.clear();
+    if (budget <= 0) return;
+    for (FuncNode* f : program->functions) {
+        if (f->body) inlineCalls(f, f->body);
+    }
+}
+
+bool Inliner::canInline(FuncNode* caller, FuncNode* callee) const {
+    if (!callee || callee == caller || !callee->body) return false;
+    if (callee->paramDecls.size() != callee->paramTypes.size()) return false;
+    return !callsFunction(callee->body, callee) && stmtSize(callee->body) <= budget;
+}
+
+void Inliner::inlineCalls(FuncNode* caller, StmtNode* s) {
+    if (s->kind == STMT_CALL) {
+        if (canInline(caller, s->callee)) expand(caller, s);
+        return;
+    }
+    for (StmtNode* item : s->body) inlineCalls(caller, item);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) inlineCalls(caller, item);
+    }
+}
+
+// Оператор вызова на месте превращается в блок { параметры; тело }
+void Inliner::expand(FuncNode* caller, StmtNode* call) {
+    FuncNode* callee = call->callee;
+    int base = static_cast<int>(caller->slotTypes.size());
+    caller->slotTypes.insert(caller->slotTypes.end(), callee->slotTypes.begin(), callee->slotTypes.end());
+
+    vector<StmtNode*> items;
+    for (size_t i = 0; i < callee->paramTypes.size() && i < call->args.size(); ++i) {
+        ExprNode* arg = call->args[i];
+        DATA_TYPE type = callee->paramTypes[i];
+        if (arg->type != type) {
+            ExprNode* cast = new ExprNode(EXPR_CAST, type, call->loc);
+            cast->left = arg;
+            arg = cast;
+        }
+
+        StmtNode* param = new StmtNode(STMT_VAR_DECL, call->loc);
+        param->name = callee->paramNames[i];
+        param->declType = type;
+        param->decl = callee->paramDecls[i];
+        param->slot = VarSlot(false, base + static_cast<int>(i));
+        param->value = arg;
+        items.push_back(param);
+    }
+    call->args.clear();
+
+    StmtNode* body = callee->body->clone();
+    relocateStmt(body, base, call->tail);
+    items.push_back(body);
+
+    auto lc = call->loc.lineCol();
+    report.push_back(callee->name + " -> " + caller->name + " (строка " + to_string(lc.first) + ":"
+        + to_string(lc.second) + ", узлов: " + to_string(stmtSize(callee->body)) + ")");
+
+    call->kind = STMT_BLOCK;
+    call->body = items;
+    call->name.clear();
+    call->callee = nullptr;
+    call->decl = nullptr;
+    call->tail = false;
+}
@@ -0,0 +1,34 @@
+﻿#pragma once
+#include "Ast.h"
+#include <string>
+#include <vector>
+
+// Встраивание небольших функций в места вызова (в проверенной программе, AST).
+// Вызов заменяется блоком: описания параметров, инициализированные аргументами с приведением
+// к типам параметров (как castToType при вызове, без предупреждения об обрезке), и копия тела.
+// Параметры и локальные переменные копии получают новые ячейки в кадре вызывающей функции.
+// Встраиваются функции, тело которых (после встраивания в него самого) занимает не больше
+// budget узлов AST и не вызывает саму функцию. Функции обрабатываются в порядке описания:
+// вызываемая всегда описана раньше, поэтому к моменту встраивания она уже обработана.
+// Встроенный вызов не увеличивает глубину рекурсии и не печатает отладочный вывод вызова,
+// поэтому проход применяется только без debug
+class Inliner {
+public:
+    static const int DEFAULT_BUDGET = 16;
+
+    explicit Inliner(int budget);
+
+    void run(ProgramNode* program);
+
+    int inlinedCalls() const { return static_cast<int>(report.size()); }
+    // По строке на встроенный вызов: что, куда и где
+    const std::vector<std::string>& inlinedReport() const { return report; }
+
+private:
+    int budget;
+    std::vector<std::string> report;
+
+    void inlineCalls(FuncNode* caller, StmtNode* s);
+    bool canInline(FuncNode* caller, FuncNode* callee) const;
+    void expand(FuncNode* caller, StmtNode* call);
+};
@@ -0,0 +1,124 @@
+﻿#include "Jit.h"
+#include "Value.h"
+#include "X86Emitter.h"
+#include <cstring>
+#include <vector>
+
+#if defined(__linux__) && defined(__x86_64__)
+#define JIT_X86_64 1
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+#ifdef JIT_X86_64
+
+// Цель SWITCH для машинного кода (find не бросает исключений)
+static int64_t switchTarget(const SwitchTable* table, int64_t value) {
+    return table->find(value);
+}
+
+bool JitCode::supported() { return true; }
+
+JitCode* JitCode::compile(const BcFunction& fn) {
+    size_t n = fn.code.size();
+    for (const Instr& in : fn.code) {
+        if (in.op >= OP_TRACE_ASSIGN) return nullptr;
+        if ((in.op == OP_NARROW_S || in.op == OP_NARROW_I) && fn.sites[in.c].warnConversion) return nullptr;
+    }
+
+    X86Assembler a;
+    vector<size_t> labels(n); // смещение кода каждой инструкции
+    vector<pair<size_t, size_t>> branches; // (место rel32, адрес байт-кода цели)
+    vector<size_t> exits; // места rel32 переходов к эпилогу
+    vector<size_t> tableRefs; // места imm64 с адресом таблицы адресов инструкций
+
+    // Выход в интерпретатор перед инструкцией pc: eax = pc
+    auto exitAt = [&](size_t pc) {
+        a.byte(0xB8); a.u32(static_cast<uint32_t>(pc)); // mov eax, imm32
+        a.byte(0xE9); exits.push_back(a.pos()); a.u32(0); // jmp epilogue
+    };
+    // Если условие cc (короткий переход) не выполнено — выход в интерпретатор перед pc
+    auto exitUnless = [&](uint8_t cc, size_t pc) {
+        size_t skip = a.jump8(cc);
+        exitAt(pc);
+        a.bind8(skip);
+    };
+
+    // Пролог: сохранение закреплённых регистров (пять push выравнивают стек на 16),
+    // затем переход к инструкции pc через таблицу адресов
+    a.bytes({ 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 });
+    a.bytes({ 0x48, 0x89, 0xFB }); // mov rbx, rdi
+    a.bytes({ 0x49, 0x89, 0xF4 }); // mov r12, rsi
+    a.bytes({ 0x49, 0x89, 0xD5 }); // mov r13, rdx
+    a.bytes({ 0x49, 0x89, 0xCE }); // mov r14, rcx
+    a.movImm64(RAX, 0); tableRefs.push_back(a.pos() - 8);
+    a.bytes({ 0x42, 0xFF, 0x24, 0xC0 }); // jmp [rax + r8 * 8]
+
+    for (size_t pc = 0; pc < n; ++pc) {
+        const Instr& in = fn.code[pc];
+        labels[pc] = a.pos();
+        OPCODE op = in.op;
+
+        if (emitX86Instruction(a, fn, pc, branches, exitUnless)) continue;
+        if (op == OP_SWITCH) {
+            a.movImm64(RDI, reinterpret_cast<uint64_t>(&fn.switches[in.b]));
+            a.loadR(RSI, in.a);
+            a.movImm64(RAX, reinterpret_cast<uint64_t>(&switchTarget));
+            a.bytes({ 0xFF, 0xD0 }); // call rax
+            a.movImm64(RCX, 0); tableRefs.push_back(a.pos() - 8);
+            a.bytes({ 0xFF, 0x24, 0xC1 }); // jmp [rcx + rax * 8]
+        }
+        else {
+            // OP_CALL, OP_TAILCALL, OP_RET — исполняет интерпретатор
+            exitAt(pc);
+        }
+    }
+
+    // Эпилог: результат (адрес инструкции) уже в rax
+    size_t epilogue = a.pos();
+    a.bytes({ 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3 });
+
+    for (const auto& b : branches) a.patch32(b.first, static_cast<int32_t>(labels[b.second] - (b.first + 4)));
+    for (size_t at : exits) a.patch32(at, static_cast<int32_t>(epilogue - (at + 4)));
+
+    // Код, за ним (с выравниванием на 8) таблица абсолютных адресов инструкций
+    size_t tableOffset = (a.pos() + 7) & ~static_cast<size_t>(7);
+    size_t total = tableOffset + n * sizeof(uint64_t);
+    void* mem = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return nullptr;
+
+    uint8_t* base = static_cast<uint8_t*>(mem);
+    uint64_t tableAddr = reinterpret_cast<uint64_t>(base + tableOffset);
+    for (size_t at : tableRefs) a.patch64(at, tableAddr);
+    memcpy(base, a.code.data(), a.code.size());
+    for (size_t pc = 0; pc < n; ++pc) {
+        uint64_t addr = reinterpret_cast<uint64_t>(base + labels[pc]);
+        memcpy(base + tableOffset + pc * sizeof(uint64_t), &addr, sizeof(addr));
+    }
+
+    // Память доступна либо на запись, либо на исполнение
+    if (mprotect(mem, total, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, total);
+        return nullptr;
+    }
+
+    JitCode* jit = new JitCode();
+    jit->memory = mem;
+    jit->size = total;
+    jit->entry = reinterpret_cast<Entry>(mem);
+    return jit;
+}
+
+JitCode::~JitCode() {
+    if (memory) munmap(memory, size);
+}
+
+#else
+
+// Другие платформы: функции всегда исполняет интерпретатор
+bool JitCode::supported() { return false; }
+JitCode* JitCode::compile(const BcFunction&) { return nullptr; }
+JitCode::~JitCode() {}
+
+#endif
@@ -0,0 +1,48 @@
+﻿#pragma once
+#include "Bytecode.h"
+#include <cstddef>
+#include <cstdint>
+
+// Базовый JIT: байт-код функции переводится в машинный код x86-64 (Linux, System V ABI),
+// каждая инструкция — фиксированной последовательностью команд.
+// Регистры VM остаются в памяти (окно регистров, признаки инициализации, глобальные
+// переменные), поэтому на границе любой инструкции состояние машинного кода и интерпретатора
+// совпадает: машинный код можно начать с любого адреса байт-кода и прервать перед любой
+// инструкцией. Он исполняет инструкции, пока не встретит то, что делает интерпретатор, —
+// вызов, возврат, ошибку (неинициализированная переменная, деление на ноль) или
+// предупреждение (обрезка при присваивании), и возвращает адрес этой инструкции.
+// Кадры вызовов поэтому остаются в стеке VM, а стек C++ не растёт с глубиной рекурсии.
+class JitCode {
+public:
+    // Число вызовов функции, после которого VM компилирует её в машинный код
+    static const uint32_t CALL_THRESHOLD = 100;
+
+    // Доступен ли JIT на этой платформе
+    static bool supported();
+
+    // Машинный код функции или nullptr, если JIT недоступен или функция содержит
+    // отладочные инструкции (с отладочным выводом исполнение остаётся в интерпретаторе)
+    static JitCode* compile(const BcFunction& fn);
+
+    ~JitCode();
+    JitCode(const JitCode&) = delete;
+    JitCode& operator=(const JitCode&) = delete;
+
+    // Исполнение с адреса pc в окне регистров R (I — признаки инициализации),
+    // G / GI — глобальные переменные. Результат — адрес инструкции для интерпретатора
+    size_t run(int64_t* R, uint8_t* I, int64_t* G, uint8_t* GI, size_t pc) const {
+        return static_cast<size_t>(entry(R, I, G, GI, static_cast<int64_t>(pc)));
+    }
+
+    // Размер машинного кода вместе с таблицей адресов инструкций
+    size_t codeSize() const { return size; }
+
+private:
+    typedef int64_t (*Entry)(int64_t* R, uint8_t* I, int64_t* G, uint8_t* GI, int64_t pc);
+
+    void* memory;
+    size_t size;
+    Entry entry;
+
+    JitCode() : memory(nullptr), size(0), entry(nullptr) {}
+};
@@ -0,0 +1,121 @@
+﻿#include "Kernels.h"
+#include "Value.h"
+#include "Tree.h"
+#include <array>
+#include <utility>
+
+const char* binOpName(BIN_OP op) {
+    static const char* const names[BOP_COUNT] = {
+        "+", "-", "*", "/", "%", "<<", ">>", "<", "<=", ">", ">=", "==", "!="
+    };
+    return (op >= 0 && op < BOP_COUNT) ? names[op] : "?";
+}
+
+// Допустимые сочетания: арифметика, сдвиги и <, <=, >, >= — только над целыми, == и != — и над bool
+static constexpr bool kernelExists(BIN_OP op, DATA_TYPE type) {
+    return type != TYPE_BOOL || op == BOP_EQ || op == BOP_NE;
+}
+
+// Ядро операции Op в типе T. Ветви выбираются при компиляции, поэтому каждое ядро —
+// несколько машинных команд без проверок типа и знака операции.
+// short и int вычисляются в 64 битах и отсекаются до разрядности типа, long — по модулю 2^64
+template<BIN_OP Op, DATA_TYPE T>
+static int64_t kernel(int64_t a, int64_t b, SrcLoc loc) {
+    constexpr bool isLong = (T == TYPE_LONG_INT);
+    if constexpr (Op == BOP_ADD) return isLong ? wrapAdd(a, b) : truncateTo(T, a + b);
+    else if constexpr (Op == BOP_SUB) return isLong ? wrapSub(a, b) : truncateTo(T, a - b);
+    else if constexpr (Op == BOP_MUL) return isLong ? wrapMul(a, b) : truncateTo(T, a * b);
+    else if constexpr (Op == BOP_DIV || Op == BOP_MOD) {
+        if (b == 0) Tree::interpError("деление на ноль", "", loc);
+        if constexpr (Op == BOP_DIV) return isLong ? divLong(a, b) : truncateTo(T, a / b);
+        else return isLong ? modLong(a, b) : truncateTo(T, a % b);
+    }
+    // Счётчик сдвига ограничивается разрядностью операции
+    else if constexpr (Op == BOP_SHL) return isLong ? wrapShl(a, b & 63) : truncateTo(T, wrapShl(a, b & 31));
+    else if constexpr (Op == BOP_SHR) return isLong ? a >> (b & 63) : truncateTo(T, a >> (b & 31));
+    // Канонические значения сравниваются без приведения
+    else if constexpr (Op == BOP_LT) return a < b;
+    else if constexpr (Op == BOP_LE) return a <= b;
+    else if constexpr (Op == BOP_GT) return a > b;
+    else if constexpr (Op == BOP_GE) return a >= b;
+    else if constexpr (Op == BOP_EQ) return a == b;
+    else return a != b;
+}
+
+template<BIN_OP Op, DATA_TYPE T>
+static constexpr BinKernel entry() {
+    return kernelExists(Op, T) ? &kernel<Op, T> : nullptr;
+}
+
+// Столбцы таблицы — типы в порядке DATA_TYPE, начиная с TYPE_INT
+static const int TYPE_COLUMNS = TYPE_BOOL - TYPE_INT + 1;
+typedef std::array<std::array<BinKernel, TYPE_COLUMNS>, BOP_COUNT> KernelTable;
+
+template<size_t... Ops>
+static constexpr KernelTable makeTable(std::index_sequence<Ops...>) {
+    return KernelTable{ {
+        { { entry<BIN_OP(Ops), TYPE_INT>(), entry<BIN_OP(Ops), TYPE_SHORT_INT>(),
+            entry<BIN_OP(Ops), TYPE_LONG_INT>(), entry<BIN_OP(Ops), TYPE_BOOL>() } }...
+    } };
+}
+
+static constexpr KernelTable kernelTable = makeTable(std::make_index_sequence<BOP_COUNT>());
+
+BinKernel selectKernel(BIN_OP op, DATA_TYPE type) {
+    if (op < 0 || op >= BOP_COUNT || type < TYPE_INT || type > TYPE_BOOL) return nullptr;
+    return kernelTable[op][type - TYPE_INT];
+}
+
+template<BIN_OP Op, DATA_TYPE T>
+static int64_t nonZeroKernel(int64_t a, int64_t b, SrcLoc) {
+    constexpr bool isLong = (T == TYPE_LONG_INT);
+    if constexpr (Op == BOP_DIV) return isLong ? divLong(a, b) : truncateTo(T, a / b);
+    else return isLong ? modLong(a, b) : truncateTo(T, a % b);
+}
+
+BinKernel selectNonZeroKernel(BIN_OP op, DATA_TYPE type) {
+    if (op != BOP_DIV && op != BOP_MOD) return selectKernel(op, type);
+    bool div = op == BOP_DIV;
+    switch (type) {
+    case TYPE_SHORT_INT: return div ? &nonZeroKernel<BOP_DIV, TYPE_SHORT_INT> : &nonZeroKernel<BOP_MOD, TYPE_SHORT_INT>;
+    case TYPE_INT: return div ? &nonZeroKernel<BOP_DIV, TYPE_INT> : &nonZeroKernel<BOP_MOD, TYPE_INT>;
+    case TYPE_LONG_INT: return div ? &nonZeroKernel<BOP_DIV, TYPE_LONG_INT> : &nonZeroKernel<BOP_MOD, TYPE_LONG_INT>;
+    default: return nullptr;
+    }
+}
+
+template<DATA_TYPE T>
+static int64_t negKernel(int64_t a, int64_t, SrcLoc) {
+    return T == TYPE_LONG_INT ? wrapSub(0, a) : truncateTo(T, -a);
+}
+
+BinKernel selectNegKernel(DATA_TYPE type) {
+    switch (type) {
+    case TYPE_SHORT_INT: return &negKernel<TYPE_SHORT_INT>;
+    case TYPE_INT: return &negKernel<TYPE_INT>;
+    case TYPE_LONG_INT: return &negKernel<TYPE_LONG_INT>;
+    default: return nullptr;
+    }
+}
+
+// Число разрядов сдвига — параметр шаблона: каждое ядро — несколько команд без деления
+template<BIN_OP Op, int K>
+static int64_t pow2Kernel(int64_t a, int64_t, SrcLoc) {
+    if constexpr (Op == BOP_DIV) return divPow2(a, K);
+    else return modPow2(a, K);
+}
+
+static const int POW2_LIMIT = 63; // строки таблицы — k от 0 до 62 (строка 0 не используется)
+typedef std::array<std::array<BinKernel, 2>, POW2_LIMIT> Pow2Table;
+
+template<size_t... Ks>
+static constexpr Pow2Table makePow2Table(std::index_sequence<Ks...>) {
+    return Pow2Table{ { { { &pow2Kernel<BOP_DIV, int(Ks)>, &pow2Kernel<BOP_MOD, int(Ks)> } }... } };
+}
+
+static constexpr Pow2Table pow2Table = makePow2Table(std::make_index_sequence<POW2_LIMIT>());
+
+BinKernel selectPow2Kernel(BIN_OP op, int k) {
+    if ((op != BOP_DIV && op != BOP_MOD) || k < 1 || k >= POW2_LIMIT) return nullptr;
+    return pow2Table[k][op == BOP_DIV ? 0 : 1];
+}
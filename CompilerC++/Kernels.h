@@ -0,0 +1,37 @@
+﻿#pragma once
+#include "DataType.h"
+#include "SourceManager.h"
+#include <cstdint>
+#include <string>
+
+// Бинарные операции языка (вместо сравнения строк "+", "-", ... при исполнении)
+enum BIN_OP {
+    BOP_ADD, BOP_SUB, BOP_MUL, BOP_DIV, BOP_MOD, // арифметика
+    BOP_SHL, BOP_SHR, // сдвиги
+    BOP_LT, BOP_LE, BOP_GT, BOP_GE, BOP_EQ, BOP_NE, // сравнения
+    BOP_COUNT
+};
+
+// Знак операции для сообщений и отладочного вывода
+const char* binOpName(BIN_OP op);
+
+// Ядро операции над каноническими значениями (см. Value.h): тип операции зашит в ядро,
+// операнды уже имеют общий тип, поэтому приведений при исполнении нет.
+// loc нужен только для сообщения о делении на ноль
+typedef int64_t (*BinKernel)(int64_t a, int64_t b, SrcLoc loc);
+
+// Ядро для пары (операция, тип операции) или nullptr, если сочетание недопустимо.
+// Тип операции: для арифметики — тип результата, для сдвига — тип левого операнда,
+// для сравнения — общий тип операндов
+BinKernel selectKernel(BIN_OP op, DATA_TYPE type);
+
+// То же, но деление и остаток — без проверки делителя: он заведомо не 0 (RangeAnalysis)
+BinKernel selectNonZeroKernel(BIN_OP op, DATA_TYPE type);
+
+// Отрицание в типе type (EXPR_NEG после Simplifier): то же, что умножение на -1, второй
+// операнд ядра не используется
+BinKernel selectNegKernel(DATA_TYPE type);
+
+// Деление и остаток на 2^k (1 <= k <= 62) сдвигом (Simplifier); делитель — константа,
+// поэтому без проверки. Ядро одно для всех типов: результат помещается в тип делимого
+BinKernel selectPow2Kernel(BIN_OP op, int k);
@@ -0,0 +1,58 @@
+﻿#include "MemoCache.h"
+#include "Tree.h"
+
+MemoCache::MemoCache() : hitCount(0), missCount(0) {}
+
+void MemoCache::reset() {
+    table.clear();
+    pending.clear();
+    hitCount = 0;
+    missCount = 0;
+}
+
+size_t MemoCache::KeyHash::operator()(const vector<int64_t>& key) const {
+    uint64_t h = 14695981039346656037ULL;
+    for (int64_t v : key) {
+        h ^= static_cast<uint64_t>(v);
+        h *= 1099511628211ULL;
+        h ^= h >> 29;
+    }
+    return static_cast<size_t>(h);
+}
+
+const MemoCache::Entry* MemoCache::find(const vector<int64_t>& key) {
+    auto it = table.find(key);
+    if (it == table.end()) return nullptr;
+
+    // На этой глубине вызов превысил бы предел рекурсии: пусть он выполнится и сообщит об ошибке
+    int depth = Tree::getRecursionDepth();
+    if (it->second.depth > Tree::getMaxRecursionDepth() - depth) return nullptr;
+
+    // Повтор учитывается в глубине объемлющих незавершённых вызовов, как и сам вызов
+    if (depth + it->second.depth > Tree::getPeakDepth()) Tree::setPeakDepth(depth + it->second.depth);
+    hitCount++;
+    return &it->second;
+}
+
+void MemoCache::begin(const vector<int64_t>& key) {
+    missCount++;
+    pending.push_back(Pending{ key, Tree::getRecursionDepth(), Tree::getPeakDepth() });
+    Tree::setPeakDepth(Tree::getRecursionDepth());
+}
+
+void MemoCache::finish(const vector<int64_t>& writes) {
+    Pending& p = pending.back();
+    int peak = Tree::getPeakDepth();
+    if (table.size() < MAX_ENTRIES) {
+        Entry& e = table[p.key];
+        e.writes = writes;
+        e.depth = peak - p.depth;
+    }
+    if (p.savedPeak > peak) Tree::setPeakDepth(p.savedPeak);
+    pending.pop_back();
+}
+
+void MemoCache::printStats(const string& title, ostream& out) const {
+    out << title << ": попаданий " << hitCount << ", промахов " << missCount
+        << ", записано результатов " << table.size() << endl;
+}
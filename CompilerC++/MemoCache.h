@@ -0,0 +1,64 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Таблица запомненных вызовов функций, отмеченных EffectAnalysis (FuncNode::memoId).
+// Ключ — номер функции, аргументы (приведённые к типам параметров) и пары (значение, признак
+// инициализации) глобальных переменных memoReads при входе; результат — такие же пары для
+// memoWrites после возврата. Исполнитель (Executor или VM) перед вызовом ищет ключ: при
+// попадании вызов не выполняется, а записанные значения переносятся в глобальные переменные.
+// При промахе вызов начинается (begin) и по возврату из него результат записывается (finish);
+// незавершённые вызовы образуют стек, вложенный так же, как сами вызовы.
+// Вместе с результатом хранится глубина рекурсии, которой достиг вызов: запомненный вызов
+// повторяется, только если и на текущей глубине он не превысил бы предел, — иначе он
+// выполняется заново и сообщает об ошибке так же, как без мемоизации
+class MemoCache {
+public:
+    static const size_t MAX_ENTRIES = 1 << 20; // дальше новые результаты не запоминаются
+
+    struct Entry {
+        vector<int64_t> writes; // пары (значение, признак инициализации) для memoWrites
+        int depth; // наибольшая глубина вызовов сверх глубины в месте вызова
+    };
+
+    MemoCache();
+
+    void reset();
+
+    // Записанный результат для key или nullptr (промахи считает begin)
+    const Entry* find(const vector<int64_t>& key);
+
+    // Начало вызова, результат которого будет записан
+    void begin(const vector<int64_t>& key);
+
+    // Возврат из вызова, начатого последним begin; writes — значения memoWrites
+    void finish(const vector<int64_t>& writes);
+
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+    size_t entries() const { return table.size(); }
+
+    void printStats(const string& title, ostream& out) const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const vector<int64_t>& key) const;
+    };
+
+    struct Pending {
+        vector<int64_t> key;
+        int depth; // глубина рекурсии в месте вызова
+        int savedPeak; // Tree::getPeakDepth() объемлющего вызова
+    };
+
+    unordered_map<vector<int64_t>, Entry, KeyHash> table;
+    vector<Pending> pending;
+    uint64_t hitCount;
+    uint64_t missCount;
+};
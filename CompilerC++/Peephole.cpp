@@ -0,0 +1,419 @@
+﻿#include "Peephole.h"
+#include <algorithm>
+
+// Коды с суффиксами _S / _I / _L идут тройками
+static bool isTypedOf(OPCODE op, OPCODE shortOp) {
+    return op >= shortOp && op <= shortOp + 2;
+}
+
+// Инструкция только записывает r[a] (операнды — регистры b и c или константы)
+static bool definesRegister(OPCODE op) {
+    return op == OP_LOADK || op == OP_MOV || op == OP_LOADG
+        || (op >= OP_ADD_S && op <= OP_REMK_L) || (op >= OP_EQ && op <= OP_NARROW_I);
+}
+
+// Переходы, вызовы и возврат: окно оптимизации через них не распространяется
+static bool endsWindow(OPCODE op) {
+    return op == OP_JMP || op == OP_JT || op == OP_JF || (op >= OP_JEQ && op <= OP_SWITCH)
+        || op == OP_CALL || op == OP_TAILCALL || op == OP_RET || op >= OP_TRACE_ASSIGN;
+}
+
+static bool readsRegister(const Instr& in, int r) {
+    OPCODE op = in.op;
+    if ((op >= OP_ADD_S && op <= OP_SHR_L) || (op >= OP_ADDG_S && op <= OP_GE)) return in.b == r || in.c == r;
+    if ((op >= OP_NEG_S && op <= OP_REMK_L) || (op >= OP_CAST_S && op <= OP_NARROW_I)) return in.b == r;
+    switch (op) {
+    case OP_MOV:
+    case OP_STL:
+    case OP_STG:
+        return in.b == r;
+    case OP_CHKL:
+    case OP_JT:
+    case OP_JF:
+    case OP_JEQK:
+    case OP_JNEK:
+    case OP_SWITCH:
+        return in.a == r;
+    case OP_JEQ:
+    case OP_JNE:
+        return in.a == r || in.b == r;
+    case OP_CALL:
+    case OP_TAILCALL:
+        return r >= in.b; // аргументы — в регистрах начиная с b
+    default:
+        return op >= OP_TRACE_ASSIGN && op < OP_COUNT;
+    }
+}
+
+static bool writesRegister(const Instr& in, int r) {
+    return (definesRegister(in.op) || in.op == OP_STL) && in.a == r;
+}
+
+// Разрядность результата операции с суффиксом (index — смещение в тройке _S / _I / _L)
+static int tripleBits(int index) {
+    return index == 0 ? 16 : index == 1 ? 32 : 64;
+}
+
+static int typeBits(DATA_TYPE type) {
+    switch (type) {
+    case TYPE_BOOL: return 1;
+    case TYPE_SHORT_INT: return 16;
+    case TYPE_INT: return 32;
+    default: return 64;
+    }
+}
+
+static int constantBits(int64_t v) {
+    if (v == 0 || v == 1) return 1;
+    if (v >= INT16_MIN && v <= INT16_MAX) return 16;
+    if (v >= INT32_MIN && v <= INT32_MAX) return 32;
+    return 64;
+}
+
+// Знаковое расширение младших bits разрядов (каноническая форма short / int / long)
+static int64_t wrapToBits(int64_t v, int bits) {
+    if (bits == 16) return static_cast<int16_t>(static_cast<uint16_t>(v));
+    if (bits == 32) return static_cast<int32_t>(static_cast<uint32_t>(v));
+    return v;
+}
+
+// Разрядность остатка от деления на константу k: |x % k| < |k|
+static int remainderBits(int64_t k) {
+    if (k == INT64_MIN) return 64;
+    return constantBits((k < 0 ? -k : k) - 1);
+}
+
+static bool fitsImmediate(int64_t v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+// switch, в котором ровно одна метка ведёт не туда же, куда default
+static bool singleCase(const SwitchTable& table, int64_t& label, int& caseTarget) {
+    int found = 0;
+    if (table.dense) {
+        for (size_t i = 0; i < table.jump.size(); ++i) {
+            if (table.jump[i] == table.defaultTarget) continue;
+            found++;
+            label = table.minLabel + static_cast<int64_t>(i);
+            caseTarget = table.jump[i];
+        }
+    }
+    else {
+        for (size_t i = 0; i < table.labels.size(); ++i) {
+            if (table.targets[i] == table.defaultTarget) continue;
+            found++;
+            label = table.labels[i];
+            caseTarget = table.targets[i];
+        }
+    }
+    return found == 1;
+}
+
+Peephole::Peephole() : fn(nullptr), firstTemp(0), casts(0), constants(0), branches(0), moves(0), stores(0) {}
+
+void Peephole::run(BcFunction& function, const vector<DATA_TYPE>& slotTypes, const vector<DATA_TYPE>& globalTypes) {
+    fn = &function;
+    firstTemp = static_cast<int>(slotTypes.size());
+    size_t n = fn->code.size();
+
+    target.assign(n + 1, false);
+    for (const Instr& in : fn->code) {
+        if (in.op == OP_JMP) target[in.a] = true;
+        else if (in.op == OP_JT || in.op == OP_JF) target[in.b] = true;
+        else if (in.op == OP_SWITCH) {
+            const SwitchTable& table = fn->switches[in.b];
+            for (int t : table.jump) target[t] = true;
+            for (int t : table.targets) target[t] = true;
+            target[table.defaultTarget] = true;
+        }
+    }
+    removed.assign(n, false);
+    fn->merged.assign(n, 1);
+
+    removeCasts(slotTypes, globalTypes);
+    fuseConstants();
+    fuseBranches();
+    fuseConstants(); // константа — операнд вычитания, ставшего сравнением (JNE x, t -> JNEK x, k)
+    retargetMoves();
+    fuseGlobalStores();
+    compact();
+    fn = nullptr;
+}
+
+// Разрядность значения в каждом временном регистре — по определившей его инструкции;
+// на границах окна сбрасывается (64 — ничего не известно)
+void Peephole::removeCasts(const vector<DATA_TYPE>& slotTypes, const vector<DATA_TYPE>& globalTypes) {
+    vector<int> bits(fn->numRegs, 64);
+    vector<int> constant(fn->numRegs, -1); // индекс константы, загруженной во временный регистр
+    auto regBits = [&](int r) { return r < firstTemp ? typeBits(slotTypes[r]) : bits[r]; };
+
+    for (size_t pc = 0; pc < fn->code.size(); ++pc) {
+        Instr& in = fn->code[pc];
+        if (target[pc]) {
+            fill(bits.begin() + firstTemp, bits.end(), 64);
+            fill(constant.begin() + firstTemp, constant.end(), -1);
+        }
+        OPCODE op = in.op;
+
+        int width = 64;
+        if (op == OP_CAST_S || op == OP_CAST_I || op == OP_NARROW_S || op == OP_NARROW_I) {
+            int to = (op == OP_CAST_S || op == OP_NARROW_S) ? 16 : 32;
+            width = min(to, regBits(in.b));
+            if (regBits(in.b) <= to && in.a == in.b && !target[pc]) {
+                drop(pc);
+                casts++;
+                continue;
+            }
+            if (regBits(in.b) <= to && in.a != in.b) {
+                in.op = OP_MOV;
+                in.c = 0;
+                casts++;
+            }
+        }
+        else if (op == OP_LOADK) width = constantBits(fn->consts[in.b]);
+        else if (op == OP_MOV || op == OP_DIVP2 || op == OP_MODP2) width = regBits(in.b);
+        else if (op == OP_LOADG) width = typeBits(globalTypes[in.b]);
+        else if (op >= OP_EQ && op <= OP_GE) width = 1;
+        else if (op >= OP_ADD_S && op <= OP_SHLK_L) width = tripleBits((op - OP_ADD_S) % 3);
+        else if (op >= OP_ADDK_S && op <= OP_REMK_L) width = tripleBits((op - OP_ADDK_S) % 3);
+
+        // Остаток от деления на константу уже типа операции (k % 100 в параметр short)
+        if ((op >= OP_MOD_S && op <= OP_MOD_L) || (op >= OP_REM_S && op <= OP_REM_L)) {
+            if (in.c >= firstTemp && constant[in.c] >= 0)
+                width = min(width, remainderBits(fn->consts[constant[in.c]]));
+        }
+        else if (op >= OP_REMK_S && op <= OP_REMK_L) width = min(width, remainderBits(in.c));
+        else if (op == OP_MODP2) width = min(width, static_cast<int>(in.c) + 1);
+
+        if (endsWindow(op)) {
+            fill(bits.begin() + firstTemp, bits.end(), 64);
+            fill(constant.begin() + firstTemp, constant.end(), -1);
+        }
+        else if (definesRegister(op) && in.a >= firstTemp) {
+            bits[in.a] = width;
+            constant[in.a] = op == OP_LOADK ? in.b : -1;
+        }
+    }
+}
+
+// Константа, загруженная во временный регистр, который читает только следующая арифметическая
+// операция или сравнение с переходом, становится операндом этой инструкции
+void Peephole::fuseConstants() {
+    size_t n = fn->code.size();
+    for (size_t pc = 0; pc < n; ++pc) {
+        const Instr& load = fn->code[pc];
+        if (removed[pc] || load.op != OP_LOADK || load.a < firstTemp) continue;
+        int t = load.a;
+        int64_t k = fn->consts[load.b];
+
+        size_t use = pc + 1;
+        while (use < n && (removed[use] || (!target[use] && !readsRegister(fn->code[use], t)
+            && !writesRegister(fn->code[use], t) && !endsWindow(fn->code[use].op)))) {
+            use++;
+        }
+        if (use >= n || target[use] || !readsRegister(fn->code[use], t) || readLater(t, use)) continue;
+
+        Instr& in = fn->code[use];
+        OPCODE op = in.op;
+        if ((op == OP_JEQ || op == OP_JNE) && (in.a == t) != (in.b == t) && fitsImmediate(k)) {
+            if (in.a == t) in.a = in.b;
+            in.op = op == OP_JEQ ? OP_JEQK : OP_JNEK;
+            in.b = static_cast<int32_t>(k);
+            absorb(pc, use);
+            constants++;
+            continue;
+        }
+        bool commutative = isTypedOf(op, OP_ADD_S) || isTypedOf(op, OP_MUL_S);
+        if (commutative && in.b == t && in.c != t) swap(in.b, in.c);
+        if (in.c != t || in.b == t) continue;
+
+        OPCODE fused;
+        if (isTypedOf(op, OP_ADD_S)) fused = static_cast<OPCODE>(OP_ADDK_S + (op - OP_ADD_S));
+        else if (isTypedOf(op, OP_SUB_S)) {
+            fused = static_cast<OPCODE>(OP_ADDK_S + (op - OP_SUB_S));
+            if (k == INT64_MIN) continue;
+            k = -k;
+        }
+        else if (isTypedOf(op, OP_MUL_S)) fused = static_cast<OPCODE>(OP_MULK_S + (op - OP_MUL_S));
+        else if (isTypedOf(op, OP_QUO_S)) fused = static_cast<OPCODE>(OP_QUOK_S + (op - OP_QUO_S));
+        else if (isTypedOf(op, OP_REM_S)) fused = static_cast<OPCODE>(OP_REMK_S + (op - OP_REM_S));
+        else continue;
+        if (!fitsImmediate(k) || ((fused >= OP_QUOK_S) && k == 0)) continue;
+
+        in.op = fused;
+        in.c = static_cast<int32_t>(k);
+        absorb(pc, use);
+        constants++;
+    }
+}
+
+// switch с одной меткой, ветвь которой (или default) начинается сразу за ним, — сравнение
+// с переходом; вычитание перед сравнением с нулём и прибавление константы входят в сравнение
+void Peephole::fuseBranches() {
+    for (size_t pc = 0; pc < fn->code.size(); ++pc) {
+        Instr& in = fn->code[pc];
+        if (removed[pc] || in.op != OP_SWITCH) continue;
+        const SwitchTable& table = fn->switches[in.b];
+        int64_t label = 0;
+        int caseTarget = 0;
+        if (!singleCase(table, label, caseTarget) || !fitsImmediate(label)) continue;
+
+        int next = static_cast<int>(pc) + 1;
+        OPCODE op;
+        int jump;
+        if (caseTarget == next) {
+            op = OP_JNEK;
+            jump = table.defaultTarget;
+        }
+        else if (table.defaultTarget == next) {
+            op = OP_JEQK;
+            jump = caseTarget;
+        }
+        else continue;
+
+        int disc = in.a;
+        in.op = op;
+        in.b = static_cast<int32_t>(label);
+        in.c = jump;
+        branches++;
+
+        size_t prev = pc;
+        while (prev > 0 && removed[prev - 1]) prev--;
+        if (prev == 0 || target[pc] || disc < firstTemp || readLater(disc, pc)) continue;
+        prev--;
+        const Instr& def = fn->code[prev];
+        if (def.a != disc || def.b == disc || def.c == disc) continue;
+
+        if (isTypedOf(def.op, OP_SUB_S) && label == 0) {
+            // x - y == 0 в разрядности операции — то же, что x == y для канонических значений
+            in.op = op == OP_JNEK ? OP_JNE : OP_JEQ;
+            in.a = def.b;
+            in.b = def.c;
+        }
+        else if (isTypedOf(def.op, OP_ADDK_S)) {
+            // x + m == k в разрядности операции — x == k - m, приведённое к ней. Метка вне типа
+            // операции не совпадает с суммой никогда, а после приведения могла бы совпасть с x
+            int bits = tripleBits(def.op - OP_ADDK_S);
+            if (wrapToBits(label, bits) != label) continue;
+            int64_t k = wrapToBits(label - def.c, bits);
+            if (!fitsImmediate(k)) continue;
+            in.a = def.b;
+            in.b = static_cast<int32_t>(k);
+        }
+        else continue;
+        absorb(prev, pc);
+    }
+}
+
+// Результат операции во временном регистре, который только пересылается в переменную
+// или регистр аргумента, записывается туда сразу
+void Peephole::retargetMoves() {
+    for (size_t pc = 0; pc < fn->code.size(); ++pc) {
+        const Instr& mov = fn->code[pc];
+        if (removed[pc] || mov.op != OP_MOV || target[pc] || mov.b < firstTemp || mov.a == mov.b) continue;
+        int t = mov.b;
+        int d = mov.a;
+
+        size_t def = pc;
+        bool found = false;
+        while (def > 0) {
+            def--;
+            if (removed[def]) continue;
+            const Instr& in = fn->code[def];
+            if (definesRegister(in.op) && in.a == t) {
+                found = true;
+                break;
+            }
+            if (target[def] || endsWindow(in.op) || readsRegister(in, t) || writesRegister(in, t)
+                || readsRegister(in, d) || writesRegister(in, d)) {
+                break;
+            }
+        }
+        if (!found || readLater(t, pc)) continue;
+
+        fn->code[def].a = d;
+        absorb(pc, def);
+        moves++;
+    }
+}
+
+// Сумма или разность во временном регистре, который только записывается в глобальную
+// переменную следующей инструкцией, записывается туда сразу
+void Peephole::fuseGlobalStores() {
+    for (size_t pc = 1; pc < fn->code.size(); ++pc) {
+        const Instr& store = fn->code[pc];
+        if (removed[pc] || store.op != OP_STG || target[pc] || store.b < firstTemp) continue;
+        size_t prev = pc - 1;
+        while (prev > 0 && removed[prev]) prev--;
+        Instr& def = fn->code[prev];
+        if (removed[prev] || def.a != store.b || readLater(store.b, pc)) continue;
+
+        if (isTypedOf(def.op, OP_ADD_S)) def.op = static_cast<OPCODE>(OP_ADDG_S + (def.op - OP_ADD_S));
+        else if (isTypedOf(def.op, OP_SUB_S)) def.op = static_cast<OPCODE>(OP_SUBG_S + (def.op - OP_SUB_S));
+        else continue;
+        def.a = store.a;
+        absorb(pc, prev);
+        stores++;
+    }
+}
+
+// Удаление инструкций и пересчёт адресов переходов
+void Peephole::compact() {
+    size_t n = fn->code.size();
+    vector<int> map(n + 1);
+    int next = 0;
+    for (size_t pc = 0; pc < n; ++pc) {
+        map[pc] = next;
+        if (!removed[pc]) next++;
+    }
+    map[n] = next;
+
+    vector<Instr> code;
+    vector<SrcLoc> locs;
+    vector<uint8_t> merged;
+    for (size_t pc = 0; pc < n; ++pc) {
+        if (removed[pc]) continue;
+        Instr in = fn->code[pc];
+        if (in.op == OP_JMP) in.a = map[in.a];
+        else if (in.op == OP_JT || in.op == OP_JF) in.b = map[in.b];
+        else if (in.op >= OP_JEQ && in.op <= OP_JNEK) in.c = map[in.c];
+        code.push_back(in);
+        locs.push_back(fn->locs[pc]);
+        merged.push_back(fn->merged[pc]);
+    }
+    for (SwitchTable& table : fn->switches) table.remap(map);
+
+    fn->code.swap(code);
+    fn->locs.swap(locs);
+    fn->merged.swap(merged);
+}
+
+// reg — временный регистр: он не живёт дольше оператора, а переходы, вызовы и возврат
+// завершают оператор, поэтому поиск идёт до первой записи в reg или границы окна
+bool Peephole::readLater(int reg, size_t pc) const {
+    for (size_t j = pc + 1; j < fn->code.size(); ++j) {
+        if (removed[j]) continue;
+        const Instr& in = fn->code[j];
+        if (readsRegister(in, reg)) return true;
+        if (writesRegister(in, reg) || endsWindow(in.op)) return false;
+    }
+    return false;
+}
+
+void Peephole::absorb(size_t from, size_t into) {
+    fn->merged[into] = static_cast<uint8_t>(min(255, fn->merged[into] + fn->merged[from]));
+    removed[from] = true;
+}
+
+// Удалённую инструкцию (не цель перехода) учитывает предыдущая оставшаяся: через неё
+// проходит любой путь к удалённой
+void Peephole::drop(size_t pc) {
+    size_t into = pc;
+    while (into > 0 && removed[into - 1]) into--;
+    if (into > 0) into--;
+    else {
+        into = pc + 1;
+        while (removed[into]) into++;
+    }
+    absorb(pc, into);
+}
@@ -0,0 +1,57 @@
+﻿#pragma once
+#include "Bytecode.h"
+#include <vector>
+
+// Оконная оптимизация байт-кода функции (после компиляции, без debug).
+// Набор суперинструкций выбран по частотам пар подряд исполненных инструкций на наборах
+// CompilerBench (DispatchProfile, --dispatch-stats): чаще всего встречались загрузка константы
+// перед арифметикой, пересылка результата операции в переменную или аргумент вызова
+// и вычитание перед switch с одной меткой (проверка выхода из рекурсивного цикла).
+//   LOADK t, k; OP r, x, t    -> OPK r, x, k   (ADD, SUB как ADD с -k, MUL, QUO, REM)
+//   OP t, ...; MOV d, t       -> OP d, ...     (результат сразу в переменную / регистр аргумента)
+//   SWITCH x (одна метка k)   -> JEQK / JNEK x, k
+//   SUB t, x, y; JNEK t, 0    -> JNE x, y      (и JEQ; ADDK перед сравнением — константа в метке)
+//   ADD t, x, y; STG g, t     -> ADDG g, x, y  (и SUBG: присваивание глобальной переменной суммы)
+// Приведения, добавленные для выравнивания типов операндов и аргументов, удаляются, если
+// значение уже помещается в тип: разрядность регистра известна по типу ячейки кадра,
+// глобальной переменной или операции, определившей временный регистр (остаток от деления на
+// константу k не шире k).
+// Временный регистр читается один раз, в пределах оператора; переходы — только между
+// операторами, поэтому ни одна удалённая инструкция не является целью перехода.
+// BcFunction::merged — сколько исходных инструкций заменяет каждая оставшаяся
+class Peephole {
+public:
+    Peephole();
+
+    // slotTypes — типы ячеек кадра (регистры ниже slotTypes.size()), globalTypes — глобальных переменных
+    void run(BcFunction& fn, const std::vector<DATA_TYPE>& slotTypes, const std::vector<DATA_TYPE>& globalTypes);
+
+    // Статистика по всем обработанным функциям (для тестов и отчёта)
+    int removedCasts() const { return casts; }
+    int fusedConstants() const { return constants; }
+    int fusedBranches() const { return branches; }
+    int retargetedMoves() const { return moves; }
+    int fusedStores() const { return stores; }
+
+private:
+    BcFunction* fn;
+    int firstTemp; // первый временный регистр
+    std::vector<bool> target; // инструкция — цель перехода
+    std::vector<bool> removed;
+    int casts;
+    int constants;
+    int branches;
+    int moves;
+    int stores;
+
+    void removeCasts(const std::vector<DATA_TYPE>& slotTypes, const std::vector<DATA_TYPE>& globalTypes);
+    void fuseConstants();
+    void fuseBranches();
+    void retargetMoves();
+    void fuseGlobalStores();
+    void compact();
+
+    bool readLater(int reg, size_t pc) const; // значение reg читается после инструкции pc
+    void absorb(size_t from, size_t into); // инструкция from удалена, её заменяет into
+    void drop(size_t pc); // инструкция pc удалена (ничего не делала)
+};
@@ -0,0 +1,311 @@
+﻿#include "Ranges.h"
+#include "Tree.h"
+#include <algorithm>
+#include <limits>
+
+// Сложение, вычитание и умножение 64-битных чисел; false — результат не помещается в 64 бита
+static bool addExact(int64_t a, int64_t b, int64_t& result) {
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) return false;
+    result = a + b;
+    return true;
+}
+
+static bool subExact(int64_t a, int64_t b, int64_t& result) {
+    if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b)) return false;
+    result = a - b;
+    return true;
+}
+
+static bool mulExact(int64_t a, int64_t b, int64_t& result) {
+    if (a > 0) {
+        if (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a) return false;
+    }
+    else if (a < 0) {
+        if (b > 0 ? a < INT64_MIN / b : (b != 0 && b < INT64_MAX / a)) return false;
+    }
+    result = a * b;
+    return true;
+}
+
+RangeAnalysis::RangeAnalysis() : program(nullptr), changed(false), stores(0), divisors(0), casts(0), warnings(0) {}
+
+RangeAnalysis::Interval RangeAnalysis::none() {
+    return Interval{ true, 0, 0 };
+}
+
+RangeAnalysis::Interval RangeAnalysis::exact(int64_t lo, int64_t hi) {
+    return Interval{ false, lo, hi };
+}
+
+RangeAnalysis::Interval RangeAnalysis::typeRange(DATA_TYPE type) {
+    switch (type) {
+    case TYPE_SHORT_INT: return exact(-32768, 32767);
+    case TYPE_INT: return exact(INT32_MIN, INT32_MAX);
+    case TYPE_BOOL: return exact(0, 1);
+    default: return exact(INT64_MIN, INT64_MAX);
+    }
+}
+
+bool RangeAnalysis::fitsType(const Interval& r, DATA_TYPE type) {
+    Interval t = typeRange(type);
+    return r.empty || (r.lo >= t.lo && r.hi <= t.hi);
+}
+
+// Значение после присваивания переменной типа type (или передачи параметру): если отрезок
+// не помещается в тип, значение обрезается — и может оказаться любым значением типа
+RangeAnalysis::Interval RangeAnalysis::stored(const Interval& r, DATA_TYPE type) {
+    return fitsType(r, type) ? r : typeRange(type);
+}
+
+void RangeAnalysis::run(ProgramNode* prog) {
+    program = prog;
+    stores = 0;
+    divisors = 0;
+    casts = 0;
+    warnings = 0;
+    warned.clear();
+
+    globals.ranges.assign(program->globals.size(), none());
+    globals.widened.assign(program->globals.size(), 0);
+    frames.clear();
+    for (FuncNode* f : program->functions) {
+        frames[f].ranges.assign(f->slotTypes.size(), none());
+        frames[f].widened.assign(f->slotTypes.size(), 0);
+    }
+
+    // Отрезки только расширяются (и не больше WIDEN_AFTER раз), поэтому обход сходится
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (StmtNode* g : program->globals) {
+            if (g->value) join(globals, g->slot.index, range(g->value, nullptr), g->declType);
+        }
+        for (FuncNode* f : program->functions) {
+            if (f->body) collect(f->body, f);
+        }
+    }
+
+    for (StmtNode* g : program->globals) {
+        if (g->value) markStore(g, g->declType, nullptr);
+    }
+    for (FuncNode* f : program->functions) {
+        if (f->body) mark(f->body, f);
+    }
+}
+
+// Добавляет к отрезку переменной значения r (после приведения к её типу)
+void RangeAnalysis::join(Cells& cells, size_t index, const Interval& r, DATA_TYPE type) {
+    Interval value = stored(r, type);
+    if (value.empty) return;
+    Interval& cur = cells.ranges[index];
+    if (cur.empty) {
+        cur = value;
+        changed = true;
+        return;
+    }
+    if (value.lo >= cur.lo && value.hi <= cur.hi) return;
+
+    Interval next = exact(min(cur.lo, value.lo), max(cur.hi, value.hi));
+    if (++cells.widened[index] > WIDEN_AFTER) next = typeRange(type);
+    cur = next;
+    changed = true;
+}
+
+void RangeAnalysis::collect(StmtNode* s, FuncNode* f) {
+    if ((s->kind == STMT_VAR_DECL && s->value) || s->kind == STMT_ASSIGN) {
+        DATA_TYPE type = s->kind == STMT_VAR_DECL ? s->declType : s->decl->n->DataType;
+        Cells& cells = s->slot.global ? globals : frames[f];
+        join(cells, s->slot.index, range(s->value, f), type);
+    }
+    if (s->kind == STMT_CALL && s->callee) {
+        // Аргументы приводятся к типам параметров (castToType)
+        Cells& callee = frames[s->callee];
+        for (size_t i = 0; i < s->args.size() && i < s->callee->paramTypes.size(); ++i) {
+            join(callee, i, range(s->args[i], f), s->callee->paramTypes[i]);
+        }
+    }
+    for (StmtNode* item : s->body) collect(item, f);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) collect(item, f);
+    }
+}
+
+void RangeAnalysis::mark(StmtNode* s, FuncNode* f) {
+    switch (s->kind) {
+    case STMT_VAR_DECL:
+        if (s->value) markStore(s, s->declType, f);
+        break;
+    case STMT_ASSIGN:
+        markStore(s, s->decl->n->DataType, f);
+        break;
+    case STMT_CALL:
+        for (ExprNode* a : s->args) markExpr(a, f);
+        break;
+    case STMT_SWITCH:
+        markExpr(s->value, f);
+        break;
+    default:
+        break;
+    }
+    for (StmtNode* item : s->body) mark(item, f);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) mark(item, f);
+    }
+}
+
+// Присваивание: сужение, которое ничего не обрезает, — без проверки; константа, которая
+// обрезается, — предупреждение сейчас и обрезанная константа вместо неё. Копии оператора
+// в специализированных и встроенных функциях имеют ту же позицию — предупреждение одно
+void RangeAnalysis::markStore(StmtNode* s, DATA_TYPE varType, FuncNode* f) {
+    markExpr(s->value, f);
+    ExprNode* value = s->value;
+    if (varType == TYPE_BOOL || value->type == TYPE_BOOL) return;
+
+    if (value->kind == EXPR_CONST && truncateTo(varType, value->value.v) != value->value.v) {
+        if (warned.insert(s->loc.offset).second) {
+            Tree::printTruncationWarning(value->value.v, varType, s->loc);
+            warnings++;
+        }
+        value->value = Value(varType, truncateTo(varType, value->value.v));
+        value->type = varType;
+        return;
+    }
+
+    // Как в BytecodeCompiler::compileStore: проверка нужна только при сужении
+    bool narrowing = value->type != varType
+        && (varType == TYPE_SHORT_INT || (varType == TYPE_INT && value->type == TYPE_LONG_INT));
+    if (!narrowing) return;
+    Interval r = range(value, f);
+    if (!r.empty && fitsType(r, varType)) {
+        s->fits = true;
+        stores++;
+    }
+}
+
+void RangeAnalysis::markExpr(ExprNode* e, FuncNode* f) {
+    if (!e) return;
+    markExpr(e->left, f);
+    markExpr(e->right, f);
+
+    if (e->kind == EXPR_BINARY && (e->op == BOP_DIV || e->op == BOP_MOD)) {
+        Interval d = range(e->right, f);
+        if (!d.empty && (d.lo > 0 || d.hi < 0)) {
+            e->checkZero = false;
+            e->kernel = selectNonZeroKernel(e->op, e->type);
+            divisors++;
+        }
+    }
+    else if (e->kind == EXPR_CAST) {
+        DATA_TYPE from = e->left->type;
+        bool narrowing = (e->type == TYPE_SHORT_INT && from != TYPE_SHORT_INT)
+            || (e->type == TYPE_INT && from == TYPE_LONG_INT);
+        Interval r = range(e->left, f);
+        if (narrowing && !r.empty && fitsType(r, e->type)) {
+            e->fits = true;
+            casts++;
+        }
+    }
+}
+
+// Отрезок значений выражения в функции f (nullptr — инициализаторы глобальных переменных)
+RangeAnalysis::Interval RangeAnalysis::range(ExprNode* e, FuncNode* f) {
+    switch (e->kind) {
+    case EXPR_CONST:
+        return exact(e->value.v, e->value.v);
+    case EXPR_VAR:
+        if (e->slot.index < 0) return typeRange(e->type);
+        if (e->slot.global) return globals.ranges[e->slot.index];
+        if (!f) return typeRange(e->type);
+        return frames[f].ranges[e->slot.index];
+    case EXPR_CAST:
+        return stored(range(e->left, f), e->type);
+    case EXPR_NEG:
+        return arithmetic(BOP_MUL, e->type, range(e->left, f), exact(-1, -1));
+    case EXPR_BINARY:
+        if (e->group == OP_COMPARISON) return exact(0, 1);
+        return arithmetic(e->op, e->type, range(e->left, f), range(e->right, f));
+    }
+    return typeRange(e->type);
+}
+
+// Операция в типе type над отрезками операндов. short и int вычисляются в 64 битах и
+// обрезаются, long — по модулю 2^64: если точный результат не помещается в тип, он
+// может оказаться любым значением типа
+RangeAnalysis::Interval RangeAnalysis::arithmetic(BIN_OP op, DATA_TYPE type, const Interval& l, const Interval& r) {
+    if (l.empty || r.empty) return none();
+    Interval whole = typeRange(type);
+    int64_t lo = INT64_MAX, hi = INT64_MIN;
+
+    switch (op) {
+    case BOP_ADD:
+    case BOP_SUB:
+    case BOP_MUL: {
+        // Крайние значения — в углах прямоугольника значений операндов
+        int64_t xs[2] = { l.lo, l.hi };
+        int64_t ys[2] = { r.lo, r.hi };
+        for (int64_t x : xs) {
+            for (int64_t y : ys) {
+                int64_t v = 0;
+                bool ok = op == BOP_ADD ? addExact(x, y, v) : op == BOP_SUB ? subExact(x, y, v) : mulExact(x, y, v);
+                if (!ok) return whole;
+                lo = min(lo, v);
+                hi = max(hi, v);
+            }
+        }
+        break;
+    }
+
+    case BOP_DIV: {
+        // Делитель одного знака: частное монотонно по каждому операнду. Деление на 0
+        // завершается ошибкой и значения не даёт
+        Interval parts[2] = { exact(r.lo, min<int64_t>(r.hi, -1)), exact(max<int64_t>(r.lo, 1), r.hi) };
+        bool any = false;
+        for (const Interval& d : parts) {
+            if (d.lo > d.hi) continue;
+            int64_t xs[2] = { l.lo, l.hi };
+            int64_t ys[2] = { d.lo, d.hi };
+            for (int64_t x : xs) {
+                for (int64_t y : ys) {
+                    if (x == INT64_MIN && y == -1) return whole;
+                    lo = min(lo, x / y);
+                    hi = max(hi, x / y);
+                }
+            }
+            any = true;
+        }
+        if (!any) return none();
+        break;
+    }
+
+    case BOP_MOD: {
+        // Остаток по модулю меньше делителя, знак — как у делимого
+        if (r.lo == 0 && r.hi == 0) return none();
+        int64_t bound = max<int64_t>(r.hi > 0 ? r.hi - 1 : 0, r.lo < 0 ? -(r.lo + 1) : 0);
+        lo = l.lo < 0 ? max(l.lo, -bound) : 0;
+        hi = l.hi > 0 ? min(l.hi, bound) : 0;
+        break;
+    }
+
+    case BOP_SHL: {
+        // Сдвиг на известное число разрядов — умножение на степень двойки
+        if (r.lo != r.hi) return whole;
+        int64_t count = r.lo & (type == TYPE_LONG_INT ? 63 : 31);
+        if (count > 62) return whole;
+        int64_t factor = int64_t(1) << count;
+        if (!mulExact(l.lo, factor, lo) || !mulExact(l.hi, factor, hi)) return whole;
+        break;
+    }
+
+    case BOP_SHR:
+        // Арифметический сдвиг приближает значение к 0 (отрицательное — к -1)
+        lo = min<int64_t>(l.lo, 0);
+        hi = max<int64_t>(l.hi, 0);
+        break;
+
+    default:
+        return exact(0, 1);
+    }
+
+    Interval result = exact(lo, hi);
+    return fitsType(result, type) ? result : whole;
+}
@@ -0,0 +1,80 @@
+﻿#pragma once
+#include "Ast.h"
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Анализ диапазонов значений (в проверенной программе, AST): для каждой переменной —
+// отрезок, в котором лежат все её значения (объединение по всем присваиваниям, инициализаторам
+// и — для параметров — аргументам всех вызовов, до неподвижной точки по графу вызовов);
+// для выражения — отрезок, вычисленный по отрезкам операндов с учётом разрядности и
+// переполнения типа операции (при возможном переполнении — весь диапазон типа).
+// По результатам снимаются проверки, исход которых известен:
+//   присваивание, значение которого заведомо помещается в тип переменной, — без проверки
+//   обрезки и приведения (StmtNode::fits);
+//   деление и остаток, делитель которых заведомо не 0, — без проверки (ExprNode::checkZero,
+//   ядро selectNonZeroKernel, в байт-коде OP_QUO_* / OP_REM_*);
+//   приведение аргумента встроенного вызова, значение которого помещается в тип, — пустое
+//   (ExprNode::fits).
+// Присваивание константы, которая не помещается в тип переменной, обрезало бы её при каждом
+// исполнении одинаково: предупреждение печатается один раз при компиляции, а константа
+// заменяется обрезанным значением. Предупреждения для значений, известных только при
+// исполнении, остаются там же. Отладочный вывод (преобразования при присваивании) при этом
+// пропал бы, поэтому анализ применяется только без debug
+class RangeAnalysis {
+public:
+    // Сколько раз отрезок переменной может расшириться, прежде чем станет диапазоном её типа
+    // (рекурсия со счётчиком иначе расширяла бы его по одному значению)
+    static const int WIDEN_AFTER = 3;
+
+    RangeAnalysis();
+
+    void run(ProgramNode* program);
+
+    // Статистика (для тестов): снятые проверки обрезки, деления на 0, приведения
+    // и предупреждения, напечатанные при компиляции
+    int fittingStores() const { return stores; }
+    int nonZeroDivisors() const { return divisors; }
+    int fittingCasts() const { return casts; }
+    int compileTimeWarnings() const { return warnings; }
+
+private:
+    struct Interval {
+        bool empty; // значений нет: переменной не присваивается, выражение не вычисляется
+        int64_t lo;
+        int64_t hi;
+    };
+
+    // Отрезки переменных: глобальных (индекс — VarSlot::index) и ячеек кадра каждой функции,
+    // и сколько раз каждый уже расширялся
+    struct Cells {
+        std::vector<Interval> ranges;
+        std::vector<int> widened;
+    };
+
+    ProgramNode* program;
+    Cells globals;
+    std::unordered_map<FuncNode*, Cells> frames;
+    bool changed;
+
+    int stores;
+    int divisors;
+    int casts;
+    int warnings;
+    std::unordered_set<uint32_t> warned; // позиции присваиваний, о которых уже предупреждено
+
+    static Interval none();
+    static Interval exact(int64_t lo, int64_t hi);
+    static Interval typeRange(DATA_TYPE type);
+    static bool fitsType(const Interval& r, DATA_TYPE type);
+    static Interval stored(const Interval& r, DATA_TYPE type);
+
+    void join(Cells& cells, size_t index, const Interval& r, DATA_TYPE type);
+    void collect(StmtNode* s, FuncNode* f);
+    void mark(StmtNode* s, FuncNode* f);
+    void markExpr(ExprNode* e, FuncNode* f);
+    void markStore(StmtNode* s, DATA_TYPE varType, FuncNode* f);
+    Interval range(ExprNode* e, FuncNode* f);
+    Interval arithmetic(BIN_OP op, DATA_TYPE type, const Interval& l, const Interval& r);
+};
@@ -9,6 +9,10 @@
 // В конструкторе текущая позиция = 0, текст пуст
 Scanner::Scanner() : text(), currentPos(0) {}
 
+Scanner::~Scanner() {
+    if (SourceManager::getActive() == &lineTable) SourceManager::setActive(nullptr);
+}
+
 bool Scanner::loadFile(const string& fileName) {
     ifstream in(fileName);
     if (!in) return false;
@@ -20,6 +24,7 @@ bool Scanner::loadFile(const string& fileName) {
     // Добавляем нулевой символ в конце текста (на всякий случай)
     text.push_back('\0');
     currentPos = 0;
+    loadSource();
     return true;
 }
 
@@ -55,7 +60,7 @@ bool Scanner::isIdentPart(char c) {
 }
 
 // Проверка ключевых слов: возвращает соответствующий KW_* или IDENT
-int Scanner::checkKeyword(const string& s) {
+int Scanner::checkKeyword(string_view s) {
     if (s == "int") return KW_INT;
     if (s == "short") return KW_SHORT;
     if (s == "long") return KW_LONG;
@@ -113,10 +118,17 @@ void Scanner::skipIgnored() {
 
 // Основной метод лексера: получить следующую лексему
 int Scanner::getNextLex(string& outLex) {
-    outLex.clear();
+    size_t start = 0;
+    int code = scanLex(start);
+    outLex.assign(text, start, currentPos - start);
+    return code;
+}
 
+// Чтение лексемы без выделения памяти: текст лексемы — всё, что было прочитано начиная со start
+int Scanner::scanLex(size_t& start) {
     // Пропускаем игнорируемые символы
     skipIgnored();
+    start = currentPos;
 
     // Конец текста
     char c = peek();
@@ -124,134 +136,140 @@ int Scanner::getNextLex(string& outLex) {
 
     // Идентификатор или ключевое слово
     if (isIdentStart(c)) {
-        string lex;
-        lex.push_back(getChar());
-        while (isIdentPart(peek())) lex.push_back(getChar());
-        int code = checkKeyword(lex);
-        outLex = lex;
+        getChar();
+        while (isIdentPart(peek())) getChar();
+        size_t len = currentPos - start;
+        int code = checkKeyword(string_view(text.data() + start, len));
 
-        if (code == IDENT && lex.length() > MAX_CONST_LEN) return T_ERR;
+        if (code == IDENT && len > MAX_CONST_LEN) return T_ERR;
 
         return code;
     }
 
-
     // Десятичные и шестнадацатеричные числа
     if (isDigit(c)) {
         char first = getChar();
-        if (first == '0') {
-            char nx = peek();
-            if (nx == 'x' || nx == 'X') {
-                // требуется >=1 16-ричная цифра
-                getChar(); // убираем x/X
-                string lex = "0";
-                lex.push_back(nx);
-                if (!isHexDigit(peek())) {
-                    // ошибка: 0x без цифр
-                    outLex = lex;
-                    return T_ERR;
-                }
-                while (isHexDigit(peek())) lex.push_back(getChar());
-                outLex = lex;
-
-                if (lex.length() > MAX_CONST_LEN) return T_ERR;
-
-                return HEX_CONST;
+        if (first == '0' && (peek() == 'x' || peek() == 'X')) {
+            // требуется >=1 16-ричная цифра
+            getChar(); // убираем x/X
+            if (!isHexDigit(peek())) {
+                // ошибка: 0x без цифр
+                return T_ERR;
             }
-            else if (isDigit(nx)) {
-                // цифра после 0 - читаем как DEC
-                string lex;
-                lex.push_back(first);
-                while (isDigit(peek())) lex.push_back(getChar());
-                outLex = lex;
+            while (isHexDigit(peek())) getChar();
 
-                if (lex.length() > MAX_CONST_LEN) return T_ERR;
+            if (currentPos - start > MAX_CONST_LEN) return T_ERR;
 
-                return DEC_CONST;
-            }
-            else {
-                // просто '0'
-                outLex = "0";
-                return DEC_CONST;
-            }
+            return HEX_CONST;
         }
-        else {
-            // первая цифра 1..9
-            string lex;
-            lex.push_back(first);
-            while (isDigit(peek())) lex.push_back(getChar());
-            outLex = lex;
 
-            if (lex.length() > MAX_CONST_LEN) return T_ERR;
+        // десятичная константа (в том числе просто '0' и цифры после 0)
+        while (isDigit(peek())) getChar();
 
-            return DEC_CONST;
-        }
+        if (currentPos - start > MAX_CONST_LEN) return T_ERR;
+
+        return DEC_CONST;
     }
 
     // Операторы и разделители
-    char n1 = peek(1);
-    switch (c) {
-    case '+': getChar(); outLex = "+"; return PLUS;
-    case '-': getChar(); outLex = "-"; return MINUS;
-    case '*': getChar(); outLex = "*"; return MULT;
-    case '%': getChar(); outLex = "%"; return MOD;
-    case ';': getChar(); outLex = ";"; return SEMI;
-    case ',': getChar(); outLex = ","; return COMMA;
-    case '(': getChar(); outLex = "("; return LPAREN;
-    case ')': getChar(); outLex = ")"; return RPAREN;
-    case '{': getChar(); outLex = "{"; return LBRACE;
-    case '}': getChar(); outLex = "}"; return RBRACE;
-    case ':': getChar(); outLex = ":"; return COLON;
+    switch (getChar()) {
+    case '+': return PLUS;
+    case '-': return MINUS;
+    case '*': return MULT;
+    case '%': return MOD;
+    case ';': return SEMI;
+    case ',': return COMMA;
+    case '(': return LPAREN;
+    case ')': return RPAREN;
+    case '{': return LBRACE;
+    case '}': return RBRACE;
+    case ':': return COLON;
+    case '/': return DIV;
     case '=':
-        getChar();
-        if (peek() == '=') { getChar(); outLex = "=="; return EQ; }
-        outLex = "="; return ASSIGN;
+        if (peek() == '=') { getChar(); return EQ; }
+        return ASSIGN;
     case '!':
-        getChar();
-        if (peek() == '=') { getChar(); outLex = "!="; return NEQ; }
+        if (peek() == '=') { getChar(); return NEQ; }
         // одиночный '!' — лексическая ошибка :)
-        outLex = "!"; return T_ERR;
+        return T_ERR;
     case '<':
-        getChar();
-        if (peek() == '<') { getChar(); outLex = "<<"; return SHL; }
-        if (peek() == '=') { getChar(); outLex = "<="; return LE; }
-        outLex = "<"; return LT;
+        if (peek() == '<') { getChar(); return SHL; }
+        if (peek() == '=') { getChar(); return LE; }
+        return LT;
     case '>':
-        getChar();
-        if (peek() == '>') { getChar(); outLex = ">>"; return SHR; }
-        if (peek() == '=') { getChar(); outLex = ">="; return GE; }
-        outLex = ">"; return GT;
-    case '/':
-        getChar();
-        outLex = "/";
-        return DIV;
+        if (peek() == '>') { getChar(); return SHR; }
+        if (peek() == '=') { getChar(); return GE; }
+        return GT;
     default:
         // неизвестный/недопустимый символ
-    {
-        string s;
-        s.push_back(getChar());
-        outLex = s;
         return T_ERR;
     }
+}
+
+// Значение числовой константы по правилам std::stoll с основанием 0:
+// 0x... — шестнадцатеричная, 0... — восьмеричная (разбор до первой не восьмеричной цифры),
+// иначе десятичная. Значения, не помещающиеся в uint64_t, насыщаются до UINT64_MAX
+uint64_t Scanner::decodeInt(string_view lex) {
+    unsigned base = 10;
+    size_t i = 0;
+    if (lex.size() > 2 && lex[0] == '0' && (lex[1] == 'x' || lex[1] == 'X')) {
+        base = 16;
+        i = 2;
+    }
+    else if (lex.size() > 1 && lex[0] == '0') {
+        base = 8;
+        i = 1;
+    }
+
+    uint64_t value = 0;
+    for (; i < lex.size(); ++i) {
+        char c = lex[i];
+        unsigned digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else break;
+        if (digit >= base) break;
+
+        if (value > (UINT64_MAX - digit) / base) return UINT64_MAX;
+        value = value * base + digit;
     }
+    return value;
 }
 
-std::pair<int, int> Scanner::getLineCol() const {
-    int line = 1;
-    int col = 0;
-    size_t pos = 0;
-    while (pos < currentPos && pos < text.size()) {
-        char c = text[pos];
-        if (c == '\n') {
-            line++;
-            col = 1;
-        }
-        else {
-            col++;
+TokenStream Scanner::tokenize() {
+    TokenStream out;
+    out.source = string_view(text.data(), text.empty() ? 0 : text.size() - 1);
+
+    // Грубая оценка числа лексем, чтобы избежать повторных перераспределений
+    size_t estimate = text.size() / 3 + 1;
+    out.kind.reserve(estimate);
+    out.offset.reserve(estimate);
+    out.length.reserve(estimate);
+    out.value.reserve(estimate);
+
+    for (;;) {
+        size_t start = 0;
+        int code = scanLex(start);
+        size_t len = currentPos - start;
+
+        uint64_t value = 0;
+        if (code == DEC_CONST || code == HEX_CONST) {
+            value = decodeInt(string_view(text.data() + start, len));
         }
-        pos++;
+
+        out.kind.push_back(static_cast<uint8_t>(code));
+        out.offset.push_back(static_cast<uint32_t>(start));
+        out.length.push_back(static_cast<uint32_t>(len));
+        out.value.push_back(value);
+
+        if (code == T_END) break;
     }
-    return { line, col };
+    return out;
+}
+
+std::pair<int, int> Scanner::getLineCol() const {
+    return lineTable.lineCol(currentPos);
 }
 
 size_t Scanner::getPos() const {
@@ -266,4 +284,11 @@ void Scanner::loadFromString(const string& source) {
     text = source;
     text.push_back('\0');
     currentPos = 0;
+    loadSource();
+}
+
+// Таблица строк нового текста; позиции в диагностике разрешаются по ней
+void Scanner::loadSource() {
+    lineTable.load(string_view(text.data(), text.size() - 1));
+    SourceManager::setActive(&lineTable);
 }
\ No newline at end of file
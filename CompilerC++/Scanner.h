@@ -1,10 +1,32 @@
-﻿#include <string>
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "SourceManager.h"
 
 using namespace std;
 
+// Поток лексем, полученный за один проход лексера (структура массивов).
+// i-я лексема: kind[i], offset[i], length[i]; для DEC_CONST/HEX_CONST в value[i] — уже
+// вычисленное значение (модуль константы, знак учитывает парсер; при переполнении — UINT64_MAX).
+// Последняя лексема всегда T_END. Текст лексем ссылается на буфер Scanner'а,
+// поэтому поток действителен, пока жив Scanner и не загружен новый текст.
+struct TokenStream {
+    vector<uint8_t> kind;
+    vector<uint32_t> offset;
+    vector<uint32_t> length;
+    vector<uint64_t> value;
+    string_view source;
+
+    size_t size() const { return kind.size(); }
+    string_view lexeme(size_t i) const { return source.substr(offset[i], length[i]); }
+};
+
 class Scanner {
 public:
     Scanner();
+    ~Scanner();
 
     // Загрузить файл; вернуть true при успехе
     bool loadFile(const string& fileName);
@@ -15,8 +37,14 @@ public:
     // Возвращает её код 
     int getNextLex(string& outLex);
 
+    // Разобрать весь оставшийся текст на лексемы (до T_END включительно)
+    TokenStream tokenize();
+
     std::pair<int, int> getLineCol() const;
 
+    // Таблица строк загруженного текста
+    const SourceManager& getLineTable() const { return lineTable; }
+
     // возвращает текущую позицию/индекс в внутреннем буфере/строке
     size_t getPos() const;
 
@@ -26,6 +54,7 @@ public:
 private:
     string text; // исходный текст + завершающий '\0'
     size_t currentPos; // текущая позиция в text
+    SourceManager lineTable; // таблица начал строк text (строится при загрузке)
 
 	char peek(size_t offset = 0) const; // получить текущий символ, но не сдвигать позицию
 	char getChar(); // получить текущий символ и сдвинуть позицию
@@ -38,6 +67,9 @@ private:
     static bool isIdentStart(char c);
     static bool isIdentPart(char c);
 
+    void loadSource(); // построить таблицу строк загруженного текста
     void skipIgnored(); // проверить пробелы и комментарии
-    int checkKeyword(const string& s); // проверить ключевые слова
+    int checkKeyword(string_view s); // проверить ключевые слова
+    int scanLex(size_t& start); // прочитать лексему без копирования: её текст — text[start, currentPos)
+    static uint64_t decodeInt(string_view lex); // значение числовой константы (с насыщением)
 };
\ No newline at end of file
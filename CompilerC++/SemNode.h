@@ -2,9 +2,21 @@
 #include <string>
 #include <vector>
 #include "DataType.h"
+#include "SourceManager.h"
+#include "Arena.h"
 
 using namespace std;
 
+// Адрес переменной, назначенный при семантическом анализе: исполнение обращается
+// к ячейке по индексу, не выполняя поиска по имени
+struct VarSlot {
+    bool global; // true — индекс в массиве глобальных переменных, false — ячейка кадра функции
+    int index; // -1, если ячейка не назначена
+
+    VarSlot() : global(true), index(-1) {}
+    VarSlot(bool g, int i) : global(g), index(i) {}
+};
+
 struct SemNode {
     string id; // имя идентификатора 
     DATA_TYPE DataType; // тип объекта 
@@ -20,16 +32,10 @@ struct SemNode {
 
     int Param; // число формальных параметров (для функций) 
     std::vector<DATA_TYPE> ParamTypes; // список типов формальных параметров (для функций)
-    int line; // строка объявления (для сообщений об ошибках) 
-    int col; // позиция в строке (для сообщений об ошибках) 
+    SrcLoc loc; // позиция объявления (для сообщений об ошибках)
+    VarSlot Slot; // ячейка переменной (для функций и областей не назначается)
 
-    // Позиции тела функции в исходном тексте (индексы/смещение в буфере Scanner)
-    // Используются при интерпретации: перейти на начало тела и повторно распарсить/выполнить.
-    size_t bodyStartPos = 0;
-    size_t bodyEndPos = 0;
-
-    SemNode() : id(""), DataType(TYPE_INT), hasValue(false), Param(0),
-        line(0), col(0), bodyStartPos(0), bodyEndPos(0) {
+    SemNode() : id(""), DataType(TYPE_INT), hasValue(false), Param(0) {
         Value.v_int64 = 0;
     }
 
@@ -39,14 +45,17 @@ struct SemNode {
         hasValue(other.hasValue),
         Param(other.Param),
         ParamTypes(other.ParamTypes),
-        line(other.line),
-        col(other.col),
-        bodyStartPos(other.bodyStartPos),
-        bodyEndPos(other.bodyEndPos)
+        loc(other.loc),
+        Slot(other.Slot)
     {
         Value = other.Value;
     }
 
+    // Узлы, создаваемые через new, размещаются в арене узлов дерева и освобождаются
+    // вместе с ней (Tree::reset); delete только вызывает деструктор
+    static void* operator new(size_t size) { return nodeArena().allocate(size, alignof(SemNode)); }
+    static void operator delete(void*) noexcept {}
+
     SemNode& operator=(const SemNode& other) {
         if (this == &other) return *this;
         id = other.id;
@@ -55,10 +64,8 @@ struct SemNode {
         Param = other.Param;
         ParamTypes = other.ParamTypes;
         Value = other.Value;
-        line = other.line;
-        col = other.col;
-        bodyStartPos = other.bodyStartPos;
-        bodyEndPos = other.bodyEndPos;
+        loc = other.loc;
+        Slot = other.Slot;
         return *this;
     }
 };
\ No newline at end of file
@@ -0,0 +1,183 @@
+﻿#include "Simplify.h"
+
+// Операнд в типе операции: расширение канонического значения ничего не меняет
+static ExprNode* widenTo(ExprNode* e, DATA_TYPE type) {
+    if (e->type == type) return e;
+    ExprNode* cast = new ExprNode(EXPR_CAST, type, e->loc);
+    cast->fits = true;
+    cast->left = e;
+    return cast;
+}
+
+static bool isConstant(const ExprNode* e, int64_t value) {
+    return e->kind == EXPR_CONST && e->type != TYPE_BOOL && e->value.v == value;
+}
+
+Simplifier::Simplifier() : removed(0), negated(0), shifted(0), divisions(0) {}
+
+int Simplifier::powerOfTwo(const ExprNode* e) {
+    if (e->kind != EXPR_CONST || e->type == TYPE_BOOL) return 0;
+    int64_t v = e->value.v;
+    if (v < 2 || (v & (v - 1)) != 0) return 0;
+    int k = 0;
+    while (v > 1) {
+        v >>= 1;
+        k++;
+    }
+    return k;
+}
+
+void Simplifier::run(ProgramNode* program) {
+    removed = 0;
+    negated = 0;
+    shifted = 0;
+    divisions = 0;
+    for (StmtNode* g : program->globals) {
+        if (g->value) simplify(g->value);
+    }
+    for (FuncNode* f : program->functions) {
+        if (f->body) simplifyStmt(f->body);
+    }
+}
+
+void Simplifier::simplifyStmt(StmtNode* s) {
+    if (s->value) simplify(s->value);
+    for (ExprNode*& a : s->args) simplify(a);
+    for (StmtNode* item : s->body) simplifyStmt(item);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) simplifyStmt(item);
+    }
+}
+
+// Узел e заменяется своим операндом (в типе type); остальное поддерево удаляется
+ExprNode* Simplifier::take(ExprNode* e, ExprNode*& operand, DATA_TYPE type) {
+    ExprNode* kept = operand;
+    operand = nullptr;
+    delete e;
+    return widenTo(kept, type);
+}
+
+ExprNode* Simplifier::negate(ExprNode* operand, DATA_TYPE type, SrcLoc loc) {
+    ExprNode* neg = new ExprNode(EXPR_NEG, type, loc);
+    neg->op = BOP_SUB;
+    neg->kernel = selectNegKernel(type);
+    neg->left = widenTo(operand, type);
+    negated++;
+    return neg;
+}
+
+void Simplifier::simplify(ExprNode*& e) {
+    // -(-x): отрицание по модулю разрядности обратно само себе (тип у обоих узлов — тип x)
+    while (e->kind == EXPR_NEG && e->left->kind == EXPR_NEG) {
+        ExprNode* x = e->left->left;
+        e->left->left = nullptr;
+        delete e;
+        e = x;
+        removed++;
+    }
+    if (e->left) simplify(e->left);
+    if (e->right) simplify(e->right);
+
+    if (e->kind == EXPR_NEG) {
+        e->op = BOP_SUB;
+        e->kernel = selectNegKernel(e->type);
+        negated++;
+        return;
+    }
+    if (e->kind != EXPR_BINARY) return;
+
+    DATA_TYPE type = e->type;
+    SrcLoc loc = e->loc;
+    if (e->group == OP_SHIFT) {
+        // Счётчик ограничивается разрядностью операции (тип сдвига — тип левого операнда)
+        int64_t mask = type == TYPE_LONG_INT ? 63 : 31;
+        if (e->right->kind == EXPR_CONST && (e->right->value.v & mask) == 0) {
+            e = take(e, e->left, type);
+            removed++;
+        }
+        return;
+    }
+    if (e->group != OP_ARITHMETIC) return;
+
+    switch (e->op) {
+    case BOP_ADD:
+        if (isConstant(e->right, 0)) e = take(e, e->left, type);
+        else if (isConstant(e->left, 0)) e = take(e, e->right, type);
+        else return;
+        removed++;
+        return;
+
+    case BOP_SUB:
+        if (isConstant(e->right, 0)) {
+            e = take(e, e->left, type);
+            removed++;
+        }
+        else if (isConstant(e->left, 0)) {
+            ExprNode* x = e->right;
+            e->right = nullptr;
+            delete e;
+            e = negate(x, type, loc);
+        }
+        return;
+
+    case BOP_MUL: {
+        // Константу удобнее видеть справа
+        ExprNode*& x = e->right->kind == EXPR_CONST ? e->left : e->right;
+        ExprNode* c = e->right->kind == EXPR_CONST ? e->right : e->left;
+        if (c->kind != EXPR_CONST) return;
+        if (isConstant(c, 1)) {
+            e = take(e, x, type);
+            removed++;
+            return;
+        }
+        if (isConstant(c, -1)) {
+            ExprNode* operand = x;
+            x = nullptr;
+            delete e;
+            e = negate(operand, type, loc);
+            return;
+        }
+        int k = powerOfTwo(c);
+        if (k == 0) return;
+        // x * 2^k и x << k совпадают и при переполнении: оба — по модулю разрядности типа
+        ExprNode* operand = x;
+        x = nullptr;
+        delete e;
+        ExprNode* count = new ExprNode(EXPR_CONST, TYPE_INT, loc);
+        count->value = Value(TYPE_INT, k);
+        e = new ExprNode(EXPR_BINARY, type, loc);
+        e->op = BOP_SHL;
+        e->group = OP_SHIFT;
+        e->kernel = selectKernel(BOP_SHL, type);
+        e->left = widenTo(operand, type);
+        e->right = count;
+        shifted++;
+        return;
+    }
+
+    case BOP_DIV:
+    case BOP_MOD: {
+        if (e->op == BOP_DIV && isConstant(e->right, 1)) {
+            e = take(e, e->left, type);
+            removed++;
+            return;
+        }
+        if (e->op == BOP_DIV && isConstant(e->right, -1)) {
+            ExprNode* x = e->left;
+            e->left = nullptr;
+            delete e;
+            e = negate(x, type, loc);
+            return;
+        }
+        int k = powerOfTwo(e->right);
+        if (k == 0) return;
+        e->kernel = selectPow2Kernel(e->op, k);
+        e->checkZero = false;
+        divisions++;
+        return;
+    }
+
+    default:
+        return;
+    }
+}
@@ -0,0 +1,43 @@
+﻿#pragma once
+#include "Ast.h"
+
+// Алгебраические упрощения и снижение стоимости операций (в проверенной программе, AST).
+// Каждое преобразование даёт тот же результат, что исходная операция, в разрядности её типа
+// (short и int — обрезка, long — по модулю 2^64); операнд меньшего типа расширяется узлом
+// EXPR_CAST, который ничего не стоит:
+//   x + 0, 0 + x, x - 0, x * 1, 1 * x, x / 1, x << 0, x >> 0 — x;
+//   0 - x, x * -1, -1 * x, x / -1 — отрицание; -(-x) — x;
+//   x * 2^k, 2^k * x — сдвиг x << k;
+//   x / 2^k, x % 2^k — сдвиги с поправкой для отрицательного делимого (частное округляется
+//   к нулю, как у деления), ядро selectPow2Kernel, в байт-коде OP_DIVP2 / OP_MODP2.
+// Отрицание исполняется ядром selectNegKernel (в байт-коде OP_NEG_*) вместо умножения на -1.
+// Отбрасывается только константный операнд, поэтому ошибки (чтение неинициализированной
+// переменной, деление на 0) возникают как прежде. Отладочный вывод арифметики при этом
+// пропал бы, поэтому проход применяется только без debug
+class Simplifier {
+public:
+    Simplifier();
+
+    void run(ProgramNode* program);
+
+    // Показатель k, если e — константа 2^k (k >= 1), иначе 0
+    static int powerOfTwo(const ExprNode* e);
+
+    // Статистика (для тестов): операции, заменённые операндом, отрицанием, сдвигом влево
+    // и делением или остатком сдвигом
+    int identities() const { return removed; }
+    int negations() const { return negated; }
+    int shifts() const { return shifted; }
+    int pow2Divisions() const { return divisions; }
+
+private:
+    int removed;
+    int negated;
+    int shifted;
+    int divisions;
+
+    void simplifyStmt(StmtNode* s);
+    void simplify(ExprNode*& e);
+    ExprNode* take(ExprNode* e, ExprNode*& operand, DATA_TYPE type);
+    ExprNode* negate(ExprNode* operand, DATA_TYPE type, SrcLoc loc);
+};
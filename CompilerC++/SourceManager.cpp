@@ -0,0 +1,32 @@
+﻿#include "SourceManager.h"
+#include <algorithm>
+
+const SourceManager* SourceManager::active = nullptr;
+
+pair<int, int> SrcLoc::lineCol() const {
+    const SourceManager* source = SourceManager::getActive();
+    if (!known() || source == nullptr) return { -1, -1 };
+    return source->lineCol(offset);
+}
+
+void SourceManager::load(string_view text) {
+    length = text.size();
+    lineStarts.clear();
+    lineStarts.push_back(0);
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\n') lineStarts.push_back(static_cast<uint32_t>(i + 1));
+    }
+}
+
+// Позиция после прочтения текста до смещения offset (не включая его).
+// Столбцы первой строки, как и раньше, отсчитываются от 0, остальных — от 1
+pair<int, int> SourceManager::lineCol(size_t offset) const {
+    if (offset > length) offset = length;
+
+    // Последнее начало строки, не превосходящее offset
+    size_t line = std::upper_bound(lineStarts.begin(), lineStarts.end(), static_cast<uint32_t>(offset)) - lineStarts.begin();
+    size_t start = lineStarts[line - 1];
+    int col = static_cast<int>(offset - start);
+    if (line > 1) col += 1;
+    return { static_cast<int>(line), col };
+}
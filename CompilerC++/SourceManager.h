@@ -0,0 +1,41 @@
+﻿#pragma once
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Позиция в исходном тексте в упакованном виде — смещение от начала текста.
+// Строка и столбец вычисляются по таблице строк только тогда, когда позиция выводится
+// (диагностика или отладочный вывод)
+struct SrcLoc {
+    static const uint32_t UNKNOWN = UINT32_MAX;
+
+    uint32_t offset;
+
+    SrcLoc() : offset(UNKNOWN) {}
+    explicit SrcLoc(size_t off) : offset(static_cast<uint32_t>(off)) {}
+
+    bool known() const { return offset != UNKNOWN; }
+    // Строка и столбец; для неизвестной позиции — (-1, -1)
+    pair<int, int> lineCol() const;
+};
+
+// Таблица начал строк исходного текста: строится один раз при загрузке текста,
+// смещение переводится в строку и столбец двоичным поиском
+class SourceManager {
+public:
+    void load(string_view text);
+    pair<int, int> lineCol(size_t offset) const;
+
+    // Таблица текста, который сейчас разбирается и исполняется (её использует SrcLoc::lineCol)
+    static const SourceManager* getActive() { return active; }
+    static void setActive(const SourceManager* source) { active = source; }
+
+private:
+    vector<uint32_t> lineStarts; // смещения начала каждой строки; lineStarts[0] == 0
+    size_t length = 0;
+
+    static const SourceManager* active;
+};
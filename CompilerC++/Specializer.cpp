@@ -0,0 +1,211 @@
+﻿#include "Specializer.h"
+#include <algorithm>
+
+// Обращения к ячейкам параметров, которым что-то присваивается
+static void collectAssignedSlots(const StmtNode* s, vector<bool>& assigned) {
+    if (s->kind == STMT_ASSIGN && !s->slot.global && s->slot.index >= 0
+        && static_cast<size_t>(s->slot.index) < assigned.size()) {
+        assigned[s->slot.index] = true;
+    }
+    for (StmtNode* item : s->body) collectAssignedSlots(item, assigned);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) collectAssignedSlots(item, assigned);
+    }
+}
+
+static bool readsParam(const ExprNode* e, const vector<pair<bool, int64_t>>& args) {
+    if (!e) return false;
+    if (e->kind == EXPR_VAR && !e->slot.global && e->slot.index >= 0
+        && static_cast<size_t>(e->slot.index) < args.size() && args[e->slot.index].first) {
+        return true;
+    }
+    return readsParam(e->left, args) || readsParam(e->right, args);
+}
+
+// Селектор какого-либо switch тела зависит от параметра с известным значением
+static bool selectorReadsParam(const StmtNode* s, const vector<pair<bool, int64_t>>& args) {
+    if (s->kind == STMT_SWITCH && readsParam(s->value, args)) return true;
+    for (StmtNode* item : s->body) {
+        if (selectorReadsParam(item, args)) return true;
+    }
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) {
+            if (selectorReadsParam(item, args)) return true;
+        }
+    }
+    return false;
+}
+
+static int specializedSize(const ExprNode* e) {
+    return e ? 1 + specializedSize(e->left) + specializedSize(e->right) : 0;
+}
+
+static int specializedSize(const StmtNode* s) {
+    int size = 1 + specializedSize(s->value);
+    for (StmtNode* item : s->body) size += specializedSize(item);
+    for (ExprNode* a : s->args) size += specializedSize(a);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) size += specializedSize(item);
+    }
+    return size;
+}
+
+// Замена обращений к параметрам с известными значениями константами
+static void substituteExpr(ExprNode* e, const vector<pair<bool, int64_t>>& args, const vector<DATA_TYPE>& types) {
+    if (!e) return;
+    if (e->kind == EXPR_VAR && !e->slot.global && e->slot.index >= 0
+        && static_cast<size_t>(e->slot.index) < args.size() && args[e->slot.index].first) {
+        e->kind = EXPR_CONST;
+        e->value = Value(types[e->slot.index], args[e->slot.index].second);
+        e->decl = nullptr;
+        return;
+    }
+    substituteExpr(e->left, args, types);
+    substituteExpr(e->right, args, types);
+}
+
+static void substituteStmt(StmtNode* s, const vector<pair<bool, int64_t>>& args, const vector<DATA_TYPE>& types) {
+    substituteExpr(s->value, args, types);
+    for (ExprNode* a : s->args) substituteExpr(a, args, types);
+    for (StmtNode* item : s->body) substituteStmt(item, args, types);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) substituteStmt(item, args, types);
+    }
+}
+
+Specializer::Specializer() : created(0), redirected(0) {}
+
+int Specializer::run(ProgramNode* program) {
+    for (Variant& v : variants) v.sites = 0;
+    for (FuncNode* f : program->functions) {
+        if (f->body) collect(f, f->body, program);
+    }
+
+    // Чаще встречающиеся кортежи получают копии первыми
+    vector<Variant*> order;
+    for (Variant& v : variants) {
+        if (!v.clone && (v.sites > 1 || (v.sites > 0 && v.selector))) order.push_back(&v);
+    }
+    stable_sort(order.begin(), order.end(), [](const Variant* a, const Variant* b) { return a->sites > b->sites; });
+
+    int made = 0;
+    for (Variant* v : order) {
+        if (cloneCount(v->origin) >= MAX_CLONES) continue;
+        v->clone = makeClone(*v);
+        origins[v->clone] = v->origin;
+        made++;
+
+        // Копия размещается сразу за исходной функцией
+        auto at = find(program->functions.begin(), program->functions.end(), v->origin);
+        program->functions.insert(at == program->functions.end() ? at : at + 1, v->clone);
+    }
+    created += made;
+
+    for (FuncNode* f : program->functions) {
+        if (f->body) redirect(f->body);
+    }
+    return made;
+}
+
+// Вызов уже переадресованной копии рассматривается как вызов исходной функции: после
+// следующей свёртки констант его кортеж может стать полнее
+FuncNode* Specializer::originOf(FuncNode* f) const {
+    auto it = origins.find(f);
+    return it == origins.end() ? f : it->second;
+}
+
+// Кортеж констант вызова; false, если специализировать нечего
+bool Specializer::tupleFor(StmtNode* call, ArgTuple& out) const {
+    FuncNode* callee = originOf(call->callee);
+    if (!callee || !callee->body || call->args.size() != callee->paramTypes.size()) return false;
+
+    vector<bool> assigned(callee->paramTypes.size(), false);
+    collectAssignedSlots(callee->body, assigned);
+
+    out.assign(call->args.size(), make_pair(false, int64_t(0)));
+    bool any = false;
+    for (size_t i = 0; i < call->args.size(); ++i) {
+        const ExprNode* arg = call->args[i];
+        DATA_TYPE type = callee->paramTypes[i];
+        if (arg->kind != EXPR_CONST || assigned[i] || type == TYPE_BOOL || arg->type == TYPE_BOOL) continue;
+        out[i] = make_pair(true, truncateTo(type, arg->value.v));
+        any = true;
+    }
+    return any;
+}
+
+Specializer::Variant* Specializer::findVariant(FuncNode* origin, const ArgTuple& args) {
+    for (Variant& v : variants) {
+        if (v.origin == origin && v.args == args) return &v;
+    }
+    return nullptr;
+}
+
+int Specializer::cloneCount(FuncNode* origin) const {
+    int count = 0;
+    for (const Variant& v : variants) {
+        if (v.origin == origin && v.clone) count++;
+    }
+    return count;
+}
+
+void Specializer::collect(FuncNode* caller, StmtNode* s, ProgramNode* program) {
+    ArgTuple args;
+    if (s->kind == STMT_CALL && s->callee != program->main && originOf(s->callee) != originOf(caller)
+        && tupleFor(s, args) && specializedSize(originOf(s->callee)->body) <= MAX_SIZE) {
+        FuncNode* origin = originOf(s->callee);
+        Variant* v = findVariant(origin, args);
+        if (v) v->sites++;
+        else variants.push_back(Variant{ origin, args, nullptr, 1, selectorReadsParam(origin->body, args) });
+    }
+    for (StmtNode* item : s->body) collect(caller, item, program);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) collect(caller, item, program);
+    }
+}
+
+FuncNode* Specializer::makeClone(const Variant& v) {
+    FuncNode* origin = v.origin;
+    FuncNode* clone = new FuncNode(origin->name + ".constprop." + to_string(cloneCount(origin)), origin->decl, origin->loc);
+    clone->paramNames = origin->paramNames;
+    clone->paramTypes = origin->paramTypes;
+    clone->paramDecls = origin->paramDecls;
+    clone->slotTypes = origin->slotTypes;
+    clone->body = origin->body->clone();
+    substituteStmt(clone->body, v.args, origin->paramTypes);
+    return clone;
+}
+
+// Вызов переадресуется на копию, все известные параметры которой совпадают с константами
+// вызова (из нескольких — на копию с наибольшим числом известных параметров). Имя в операторе
+// вызова остаётся исходным — оно используется в сообщениях
+void Specializer::redirect(StmtNode* s) {
+    ArgTuple args;
+    if (s->kind == STMT_CALL && tupleFor(s, args)) {
+        FuncNode* origin = originOf(s->callee);
+        Variant* best = nullptr;
+        int bestKnown = 0;
+        for (Variant& v : variants) {
+            if (v.origin != origin || !v.clone) continue;
+            int known = 0;
+            bool matches = true;
+            for (size_t i = 0; i < args.size() && matches; ++i) {
+                if (!v.args[i].first) continue;
+                matches = args[i] == v.args[i];
+                known++;
+            }
+            if (matches && known > bestKnown) {
+                best = &v;
+                bestKnown = known;
+            }
+        }
+        if (best && best->clone != s->callee) {
+            s->callee = best->clone;
+            redirected++;
+        }
+    }
+    for (StmtNode* item : s->body) redirect(item);
+    for (CaseNode* c : s->cases) {
+        for (StmtNode* item : c->body) redirect(item);
+    }
+}
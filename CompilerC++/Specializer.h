@@ -0,0 +1,62 @@
+﻿#pragma once
+#include "Ast.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Частичное вычисление: копии функций, специализированные по константным аргументам.
+// Для каждого вызова с константными аргументами (после свёртки констант) набор значений
+// параметров — пара (функция, кортеж констант, приведённых к типам параметров, как
+// castToType при вызове). Для кортежа создаётся копия функции «имя.constprop.N», в теле
+// которой обращения к этим параметрам заменены значениями; вызовы с тем же кортежем
+// переадресуются на копию. Сигнатура копии не меняется (аргументы по-прежнему передаются),
+// а сообщения об ошибках ссылаются на исходное имя, поэтому поведение не меняется.
+// Свёртку констант и выбор ветвей switch внутри копий выполняет следующий проход ConstFolder.
+// Копия создаётся для кортежа, который встречается в нескольких вызовах или задаёт параметр,
+// от которого зависит селектор switch (тогда выбор ветви уходит из времени выполнения).
+// Рекурсивные вызовы функции из неё самой (и из её копий) не специализируются — иначе
+// рекурсия разворачивалась бы в цепочку копий. Параметры, которым в теле присваивается,
+// не специализируются. Число копий одной функции ограничено (чаще встречающиеся кортежи —
+// первыми), размер копируемой функции — тоже
+class Specializer {
+public:
+    static const int MAX_CLONES = 4; // копий одной функции за всё время работы
+    static const int MAX_SIZE = 200; // узлов AST в копируемой функции
+    // Проходов «специализация + свёртка»: свёртка в копии может сделать константными
+    // аргументы её собственных вызовов (например, рекурсивного вызова с n - 1)
+    static const int MAX_ROUNDS = 4;
+
+    Specializer();
+
+    // Один проход по программе; возвращает число созданных копий
+    int run(ProgramNode* program);
+
+    int clonesCreated() const { return created; }
+    int callsRedirected() const { return redirected; }
+
+private:
+    // Кортеж: для каждого параметра — известно ли значение и само значение
+    typedef std::vector<std::pair<bool, int64_t>> ArgTuple;
+
+    struct Variant {
+        FuncNode* origin;
+        ArgTuple args;
+        FuncNode* clone; // nullptr, пока копия не создана
+        int sites; // число вызовов с этим кортежем
+        bool selector; // известный параметр входит в селектор switch
+    };
+
+    std::vector<Variant> variants; // все кортежи, встреченные за время работы
+    std::unordered_map<FuncNode*, FuncNode*> origins; // копия -> исходная функция
+    int created;
+    int redirected;
+
+    void collect(FuncNode* caller, StmtNode* s, ProgramNode* program);
+    FuncNode* originOf(FuncNode* f) const;
+    bool tupleFor(StmtNode* call, ArgTuple& out) const;
+    Variant* findVariant(FuncNode* origin, const ArgTuple& args);
+    int cloneCount(FuncNode* origin) const;
+    FuncNode* makeClone(const Variant& v);
+    void redirect(StmtNode* s);
+};
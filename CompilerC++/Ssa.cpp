@@ -0,0 +1,388 @@
+﻿#include "Ssa.h"
+#include "Kernels.h"
+#include "Tree.h"
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+static const char* typeWord(DATA_TYPE type) {
+    switch (type) {
+    case TYPE_SHORT_INT: return "short";
+    case TYPE_INT: return "int";
+    case TYPE_LONG_INT: return "long";
+    case TYPE_BOOL: return "bool";
+    default: return "?";
+    }
+}
+
+// Сужение при присваивании или передаче параметра (как Tree::castToType)
+static bool isNarrowing(DATA_TYPE from, DATA_TYPE to) {
+    return (to == TYPE_SHORT_INT && from != TYPE_SHORT_INT && from != TYPE_BOOL)
+        || (to == TYPE_INT && from == TYPE_LONG_INT);
+}
+
+bool SsaBlock::dominates(const SsaBlock* other) const {
+    for (const SsaBlock* b = other; b; b = b->idom) {
+        if (b == this) return true;
+    }
+    return false;
+}
+
+SsaFunction::SsaFunction(FuncNode* f, size_t globals, const unordered_map<FuncNode*, vector<char>>& writes)
+    : func(f), globalCount(globals), mayWrite(writes), cur(nullptr), order(0), preorder(0), curStmt(nullptr), curList(nullptr) {
+    cur = newBlock();
+    defs.assign(globalCount + func->slotTypes.size(), nullptr);
+    for (size_t i = 0; i < func->paramTypes.size(); ++i) {
+        SsaValue* p = append(newValue(SSA_PARAM, func->paramTypes[i]));
+        p->index = static_cast<int>(i);
+        defs[globalCount + i] = p;
+    }
+    if (func->body) buildList(func->body->body);
+    computeDominators();
+}
+
+SsaFunction::~SsaFunction() {
+    for (SsaValue* v : values) delete v;
+    for (SsaBlock* b : blocks) delete b;
+}
+
+SsaBlock* SsaFunction::newBlock() {
+    SsaBlock* b = new SsaBlock(static_cast<int>(blocks.size()));
+    blocks.push_back(b);
+    return b;
+}
+
+SsaValue* SsaFunction::newValue(SSA_KIND kind, DATA_TYPE type) {
+    SsaValue* v = new SsaValue(static_cast<int>(values.size()), kind, type);
+    values.push_back(v);
+    return v;
+}
+
+SsaValue* SsaFunction::append(SsaValue* v) {
+    v->block = cur;
+    cur->code.push_back(v);
+    return v;
+}
+
+// Операторы списка по порядку; false — путь закончился break
+bool SsaFunction::buildList(vector<StmtNode*>& list) {
+    for (StmtNode* s : list) {
+        curList = &list;
+        if (!buildStmt(s)) return false;
+    }
+    return true;
+}
+
+bool SsaFunction::buildStmt(StmtNode* s) {
+    if (s->kind == STMT_BLOCK) return buildList(s->body);
+    order++;
+    curStmt = s;
+
+    switch (s->kind) {
+    case STMT_VAR_DECL:
+        if (s->value) {
+            SsaValue* v = buildExpr(s->value);
+            defs[cellOf(s->slot)] = converted(v, s->value->type, s->declType, s->fits);
+        }
+        else {
+            defs[cellOf(s->slot)] = nullptr;
+        }
+        return true;
+
+    case STMT_ASSIGN: {
+        SsaValue* v = converted(buildExpr(s->value), s->value->type, s->decl->n->DataType, s->fits);
+        if (s->slot.global) {
+            SsaValue* store = append(newValue(SSA_STORE, v->type));
+            store->index = s->slot.index;
+            store->operands.push_back(v);
+        }
+        defs[cellOf(s->slot)] = v;
+        return true;
+    }
+
+    case STMT_CALL: {
+        SsaValue* call = newValue(SSA_CALL, TYPE_INT);
+        call->callee = s->callee;
+        for (size_t i = 0; i < s->args.size(); ++i) {
+            SsaValue* a = buildExpr(s->args[i]);
+            call->operands.push_back(converted(a, s->args[i]->type, s->callee->paramTypes[i], false));
+        }
+        append(call);
+        // Глобальные переменные, которые вызов может изменить, снова нужно читать из памяти
+        auto it = mayWrite.find(s->callee);
+        for (size_t g = 0; it != mayWrite.end() && g < globalCount; ++g) {
+            if (it->second[g]) defs[g] = nullptr;
+        }
+        return true;
+    }
+
+    case STMT_SWITCH:
+        buildSwitch(s);
+        return true;
+
+    case STMT_BREAK:
+        return false;
+
+    default:
+        return true;
+    }
+}
+
+// Ветвь начинается переходом из switch и, если предыдущая ветвь дошла до конца, провалом
+// из неё; после switch сходятся break, конец последней ветви и обход (нет default)
+void SsaFunction::buildSwitch(StmtNode* s) {
+    SsaValue* selector = buildExpr(s->value);
+    SsaValue* sw = append(newValue(SSA_SWITCH, s->value->type));
+    sw->operands.push_back(selector);
+    SsaBlock* head = cur;
+    Defs start = defs;
+
+    vector<pair<SsaBlock*, Defs>> toJoin;
+    bool hasDefault = false;
+    for (CaseNode* c : s->cases) {
+        if (c->isDefault) hasDefault = true;
+    }
+    if (!hasDefault) toJoin.push_back(make_pair(head, start));
+
+    bool falls = false;
+    for (CaseNode* c : s->cases) {
+        vector<pair<SsaBlock*, Defs>> incoming;
+        incoming.push_back(make_pair(head, start));
+        if (falls) incoming.push_back(make_pair(cur, defs));
+        enter(newBlock(), incoming);
+        falls = buildList(c->body);
+        if (!falls) toJoin.push_back(make_pair(cur, defs));
+    }
+    if (falls) toJoin.push_back(make_pair(cur, defs));
+    enter(newBlock(), toJoin);
+}
+
+// Начало блока b: значения переменных, пришедшие по всем путям; где они различаются — phi
+void SsaFunction::enter(SsaBlock* b, const vector<pair<SsaBlock*, Defs>>& incoming) {
+    for (const auto& in : incoming) {
+        b->preds.push_back(in.first);
+        in.first->succs.push_back(b);
+    }
+    cur = b;
+    defs = incoming[0].second;
+    for (size_t k = 0; k < defs.size(); ++k) {
+        bool same = true;
+        bool known = defs[k] != nullptr;
+        for (const auto& in : incoming) {
+            if (in.second[k] != defs[k]) same = false;
+            if (!in.second[k]) known = false;
+        }
+        if (same) continue;
+        if (!known) {
+            // Глобальная переменная будет прочитана заново, локальная может быть не присвоена
+            defs[k] = nullptr;
+            continue;
+        }
+        SsaValue* phi = append(newValue(SSA_PHI, defs[k]->type));
+        for (const auto& in : incoming) phi->operands.push_back(in.second[k]);
+        defs[k] = phi;
+    }
+}
+
+SsaValue* SsaFunction::buildExpr(ExprNode*& e) {
+    int pre = preorder++;
+    SsaValue* v = nullptr;
+    switch (e->kind) {
+    case EXPR_CONST:
+        v = append(newValue(SSA_CONST, e->type));
+        v->konst = e->value.v;
+        break;
+    case EXPR_VAR:
+        v = read(e);
+        break;
+    case EXPR_NEG:
+        v = newValue(SSA_NEG, e->type);
+        v->operands.push_back(buildExpr(e->left));
+        append(v);
+        break;
+    case EXPR_CAST:
+        v = converted(buildExpr(e->left), e->left->type, e->type, e->fits);
+        break;
+    case EXPR_BINARY:
+        v = newValue(SSA_BINARY, e->type);
+        v->op = e->op;
+        v->operands.push_back(buildExpr(e->left));
+        v->operands.push_back(buildExpr(e->right));
+        append(v);
+        break;
+    }
+
+    SsaUse use;
+    use.expr = e;
+    use.ref = &e;
+    use.value = v;
+    use.block = cur;
+    use.order = order;
+    use.pre = pre;
+    use.stmt = curStmt;
+    use.list = curList;
+    exprUses.push_back(use);
+    return v;
+}
+
+SsaValue* SsaFunction::read(const ExprNode* e) {
+    SsaValue*& def = defs[cellOf(e->slot)];
+    if (!def) {
+        def = append(newValue(e->slot.global ? SSA_LOAD : SSA_UNDEF, e->type));
+        def->index = e->slot.index;
+    }
+    return def;
+}
+
+// Значение после приведения к типу to: расширение и сужение, которое ничего не обрезает
+// (RangeAnalysis), значение не меняют
+SsaValue* SsaFunction::converted(SsaValue* v, DATA_TYPE from, DATA_TYPE to, bool fits) {
+    if (!isNarrowing(from, to) || fits) return v;
+    SsaValue* cast = newValue(SSA_CAST, to);
+    cast->operands.push_back(v);
+    return append(cast);
+}
+
+// Граф ацикличен, а предшественники созданы раньше блока: один проход в порядке создания
+void SsaFunction::computeDominators() {
+    for (SsaBlock* b : blocks) {
+        if (b->preds.empty()) continue;
+        SsaBlock* dom = b->preds[0];
+        for (SsaBlock* p : b->preds) {
+            SsaBlock* x = dom;
+            SsaBlock* y = p;
+            while (x != y) {
+                while (x->id > y->id) x = x->idom;
+                while (y->id > x->id) y = y->idom;
+            }
+            dom = x;
+        }
+        b->idom = dom;
+    }
+}
+
+// Ключ операции для таблицы значений: вид, тип и представители операндов
+static string valueKey(const SsaValue* v) {
+    string key = to_string(v->kind) + ":" + to_string(v->type) + ":" + to_string(v->op);
+    if (v->kind == SSA_CONST) return "c:" + to_string(v->konst);
+    if (v->kind == SSA_PHI) key += ":b" + to_string(v->block->id);
+
+    vector<int> ids;
+    for (const SsaValue* a : v->operands) ids.push_back(a->leader->id);
+    bool commutative = v->kind == SSA_BINARY
+        && (v->op == BOP_ADD || v->op == BOP_MUL || v->op == BOP_EQ || v->op == BOP_NE);
+    if (commutative) sort(ids.begin(), ids.end());
+    for (int id : ids) key += ":" + to_string(id);
+    return key;
+}
+
+// Обход дерева доминаторов: значение из доминирующего блока доступно во всех подчинённых.
+// Таблица общая; при выходе из поддерева добавленные в нём ключи удаляются
+void SsaFunction::numberValues() {
+    vector<vector<SsaBlock*>> children(blocks.size());
+    for (SsaBlock* b : blocks) {
+        if (b->idom) children[b->idom->id].push_back(b);
+    }
+
+    unordered_map<string, SsaValue*> table;
+    vector<pair<SsaBlock*, size_t>> stack; // блок и число его обработанных подчинённых
+    vector<vector<string>> added(blocks.size());
+    if (blocks.empty()) return;
+    stack.push_back(make_pair(blocks[0], size_t(0)));
+    while (!stack.empty()) {
+        SsaBlock* b = stack.back().first;
+        size_t& next = stack.back().second;
+        if (next == 0) {
+            for (SsaValue* v : b->code) {
+                v->leader = v;
+                bool pure = v->kind == SSA_CONST || v->kind == SSA_NEG || v->kind == SSA_CAST
+                    || v->kind == SSA_BINARY || v->kind == SSA_PHI;
+                if (!pure) continue;
+                if (v->kind == SSA_PHI) {
+                    // phi из одного и того же значения — это значение
+                    SsaValue* first = v->operands[0]->leader;
+                    bool same = true;
+                    for (SsaValue* a : v->operands) {
+                        if (a->leader != first) same = false;
+                    }
+                    if (same) {
+                        v->leader = first;
+                        continue;
+                    }
+                }
+                string key = valueKey(v);
+                auto it = table.find(key);
+                if (it != table.end()) {
+                    v->leader = it->second;
+                    continue;
+                }
+                table[key] = v;
+                added[b->id].push_back(key);
+            }
+        }
+        if (next < children[b->id].size()) {
+            SsaBlock* child = children[b->id][next++];
+            stack.push_back(make_pair(child, size_t(0)));
+            continue;
+        }
+        for (const string& key : added[b->id]) table.erase(key);
+        stack.pop_back();
+    }
+}
+
+void SsaFunction::print(ostream& out, const ProgramNode* program) const {
+    auto name = [](const SsaValue* v) { return "v" + to_string(v->id); };
+    auto globalName = [program](int index) {
+        return index >= 0 && static_cast<size_t>(index) < program->globals.size()
+            ? program->globals[index]->name : "g" + to_string(index);
+    };
+
+    out << func->name << "(";
+    for (size_t i = 0; i < func->paramTypes.size(); ++i) {
+        out << (i ? ", " : "") << typeWord(func->paramTypes[i]) << " " << func->paramNames[i];
+    }
+    out << ")" << endl;
+
+    for (const SsaBlock* b : blocks) {
+        out << "b" << b->id << ":";
+        if (!b->preds.empty()) {
+            out << " ; из";
+            for (const SsaBlock* p : b->preds) out << " b" << p->id;
+        }
+        out << endl;
+        for (const SsaValue* v : b->code) {
+            out << "  ";
+            switch (v->kind) {
+            case SSA_PARAM: out << name(v) << " = " << typeWord(v->type) << " param " << func->paramNames[v->index]; break;
+            case SSA_UNDEF: out << name(v) << " = " << typeWord(v->type) << " undef %" << v->index; break;
+            case SSA_CONST: out << name(v) << " = " << typeWord(v->type) << " " << v->konst; break;
+            case SSA_LOAD: out << name(v) << " = " << typeWord(v->type) << " load " << globalName(v->index); break;
+            case SSA_NEG: out << name(v) << " = " << typeWord(v->type) << " -" << name(v->operands[0]); break;
+            case SSA_CAST: out << name(v) << " = " << typeWord(v->type) << " (" << name(v->operands[0]) << ")"; break;
+            case SSA_BINARY:
+                out << name(v) << " = " << typeWord(v->type) << " " << name(v->operands[0]) << " " << binOpName(v->op)
+                    << " " << name(v->operands[1]);
+                break;
+            case SSA_PHI:
+                out << name(v) << " = " << typeWord(v->type) << " phi(";
+                for (size_t i = 0; i < v->operands.size(); ++i) {
+                    out << (i ? ", " : "") << "b" << v->block->preds[i]->id << ": " << name(v->operands[i]);
+                }
+                out << ")";
+                break;
+            case SSA_STORE: out << "store " << globalName(v->index) << " = " << name(v->operands[0]); break;
+            case SSA_CALL:
+                out << "call " << v->callee->name << "(";
+                for (size_t i = 0; i < v->operands.size(); ++i) out << (i ? ", " : "") << name(v->operands[i]);
+                out << ")";
+                break;
+            case SSA_SWITCH:
+                out << "switch " << name(v->operands[0]) << " ->";
+                for (const SsaBlock* s : b->succs) out << " b" << s->id;
+                break;
+            }
+            if (v->leader != v) out << " ; = " << name(v->leader);
+            out << endl;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+﻿#pragma once
+#include "Ast.h"
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Промежуточное представление функции в форме SSA (строится по проверенной программе, AST).
+// Каждое значение определяется один раз; локальные переменные — не ячейки, а текущие значения:
+// присваивание лишь меняет значение переменной в точке программы, чтение берёт его.
+// Глобальные переменные — память: чтение, перед которым значение неизвестно, становится
+// инструкцией load, после неё (и после store) значение известно до вызова, который может её
+// изменить. Поэтому повторные чтения между присваиваниями загрузок не дают.
+// Блоки — участки без ветвлений: switch завершает блок, ветви и продолжение после switch
+// начинают новые; циклов в языке нет, поэтому граф ацикличен, а блоки создаются в
+// топологическом порядке. Где к блоку сходятся разные значения переменной — phi.
+// numberValues — нумерация значений по дереву доминаторов (GVN): одинаковые операции над
+// одинаковыми значениями получают общего представителя (SsaValue::leader)
+
+// Виды значений и инструкций
+enum SSA_KIND {
+    SSA_PARAM, // параметр index
+    SSA_UNDEF, // локальная переменная index, значение которой неизвестно (до присваивания или после слияния)
+    SSA_CONST, // константа konst
+    SSA_LOAD, // чтение глобальной переменной index из памяти
+    SSA_NEG, // -a
+    SSA_CAST, // сужение a до type (обрезка)
+    SSA_BINARY, // a op b
+    SSA_PHI, // значение по пришедшему пути: operands[i] — из preds[i]
+    SSA_STORE, // globals[index] = a
+    SSA_CALL, // вызов callee(operands...)
+    SSA_SWITCH // переход по значению a в succs
+};
+
+struct SsaBlock;
+
+struct SsaValue {
+    int id; // номер: vN в текстовом виде
+    SSA_KIND kind;
+    DATA_TYPE type;
+    BIN_OP op; // SSA_BINARY
+    int index; // SSA_PARAM / SSA_UNDEF: ячейка кадра; SSA_LOAD / SSA_STORE: глобальная переменная
+    int64_t konst; // SSA_CONST
+    FuncNode* callee; // SSA_CALL
+    std::vector<SsaValue*> operands;
+    SsaBlock* block;
+    SsaValue* leader; // представитель класса равных значений (после numberValues)
+
+    SsaValue(int i, SSA_KIND k, DATA_TYPE t)
+        : id(i), kind(k), type(t), op(BOP_ADD), index(-1), konst(0), callee(nullptr), block(nullptr), leader(this) {}
+};
+
+struct SsaBlock {
+    int id;
+    std::vector<SsaValue*> code; // phi, затем инструкции в порядке исполнения
+    std::vector<SsaBlock*> preds;
+    std::vector<SsaBlock*> succs;
+    SsaBlock* idom; // ближайший доминатор (у входного блока — nullptr)
+
+    explicit SsaBlock(int i) : id(i), idom(nullptr) {}
+    bool dominates(const SsaBlock* other) const;
+};
+
+// Вычисление выражения AST в SSA: значение, блок и номер оператора в порядке исполнения
+// (операторы одного блока исполняются в порядке номеров), сам оператор и список, в котором он стоит
+struct SsaUse {
+    ExprNode* expr;
+    ExprNode** ref; // место указателя на expr в родительском узле или операторе
+    SsaValue* value;
+    SsaBlock* block;
+    int order;
+    int pre; // номер узла при обходе выражений сверху вниз (внешний узел раньше операндов)
+    StmtNode* stmt;
+    std::vector<StmtNode*>* list;
+};
+
+class SsaFunction {
+public:
+    // mayWrite[f] — глобальные переменные, которые может изменить вызов f (с учётом вызываемых)
+    SsaFunction(FuncNode* func, size_t globalCount, const std::unordered_map<FuncNode*, std::vector<char>>& mayWrite);
+    ~SsaFunction();
+    SsaFunction(const SsaFunction&) = delete;
+    SsaFunction& operator=(const SsaFunction&) = delete;
+
+    void numberValues();
+    void print(std::ostream& out, const ProgramNode* program) const;
+
+    FuncNode* function() const { return func; }
+    const std::vector<SsaUse>& uses() const { return exprUses; } // в порядке вычисления (операнды раньше)
+
+private:
+    // Значения переменных в точке программы: сначала глобальные (VarSlot::index), затем ячейки
+    // кадра; nullptr — глобальная переменная не прочитана после последнего изменения /
+    // локальная не присвоена
+    typedef std::vector<SsaValue*> Defs;
+
+    FuncNode* func;
+    size_t globalCount;
+    const std::unordered_map<FuncNode*, std::vector<char>>& mayWrite;
+    std::vector<SsaBlock*> blocks;
+    std::vector<SsaValue*> values;
+    std::vector<SsaUse> exprUses;
+
+    SsaBlock* cur; // блок, в который добавляются инструкции (nullptr — код недостижим)
+    Defs defs;
+    int order;
+    int preorder;
+    StmtNode* curStmt;
+    std::vector<StmtNode*>* curList;
+
+    SsaBlock* newBlock();
+    SsaValue* newValue(SSA_KIND kind, DATA_TYPE type);
+    SsaValue* append(SsaValue* v);
+    size_t cellOf(const VarSlot& slot) const { return slot.global ? slot.index : globalCount + slot.index; }
+
+    bool buildList(std::vector<StmtNode*>& list);
+    bool buildStmt(StmtNode* s);
+    void buildSwitch(StmtNode* s);
+    void enter(SsaBlock* b, const std::vector<std::pair<SsaBlock*, Defs>>& incoming);
+    SsaValue* buildExpr(ExprNode*& e);
+    SsaValue* read(const ExprNode* e);
+    SsaValue* converted(SsaValue* v, DATA_TYPE from, DATA_TYPE to, bool fits);
+    void computeDominators();
+};
@@ -0,0 +1,48 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Таблица переходов оператора switch: по значению селектора — цель перехода.
+// Строится один раз при разборе (Diagram::buildSwitchTable). Для плотных меток это массив,
+// индексируемый значением (O(1)), для разреженных — отсортированные метки с двоичным
+// поиском (O(log n)). Цели — номера ветвей в AST; компилятор байт-кода заменяет их адресами
+struct SwitchTable {
+    bool dense;
+    long long minLabel; // dense: значение, соответствующее jump[0]
+    vector<int> jump; // dense: цель для значения minLabel + i (пропуски — defaultTarget)
+    vector<long long> labels; // sparse: метки по возрастанию
+    vector<int> targets; // sparse: цель для labels[i]
+    int defaultTarget; // цель при отсутствии совпадения (default или выход из switch)
+
+    SwitchTable() : dense(true), minLabel(0), defaultTarget(0) {}
+
+    int find(long long value) const {
+        if (dense) {
+            // Беззнаковая разность: значения меньше minLabel дают индекс за концом массива
+            uint64_t i = static_cast<uint64_t>(value) - static_cast<uint64_t>(minLabel);
+            return i < jump.size() ? jump[i] : defaultTarget;
+        }
+        auto it = lower_bound(labels.begin(), labels.end(), value);
+        return (it != labels.end() && *it == value) ? targets[it - labels.begin()] : defaultTarget;
+    }
+
+    // Замена каждой цели t на map[t]
+    void remap(const vector<int>& map) {
+        for (int& t : jump) t = map[t];
+        for (int& t : targets) t = map[t];
+        defaultTarget = map[defaultTarget];
+    }
+
+    // Селектор известен при трансляции: таблица без меток, всегда дающая target
+    void resolve(int target) {
+        dense = true;
+        minLabel = 0;
+        jump.clear();
+        labels.clear();
+        targets.clear();
+        defaultTarget = target;
+    }
+};
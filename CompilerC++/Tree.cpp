@@ -12,12 +12,15 @@ bool Tree::interpretationEnabled = true; // По умолчанию включе
 bool Tree::debug = true; // По умолчанию включен подробный вывод
 Tree* Tree::currentFunction = nullptr; 
 int Tree::recursionDepth = 0;
+int Tree::maxRecursionDepth = Tree::DEFAULT_MAX_RECURSION_DEPTH;
+int Tree::peakDepth = 0;
 
-void Tree::enterFunctionCall(const string& funcName, int line, int col) {
+void Tree::enterFunctionCall(const string& funcName, SrcLoc loc) {
     recursionDepth++;
-    if (recursionDepth > MAX_RECURSION_DEPTH) {
-        interpError("превышение глубины рекурсии", funcName, line, col);
+    if (recursionDepth > maxRecursionDepth) {
+        interpError("превышение глубины рекурсии", funcName, loc);
     }
+    if (recursionDepth > peakDepth) peakDepth = recursionDepth;
 }
 
 void Tree::exitFunctionCall() {
@@ -25,7 +28,7 @@ void Tree::exitFunctionCall() {
 }
 
 void Tree::printTypeConversionWarning(DATA_TYPE from, DATA_TYPE to, const string& context,
-    const string& expression, int line, int col) {
+    const string& expression, SrcLoc loc) {
 
     // Выводим только если включен debug режим
     if (!debug || !interpretationEnabled) return;
@@ -54,79 +57,143 @@ void Tree::printTypeConversionWarning(DATA_TYPE from, DATA_TYPE to, const string
     if (!expression.empty()) {
         std::cerr << " выражения " << expression;
     }
-    std::cerr << std::endl << "(строка " << line << ":" << col << ")" << std::endl;
+    auto lc = loc.lineCol();
+    std::cerr << std::endl << "(строка " << lc.first << ":" << lc.second << ")" << std::endl;
+}
+
+// Предупреждение об обрезке значения при присваивании (выводится независимо от debug)
+void Tree::printTruncationWarning(long long value, DATA_TYPE to, SrcLoc loc) {
+    std::cerr << "Предупреждение: значение " << value
+        << " обрезается при преобразовании к "
+        << (to == TYPE_SHORT_INT ? "short" : "int");
+    auto lc = loc.lineCol();
+    std::cerr << std::endl << "(строка " << lc.first << ":" << lc.second << ")" << std::endl;
 }
 
 // печать семантической ошибки
-void Tree::semError(const string& msg, const string& id, int line, int col) {
+void Tree::semError(const string& msg, const string& id, SrcLoc loc) {
     std::cerr << "Семантическая ошибка: " << msg;
     if (!id.empty()) std::cerr << " (около '" << id << "')";
-    std::cerr << std::endl << "(строка " << line << ":" << col << ")" << std::endl;
+    auto lc = loc.lineCol();
+    std::cerr << std::endl << "(строка " << lc.first << ":" << lc.second << ")" << std::endl;
     throw std::runtime_error("Семантическая ошибка");
 }
 
-void Tree::interpError(const string& msg, const string& id, int line, int col) {
+void Tree::interpError(const string& msg, const string& id, SrcLoc loc) {
     std::cerr << "Ошибка при интерпретации: " << msg;
     if (!id.empty()) std::cerr << " (около '" << id << "')";
-    std::cerr << std::endl << "(строка " << line << ":" << col << ")" << std::endl;
+    auto lc = loc.lineCol();
+    std::cerr << std::endl << "(строка " << lc.first << ":" << lc.second << ")" << std::endl;
     throw std::runtime_error("Ошибка при интерпретации");
 }
 
 // Конструктор
-Tree::Tree(SemNode* node, Tree* up) : n(node), Up(up), Left(nullptr), Right(nullptr) {
+Tree::Tree(SemNode* node, Tree* up) : n(node), Up(up), Left(nullptr), Right(nullptr), Tail(nullptr), index(nullptr) {
     if (Root == nullptr) {
         Root = this;
         Cur = this;
     }
 }
 
-// Деструктор: рекурсивно удаляем поддерево
+// Деструктор: удаляем поддерево. Цепочки соседей обходим циклом, а не рекурсией,
+// чтобы области с большим числом описаний не переполняли стек
 Tree::~Tree() {
     if (n) delete n;
-    if (Left) { delete Left; Left = nullptr; }
-    if (Right) { delete Right; Right = nullptr; }
+    if (index) { delete index; index = nullptr; }
+    Tree* p = Left;
+    while (p) {
+        Tree* next = p->Right;
+        p->Right = nullptr;
+        delete p;
+        p = next;
+    }
+    Left = nullptr;
+    p = Right;
+    while (p) {
+        Tree* next = p->Right;
+        p->Right = nullptr;
+        delete p;
+        p = next;
+    }
+    Right = nullptr;
+}
+
+// Таблица интернированных имён (узлы unordered_set не перемещаются при рехешировании)
+static unordered_set<string>& internTable() {
+    static unordered_set<string> names;
+    return names;
+}
+
+const string* Tree::intern(const string& id) {
+    return &*internTable().insert(id).first;
 }
 
-// Вставка первого дочернего элемента (левая ссылка)
-void Tree::setLeft(SemNode* Data) {
+const string* Tree::findName(const string& id) {
+    unordered_set<string>& names = internTable();
+    auto it = names.find(id);
+    return it == names.end() ? nullptr : &*it;
+}
+
+// заносит именованный дочерний элемент в хеш-индекс узла (первое вхождение имени сохраняется)
+void Tree::indexChild(Tree* child) {
+    if (child->n == nullptr || child->n->id.empty()) return;
+    if (index == nullptr) index = new unordered_map<const string*, Tree*>();
+    index->emplace(intern(child->n->id), child);
+}
+
+// Вставка дочернего элемента в конец списка потомков (левая ссылка)
+Tree* Tree::setLeft(SemNode* Data) {
     Tree* newNode = new Tree(Data, this);
     if (this->Left == nullptr) {
         this->Left = newNode;
     }
     else {
-        Tree* p = this->Left;
-        while (p->Right) p = p->Right;
-        p->Right = newNode;
-        newNode->Up = this;
+        this->Tail->Right = newNode;
     }
+    this->Tail = newNode;
+    indexChild(newNode);
+    return newNode;
 }
 
 // Вставка правого соседа
-void Tree::setRight(SemNode* Data) {
+Tree* Tree::setRight(SemNode* Data) {
     Tree* newNode = new Tree(Data, this->Up);
     newNode->Right = this->Right;
     this->Right = newNode;
     newNode->Up = this->Up;
+
+    Tree* parent = this->Up;
+    if (parent) {
+        if (parent->Tail == this) parent->Tail = newNode;
+        if (newNode->n && !newNode->n->id.empty()) {
+            parent->indexChild(newNode);
+            // если одноимённый узел стоит дальше по списку, первым теперь стал новый
+            Tree* existing = (*parent->index)[intern(newNode->n->id)];
+            for (Tree* p = newNode->Right; p != nullptr && existing != newNode; p = p->Right) {
+                if (p == existing) (*parent->index)[intern(newNode->n->id)] = newNode;
+            }
+        }
+    }
+    return newNode;
 }
 
 // ищет имя id среди дочерних элементов узла
 Tree* Tree::findUpOneLevel(Tree* From, const string& id) {
-    if (From == nullptr) return nullptr;
-    Tree* p = From->Left;
-    while (p != nullptr) {
-        if (p->n && p->n->id == id) return p;
-        p = p->Right;
-    }
-    return nullptr;
+    if (From == nullptr || From->index == nullptr) return nullptr;
+    const string* key = findName(id);
+    if (key == nullptr) return nullptr;
+    auto it = From->index->find(key);
+    return it == From->index->end() ? nullptr : it->second;
 }
 
 // поиск с подъёмом по областям (для блочной видимости)
 Tree* Tree::findUp(Tree* From, const string& id) {
-    Tree* cur = From;
-    while (cur != nullptr) {
-        Tree* found = findUpOneLevel(cur, id);
-        if (found) return found;
-        cur = cur->Up;
+    const string* key = findName(id);
+    if (key == nullptr) return nullptr;
+    for (Tree* cur = From; cur != nullptr; cur = cur->Up) {
+        if (cur->index == nullptr) continue;
+        auto it = cur->index->find(key);
+        if (it != cur->index->end()) return it->second;
     }
     return nullptr;
 }
@@ -137,13 +204,13 @@ bool Tree::dupControl(Tree* Addr, const string& a) {
 }
 
 // добавляет идентификатор в текущую область Cur
-Tree* Tree::semInclude(const string& a, DATA_TYPE t, int line, int col) {
+Tree* Tree::semInclude(const string& a, DATA_TYPE t, SrcLoc loc) {
     if (Cur == nullptr) {
-        semError("внутренняя ошибка: текущая область не установлена при SemInclude", a, line, col);
+        semError("внутренняя ошибка: текущая область не установлена при SemInclude", a, loc);
     }
 
     if (dupControl(Cur, a)) {
-        semError("повторное описание идентификатора", a, line, col);
+        semError("повторное описание идентификатора", a, loc);
     }
 
     SemNode* node = new SemNode();
@@ -151,20 +218,16 @@ Tree* Tree::semInclude(const string& a, DATA_TYPE t, int line, int col) {
     node->DataType = t;
     node->hasValue = false;
     node->Param = 0;
-    node->line = line;
-    node->col = col;
+    node->loc = loc;
 
     if (t == TYPE_FUNCT) {
-        Cur->setLeft(node);
-        Tree* funcNode = Cur->Left;
-        while (funcNode->Right) funcNode = funcNode->Right;
+        Tree* funcNode = Cur->setLeft(node);
 
         SemNode* emptyNode = new SemNode();
         emptyNode->id = "";
         emptyNode->DataType = TYPE_SCOPE;
         emptyNode->Param = 0;
-        emptyNode->line = line;
-        emptyNode->col = col;
+        emptyNode->loc = loc;
 
         // ВАЖНО: scope должен быть child (Left) функции, а не её "правым соседом".
         funcNode->setLeft(emptyNode);
@@ -173,17 +236,13 @@ Tree* Tree::semInclude(const string& a, DATA_TYPE t, int line, int col) {
         return funcNode;
     }
     else {
-        Cur->setLeft(node);
-        Tree* added = Cur->Left;
-        while (added->Right) added = added->Right;
-
-        return added;
+        return Cur->setLeft(node);
     }
 }
 
 // занесение константы со значением
-Tree* Tree::semIncludeConstant(const string& a, DATA_TYPE t, const string& value, int line, int col) {
-    Tree* node = semInclude(a, t, line, col);
+Tree* Tree::semIncludeConstant(const string& a, DATA_TYPE t, const string& value, SrcLoc loc) {
+    Tree* node = semInclude(a, t, loc);
     if (node && node->n) {
         node->n->hasValue = true;
         // Преобразование строкового значения в соответствующий тип
@@ -205,7 +264,7 @@ Tree* Tree::semIncludeConstant(const string& a, DATA_TYPE t, const string& value
             }
         }
         catch (const std::exception& e) {
-            semError("неверный формат константы: " + string(e.what()), a, line, col);
+            semError("неверный формат константы: " + string(e.what()), a, loc);
         }
     }
     return node;
@@ -226,46 +285,46 @@ void Tree::semSetParamTypes(Tree* Addr, const std::vector<DATA_TYPE>& types) {
     Addr->n->Param = static_cast<int>(types.size());
 }
 
-void Tree::semControlParamTypes(Tree* Addr, const std::vector<DATA_TYPE>& argTypes, int line, int col) {
+void Tree::semControlParamTypes(Tree* Addr, const std::vector<DATA_TYPE>& argTypes, SrcLoc loc) {
     if (Addr == nullptr || Addr->n == nullptr) {
         semError("SemControlParamTypes: неверный адрес функции");
     }
     const std::vector<DATA_TYPE>& formal = Addr->n->ParamTypes;
     if (formal.size() != argTypes.size()) {
-        semError("неверное число параметров у функции", Addr->n->id, line, col);
+        semError("неверное число параметров у функции", Addr->n->id, loc);
     }
     for (size_t i = 0; i < formal.size(); ++i) {
         bool formalIsInt = (formal[i] == TYPE_INT || formal[i] == TYPE_SHORT_INT || formal[i] == TYPE_LONG_INT);
         bool argIsInt = (argTypes[i] == TYPE_INT || argTypes[i] == TYPE_SHORT_INT || argTypes[i] == TYPE_LONG_INT);
         if (formalIsInt && argIsInt) continue;
         if (formal[i] == argTypes[i]) continue;
-        semError("несоответствие типов параметров у функции", Addr->n->id, line, col);
+        semError("несоответствие типов параметров у функции", Addr->n->id, loc);
     }
 }
 
-Tree* Tree::semGetVar(const string& a, int line, int col) {
+Tree* Tree::semGetVar(const string& a, SrcLoc loc) {
     Tree* v = findUp(Cur, a);
     if (v == nullptr) {
-        semError("отсутствует описание идентификатора", a, line, col);
+        semError("отсутствует описание идентификатора", a, loc);
     }
     if (v->n->DataType == TYPE_FUNCT) {
-        semError("неверное использование - идентификатор является функцией", a, line, col);
+        semError("неверное использование - идентификатор является функцией", a, loc);
     }
     return v;
 }
 
-Tree* Tree::semGetFunct(const string& a, int line, int col) {
+Tree* Tree::semGetFunct(const string& a, SrcLoc loc) {
     Tree* v = findUp(Cur, a);
     if (v == nullptr) {
-        semError("отсутствует описание функции", a, line, col);
+        semError("отсутствует описание функции", a, loc);
     }
     if (v->n->DataType != TYPE_FUNCT) {
-        semError("идентификатор не является функцией", a, line, col);
+        semError("идентификатор не является функцией", a, loc);
     }
     return v;
 }
 
-Tree* Tree::semEnterBlock(int line, int col) {
+Tree* Tree::semEnterBlock(SrcLoc loc) {
     if (Cur == nullptr) {
         semError("SemEnterBlock: текущая область не установлена");
     }
@@ -273,12 +332,9 @@ Tree* Tree::semEnterBlock(int line, int col) {
     sn->id = "";
     sn->DataType = TYPE_SCOPE;
     sn->Param = 0;
-    sn->line = line;
-    sn->col = col;
+    sn->loc = loc;
 
-    setLeft(sn);
-    Tree* created = Cur->Left;
-    while (created->Right) created = created->Right;
+    Tree* created = Cur->setLeft(sn);
 
     Cur = created;
     return created;
@@ -294,84 +350,105 @@ void Tree::semExitBlock() {
     Cur = Cur->Up;
 }
 
-void Tree::setVarValue(const string& name, const SemNode& value, int line, int col) {
-    Tree* varNode = Cur->semGetVar(name, line, col);
+void Tree::setVarValue(const string& name, const Value& value, SrcLoc loc) {
+    Tree* varNode = Cur->semGetVar(name, loc);
+    Value cell = valueOf(*varNode->n);
+    storeValue(cell, name, value, loc);
+    assignValue(*varNode->n, cell);
+}
 
+void Tree::storeValue(Value& target, const string& name, const Value& value, SrcLoc loc) {
     if (!value.hasValue) {
-        interpError("попытка присвоить NULL", name, line, col);
+        interpError("попытка присвоить NULL", name, loc);
     }
 
     // Проверка совместимости типов
-    if (!canImplicitCast(value.DataType, varNode->n->DataType)) {
-        semError("несовместимые типы при присваивании", name, line, col);
+    if (!canImplicitCast(value.type, target.type)) {
+        semError("несовместимые типы при присваивании", name, loc);
     }
 
     // Проверяем обрезку значений для ВСЕХ типов (как было)
     bool needsTruncationWarning = false;
-    long long originalValue = 0;
-    switch (value.DataType) {
-    case TYPE_SHORT_INT: originalValue = value.Value.v_int16; break;
-    case TYPE_INT:       originalValue = value.Value.v_int32; break;
-    case TYPE_LONG_INT:  originalValue = value.Value.v_int64; break;
-    default: break;
-    }
+    long long originalValue = value.type == TYPE_BOOL ? 0 : value.v;
 
-    if (varNode->n->DataType == TYPE_SHORT_INT) {
+    if (target.type == TYPE_SHORT_INT) {
         if (originalValue < -32768 || originalValue > 32767) needsTruncationWarning = true;
     }
-    else if (varNode->n->DataType == TYPE_INT) {
+    else if (target.type == TYPE_INT) {
         if (originalValue < -2147483648LL || originalValue > 2147483647LL) needsTruncationWarning = true;
     }
 
     if (needsTruncationWarning) {
-        std::cerr << "Предупреждение: значение " << originalValue
-            << " обрезается при преобразовании к "
-            << (varNode->n->DataType == TYPE_SHORT_INT ? "short" : "int");
-        std::cerr << std::endl << "(строка " << line << ":" << col << ")" << std::endl;
+        printTruncationWarning(originalValue, target.type, loc);
     }
-    else if (value.DataType != varNode->n->DataType && debug) {
-        printTypeConversionWarning(value.DataType, varNode->n->DataType,
-            "присваивании", name + " = ...", line, col);
+    else if (value.type != target.type && debug) {
+        printTypeConversionWarning(value.type, target.type,
+            "присваивании", name + " = ...", loc);
     }
 
     // Выполняем приведение значения к типу переменной
-    SemNode converted = castToType(value, varNode->n->DataType, line, col);
+    Value converted = castToType(value, target.type, loc);
 
     // Если интерпретация выключена — мы в семантическом режиме: не меняем runtime-значение в дереве,
     // но пометим переменную как инициализированную (чтобы дальнейшая семантика в том же блоке работала)
     if (!Tree::isInterpretationEnabled()) {
         // Пометка "инициализирована" для семантики
-        varNode->n->hasValue = true;
+        target.hasValue = true;
         return;
     }
 
     // Нормальное (runtime) присваивание — только если интерпретация включена
-    varNode->n->Value = converted.Value;
-    varNode->n->hasValue = true;
+    target.v = converted.v;
+    target.hasValue = true;
 
-    printAssignment(name, converted, line, col);
+    printAssignment(name, converted, loc);
 }
 
-SemNode Tree::getVarValue(const string& name, int line, int col) {
-    Tree* varNode = Cur->semGetVar(name, line, col); // Используем Cur->
+Value Tree::getVarValue(const string& name, SrcLoc loc) {
+    Tree* varNode = Cur->semGetVar(name, loc); // Используем Cur->
     if (!varNode->n->hasValue) {
-        semError("использование неинициализированной переменной", name, line, col);
+        semError("использование неинициализированной переменной", name, loc);
     }
-    return *(varNode->n);
+    return valueOf(*varNode->n);
 }
 
-void Tree::executeFunctionCall(const string& funcName, const std::vector<SemNode>& args, int line, int col) {
-    Tree* funcNode = Cur->semGetFunct(funcName, line, col);
+Value Tree::valueOf(const SemNode& node) {
+    Value value;
+    value.type = node.DataType;
+    value.hasValue = node.hasValue;
+    switch (node.DataType) {
+    case TYPE_SHORT_INT: value.v = node.Value.v_int16; break;
+    case TYPE_INT: value.v = node.Value.v_int32; break;
+    case TYPE_LONG_INT: value.v = node.Value.v_int64; break;
+    case TYPE_BOOL: value.v = node.Value.v_bool ? 1 : 0; break;
+    default: break;
+    }
+    return value;
+}
+
+void Tree::assignValue(SemNode& node, const Value& value) {
+    node.hasValue = value.hasValue;
+    switch (node.DataType) {
+    case TYPE_SHORT_INT: node.Value.v_int16 = static_cast<int16_t>(value.v); break;
+    case TYPE_INT: node.Value.v_int32 = static_cast<int32_t>(value.v); break;
+    case TYPE_LONG_INT: node.Value.v_int64 = value.v; break;
+    case TYPE_BOOL: node.Value.v_bool = value.v != 0; break;
+    default: break;
+    }
+}
+
+void Tree::executeFunctionCall(const string& funcName, const std::vector<Value>& args, SrcLoc loc) {
+    Tree* funcNode = Cur->semGetFunct(funcName, loc);
 
     std::vector<DATA_TYPE> argTypes;
     for (const auto& arg : args) {
-        argTypes.push_back(arg.DataType);
+        argTypes.push_back(arg.type);
     }
 
-    funcNode->semControlParamTypes(funcNode, argTypes, line, col);
+    funcNode->semControlParamTypes(funcNode, argTypes, loc);
 
     // Используем новый метод вывода
-    printFunctionCall(funcName, args, line, col);
+    printFunctionCall(funcName, args, loc);
 }
 
 // Определение максимального типа
@@ -389,222 +466,96 @@ bool Tree::canImplicitCast(DATA_TYPE from, DATA_TYPE to) {
     return (fromIsInt && toIsInt) || (from == TYPE_BOOL && to == TYPE_BOOL);
 }
 
-// Приведение типов
-SemNode Tree::castToType(const SemNode& value, DATA_TYPE targetType, int line, int col, bool showWarning) {
+// Приведение типов (значения хранятся знаково расширенными, поэтому приведение к целому типу —
+// это отсечение старших разрядов)
+Value Tree::castToType(const Value& value, DATA_TYPE targetType, SrcLoc loc, bool showWarning) {
     // Если типы уже совпадают, возвращаем без изменений
-    if (value.DataType == targetType) {
+    if (value.type == targetType) {
         return value;
     }
 
-    SemNode result;
-    result.DataType = targetType;
+    Value result;
+    result.type = targetType;
     result.hasValue = value.hasValue;
 
     if (!value.hasValue) return result;
 
-    // Получаем значение в long long для безопасного приведения
-    long long originalValue = 0;
-        switch (value.DataType) {
-        case TYPE_SHORT_INT: originalValue = value.Value.v_int16; break;
-        case TYPE_INT: originalValue = value.Value.v_int32; break;
-        case TYPE_LONG_INT: originalValue = value.Value.v_int64; break;
-        default: break;
-    }
+    long long originalValue = value.type == TYPE_BOOL ? 0 : value.v;
 
     // Выполняем приведение
     switch (targetType) {
     case TYPE_SHORT_INT:
-        result.Value.v_int16 = static_cast<int16_t>(originalValue);
-        break;
     case TYPE_INT:
-        result.Value.v_int32 = static_cast<int32_t>(originalValue);
-        break;
     case TYPE_LONG_INT:
-        result.Value.v_int64 = static_cast<int64_t>(originalValue);
+        result.v = truncateTo(targetType, originalValue);
         break;
     case TYPE_BOOL:
-        if (value.DataType == TYPE_BOOL) {
-            result.Value.v_bool = value.Value.v_bool;
-        }
-        else {
-            semError("недопустимое приведение целого типа к bool", "", line, col);
-        }
+        semError("недопустимое приведение целого типа к bool", "", loc);
         break;
     default:
-        semError("неизвестный тип для приведения", "", line, col);
+        semError("неизвестный тип для приведения", "", loc);
     }
 
     return result;
 }
-// Арифметические операции
-SemNode Tree::executeArithmeticOp(const SemNode& left, const SemNode& right, const string& op, int line, int col) {
-    if (!left.hasValue || !right.hasValue) {
-        semError("операция с неинициализированными значениями", "", line, col);
-    }
-
+// Арифметические операции (с переполнением по модулю разрядности типа результата)
+Value Tree::executeArithmeticOp(const Value& left, const Value& right, BIN_OP op, SrcLoc loc) {
     // Выводим предупреждение если операнды разных типов
-    if (left.DataType != right.DataType && debug) {
-        printTypeConversionWarning(left.DataType, right.DataType,
-            "арифметической операции", "", line, col);
+    if (left.type != right.type && debug) {
+        printTypeConversionWarning(left.type, right.type,
+            "арифметической операции", "", loc);
     }
 
-    DATA_TYPE resultType = getMaxType(left.DataType, right.DataType);
-    SemNode leftConv = castToType(left, resultType, line, col);
-    SemNode rightConv = castToType(right, resultType, line, col);
-
-    SemNode result;
-    result.DataType = resultType;
-    result.hasValue = true;
+    DATA_TYPE resultType = getMaxType(left.type, right.type);
+    Value result(resultType, 0);
 
     if (!interpretationEnabled) return result;
 
-    switch (resultType) {
-    case TYPE_SHORT_INT:
-        if (op == "+") result.Value.v_int16 = leftConv.Value.v_int16 + rightConv.Value.v_int16;
-        else if (op == "-") result.Value.v_int16 = leftConv.Value.v_int16 - rightConv.Value.v_int16;
-        else if (op == "*") result.Value.v_int16 = leftConv.Value.v_int16 * rightConv.Value.v_int16;
-        else if (op == "/") {
-            if (rightConv.Value.v_int16 == 0) interpError("деление на ноль", "", line, col);
-            result.Value.v_int16 = leftConv.Value.v_int16 / rightConv.Value.v_int16;
-        }
-        else if (op == "%") {
-            if (rightConv.Value.v_int16 == 0) interpError("деление на ноль", "", line, col);
-            result.Value.v_int16 = leftConv.Value.v_int16 % rightConv.Value.v_int16;
-        }
-        break;
-
-    case TYPE_INT:
-        if (op == "+") result.Value.v_int32 = leftConv.Value.v_int32 + rightConv.Value.v_int32;
-        else if (op == "-") result.Value.v_int32 = leftConv.Value.v_int32 - rightConv.Value.v_int32;
-        else if (op == "*") result.Value.v_int32 = leftConv.Value.v_int32 * rightConv.Value.v_int32;
-        else if (op == "/") {
-            if (rightConv.Value.v_int32 == 0) interpError("деление на ноль", "", line, col);
-            result.Value.v_int32 = leftConv.Value.v_int32 / rightConv.Value.v_int32;
-        }
-        else if (op == "%") {
-            if (rightConv.Value.v_int32 == 0) interpError("деление на ноль", "", line, col);
-            result.Value.v_int32 = leftConv.Value.v_int32 % rightConv.Value.v_int32;
-        }
-        break;
-
-    case TYPE_LONG_INT:
-        if (op == "+") result.Value.v_int64 = leftConv.Value.v_int64 + rightConv.Value.v_int64;
-        else if (op == "-") result.Value.v_int64 = leftConv.Value.v_int64 - rightConv.Value.v_int64;
-        else if (op == "*") result.Value.v_int64 = leftConv.Value.v_int64 * rightConv.Value.v_int64;
-        else if (op == "/") {
-            if (rightConv.Value.v_int64 == 0) interpError("деление на ноль", "", line, col);
-            result.Value.v_int64 = leftConv.Value.v_int64 / rightConv.Value.v_int64;
-        }
-        else if (op == "%") {
-            if (rightConv.Value.v_int64 == 0) interpError("деление на ноль", "", line, col);
-            result.Value.v_int64 = leftConv.Value.v_int64 % rightConv.Value.v_int64;
-        }
-        break;
+    BinKernel kernel = selectKernel(op, resultType);
+    if (!kernel || op > BOP_MOD) semError("неподдерживаемый тип для арифметической операции", "", loc);
 
-    default:
-        semError("неподдерживаемый тип для арифметической операции", "", line, col);
-    }
+    // Приведение к более широкому типу не меняет каноническое значение
+    Value leftConv(resultType, left.v);
+    Value rightConv(resultType, right.v);
+    result.v = kernel(leftConv.v, rightConv.v, loc);
 
     // Вывод информации об операции (отладочный)
-    if (debug && interpretationEnabled) {
-        printArithmeticOp(op, leftConv, rightConv, result, line, col);
+    if (debug) {
+        printArithmeticOp(binOpName(op), leftConv, rightConv, result, loc);
     }
 
     return result;
 }
 
-// Операции сдвига
-SemNode Tree::executeShiftOp(const SemNode& left, const SemNode& right, const string& op, int line, int col) {
-    if (!left.hasValue || !right.hasValue) {
-        semError("операция с неинициализированными значениями", "", line, col);
-    }
-
-    SemNode result;
-    result.DataType = left.DataType; // Результат имеет тип левого операнда
-    result.hasValue = true;
+// Операции сдвига (счётчик ограничивается разрядностью операции)
+Value Tree::executeShiftOp(const Value& left, const Value& right, BIN_OP op, SrcLoc loc) {
+    Value result(left.type, 0); // Результат имеет тип левого операнда
 
     if (!interpretationEnabled) return result;
 
-    // Приводим правый операнд к int для сдвига
-    SemNode rightConv = castToType(right, TYPE_INT, line, col);
-
-    switch (left.DataType) {
-    case TYPE_SHORT_INT:
-        if (op == "<<") result.Value.v_int16 = left.Value.v_int16 << rightConv.Value.v_int32;
-        else if (op == ">>") result.Value.v_int16 = left.Value.v_int16 >> rightConv.Value.v_int32;
-        break;
-
-    case TYPE_INT:
-        if (op == "<<") result.Value.v_int32 = left.Value.v_int32 << rightConv.Value.v_int32;
-        else if (op == ">>") result.Value.v_int32 = left.Value.v_int32 >> rightConv.Value.v_int32;
-        break;
-
-    case TYPE_LONG_INT:
-        if (op == "<<") result.Value.v_int64 = left.Value.v_int64 << rightConv.Value.v_int32;
-        else if (op == ">>") result.Value.v_int64 = left.Value.v_int64 >> rightConv.Value.v_int32;
-        break;
-
-    default:
-        semError("неподдерживаемый тип для операции сдвига", "", line, col);
+    BinKernel kernel = selectKernel(op, left.type);
+    if (!kernel || right.type == TYPE_BOOL || (op != BOP_SHL && op != BOP_SHR)) {
+        semError("неподдерживаемый тип для операции сдвига", "", loc);
     }
-
+    result.v = kernel(left.v, right.v, loc);
     return result;
 }
 
 // Операции сравнения
-SemNode Tree::executeComparisonOp(const SemNode& left, const SemNode& right, const string& op, int line, int col) {
-    if (!left.hasValue || !right.hasValue) {
-        semError("операция с неинициализированными значениями", "", line, col);
-    }
-
-    DATA_TYPE resultType = getMaxType(left.DataType, right.DataType);
-    SemNode leftConv = castToType(left, resultType, line, col);
-    SemNode rightConv = castToType(right, resultType, line, col);
-
-    SemNode result;
-    result.DataType = TYPE_BOOL;
-    result.hasValue = true;
+Value Tree::executeComparisonOp(const Value& left, const Value& right, BIN_OP op, SrcLoc loc) {
+    Value result(TYPE_BOOL, 0);
 
     if (!interpretationEnabled) return result;
 
-    switch (resultType) {
-    case TYPE_SHORT_INT:
-        if (op == "<") result.Value.v_bool = leftConv.Value.v_int16 < rightConv.Value.v_int16;
-        else if (op == "<=") result.Value.v_bool = leftConv.Value.v_int16 <= rightConv.Value.v_int16;
-        else if (op == ">") result.Value.v_bool = leftConv.Value.v_int16 > rightConv.Value.v_int16;
-        else if (op == ">=") result.Value.v_bool = leftConv.Value.v_int16 >= rightConv.Value.v_int16;
-        else if (op == "==") result.Value.v_bool = leftConv.Value.v_int16 == rightConv.Value.v_int16;
-        else if (op == "!=") result.Value.v_bool = leftConv.Value.v_int16 != rightConv.Value.v_int16;
-        break;
-
-    case TYPE_INT:
-        if (op == "<") result.Value.v_bool = leftConv.Value.v_int32 < rightConv.Value.v_int32;
-        else if (op == "<=") result.Value.v_bool = leftConv.Value.v_int32 <= rightConv.Value.v_int32;
-        else if (op == ">") result.Value.v_bool = leftConv.Value.v_int32 > rightConv.Value.v_int32;
-        else if (op == ">=") result.Value.v_bool = leftConv.Value.v_int32 >= rightConv.Value.v_int32;
-        else if (op == "==") result.Value.v_bool = leftConv.Value.v_int32 == rightConv.Value.v_int32;
-        else if (op == "!=") result.Value.v_bool = leftConv.Value.v_int32 != rightConv.Value.v_int32;
-        break;
-
-    case TYPE_LONG_INT:
-        if (op == "<") result.Value.v_bool = leftConv.Value.v_int64 < rightConv.Value.v_int64;
-        else if (op == "<=") result.Value.v_bool = leftConv.Value.v_int64 <= rightConv.Value.v_int64;
-        else if (op == ">") result.Value.v_bool = leftConv.Value.v_int64 > rightConv.Value.v_int64;
-        else if (op == ">=") result.Value.v_bool = leftConv.Value.v_int64 >= rightConv.Value.v_int64;
-        else if (op == "==") result.Value.v_bool = leftConv.Value.v_int64 == rightConv.Value.v_int64;
-        else if (op == "!=") result.Value.v_bool = leftConv.Value.v_int64 != rightConv.Value.v_int64;
-        break;
-
-    case TYPE_BOOL:
-        if (op == "==") result.Value.v_bool = left.Value.v_bool == right.Value.v_bool;
-        else if (op == "!=") result.Value.v_bool = left.Value.v_bool != right.Value.v_bool;
-        else semError("неподдерживаемая операция сравнения для bool", "", line, col);
-        break;
-
-    default:
-        semError("неподдерживаемый тип для операции сравнения", "", line, col);
+    if (op < BOP_LT) semError("неподдерживаемая операция сравнения", "", loc);
+    if (left.type == TYPE_BOOL || right.type == TYPE_BOOL) {
+        if (left.type != right.type) semError("неподдерживаемый тип для операции сравнения", "", loc);
+        if (op != BOP_EQ && op != BOP_NE) semError("неподдерживаемая операция сравнения для bool", "", loc);
     }
 
+    // Целые в канонической форме сравниваются без приведения к общему типу
+    DATA_TYPE opType = (left.type == TYPE_BOOL) ? TYPE_BOOL : getMaxType(left.type, right.type);
+    result.v = selectKernel(op, opType)(left.v, right.v, loc);
     return result;
 }
 
@@ -666,7 +617,7 @@ void Tree::disableInterpretation() { interpretationEnabled = false; }
 bool Tree::isInterpretationEnabled() { return interpretationEnabled; }
 
 // Метод для вывода отладочной информации
-void Tree::printDebugInfo(const string& message, int line, int col) {
+void Tree::printDebugInfo(const string& message, SrcLoc loc) {
     if (!debug || !interpretationEnabled) return;
 
     // Определяем контекст
@@ -690,46 +641,41 @@ void Tree::printDebugInfo(const string& message, int line, int col) {
 
     // Выводим сообщение с контекстом и позицией
     std::cout << "DEBUG: [" << context << "]";
-    if (line > 0) {
-        std::cout << " (строка " << line << ":" << col << ")";
+    auto lc = loc.lineCol();
+    if (lc.first > 0) {
+        std::cout << " (строка " << lc.first << ":" << lc.second << ")";
     }
     std::cout << " " << message << std::endl;
 }
 
+// Значение для отладочного вывода: "42 (int)", "true (bool)"
+static void writeValue(std::ostringstream& oss, const Value& value) {
+    if (!value.hasValue) {
+        oss << "неинициализирована";
+        return;
+    }
+    switch (value.type) {
+    case TYPE_SHORT_INT: oss << value.v << " (short)"; break;
+    case TYPE_INT: oss << value.v << " (int)"; break;
+    case TYPE_LONG_INT: oss << value.v << " (long)"; break;
+    case TYPE_BOOL: oss << (value.v ? "true" : "false") << " (bool)"; break;
+    default: oss << "unknown";
+    }
+}
+
 // Метод для вывода присваивания
-void Tree::printAssignment(const string& varName, const SemNode& value, int line, int col) {
+void Tree::printAssignment(const string& varName, const Value& value, SrcLoc loc) {
     if (!debug || !interpretationEnabled) return;
 
     std::ostringstream oss;
     oss << "Присваивание: " << varName << " = ";
+    writeValue(oss, value);
 
-    if (value.hasValue) {
-        switch (value.DataType) {
-        case TYPE_SHORT_INT:
-            oss << value.Value.v_int16 << " (short)";
-            break;
-        case TYPE_INT:
-            oss << value.Value.v_int32 << " (int)";
-            break;
-        case TYPE_LONG_INT:
-            oss << value.Value.v_int64 << " (long)";
-            break;
-        case TYPE_BOOL:
-            oss << (value.Value.v_bool ? "true" : "false") << " (bool)";
-            break;
-        default:
-            oss << "unknown";
-        }
-    }
-    else {
-        oss << "неинициализирована";
-    }
-
-    printDebugInfo(oss.str(), line, col);
+    printDebugInfo(oss.str(), loc);
 }
 
 // Метод для вывода вызова функции
-void Tree::printFunctionCall(const string& funcName, const std::vector<SemNode>& args, int line, int col) {
+void Tree::printFunctionCall(const string& funcName, const std::vector<Value>& args, SrcLoc loc) {
     if (!debug || !interpretationEnabled) return;
 
     std::ostringstream oss;
@@ -737,83 +683,31 @@ void Tree::printFunctionCall(const string& funcName, const std::vector<SemNode>&
 
     for (size_t i = 0; i < args.size(); ++i) {
         if (i > 0) oss << ", ";
-        if (args[i].hasValue) {
-            switch (args[i].DataType) {
-            case TYPE_SHORT_INT: oss << args[i].Value.v_int16 << " (short)"; break;
-            case TYPE_INT: oss << args[i].Value.v_int32 << " (int)"; break;
-            case TYPE_LONG_INT: oss << args[i].Value.v_int64 << " (long)"; break;
-            case TYPE_BOOL: oss << (args[i].Value.v_bool ? "true" : "false") << " (bool)"; break;
-            default: oss << "unknown";
-            }
-        }
-        else {
-            oss << "неинициализирована";
-        }
+        writeValue(oss, args[i]);
     }
     oss << ")";
 
-    printDebugInfo(oss.str(), line, col);
+    printDebugInfo(oss.str(), loc);
 
     // Добавляем сообщение о начале выполнения тела функции
     std::ostringstream oss2;
     oss2 << "|--> Начало выполнения тела функции " << funcName;
-    printDebugInfo(oss2.str(), line, col);
+    printDebugInfo(oss2.str(), loc);
 }
 
 // Метод для вывода арифметической операции
-void Tree::printArithmeticOp(const string& op, const SemNode& left, const SemNode& right, const SemNode& result, int line, int col) {
+void Tree::printArithmeticOp(const string& op, const Value& left, const Value& right, const Value& result, SrcLoc loc) {
     if (!debug || !interpretationEnabled) return;
 
     std::ostringstream oss;
     oss << "Арифметическая операция: ";
-
-    // Левый операнд
-    if (left.hasValue) {
-        switch (left.DataType) {
-        case TYPE_SHORT_INT: oss << left.Value.v_int16 << " (short)"; break;
-        case TYPE_INT: oss << left.Value.v_int32 << " (int)"; break;
-        case TYPE_LONG_INT: oss << left.Value.v_int64 << " (long)"; break;
-        case TYPE_BOOL: oss << (left.Value.v_bool ? "true" : "false") << " (bool)"; break;
-        default: oss << "unknown";
-        }
-    }
-    else {
-        oss << "неинициализирована";
-    }
-
+    writeValue(oss, left);
     oss << " " << op << " ";
-
-    // Правый операнд
-    if (right.hasValue) {
-        switch (right.DataType) {
-        case TYPE_SHORT_INT: oss << right.Value.v_int16 << " (short)"; break;
-        case TYPE_INT: oss << right.Value.v_int32 << " (int)"; break;
-        case TYPE_LONG_INT: oss << right.Value.v_int64 << " (long)"; break;
-        case TYPE_BOOL: oss << (right.Value.v_bool ? "true" : "false") << " (bool)"; break;
-        default: oss << "unknown";
-        }
-    }
-    else {
-        oss << "неинициализирована";
-    }
-
+    writeValue(oss, right);
     oss << " = ";
+    writeValue(oss, result);
 
-    // Результат
-    if (result.hasValue) {
-        switch (result.DataType) {
-        case TYPE_SHORT_INT: oss << result.Value.v_int16 << " (short)"; break;
-        case TYPE_INT: oss << result.Value.v_int32 << " (int)"; break;
-        case TYPE_LONG_INT: oss << result.Value.v_int64 << " (long)"; break;
-        case TYPE_BOOL: oss << (result.Value.v_bool ? "true" : "false") << " (bool)"; break;
-        default: oss << "unknown";
-        }
-    }
-    else {
-        oss << "неинициализирована";
-    }
-
-    printDebugInfo(oss.str(), line, col);
+    printDebugInfo(oss.str(), loc);
 }
 
 void Tree::enableDebug() { debug = true; }
@@ -833,6 +727,11 @@ Tree* Tree::cloneRecursive(const Tree* node) {
     }
     copy->Left = cloneRecursive(node->Left);
     copy->Right = cloneRecursive(node->Right);
+    // восстанавливаем хвост и хеш-индекс скопированного списка потомков
+    for (Tree* p = copy->Left; p != nullptr; p = p->Right) {
+        copy->Tail = p;
+        copy->indexChild(p);
+    }
     return copy;
 }
 
@@ -853,9 +752,13 @@ void Tree::fixUpPointers(Tree* copy, Tree* parentUp) {
 void Tree::reset() {
     if (Root) delete Root;
     Root = nullptr;
+    // Все узлы дерева удалены — память арены используется заново
+    nodeArena().reset();
     Cur = nullptr;
     interpretationEnabled = true;
     debug = false;
     currentFunction = nullptr;
     recursionDepth = 0;
+    maxRecursionDepth = DEFAULT_MAX_RECURSION_DEPTH;
+    peakDepth = 0;
 }
\ No newline at end of file
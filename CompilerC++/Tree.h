@@ -1,10 +1,14 @@
 ﻿#pragma once
 #include "SemNode.h"
+#include "Value.h"
+#include "Kernels.h"
 #include <fstream>
 #include <vector>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
@@ -14,6 +18,11 @@ public:
     Tree* Up;
     Tree* Left;
     Tree* Right;
+    Tree* Tail; // последний дочерний элемент (для вставки за O(1))
+
+    // Хеш-индекс дочерних элементов по интернированному имени (создаётся при первом
+    // именованном потомке). При совпадении имён хранится первый по порядку узел.
+    unordered_map<const string*, Tree*>* index;
 
     static Tree* Root;
     static Tree* Cur;
@@ -21,41 +30,59 @@ public:
     Tree(SemNode* node = nullptr, Tree* up = nullptr);
     ~Tree();
 
-    void setLeft(SemNode* Data);
-    void setRight(SemNode* Data);
+    // Узлы дерева размещаются в арене узлов (см. SemNode)
+    static void* operator new(size_t size) { return nodeArena().allocate(size, alignof(Tree)); }
+    static void operator delete(void*) noexcept {}
+
+    Tree* setLeft(SemNode* Data);
+    Tree* setRight(SemNode* Data);
+
+    // Интернирование имён: одинаковые строки получают один и тот же указатель
+    static const string* intern(const string& id);
+    // Указатель на интернированное имя или nullptr, если имя ни разу не описывалось
+    static const string* findName(const string& id);
 
     Tree* findUp(Tree* From, const string& id);
     Tree* findUpOneLevel(Tree* From, const string& id);
 
     // Семантические операции
-    Tree* semInclude(const string& a, DATA_TYPE t, int line, int col);
-    Tree* semIncludeConstant(const string& a, DATA_TYPE t, const string& value, int line, int col);
+    Tree* semInclude(const string& a, DATA_TYPE t, SrcLoc loc);
+    Tree* semIncludeConstant(const string& a, DATA_TYPE t, const string& value, SrcLoc loc);
     void semSetParam(Tree* Addr, int n);
     void semSetParamTypes(Tree* Addr, const std::vector<DATA_TYPE>& types);
-    void semControlParamTypes(Tree* Addr, const std::vector<DATA_TYPE>& argTypes, int line, int col);
-    Tree* semGetVar(const string& a, int line, int col);
-    Tree* semGetFunct(const string& a, int line, int col);
+    void semControlParamTypes(Tree* Addr, const std::vector<DATA_TYPE>& argTypes, SrcLoc loc);
+    Tree* semGetVar(const string& a, SrcLoc loc);
+    Tree* semGetFunct(const string& a, SrcLoc loc);
     bool dupControl(Tree* Addr, const string& a);
-    Tree* semEnterBlock(int line, int col);
+    Tree* semEnterBlock(SrcLoc loc);
     void semExitBlock();
 
     static void setCur(Tree* a) { Cur = a; }
     static Tree* getCur() { return Cur; }
 
     void print();
-    static void semError(const string& msg, const string& id = "", int line = -1, int col = -1);
-	static void interpError(const string& msg, const string& id = "", int line = -1, int col = -1);
+    static void semError(const string& msg, const string& id = "", SrcLoc loc = SrcLoc());
+	static void interpError(const string& msg, const string& id = "", SrcLoc loc = SrcLoc());
 
     // Статические методы для интерпретации - исправленные сигнатуры
-    static void setVarValue(const string& name, const SemNode& value, int line, int col);
-    static SemNode getVarValue(const string& name, int line, int col);
-    static SemNode executeArithmeticOp(const SemNode& left, const SemNode& right, const string& op, int line, int col);
-    static SemNode executeShiftOp(const SemNode& left, const SemNode& right, const string& op, int line, int col);
-    static SemNode executeComparisonOp(const SemNode& left, const SemNode& right, const string& op, int line, int col);
+    static void setVarValue(const string& name, const Value& value, SrcLoc loc);
+    // Присваивание в уже найденную ячейку target (с проверками, приведением и отладочным выводом setVarValue)
+    static void storeValue(Value& target, const string& name, const Value& value, SrcLoc loc);
+    static Value getVarValue(const string& name, SrcLoc loc);
+    // Операции с проверкой типов и отладочным выводом; вычисление — ядром selectKernel(op, тип).
+    // Операнды — результаты вычисления выражений: инициализацию чтений уже проверил исполнитель
+    // (или DefiniteAssignment доказал её при компиляции), поэтому здесь она не проверяется
+    static Value executeArithmeticOp(const Value& left, const Value& right, BIN_OP op, SrcLoc loc);
+    static Value executeShiftOp(const Value& left, const Value& right, BIN_OP op, SrcLoc loc);
+    static Value executeComparisonOp(const Value& left, const Value& right, BIN_OP op, SrcLoc loc);
     static DATA_TYPE getMaxType(DATA_TYPE t1, DATA_TYPE t2);
-    static SemNode castToType(const SemNode& value, DATA_TYPE targetType, int line, int col, bool showWarning = false);
+    static Value castToType(const Value& value, DATA_TYPE targetType, SrcLoc loc, bool showWarning = false);
     static bool canImplicitCast(DATA_TYPE from, DATA_TYPE to);
-    static void executeFunctionCall(const string& funcName, const std::vector<SemNode>& args, int line, int col);
+    static void executeFunctionCall(const string& funcName, const std::vector<Value>& args, SrcLoc loc);
+
+    // Значение записи таблицы символов и обратная запись (SemNode хранит значение по типу в объединении)
+    static Value valueOf(const SemNode& node);
+    static void assignValue(SemNode& node, const Value& value);
 
     // Методы для управления интерпретацией
     static void enableInterpretation();
@@ -67,11 +94,12 @@ public:
     static bool isDebugEnabled();
 
     // Методы для вывода
-    static void printDebugInfo(const string& message, int line = 0, int col = 0);
-    static void printAssignment(const string& varName, const SemNode& value, int line, int col);
-    static void printFunctionCall(const string& funcName, const std::vector<SemNode>& args, int line, int col);
-    static void printArithmeticOp(const string& op, const SemNode& left, const SemNode& right, const SemNode& result, int line, int col);
-    static void printTypeConversionWarning(DATA_TYPE from, DATA_TYPE to, const string& context, const string& expression, int line, int col);
+    static void printDebugInfo(const string& message, SrcLoc loc = SrcLoc());
+    static void printAssignment(const string& varName, const Value& value, SrcLoc loc);
+    static void printFunctionCall(const string& funcName, const std::vector<Value>& args, SrcLoc loc);
+    static void printArithmeticOp(const string& op, const Value& left, const Value& right, const Value& result, SrcLoc loc);
+    static void printTypeConversionWarning(DATA_TYPE from, DATA_TYPE to, const string& context, const string& expression, SrcLoc loc);
+    static void printTruncationWarning(long long value, DATA_TYPE to, SrcLoc loc);
     
     // Текущая функция для контекста
     static Tree* currentFunction;
@@ -86,13 +114,24 @@ public:
     static Tree* cloneRecursive(const Tree* node);
     static void fixUpPointers(Tree* copy, Tree* parentUp);
 
-    static void enterFunctionCall(const string& funcName, int line = -1, int col = -1);
+    static void enterFunctionCall(const string& funcName, SrcLoc loc = SrcLoc());
     static void exitFunctionCall();
 
+    // Наибольшая глубина вложенных (не хвостовых) вызовов. Оба исполнителя хранят кадры
+    // в куче, так что предел ограничивает только память, а не стек C++
+    static const int DEFAULT_MAX_RECURSION_DEPTH = 100000;
+    static void setMaxRecursionDepth(int depth) { maxRecursionDepth = depth; }
+    static int getMaxRecursionDepth() { return maxRecursionDepth; }
+    static int getRecursionDepth() { return recursionDepth; }
+    // Наибольшая глубина, достигнутая с последнего setPeakDepth (для повтора запомненных вызовов)
+    static int getPeakDepth() { return peakDepth; }
+    static void setPeakDepth(int depth) { peakDepth = depth; }
+
     static void reset(); // сброс глобального состояния
 
 private:
     void print(int depth);
+    void indexChild(Tree* child);
     std::string makeLabel(const Tree* tree) const;
 
     // Флаг интерпретации
@@ -101,5 +140,6 @@ private:
 
     // глубина рекурсии
     static int recursionDepth;
-    static const int MAX_RECURSION_DEPTH = 50;
+    static int maxRecursionDepth;
+    static int peakDepth;
 };
\ No newline at end of file
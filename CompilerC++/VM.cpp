@@ -0,0 +1,388 @@
+﻿#include "VM.h"
+#include "Tree.h"
+#include "Jit.h"
+#include <climits>
+
+// Регистры уже хранят значения в канонической форме Value
+static Value makeValue(int64_t v, DATA_TYPE type) {
+    return Value(type, v);
+}
+
+VM::VM(BcProgram* program, bool jit) : program(program), jitEnabled(jit && JitCode::supported()), profile(nullptr) {
+    callCounts.assign(program->functions.size(), 0);
+    native.assign(program->functions.size(), nullptr);
+}
+
+VM::~VM() {
+    for (JitCode* code : native) delete code;
+}
+
+size_t VM::compiledFunctions() const {
+    size_t count = 0;
+    for (JitCode* code : native) if (code) count++;
+    return count;
+}
+
+// Учёт вызова функции: на пороге CALL_THRESHOLD она компилируется (одна попытка)
+const JitCode* VM::hotCode(int index) {
+    if (++callCounts[index] == JitCode::CALL_THRESHOLD) {
+        native[index] = JitCode::compile(program->functions[index]);
+    }
+    return native[index];
+}
+
+void VM::run() {
+    Tree::enableInterpretation();
+
+    globals.assign(program->globalNames.size(), 0);
+    globalInits.assign(program->globalNames.size(), 0);
+
+    const BcFunction& init = program->functions[program->entry];
+    regs.assign(init.numRegs, 0);
+    inits.assign(init.numRegs, 0);
+
+    frames.clear();
+    memo.reset();
+    Frame f;
+    f.fn = program->entry;
+    f.pc = 0;
+    f.base = 0;
+    f.counted = false;
+    f.memo = -1;
+    frames.push_back(f);
+
+    execute();
+}
+
+Value VM::globalValue(const string& name) const {
+    for (size_t i = 0; i < program->globalNames.size(); ++i) {
+        if (program->globalNames[i] == name && i < globals.size()) {
+            Value value = makeValue(globals[i], program->globalTypes[i]);
+            value.hasValue = globalInits[i] != 0;
+            return value;
+        }
+    }
+    return Value();
+}
+
+void VM::ensureRegs(size_t size) {
+    if (regs.size() < size) {
+        size_t grow = regs.size() * 2;
+        if (grow < size) grow = size;
+        regs.resize(grow, 0);
+        inits.resize(grow, 0);
+    }
+}
+
+// Поиск вызова в memo по аргументам (в регистрах они уже приведены к типам параметров) и
+// глобальным переменным memoReads. При попадании записанные значения memoWrites переносятся
+// в глобальные переменные; при промахе вызов начинается в memo, результат записывает finishCall
+bool VM::replayCall(const BcFunction& callee, const int64_t* args) {
+    memoKey.clear();
+    memoKey.push_back(callee.memoId);
+    memoKey.insert(memoKey.end(), args, args + callee.numParams);
+    for (int g : callee.memoReads) {
+        memoKey.push_back(globalInits[g] ? globals[g] : 0);
+        memoKey.push_back(globalInits[g]);
+    }
+
+    if (const MemoCache::Entry* e = memo.find(memoKey)) {
+        for (size_t i = 0; i < callee.memoWrites.size(); ++i) {
+            globals[callee.memoWrites[i]] = e->writes[2 * i];
+            globalInits[callee.memoWrites[i]] = static_cast<uint8_t>(e->writes[2 * i + 1]);
+        }
+        return true;
+    }
+    memo.begin(memoKey);
+    return false;
+}
+
+void VM::finishCall(const BcFunction& callee) {
+    memoWrites.clear();
+    for (int g : callee.memoWrites) {
+        memoWrites.push_back(globals[g]);
+        memoWrites.push_back(globalInits[g]);
+    }
+    memo.finish(memoWrites);
+}
+
+// Цикл диспетчеризации без подсчёта не содержит проверок профиля
+void VM::execute() {
+    if (profile) {
+        bool jit = jitEnabled;
+        jitEnabled = false;
+        dispatch<true>();
+        jitEnabled = jit;
+    }
+    else {
+        dispatch<false>();
+    }
+}
+
+template <bool PROFILE>
+void VM::dispatch() {
+    const BcFunction* fn = &program->functions[frames.back().fn];
+    const Instr* code = fn->code.data();
+    size_t base = frames.back().base;
+    int64_t* R = regs.data() + base;
+    uint8_t* I = inits.data() + base;
+    size_t pc = 0;
+
+    for (;;) {
+        if (PROFILE) profile->count(*fn, pc);
+        const Instr& in = code[pc++];
+        switch (in.op) {
+        case OP_LOADK: R[in.a] = fn->consts[in.b]; break;
+        case OP_MOV: R[in.a] = R[in.b]; break;
+        case OP_LOADG: R[in.a] = globals[in.b]; break;
+        case OP_STL: R[in.a] = R[in.b]; I[in.a] = 1; break;
+        case OP_STG: globals[in.a] = R[in.b]; globalInits[in.a] = 1; break;
+
+        case OP_CHKL:
+            if (!I[in.a]) {
+                const string& name = fn->sites[in.b].name;
+                Tree::interpError("использование неинициализированной переменной '" + name + "'", name, fn->locs[pc - 1]);
+            }
+            break;
+        case OP_CHKG:
+            if (!globalInits[in.a]) {
+                const string& name = fn->sites[in.b].name;
+                Tree::interpError("использование неинициализированной переменной '" + name + "'", name, fn->locs[pc - 1]);
+            }
+            break;
+
+        case OP_ADD_S: R[in.a] = toShort(R[in.b] + R[in.c]); break;
+        case OP_ADD_I: R[in.a] = toInt(R[in.b] + R[in.c]); break;
+        case OP_ADD_L: R[in.a] = wrapAdd(R[in.b], R[in.c]); break;
+        case OP_SUB_S: R[in.a] = toShort(R[in.b] - R[in.c]); break;
+        case OP_SUB_I: R[in.a] = toInt(R[in.b] - R[in.c]); break;
+        case OP_SUB_L: R[in.a] = wrapSub(R[in.b], R[in.c]); break;
+        case OP_MUL_S: R[in.a] = toShort(R[in.b] * R[in.c]); break;
+        case OP_MUL_I: R[in.a] = toInt(R[in.b] * R[in.c]); break;
+        case OP_MUL_L: R[in.a] = wrapMul(R[in.b], R[in.c]); break;
+
+        case OP_DIV_S:
+        case OP_DIV_I:
+        case OP_DIV_L:
+        case OP_MOD_S:
+        case OP_MOD_I:
+        case OP_MOD_L: {
+            int64_t b = R[in.b];
+            int64_t c = R[in.c];
+            if (c == 0) Tree::interpError("деление на ноль", "", fn->locs[pc - 1]);
+            // Для short и int частное 64-битного деления всегда представимо
+            switch (in.op) {
+            case OP_DIV_S: R[in.a] = toShort(b / c); break;
+            case OP_DIV_I: R[in.a] = toInt(b / c); break;
+            case OP_DIV_L: R[in.a] = divLong(b, c); break;
+            case OP_MOD_S: R[in.a] = toShort(b % c); break;
+            case OP_MOD_I: R[in.a] = toInt(b % c); break;
+            default: R[in.a] = modLong(b, c); break;
+            }
+            break;
+        }
+        case OP_QUO_S: R[in.a] = toShort(R[in.b] / R[in.c]); break;
+        case OP_QUO_I: R[in.a] = toInt(R[in.b] / R[in.c]); break;
+        case OP_QUO_L: R[in.a] = divLong(R[in.b], R[in.c]); break;
+        case OP_REM_S: R[in.a] = toShort(R[in.b] % R[in.c]); break;
+        case OP_REM_I: R[in.a] = toInt(R[in.b] % R[in.c]); break;
+        case OP_REM_L: R[in.a] = modLong(R[in.b], R[in.c]); break;
+
+        // Счётчик сдвига ограничивается разрядностью операции
+        case OP_SHL_S: R[in.a] = toShort(wrapShl(R[in.b], R[in.c] & 31)); break;
+        case OP_SHL_I: R[in.a] = toInt(wrapShl(R[in.b], R[in.c] & 31)); break;
+        case OP_SHL_L: R[in.a] = wrapShl(R[in.b], R[in.c] & 63); break;
+        case OP_SHR_S: R[in.a] = toShort(R[in.b] >> (R[in.c] & 31)); break;
+        case OP_SHR_I: R[in.a] = toInt(R[in.b] >> (R[in.c] & 31)); break;
+        case OP_SHR_L: R[in.a] = R[in.b] >> (R[in.c] & 63); break;
+        case OP_SHLK_S: R[in.a] = toShort(wrapShl(R[in.b], in.c)); break;
+        case OP_SHLK_I: R[in.a] = toInt(wrapShl(R[in.b], in.c)); break;
+        case OP_SHLK_L: R[in.a] = wrapShl(R[in.b], in.c); break;
+
+        case OP_NEG_S: R[in.a] = toShort(-R[in.b]); break;
+        case OP_NEG_I: R[in.a] = toInt(-R[in.b]); break;
+        case OP_NEG_L: R[in.a] = wrapSub(0, R[in.b]); break;
+        case OP_DIVP2: R[in.a] = divPow2(R[in.b], in.c); break;
+        case OP_MODP2: R[in.a] = modPow2(R[in.b], in.c); break;
+        case OP_ADDK_S: R[in.a] = toShort(R[in.b] + in.c); break;
+        case OP_ADDK_I: R[in.a] = toInt(R[in.b] + in.c); break;
+        case OP_ADDK_L: R[in.a] = wrapAdd(R[in.b], in.c); break;
+        case OP_MULK_S: R[in.a] = toShort(R[in.b] * in.c); break;
+        case OP_MULK_I: R[in.a] = toInt(R[in.b] * in.c); break;
+        case OP_MULK_L: R[in.a] = wrapMul(R[in.b], in.c); break;
+        case OP_QUOK_S: R[in.a] = toShort(R[in.b] / in.c); break;
+        case OP_QUOK_I: R[in.a] = toInt(R[in.b] / in.c); break;
+        case OP_QUOK_L: R[in.a] = divLong(R[in.b], in.c); break;
+        case OP_REMK_S: R[in.a] = toShort(R[in.b] % in.c); break;
+        case OP_REMK_I: R[in.a] = toInt(R[in.b] % in.c); break;
+        case OP_REMK_L: R[in.a] = modLong(R[in.b], in.c); break;
+        case OP_ADDG_S: globals[in.a] = toShort(R[in.b] + R[in.c]); globalInits[in.a] = 1; break;
+        case OP_ADDG_I: globals[in.a] = toInt(R[in.b] + R[in.c]); globalInits[in.a] = 1; break;
+        case OP_ADDG_L: globals[in.a] = wrapAdd(R[in.b], R[in.c]); globalInits[in.a] = 1; break;
+        case OP_SUBG_S: globals[in.a] = toShort(R[in.b] - R[in.c]); globalInits[in.a] = 1; break;
+        case OP_SUBG_I: globals[in.a] = toInt(R[in.b] - R[in.c]); globalInits[in.a] = 1; break;
+        case OP_SUBG_L: globals[in.a] = wrapSub(R[in.b], R[in.c]); globalInits[in.a] = 1; break;
+
+        case OP_EQ: R[in.a] = R[in.b] == R[in.c]; break;
+        case OP_NE: R[in.a] = R[in.b] != R[in.c]; break;
+        case OP_LT: R[in.a] = R[in.b] < R[in.c]; break;
+        case OP_LE: R[in.a] = R[in.b] <= R[in.c]; break;
+        case OP_GT: R[in.a] = R[in.b] > R[in.c]; break;
+        case OP_GE: R[in.a] = R[in.b] >= R[in.c]; break;
+
+        case OP_CAST_S: R[in.a] = toShort(R[in.b]); break;
+        case OP_CAST_I: R[in.a] = toInt(R[in.b]); break;
+
+        case OP_NARROW_S:
+        case OP_NARROW_I: {
+            // Те же предупреждения, что и в Tree::setVarValue
+            const SiteInfo& site = fn->sites[in.c];
+            int64_t v = R[in.b];
+            int64_t narrowed = (in.op == OP_NARROW_S) ? toShort(v) : toInt(v);
+            if (narrowed != v) {
+                Tree::printTruncationWarning(v, site.type2, site.loc);
+            }
+            else if (site.warnConversion) {
+                Tree::printTypeConversionWarning(site.type1, site.type2, site.context, site.name, site.loc);
+            }
+            R[in.a] = narrowed;
+            break;
+        }
+
+        case OP_JMP: pc = in.a; break;
+        case OP_JT: if (R[in.a]) pc = in.b; break;
+        case OP_JF: if (!R[in.a]) pc = in.b; break;
+        case OP_JEQ: if (R[in.a] == R[in.b]) pc = in.c; break;
+        case OP_JNE: if (R[in.a] != R[in.b]) pc = in.c; break;
+        case OP_JEQK: if (R[in.a] == in.b) pc = in.c; break;
+        case OP_JNEK: if (R[in.a] != in.b) pc = in.c; break;
+        case OP_SWITCH: pc = fn->switches[in.b].find(R[in.a]); break;
+
+        case OP_CALL: {
+            const SiteInfo& site = fn->sites[in.c];
+            const BcFunction& callee = program->functions[in.a];
+
+            // Запомненный вызов не исполняется: его результат уже в глобальных переменных,
+            // вызывающая функция продолжается (в машинном коде, если он есть)
+            if (callee.memoId >= 0 && replayCall(callee, R + in.b)) {
+                if (jitEnabled && native[frames.back().fn]) {
+                    pc = native[frames.back().fn]->run(R, I, globals.data(), globalInits.data(), pc);
+                }
+                break;
+            }
+
+            if (site.countDepth) {
+                Tree::enterFunctionCall(site.name, site.loc);
+            }
+
+            size_t calleeBase = base + fn->numRegs;
+            ensureRegs(calleeBase + callee.numRegs);
+            for (int i = 0; i < callee.numParams; ++i) {
+                regs[calleeBase + i] = regs[base + in.b + i];
+            }
+            for (int r : callee.checkedLocals) inits[calleeBase + r] = 0;
+
+            frames.back().pc = pc;
+            Frame f;
+            f.fn = in.a;
+            f.pc = 0;
+            f.base = calleeBase;
+            f.counted = site.countDepth;
+            f.memo = callee.memoId >= 0 ? in.a : -1;
+            frames.push_back(f);
+
+            Tree::setCurrentFunction(callee.decl);
+
+            fn = &callee;
+            code = fn->code.data();
+            base = calleeBase;
+            R = regs.data() + base;
+            I = inits.data() + base;
+            pc = 0;
+            if (jitEnabled) {
+                if (const JitCode* jit = hotCode(in.a)) pc = jit->run(R, I, globals.data(), globalInits.data(), pc);
+            }
+            break;
+        }
+
+        case OP_TAILCALL: {
+            // Окно регистров вызывающей функции больше не нужно: аргументы переносятся
+            // в его начало (по возрастанию — источник r[b + i] не левее приёмника r[i]),
+            // кадр остаётся тем же, глубина рекурсии не растёт
+            const BcFunction& callee = program->functions[in.a];
+            ensureRegs(base + callee.numRegs);
+            for (int i = 0; i < callee.numParams; ++i) {
+                regs[base + i] = regs[base + in.b + i];
+            }
+            for (int r : callee.checkedLocals) inits[base + r] = 0;
+
+            frames.back().fn = in.a;
+            Tree::setCurrentFunction(callee.decl);
+
+            fn = &callee;
+            code = fn->code.data();
+            R = regs.data() + base;
+            I = inits.data() + base;
+            pc = 0;
+            if (jitEnabled) {
+                if (const JitCode* jit = hotCode(in.a)) pc = jit->run(R, I, globals.data(), globalInits.data(), pc);
+            }
+            break;
+        }
+
+        case OP_RET: {
+            // Хвостовые вызовы сохраняют кадр: результат записывается за исходный вызов
+            if (frames.back().memo >= 0) finishCall(program->functions[frames.back().memo]);
+            bool counted = frames.back().counted;
+            frames.pop_back();
+            if (frames.empty()) return;
+            if (counted) Tree::exitFunctionCall();
+
+            const Frame& caller = frames.back();
+            fn = &program->functions[caller.fn];
+            code = fn->code.data();
+            base = caller.base;
+            R = regs.data() + base;
+            I = inits.data() + base;
+            pc = caller.pc;
+
+            Tree::setCurrentFunction(fn->decl);
+            // Вызывающая функция продолжается в машинном коде, если он есть
+            if (jitEnabled && native[caller.fn]) {
+                pc = native[caller.fn]->run(R, I, globals.data(), globalInits.data(), pc);
+            }
+            break;
+        }
+
+        case OP_TRACE_ASSIGN: {
+            const SiteInfo& site = fn->sites[in.a];
+            int64_t v = site.global ? globals[site.reg1] : R[site.reg1];
+            Tree::printAssignment(site.name, makeValue(v, site.type1), site.loc);
+            break;
+        }
+        case OP_TRACE_CONV: {
+            const SiteInfo& site = fn->sites[in.a];
+            Tree::printTypeConversionWarning(site.type1, site.type2, site.context, site.name, site.loc);
+            break;
+        }
+        case OP_TRACE_ARITH: {
+            const SiteInfo& site = fn->sites[in.a];
+            Tree::printArithmeticOp(site.name, makeValue(R[site.reg1], site.type2), makeValue(R[site.reg2], site.type2),
+                makeValue(R[site.reg3], site.type2), site.loc);
+            break;
+        }
+        case OP_TRACE_CALL: {
+            const SiteInfo& site = fn->sites[in.a];
+            std::vector<Value> args;
+            args.reserve(site.types.size());
+            for (int i = 0; i < site.reg2; ++i) {
+                args.push_back(makeValue(R[site.reg1 + i], site.types[i]));
+            }
+            Tree::printFunctionCall(site.name, args, site.loc);
+            break;
+        }
+        case OP_COUNT:
+            break;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+﻿#pragma once
+#include "Bytecode.h"
+#include "Value.h"
+#include "Jit.h"
+#include "MemoCache.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Интерпретатор регистрового байт-кода.
+// Регистры всех активных вызовов лежат в одном массиве: окно вызываемой функции
+// начинается сразу за окном вызывающей. Для каждого регистра хранится признак инициализации.
+// С jit == true функции, вызванные JitCode::CALL_THRESHOLD раз, компилируются в машинный код
+// (см. Jit.h); он исполняется в тех же окнах регистров, вызовы и возвраты остаются за VM.
+// Вызовы функций с BcFunction::memoId >= 0 запоминаются в MemoCache (см. MemoCache.h).
+class VM {
+public:
+    explicit VM(BcProgram* program, bool jit = false);
+    ~VM();
+    VM(const VM&) = delete;
+    VM& operator=(const VM&) = delete;
+
+    // Инициализация глобальных переменных и выполнение main
+    void run();
+
+    // Значение глобальной переменной после выполнения (для тестов)
+    Value globalValue(const std::string& name) const;
+
+    // Число функций, скомпилированных JIT
+    size_t compiledFunctions() const;
+
+    // Попадания и промахи мемоизации вызовов
+    const MemoCache& memoStats() const { return memo; }
+
+    // Подсчёт исполненных инструкций и их пар в profile (nullptr — без подсчёта).
+    // Профилируется только интерпретатор: при подсчёте машинный код JIT не используется
+    void setProfile(DispatchProfile* p) { profile = p; }
+
+private:
+    struct Frame {
+        int fn; // индекс функции в BcProgram::functions
+        size_t pc; // адрес возврата (для вызывающего кадра)
+        size_t base; // начало окна регистров
+        bool counted; // вызов учтён в глубине рекурсии
+        int memo; // функция, результат вызова которой записывается при возврате (-1 — нет)
+    };
+
+    BcProgram* program;
+    std::vector<int64_t> regs;
+    std::vector<uint8_t> inits;
+    std::vector<int64_t> globals;
+    std::vector<uint8_t> globalInits;
+    std::vector<Frame> frames;
+
+    bool jitEnabled;
+    std::vector<uint32_t> callCounts; // число вызовов каждой функции
+    std::vector<JitCode*> native; // машинный код функции (nullptr — исполняет интерпретатор)
+
+    MemoCache memo;
+    DispatchProfile* profile;
+    std::vector<int64_t> memoKey; // ключ текущего поиска (буфер)
+    std::vector<int64_t> memoWrites; // результат завершённого вызова (буфер)
+
+    const JitCode* hotCode(int index);
+    void execute();
+    template <bool PROFILE> void dispatch();
+    void ensureRegs(size_t size);
+    bool replayCall(const BcFunction& callee, const int64_t* args);
+    void finishCall(const BcFunction& callee);
+};
@@ -0,0 +1,49 @@
+﻿#pragma once
+#include "DataType.h"
+#include <cstdint>
+#include <type_traits>
+
+// Значение времени выполнения: тег типа и 64-битное содержимое (16 байт, тривиально копируется).
+// Целые хранятся в канонической форме — знаково расширенными до 64 бит, bool — как 0 или 1.
+// Используется вычислителем выражений, при передаче аргументов и в ячейках переменных;
+// SemNode остаётся записью таблицы символов
+struct Value {
+    DATA_TYPE type;
+    bool hasValue; // значение задано (для ячеек переменных)
+    int64_t v;
+
+    Value() : type(TYPE_INT), hasValue(false), v(0) {}
+    Value(DATA_TYPE t, int64_t value) : type(t), hasValue(true), v(value) {}
+};
+
+static_assert(sizeof(Value) == 16, "Value должен занимать 16 байт");
+static_assert(std::is_trivially_copyable<Value>::value, "Value должен быть тривиально копируемым");
+
+// Знаковое расширение младших разрядов: приведение к short / int в канонической форме
+inline int64_t toShort(int64_t v) { return static_cast<int16_t>(static_cast<uint16_t>(v)); }
+inline int64_t toInt(int64_t v) { return static_cast<int32_t>(static_cast<uint32_t>(v)); }
+
+// Арифметика с переполнением по модулю 2^64 (без неопределённого поведения)
+inline int64_t wrapAdd(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)); }
+inline int64_t wrapSub(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)); }
+inline int64_t wrapMul(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)); }
+inline int64_t wrapShl(int64_t a, int64_t n) { return static_cast<int64_t>(static_cast<uint64_t>(a) << n); }
+
+// Деление long: LLONG_MIN / -1 даёт LLONG_MIN (переполнение), остаток 0
+inline int64_t divLong(int64_t a, int64_t b) { return (b == -1) ? wrapSub(0, a) : a / b; }
+inline int64_t modLong(int64_t a, int64_t b) { return (b == -1) ? 0 : a % b; }
+
+// Деление и остаток на 2^k (0 < k < 63) сдвигом, с округлением частного к нулю, как у / и %:
+// к отрицательному делимому перед сдвигом прибавляется 2^k - 1. Результат помещается в тип
+// делимого, поэтому приведение к short / int не нужно
+inline int64_t divPow2(int64_t a, int k) { return (a + ((a >> 63) & ((int64_t(1) << k) - 1))) >> k; }
+inline int64_t modPow2(int64_t a, int k) { return wrapSub(a, wrapShl(divPow2(a, k), k)); }
+
+// Приведение канонического значения к целому типу (short / int / long)
+inline int64_t truncateTo(DATA_TYPE type, int64_t v) {
+    switch (type) {
+    case TYPE_SHORT_INT: return toShort(v);
+    case TYPE_INT: return toInt(v);
+    default: return v;
+    }
+}
@@ -0,0 +1,208 @@
+﻿#include "X86Emitter.h"
+
+using namespace std;
+
+// Тип операции по коду с суффиксом _S / _I / _L (коды идут тройками)
+static DATA_TYPE typedOpType(OPCODE op, OPCODE shortOp) {
+    switch (op - shortOp) {
+    case 0: return TYPE_SHORT_INT;
+    case 1: return TYPE_INT;
+    default: return TYPE_LONG_INT;
+    }
+}
+
+static bool inTriple(OPCODE op, OPCODE shortOp) {
+    return op >= shortOp && op <= shortOp + 2;
+}
+
+bool emitX86Instruction(X86Assembler& a, const BcFunction& fn, size_t pc,
+    vector<pair<size_t, size_t>>& branches, const X86SlowPath& slowPath) {
+    const Instr& in = fn.code[pc];
+    OPCODE op = in.op;
+
+    if (op == OP_LOADK) {
+        a.movImm64(RAX, static_cast<uint64_t>(fn.consts[in.b]));
+        a.storeR(in.a, RAX);
+    }
+    else if (op == OP_MOV) {
+        a.loadR(RAX, in.b);
+        a.storeR(in.a, RAX);
+    }
+    else if (op == OP_LOADG) {
+        a.loadG(in.b);
+        a.storeR(in.a, RAX);
+    }
+    else if (op == OP_STL) {
+        a.loadR(RAX, in.b);
+        a.storeR(in.a, RAX);
+        a.setInit(in.a);
+    }
+    else if (op == OP_STG) {
+        a.loadR(RAX, in.b);
+        a.storeG(in.a);
+        a.setGlobalInit(in.a);
+    }
+    else if (op == OP_CHKL || op == OP_CHKG) {
+        if (op == OP_CHKL) a.testInit(in.a);
+        else a.testGlobalInit(in.a);
+        slowPath(0x75, pc); // jne — переменная инициализирована
+    }
+    else if (inTriple(op, OP_ADD_S) || inTriple(op, OP_SUB_S) || inTriple(op, OP_MUL_S)) {
+        a.loadR(RAX, in.b);
+        a.loadR(RCX, in.c);
+        if (inTriple(op, OP_ADD_S)) a.bytes({ 0x48, 0x01, 0xC8 }); // add rax, rcx
+        else if (inTriple(op, OP_SUB_S)) a.bytes({ 0x48, 0x29, 0xC8 }); // sub rax, rcx
+        else a.bytes({ 0x48, 0x0F, 0xAF, 0xC1 }); // imul rax, rcx
+        DATA_TYPE type = inTriple(op, OP_ADD_S) ? typedOpType(op, OP_ADD_S)
+            : inTriple(op, OP_SUB_S) ? typedOpType(op, OP_SUB_S) : typedOpType(op, OP_MUL_S);
+        a.truncate(type);
+        a.storeR(in.a, RAX);
+    }
+    else if (inTriple(op, OP_ADDG_S) || inTriple(op, OP_SUBG_S)) {
+        a.loadR(RAX, in.b);
+        a.loadR(RCX, in.c);
+        if (inTriple(op, OP_ADDG_S)) a.bytes({ 0x48, 0x01, 0xC8 }); // add rax, rcx
+        else a.bytes({ 0x48, 0x29, 0xC8 }); // sub rax, rcx
+        a.truncate(inTriple(op, OP_ADDG_S) ? typedOpType(op, OP_ADDG_S) : typedOpType(op, OP_SUBG_S));
+        a.storeG(in.a);
+        a.setGlobalInit(in.a);
+    }
+    else if (inTriple(op, OP_DIV_S) || inTriple(op, OP_MOD_S) || inTriple(op, OP_QUO_S) || inTriple(op, OP_REM_S)) {
+        bool isDiv = inTriple(op, OP_DIV_S) || inTriple(op, OP_QUO_S);
+        OPCODE base = inTriple(op, OP_DIV_S) ? OP_DIV_S : inTriple(op, OP_MOD_S) ? OP_MOD_S
+            : inTriple(op, OP_QUO_S) ? OP_QUO_S : OP_REM_S;
+        a.loadR(RAX, in.b);
+        a.loadR(RCX, in.c);
+        if (base == OP_DIV_S || base == OP_MOD_S) {
+            a.bytes({ 0x48, 0x85, 0xC9 }); // test rcx, rcx
+            slowPath(0x75, pc); // деление на ноль
+        }
+
+        // Делитель -1: частное — отрицание (LLONG_MIN / -1 не вызывает исключения), остаток 0
+        a.bytes({ 0x48, 0x83, 0xF9, 0xFF }); // cmp rcx, -1
+        size_t general = a.jump8(0x75); // jne
+        if (isDiv) a.bytes({ 0x48, 0xF7, 0xD8 }); // neg rax
+        else a.bytes({ 0x31, 0xC0 }); // xor eax, eax
+        size_t done = a.jump8(0xEB);
+        a.bind8(general);
+        a.bytes({ 0x48, 0x99 }); // cqo
+        a.bytes({ 0x48, 0xF7, 0xF9 }); // idiv rcx
+        if (!isDiv) a.bytes({ 0x48, 0x89, 0xD0 }); // mov rax, rdx
+        a.bind8(done);
+        a.truncate(typedOpType(op, base));
+        a.storeR(in.a, RAX);
+    }
+    else if (inTriple(op, OP_SHL_S) || inTriple(op, OP_SHR_S)) {
+        bool isLeft = inTriple(op, OP_SHL_S);
+        DATA_TYPE type = typedOpType(op, isLeft ? OP_SHL_S : OP_SHR_S);
+        a.loadR(RAX, in.b);
+        a.loadR(RCX, in.c);
+        // 64-битный сдвиг сам ограничивает счётчик 63; для short и int — 31
+        if (type != TYPE_LONG_INT) a.bytes({ 0x83, 0xE1, 0x1F }); // and ecx, 31
+        if (isLeft) a.bytes({ 0x48, 0xD3, 0xE0 }); // shl rax, cl
+        else a.bytes({ 0x48, 0xD3, 0xF8 }); // sar rax, cl
+        a.truncate(type);
+        a.storeR(in.a, RAX);
+    }
+    else if (inTriple(op, OP_SHLK_S)) {
+        a.loadR(RAX, in.b);
+        a.bytes({ 0x48, 0xC1, 0xE0, static_cast<uint8_t>(in.c) }); // shl rax, c
+        a.truncate(typedOpType(op, OP_SHLK_S));
+        a.storeR(in.a, RAX);
+    }
+    else if (inTriple(op, OP_NEG_S)) {
+        a.loadR(RAX, in.b);
+        a.bytes({ 0x48, 0xF7, 0xD8 }); // neg rax
+        a.truncate(typedOpType(op, OP_NEG_S));
+        a.storeR(in.a, RAX);
+    }
+    else if (op == OP_DIVP2 || op == OP_MODP2) {
+        // К отрицательному делимому прибавляется 2^c - 1: знак, размноженный sar и сдвинутый shr
+        uint8_t k = static_cast<uint8_t>(in.c);
+        a.loadR(RAX, in.b);
+        a.bytes({ 0x48, 0x89, 0xC1 }); // mov rcx, rax
+        a.bytes({ 0x48, 0xC1, 0xF9, 63 }); // sar rcx, 63
+        a.bytes({ 0x48, 0xC1, 0xE9, static_cast<uint8_t>(64 - k) }); // shr rcx, 64 - c
+        a.bytes({ 0x48, 0x01, 0xC1 }); // add rcx, rax
+        a.bytes({ 0x48, 0xC1, 0xF9, k }); // sar rcx, c
+        if (op == OP_DIVP2) {
+            a.storeR(in.a, RCX);
+        }
+        else {
+            a.bytes({ 0x48, 0xC1, 0xE1, k }); // shl rcx, c
+            a.bytes({ 0x48, 0x29, 0xC8 }); // sub rax, rcx
+            a.storeR(in.a, RAX);
+        }
+    }
+    else if (inTriple(op, OP_ADDK_S) || inTriple(op, OP_MULK_S)) {
+        a.loadR(RAX, in.b);
+        if (inTriple(op, OP_ADDK_S)) a.bytes({ 0x48, 0x05 }); // add rax, imm32
+        else a.bytes({ 0x48, 0x69, 0xC0 }); // imul rax, rax, imm32
+        a.u32(static_cast<uint32_t>(in.c));
+        a.truncate(inTriple(op, OP_ADDK_S) ? typedOpType(op, OP_ADDK_S) : typedOpType(op, OP_MULK_S));
+        a.storeR(in.a, RAX);
+    }
+    else if (inTriple(op, OP_QUOK_S) || inTriple(op, OP_REMK_S)) {
+        // Делитель известен: проверки на 0 и -1 не нужны в машинном коде
+        bool isDiv = inTriple(op, OP_QUOK_S);
+        a.loadR(RAX, in.b);
+        if (in.c == -1) {
+            if (isDiv) a.bytes({ 0x48, 0xF7, 0xD8 }); // neg rax
+            else a.bytes({ 0x31, 0xC0 }); // xor eax, eax
+        }
+        else {
+            a.bytes({ 0x48, 0xC7, 0xC1 }); a.u32(static_cast<uint32_t>(in.c)); // mov rcx, imm32
+            a.bytes({ 0x48, 0x99 }); // cqo
+            a.bytes({ 0x48, 0xF7, 0xF9 }); // idiv rcx
+            if (!isDiv) a.bytes({ 0x48, 0x89, 0xD0 }); // mov rax, rdx
+        }
+        a.truncate(typedOpType(op, isDiv ? OP_QUOK_S : OP_REMK_S));
+        a.storeR(in.a, RAX);
+    }
+    else if (op >= OP_EQ && op <= OP_GE) {
+        static const uint8_t setcc[] = { 0x94, 0x95, 0x9C, 0x9E, 0x9F, 0x9D }; // sete setne setl setle setg setge
+        a.loadR(RAX, in.b);
+        a.loadR(RCX, in.c);
+        a.bytes({ 0x48, 0x39, 0xC8 }); // cmp rax, rcx
+        a.bytes({ 0x0F, setcc[op - OP_EQ], 0xC0 }); // setcc al
+        a.bytes({ 0x0F, 0xB6, 0xC0 }); // movzx eax, al
+        a.storeR(in.a, RAX);
+    }
+    else if (op == OP_CAST_S || op == OP_CAST_I) {
+        a.loadR(RAX, in.b);
+        a.truncate(op == OP_CAST_S ? TYPE_SHORT_INT : TYPE_INT);
+        a.storeR(in.a, RAX);
+    }
+    else if (op == OP_NARROW_S || op == OP_NARROW_I) {
+        // Без обрезки — обычное приведение; с обрезкой — медленный путь (предупреждение)
+        a.loadR(RAX, in.b);
+        a.bytes({ 0x48, 0x89, 0xC1 }); // mov rcx, rax
+        a.truncate(op == OP_NARROW_S ? TYPE_SHORT_INT : TYPE_INT, RCX);
+        a.bytes({ 0x48, 0x39, 0xC8 }); // cmp rax, rcx
+        slowPath(0x74, pc); // je
+        a.storeR(in.a, RCX);
+    }
+    else if (op == OP_JMP) {
+        a.byte(0xE9);
+        branches.push_back(make_pair(a.pos(), static_cast<size_t>(in.a)));
+        a.u32(0);
+    }
+    else if (op == OP_JT || op == OP_JF) {
+        a.testR(in.a);
+        a.bytes({ 0x0F, static_cast<uint8_t>(op == OP_JT ? 0x85 : 0x84) }); // jne / je rel32
+        branches.push_back(make_pair(a.pos(), static_cast<size_t>(in.b)));
+        a.u32(0);
+    }
+    else if (op >= OP_JEQ && op <= OP_JNEK) {
+        a.loadR(RAX, in.a);
+        if (op == OP_JEQ || op == OP_JNE) { a.bytes({ 0x48, 0x3B, 0x83 }); a.u32(in.b * 8); } // cmp rax, [rbx + disp32]
+        else { a.bytes({ 0x48, 0x3D }); a.u32(static_cast<uint32_t>(in.b)); } // cmp rax, imm32
+        a.bytes({ 0x0F, static_cast<uint8_t>(op == OP_JEQ || op == OP_JEQK ? 0x84 : 0x85) }); // je / jne rel32
+        branches.push_back(make_pair(a.pos(), static_cast<size_t>(in.c)));
+        a.u32(0);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+﻿#pragma once
+#include "Bytecode.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+// Генерация машинного кода x86-64 для инструкций байт-кода: общая часть JIT (Jit.h)
+// и записи объектного файла (ElfEmitter.h). Код только строится в памяти, поэтому
+// компилируется на любой платформе.
+
+// Регистры x86-64 в поле reg / rm (без учёта REX)
+enum { RAX = 0, RCX = 1, RDX = 2, RSI = 6, RDI = 7 };
+
+// Шаблоны адресуют состояние VM через закреплённые регистры (сохраняются вызываемой стороной):
+// rbx — окно регистров R, r12 — признаки I, r13 — глобальные переменные G, r14 — их признаки GI
+
+// Минимальный ассемблер: только команды, которые нужны шаблонам инструкций
+class X86Assembler {
+public:
+    std::vector<uint8_t> code;
+
+    size_t pos() const { return code.size(); }
+    void byte(uint8_t b) { code.push_back(b); }
+    void bytes(std::initializer_list<uint8_t> list) { code.insert(code.end(), list); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; ++i) byte(static_cast<uint8_t>(v >> (8 * i))); }
+    void u64(uint64_t v) { for (int i = 0; i < 8; ++i) byte(static_cast<uint8_t>(v >> (8 * i))); }
+    void patch32(size_t at, int32_t v) { for (int i = 0; i < 4; ++i) code[at + i] = static_cast<uint8_t>(static_cast<uint32_t>(v) >> (8 * i)); }
+    void patch64(size_t at, uint64_t v) { for (int i = 0; i < 8; ++i) code[at + i] = static_cast<uint8_t>(v >> (8 * i)); }
+
+    // Короткий условный (или безусловный при cc == 0xEB) переход вперёд: смещение задаёт bind8
+    size_t jump8(uint8_t cc) { byte(cc); byte(0); return pos() - 1; }
+    void bind8(size_t at) { code[at] = static_cast<uint8_t>(pos() - (at + 1)); }
+
+    // reg <- R[r] / R[r] <- reg  (mov r64, [rbx + disp32])
+    void loadR(int reg, int r) { bytes({ 0x48, 0x8B, static_cast<uint8_t>(0x83 | (reg << 3)) }); u32(r * 8); }
+    void storeR(int r, int reg) { bytes({ 0x48, 0x89, static_cast<uint8_t>(0x83 | (reg << 3)) }); u32(r * 8); }
+    // rax <- G[g] / G[g] <- rax  ([r13 + disp32])
+    void loadG(int g) { bytes({ 0x49, 0x8B, 0x85 }); u32(g * 8); }
+    void storeG(int g) { bytes({ 0x49, 0x89, 0x85 }); u32(g * 8); }
+    // I[r] = 1 / GI[g] = 1
+    void setInit(int r) { bytes({ 0x41, 0xC6, 0x84, 0x24 }); u32(r); byte(1); }
+    void setGlobalInit(int g) { bytes({ 0x41, 0xC6, 0x86 }); u32(g); byte(1); }
+    // cmp byte [r12 + r], 0 / cmp byte [r14 + g], 0
+    void testInit(int r) { bytes({ 0x41, 0x80, 0xBC, 0x24 }); u32(r); byte(0); }
+    void testGlobalInit(int g) { bytes({ 0x41, 0x80, 0xBE }); u32(g); byte(0); }
+    // cmp qword [rbx + disp32], 0
+    void testR(int r) { bytes({ 0x48, 0x83, 0xBB }); u32(r * 8); byte(0); }
+
+    void movImm64(int reg, uint64_t v) { byte(0x48); byte(static_cast<uint8_t>(0xB8 + reg)); u64(v); }
+
+    // Приведение rax (или rcx) к short / int знаковым расширением младших разрядов
+    void truncate(DATA_TYPE type, int reg = RAX) {
+        uint8_t modrm = static_cast<uint8_t>(0xC0 | (reg << 3) | reg);
+        if (type == TYPE_SHORT_INT) bytes({ 0x48, 0x0F, 0xBF, modrm }); // movsx r64, r16
+        else if (type == TYPE_INT) bytes({ 0x48, 0x63, modrm }); // movsxd r64, r32
+    }
+};
+
+// Медленный путь инструкции pc: вызывается с кодом короткого условного перехода cc,
+// выполненного в обычном случае (переменная инициализирована, делитель не ноль, обрезки нет).
+// Должен сгенерировать jcc мимо медленного пути и сам медленный путь; если медленный путь
+// возвращается в шаблон, он сохраняет rax и rcx
+typedef std::function<void(uint8_t cc, size_t pc)> X86SlowPath;
+
+// Шаблон инструкции fn.code[pc]. Переходы записываются с нулевым смещением, в branches —
+// (место rel32, адрес байт-кода цели). false — инструкция не из общего набора
+// (SWITCH, вызовы, возврат, отладочный вывод): её генерирует вызывающая сторона
+bool emitX86Instruction(X86Assembler& a, const BcFunction& fn, size_t pc,
+    std::vector<std::pair<size_t, size_t>>& branches, const X86SlowPath& slowPath);
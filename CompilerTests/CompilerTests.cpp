@@ -1,10 +1,39 @@
 #include "pch.h"                   
 #include "CppUnitTest.h"   
 
+#include "../CompilerC++/SourceManager.cpp" // Таблица строк исходного текста
+#include "../CompilerC++/Arena.cpp" // Арены узлов и кадров
 #include "../CompilerC++/Scanner.cpp" // Реализация лексера
 #include "../CompilerC++/Tree.cpp" // Реализация семантического дерева
+#include "../CompilerC++/Kernels.cpp" // Ядра бинарных операций
+#include "../CompilerC++/Ast.cpp" // Узлы AST
+#include "../CompilerC++/Diagram.cpp" // Синтаксический анализатор (строит AST)
+#include "../CompilerC++/Executor.cpp" // Исполнитель AST
+#include "../CompilerC++/Inliner.cpp" // Встраивание функций
+#include "../CompilerC++/ConstFolder.cpp" // Свёртка и распространение констант
+#include "../CompilerC++/ConstProp.cpp" // Межпроцедурное распространение констант
+#include "../CompilerC++/Specializer.cpp" // Специализация функций по константным аргументам
+#include "../CompilerC++/DeadCode.cpp" // Удаление недостижимого кода
+#include "../CompilerC++/DefAssign.cpp" // Анализ определённого присваивания
+#include "../CompilerC++/Ranges.cpp" // Анализ диапазонов значений
+#include "../CompilerC++/Simplify.cpp" // Алгебраические упрощения
+#include "../CompilerC++/Ssa.cpp" // Промежуточное представление SSA
+#include "../CompilerC++/Cse.cpp" // Устранение общих подвыражений
+#include "../CompilerC++/Effects.cpp" // Анализ чтения и записи глобальных переменных
+#include "../CompilerC++/MemoCache.cpp" // Мемоизация вызовов
+#include "../CompilerC++/Bytecode.cpp" // Байт-код
+#include "../CompilerC++/Peephole.cpp" // Суперинструкции и удаление лишних приведений
+#include "../CompilerC++/BytecodeCompiler.cpp" // Компилятор AST в байт-код
+#include "../CompilerC++/VM.cpp" // Интерпретатор байт-кода
+#include "../CompilerC++/X86Emitter.cpp" // Шаблоны машинного кода x86-64
+#include "../CompilerC++/Jit.cpp" // JIT-компилятор байт-кода в машинный код
+#include "../CompilerC++/Aot.cpp" // AOT-компиляция через C++ и разделяемую библиотеку
+#include "../CompilerC++/ElfEmitter.cpp" // Запись объектного файла ELF
 #include "../CompilerC++/DataType.h" // Типы данных
 #include "../CompilerC++/Defines.h" // Коды лексем
+#if defined(__linux__)
+#include <dirent.h> // Просмотр каталога кеша AOT
+#endif
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace std;
@@ -27,6 +56,84 @@ namespace UnitTests
         Tree::Cur = Tree::Root;
     }
 
+    // Разобранная программа. Diagram владеет AST, поэтому живёт вместе с ним
+    struct ParsedProgram
+    {
+        Scanner sc;
+        Diagram dg;
+        ProgramNode* program;
+
+        explicit ParsedProgram(const string& source) : dg(&sc), program(nullptr)
+        {
+            Tree::reset();
+            sc.loadFromString(source);
+            program = dg.Parse();
+        }
+    };
+
+    // Способ исполнения программы в тестах
+    enum RUN_ENGINE { RUN_AST, RUN_VM, RUN_JIT, RUN_AOT };
+
+    // Исполнение разобранной программы; возвращает значение глобальной переменной
+    Value RunParsed(ProgramNode* program, const string& global, RUN_ENGINE engine)
+    {
+        if (engine == RUN_AST) {
+            Executor executor(program);
+            executor.run();
+            return executor.globalValue(global);
+        }
+
+        BytecodeCompiler compiler(false);
+        BcProgram* bytecode = compiler.compile(program);
+        Value value;
+        AotModule* aot = nullptr;
+        try {
+            if (engine == RUN_AOT) {
+                string error;
+                aot = AotModule::load(bytecode, error);
+                Assert::IsNotNull(aot);
+                aot->run();
+                value = aot->globalValue(global);
+            }
+            else {
+                VM vm(bytecode, engine == RUN_JIT);
+                vm.run();
+                value = vm.globalValue(global);
+            }
+        }
+        catch (...) {
+            delete aot;
+            delete bytecode;
+            throw;
+        }
+        delete aot;
+        delete bytecode;
+        return value;
+    }
+
+    // Разбор и исполнение программы из строки; maxDepth > 0 — предел глубины рекурсии
+    // (Tree::reset возвращает предел по умолчанию)
+    Value RunProgram(const string& source, const string& global, RUN_ENGINE engine = RUN_AST, int maxDepth = 0)
+    {
+        ParsedProgram parsed(source);
+        if (maxDepth > 0) Tree::setMaxRecursionDepth(maxDepth);
+        return RunParsed(parsed.program, global, engine);
+    }
+
+    // То же, но с исполнением на VM
+    Value RunProgramVM(const string& source, const string& global)
+    {
+        return RunProgram(source, global, RUN_VM);
+    }
+
+    // Компиляция программы из строки в байт-код (без отладочного вывода); владение переходит вызывающему
+    BcProgram* CompileProgram(const string& source)
+    {
+        ParsedProgram parsed(source);
+        BytecodeCompiler compiler(false);
+        return compiler.compile(parsed.program);
+    }
+
     // Тесты лексера
     TEST_CLASS(ScannerTests)
     {
@@ -134,7 +241,7 @@ namespace UnitTests
         // 7. Добавление переменной в текущую область видимости и проверка, что она там есть
         TEST_METHOD(TestIncludeVariable)
         {
-            Tree::Cur->semInclude("x", TYPE_INT, 1, 1);
+            Tree::Cur->semInclude("x", TYPE_INT, SrcLoc());
             Tree* found = Tree::Cur->findUp(Tree::Cur, "x");
 
             Assert::IsNotNull(found);
@@ -145,7 +252,7 @@ namespace UnitTests
         // 8. Попытка повторного объявления в той же области
         TEST_METHOD(TestDuplicateVariable)
         {
-            Tree::Cur->semInclude("x", TYPE_INT, 1, 1);
+            Tree::Cur->semInclude("x", TYPE_INT, SrcLoc());
             bool dup = Tree::Cur->dupControl(Tree::Cur, "x");
 
             Assert::IsTrue(dup); // dupControl должен вернуть true (повторное использование переменной!)
@@ -155,9 +262,9 @@ namespace UnitTests
         TEST_METHOD(TestFindVariableInParent)
         {
             // Объявляем x в глобальной области
-            Tree::Cur->semInclude("x", TYPE_INT, 1, 1);
+            Tree::Cur->semInclude("x", TYPE_INT, SrcLoc());
             // Входим во вложенный блок
-            Tree::Cur->semEnterBlock(2, 1);
+            Tree::Cur->semEnterBlock(SrcLoc());
             // Ищем x из блока — он должен найтись в родителе
             Tree* found = Tree::Cur->findUp(Tree::Cur, "x");
 
@@ -170,32 +277,29 @@ namespace UnitTests
         // 10. Присваивание значения переменной и последующее чтение
         TEST_METHOD(TestSetVarValue)
         {
-            Tree::Cur->semInclude("y", TYPE_INT, 1, 1);
-            SemNode val;
-            val.DataType = TYPE_INT;
-            val.hasValue = true;
-            val.Value.v_int32 = 42;
+            Tree::Cur->semInclude("y", TYPE_INT, SrcLoc());
+            Value val(TYPE_INT, 42);
 
-            Tree::setVarValue("y", val, 1, 1);
-            SemNode retrieved = Tree::getVarValue("y", 1, 1);
+            Tree::setVarValue("y", val, SrcLoc());
+            Value retrieved = Tree::getVarValue("y", SrcLoc());
 
             Assert::IsTrue(retrieved.hasValue); // Есть ли значение
-            Assert::AreEqual(42, retrieved.Value.v_int32); // Равно ли тому, что мы присвоили
+            Assert::AreEqual((int64_t)42, retrieved.v); // Равно ли тому, что мы присвоили
         }
 
         // 11. Повторное объявление переменной с тем же именем в разных блоках
         TEST_METHOD(TestDupDifferentScope)
         {
             // Объявляем x во внешнем блоке
-            Tree::Cur->semInclude("x", TYPE_INT, 1, 1);
+            Tree::Cur->semInclude("x", TYPE_INT, SrcLoc());
             // Входим во внутренний блок
-            Tree* block = Tree::Cur->semEnterBlock(2, 1);
+            Tree* block = Tree::Cur->semEnterBlock(SrcLoc());
             // Во внутреннем блоке ещё нет x - dupControl должен вернуть false
             bool dup = Tree::Cur->dupControl(Tree::Cur, "x");
             Assert::IsFalse(dup);
 
             // Теперь объявляем x во внутреннем блоке (допустимо)
-            Tree::Cur->semInclude("x", TYPE_BOOL, 2, 2);
+            Tree::Cur->semInclude("x", TYPE_BOOL, SrcLoc());
             // Проверяем, что теперь повторное объявление есть уже во внутреннем блоке
             dup = Tree::Cur->dupControl(Tree::Cur, "x");
             Assert::IsTrue(dup);
@@ -209,46 +313,2204 @@ namespace UnitTests
         // 12. Арифметическая операция сложения двух целых
         TEST_METHOD(TestArithmeticAdd)
         {
-            SemNode left, right;
             // Два целых числа: 5 + 3
-            left.DataType = TYPE_INT; left.hasValue = true; left.Value.v_int32 = 5;
-            right.DataType = TYPE_INT; right.hasValue = true; right.Value.v_int32 = 3;
+            Value left(TYPE_INT, 5), right(TYPE_INT, 3);
 
-            SemNode result = Tree::executeArithmeticOp(left, right, "+", 1, 1);
+            Value result = Tree::executeArithmeticOp(left, right, BOP_ADD, SrcLoc());
 
             // Должно получиться такое же целое 8
             Assert::IsTrue(result.hasValue);
-            Assert::AreEqual(8, result.Value.v_int32); 
-            Assert::AreEqual((int)TYPE_INT, (int)result.DataType);
+            Assert::AreEqual((int64_t)8, result.v);
+            Assert::AreEqual((int)TYPE_INT, (int)result.type);
         }
 
         // 13. Операция сравнения < (результат bool)
         TEST_METHOD(TestComparisonLess)
         {
             // 5 < 10
-            SemNode left, right;
-            left.DataType = TYPE_INT; left.hasValue = true; left.Value.v_int32 = 5;
-            right.DataType = TYPE_INT; right.hasValue = true; right.Value.v_int32 = 10;
+            Value left(TYPE_INT, 5), right(TYPE_INT, 10);
 
-            SemNode result = Tree::executeComparisonOp(left, right, "<", 1, 1);
+            Value result = Tree::executeComparisonOp(left, right, BOP_LT, SrcLoc());
 
             // Должно вернуть true
             Assert::IsTrue(result.hasValue);
-            Assert::IsTrue(result.Value.v_bool);
-            Assert::AreEqual((int)TYPE_BOOL, (int)result.DataType);
+            Assert::IsTrue(result.v != 0);
+            Assert::AreEqual((int)TYPE_BOOL, (int)result.type);
         }
 
         // 14. Операция сдвига влево (побитовый сдвиг)
         TEST_METHOD(TestShiftLeft)
         {
-            SemNode left, right;
-            left.DataType = TYPE_INT; left.hasValue = true; left.Value.v_int32 = 4; // двоичное 100
-            right.DataType = TYPE_INT; right.hasValue = true; right.Value.v_int32 = 2;
+            Value left(TYPE_INT, 4); // двоичное 100
+            Value right(TYPE_INT, 2);
 
-            SemNode result = Tree::executeShiftOp(left, right, "<<", 1, 1);
+            Value result = Tree::executeShiftOp(left, right, BOP_SHL, SrcLoc());
 
             Assert::IsTrue(result.hasValue);
-            Assert::AreEqual(16, result.Value.v_int32); // 4 << 2 = 16 (100 << 2 = 10000)
+            Assert::AreEqual((int64_t)16, result.v); // 4 << 2 = 16 (100 << 2 = 10000)
+        }
+    };
+
+    // Тесты исполнения программ (AST строится один раз, затем исполняется Executor'ом)
+    TEST_CLASS(ExecutorTests)
+    {
+    public:
+        // 15. Рекурсивный вызов исполняется без повторного разбора тела
+        TEST_METHOD(TestRecursiveCall)
+        {
+            Value acc = RunProgram(
+                "long acc = 1;"
+                "void fact(int k) { switch (k) { case 0: break; default: acc = acc * k; fact(k - 1); break; } }"
+                "void main() { fact(10); }", "acc");
+
+            Assert::IsTrue(acc.hasValue);
+            Assert::AreEqual((int64_t)3628800, acc.v);
+        }
+
+        // 16. Ветвь switch без break продолжается следующей ветвью
+        TEST_METHOD(TestSwitchFallThrough)
+        {
+            Value a = RunProgram(
+                "int a = 2;"
+                "void main() { switch (1) { case 1: a = a * 3; case 2: a = a + 1; break; a = 999; default: a = 0; } }", "a");
+
+            Assert::AreEqual((int64_t)7, a.v);
+        }
+    };
+
+    // Тесты компилятора байт-кода и VM
+    TEST_CLASS(VMTests)
+    {
+    public:
+        // 17. Рекурсия, switch и глобальные переменные на VM
+        TEST_METHOD(TestRecursiveCallVM)
+        {
+            Value acc = RunProgramVM(
+                "long acc = 1;"
+                "void fact(int k) { switch (k) { case 0: break; default: acc = acc * k; fact(k - 1); break; } }"
+                "void main() { fact(10); }", "acc");
+
+            Assert::IsTrue(acc.hasValue);
+            Assert::AreEqual((int64_t)3628800, acc.v);
+        }
+
+        // 18. Приведения, сдвиги и обрезка дают на VM тот же результат, что и обход AST
+        TEST_METHOD(TestVMMatchesExecutor)
+        {
+            const string source =
+                "short s = 30000; int i = 0; long l = 5;"
+                "void f(short a, long b) { s = s + a; i = -(a * 3) % 7 + (b << 33 >> 31); l = l * b / (a - 1); }"
+                "void main() { f(1000, 100000); }";
+
+            const char* names[] = { "s", "i", "l" };
+            for (const char* name : names) {
+                Value expected = RunProgram(source, name);
+                Value actual = RunProgramVM(source, name);
+                Assert::AreEqual((int)expected.type, (int)actual.type);
+                Assert::AreEqual(expected.v, actual.v);
+            }
+        }
+    };
+
+    // Тесты потока лексем и позиций в исходном тексте
+    TEST_CLASS(TokenStreamTests)
+    {
+    public:
+        // 19. Поток лексем: коды, смещения, текст лексем и вычисленные значения констант
+        TEST_METHOD(TestTokenize)
+        {
+            Scanner sc;
+            sc.loadFromString("long x = 0x1F; // c\n x = 017 + 42;");
+            TokenStream ts = sc.tokenize();
+
+            Assert::AreEqual((size_t)12, ts.size());
+            Assert::AreEqual(KW_LONG, (int)ts.kind[0]);
+            Assert::AreEqual(IDENT, (int)ts.kind[1]);
+            Assert::IsTrue(ts.lexeme(1) == "x");
+            Assert::AreEqual(HEX_CONST, (int)ts.kind[3]);
+            Assert::AreEqual((uint64_t)31, ts.value[3]);
+            Assert::AreEqual((uint32_t)21, ts.offset[5]); // x во второй строке
+            Assert::AreEqual((uint64_t)15, ts.value[7]); // 017 — восьмеричная, как у std::stoll
+            Assert::AreEqual((uint64_t)42, ts.value[9]);
+            Assert::AreEqual(T_END, (int)ts.kind[11]);
+        }
+
+        // 20. Таблица строк: смещение переводится в строку и столбец без повторного просмотра текста
+        TEST_METHOD(TestLineTable)
+        {
+            SourceManager sm;
+            sm.load("int a;\nshort b;\n\nlong c;");
+
+            Assert::AreEqual(1, sm.lineCol(3).first);
+            Assert::AreEqual(3, sm.lineCol(3).second);
+            Assert::AreEqual(2, sm.lineCol(7).first); // сразу после перевода строки
+            Assert::AreEqual(1, sm.lineCol(7).second);
+            Assert::AreEqual(4, sm.lineCol(21).first);
+            Assert::AreEqual(5, sm.lineCol(21).second);
+            Assert::AreEqual(-1, SrcLoc().lineCol().first); // неизвестная позиция
+        }
+    };
+
+    // Тесты хеш-индекса областей видимости
+    TEST_CLASS(ScopeIndexTests)
+    {
+    public:
+        TEST_METHOD_INITIALIZE(Init)
+        {
+            ResetTree();
+        }
+
+        // 21. Поиск среди большого числа описаний, сокрытие имени во вложенном блоке и его снятие
+        TEST_METHOD(TestManySymbolsAndShadowing)
+        {
+            for (int i = 0; i < 5000; i++) {
+                Tree::Cur->semInclude("v" + to_string(i), i % 2 ? TYPE_LONG_INT : TYPE_SHORT_INT, SrcLoc());
+            }
+            Tree* outer = Tree::Cur->semGetVar("v4999", SrcLoc());
+            Assert::AreEqual((int)TYPE_LONG_INT, (int)outer->n->DataType);
+            Assert::IsTrue(Tree::Cur->dupControl(Tree::Cur, "v0"));
+            Assert::IsFalse(Tree::Cur->dupControl(Tree::Cur, "v5000"));
+
+            Tree::Cur->semEnterBlock(SrcLoc());
+            Tree* inner = Tree::Cur->semInclude("v4999", TYPE_INT, SrcLoc());
+            Assert::IsTrue(Tree::Cur->semGetVar("v4999", SrcLoc()) == inner); // внутреннее описание скрывает внешнее
+            Assert::IsTrue(Tree::Cur->semGetVar("v17", SrcLoc())->n->DataType == TYPE_LONG_INT);
+            Tree::Cur->semExitBlock();
+
+            Assert::IsTrue(Tree::Cur->semGetVar("v4999", SrcLoc()) == outer);
+            Assert::IsNull(Tree::Cur->findUp(Tree::Cur, "неописанное"));
+        }
+    };
+
+    // Тесты разрешения переменных в ячейки при разборе
+    TEST_CLASS(SlotTests)
+    {
+    public:
+        // 22. Параметры и локальные переменные вложенных блоков уплощаются в кадр функции,
+        // внутреннее описание получает свою ячейку, глобальные нумеруются по порядку
+        TEST_METHOD(TestSlotResolution)
+        {
+            Tree::reset();
+            Scanner sc;
+            sc.loadFromString(
+                "int g; long h;"
+                "void f(short a) { int x = a; { long x = 7; h = x; } { bool y = true; } g = x; }"
+                "void main() { f(5); }");
+            Diagram dg(&sc);
+            ProgramNode* program = dg.Parse();
+
+            Assert::AreEqual(1, program->globals[1]->slot.index);
+            Assert::IsTrue(program->globals[1]->slot.global);
+
+            FuncNode* f = program->functions[0];
+            Assert::AreEqual((size_t)4, f->slotTypes.size()); // a, x, внутренний x, y
+            Assert::AreEqual((int)TYPE_SHORT_INT, (int)f->slotTypes[0]);
+            Assert::AreEqual((int)TYPE_LONG_INT, (int)f->slotTypes[2]);
+            Assert::AreEqual((int)TYPE_BOOL, (int)f->slotTypes[3]);
+
+            StmtNode* inner = f->body->body[1];
+            StmtNode* assignH = inner->body[1];
+            Assert::IsFalse(assignH->value->slot.global);
+            Assert::AreEqual(2, assignH->value->slot.index); // h = x читает внутренний x
+            StmtNode* assignG = f->body->body[3];
+            Assert::AreEqual(1, assignG->value->slot.index); // g = x — внешний x
+
+            Executor executor(program);
+            executor.run();
+            Assert::AreEqual((int64_t)7, executor.globalValue("h").v);
+            Assert::AreEqual((int64_t)5, executor.globalValue("g").v);
+        }
+    };
+
+    // Тесты арен
+    TEST_CLASS(ArenaTests)
+    {
+    public:
+        // 23. Откат к отметке освобождает память за O(1) и она используется повторно;
+        // после выполнения программы арена кадров пуста, пик соответствует глубине рекурсии
+        TEST_METHOD(TestArenaRegions)
+        {
+            Arena arena(256);
+            void* first = arena.allocate(16, 8);
+            Arena::Mark m = arena.mark();
+            void* second = arena.allocate(100, 8);
+            arena.allocate(300, 8); // больше блока — отдельный блок
+            Assert::AreEqual((size_t)2, arena.chunkCount());
+            arena.release(m);
+            Assert::AreEqual((size_t)16, arena.bytesUsed());
+            Assert::IsTrue(arena.allocate(100, 8) == second);
+            Assert::IsTrue(first != second);
+
+            Tree::reset();
+            Scanner sc;
+            sc.loadFromString(
+                "int acc = 0;"
+                "void f(int n) { int t = n * 2; switch (n) { case 0: break; default: f(n - 1); acc = acc + t; } }"
+                "void main() { f(10); }");
+            Diagram dg(&sc);
+            Executor executor(dg.Parse());
+            executor.run();
+
+            Assert::AreEqual((int64_t)110, executor.globalValue("acc").v);
+            Assert::AreEqual((size_t)0, executor.frameStats().bytesUsed());
+            Assert::IsTrue(executor.frameStats().peakBytes() >= 11 * 2 * sizeof(Value));
+            Assert::AreEqual((size_t)1, executor.frameStats().chunkCount());
+        }
+    };
+
+    // Тесты значений времени исполнения
+    TEST_CLASS(ValueTests)
+    {
+    public:
+        // 24. Value занимает 16 байт; переполнение short/int и сдвиги дают одинаковый
+        // канонический результат в интерпретаторе AST и в VM
+        TEST_METHOD(TestValueLayoutAndWrap)
+        {
+            Assert::AreEqual((size_t)16, sizeof(Value));
+            Value v(TYPE_SHORT_INT, -5);
+            Assert::IsTrue(v.hasValue);
+            Assert::IsFalse(Value().hasValue);
+
+            string source =
+                "short s = 32767; int i = 2147483647; long l = 1; int r = 0;"
+                "void main() { s = s + 1; i = i + 1; l = l << 40; r = i / (-1 + 2); }";
+            const char* names[] = { "s", "i", "l", "r" };
+            int64_t expected[] = { -32768, -2147483647LL - 1, 1LL << 40, -2147483647LL - 1 };
+            for (int k = 0; k < 4; k++) {
+                Value ast = RunProgram(source, names[k]);
+                Value vm = RunProgramVM(source, names[k]);
+                Assert::AreEqual(expected[k], ast.v);
+                Assert::AreEqual(expected[k], vm.v);
+                Assert::AreEqual((int)ast.type, (int)vm.type);
+            }
+        }
+    };
+
+    // Тесты ядер бинарных операций
+    TEST_CLASS(KernelTests)
+    {
+    public:
+        // 25. Ядра выбираются по (операция, тип) при проверке типов; недопустимые сочетания
+        // отсутствуют в таблице, деление на ноль обнаруживается ядром
+        TEST_METHOD(TestKernelTable)
+        {
+            Assert::AreEqual((int64_t)-32768, selectKernel(BOP_ADD, TYPE_SHORT_INT)(32767, 1, SrcLoc()));
+            Assert::AreEqual((int64_t)32768, selectKernel(BOP_ADD, TYPE_INT)(32767, 1, SrcLoc()));
+            Assert::AreEqual((int64_t)1 << 40, selectKernel(BOP_SHL, TYPE_LONG_INT)(1, 40, SrcLoc()));
+            Assert::AreEqual((int64_t)256, selectKernel(BOP_SHL, TYPE_INT)(1, 40, SrcLoc())); // 40 & 31 = 8
+            Assert::AreEqual((int64_t)1, selectKernel(BOP_EQ, TYPE_BOOL)(1, 1, SrcLoc()));
+            Assert::IsTrue(selectKernel(BOP_ADD, TYPE_BOOL) == nullptr);
+            Assert::IsTrue(selectKernel(BOP_LT, TYPE_BOOL) == nullptr);
+            Assert::ExpectException<runtime_error>([]() { selectKernel(BOP_DIV, TYPE_INT)(1, 0, SrcLoc()); });
+
+            Tree::reset();
+            Scanner sc;
+            sc.loadFromString("long r = 0; void main() { short s = 3; int i = 4; r = s * i + 1; }");
+            Diagram dg(&sc);
+            ProgramNode* program = dg.Parse();
+            ExprNode* sum = program->functions[0]->body->body[2]->value;
+            Assert::AreEqual((int)BOP_ADD, (int)sum->op);
+            Assert::IsTrue(sum->kernel == selectKernel(BOP_ADD, TYPE_INT));
+            Assert::IsTrue(sum->left->kernel == selectKernel(BOP_MUL, TYPE_INT));
+        }
+    };
+
+    // Тесты таблиц переходов switch
+    TEST_CLASS(SwitchTableTests)
+    {
+    public:
+        // 26. Разреженные метки — отсортированный список с двоичным поиском; нет метки — ветвь default
+        TEST_METHOD(TestSparseLabels)
+        {
+            Tree::reset();
+            Scanner sc;
+            sc.loadFromString("int r = 0; void main() { long x = 1000000;"
+                "  switch (x) { case 5: r = 1; case 1000000: r = r + 2; case 77777777: r = r + 4; break; default: r = 100; } }");
+            Diagram dg(&sc);
+            StmtNode* sparse = dg.Parse()->functions[0]->body->body[1];
+
+            Assert::IsFalse(sparse->table->dense);
+            Assert::AreEqual(3, sparse->table->defaultTarget);
+            Assert::AreEqual(1, sparse->table->find(1000000));
+            Assert::AreEqual(3, sparse->table->find(6));
+        }
+
+        // 27. Плотные метки — массив переходов; без default значение вне меток — выход из switch
+        TEST_METHOD(TestDenseLabels)
+        {
+            Tree::reset();
+            Scanner sc;
+            sc.loadFromString("int r = 6; int q = 0;"
+                "void main() { switch (r) { case 0: q = 10; case 6: q = q + 1; break; case 2: q = 20; case 3: q = 30; } }");
+            Diagram dg(&sc);
+            StmtNode* dense = dg.Parse()->functions[0]->body->body[0];
+
+            Assert::IsTrue(dense->table->dense);
+            Assert::AreEqual(4, dense->table->defaultTarget);
+            Assert::AreEqual(1, dense->table->find(6));
+            Assert::AreEqual(4, dense->table->find(-1));
+            Assert::AreEqual(4, dense->table->find(5));
+        }
+
+        // 28. Выбор ветви и проваливание по таблице совпадают в AST и VM
+        TEST_METHOD(TestSwitchTableDispatch)
+        {
+            string source =
+                "int r = 0; int q = 0;"
+                "void main() { long x = 1000000;"
+                "  switch (x) { case 5: r = 1; case 1000000: r = r + 2; case 77777777: r = r + 4; break; default: r = 100; }"
+                "  switch (r) { case 0: q = 10; case 6: q = q + 1; break; case 2: q = 20; case 3: q = 30; } }";
+
+            Assert::AreEqual((int64_t)6, RunProgram(source, "r").v);
+            Assert::AreEqual((int64_t)6, RunProgramVM(source, "r").v);
+            Assert::AreEqual((int64_t)1, RunProgram(source, "q").v); // case 6: q = q + 1; break;
+            Assert::AreEqual((int64_t)1, RunProgramVM(source, "q").v);
+        }
+
+        // 29. Повторяющаяся метка case (в том числе в другой записи) — ошибка при разборе
+        TEST_METHOD(TestSwitchDuplicateLabel)
+        {
+            Tree::reset();
+            Scanner sc;
+            sc.loadFromString("int r = 0; void main() { switch (r) { case 1: r = 1; break; case 2: r = 2; case 0x1: r = 3; } }");
+            Diagram dg(&sc);
+            Assert::ExpectException<runtime_error>([&dg]() { dg.Parse(); });
+        }
+    };
+
+    // Тесты рекурсии
+    TEST_CLASS(RecursionTests)
+    {
+    public:
+        // 30. Хвостовые вызовы отмечаются при разборе: вызов, после которого в функции ничего не исполняется
+        TEST_METHOD(TestTailCallsMarked)
+        {
+            ParsedProgram parsed(
+                "long acc = 0; int depth = 0;"
+                "void loop(long i, long n) { switch (n - i) { case 0: break; default: acc = acc + i; loop(i + 1, n); } }"
+                "void down(int n) { switch (n) { case 0: break; default: down(n - 1); depth = depth + 1; } }"
+                "void main() { loop(0, 1); down(1); }");
+            vector<FuncNode*>& functions = parsed.program->functions;
+
+            Assert::IsTrue(functions[0]->body->body[0]->cases[1]->body[1]->tail); // loop(i + 1, n)
+            Assert::IsFalse(functions[1]->body->body[0]->cases[1]->body[0]->tail); // down(n - 1)
+            Assert::IsFalse(functions[2]->body->body[0]->tail); // loop(0, 1) в main
+            Assert::IsTrue(functions[2]->body->body[1]->tail); // down(1) в main
+            Tree::reset();
+        }
+
+        // 31. Хвостовые вызовы не увеличивают глубину: цикл на 200000 итераций укладывается в предел 10
+        TEST_METHOD(TestTailLoopWithinDepthLimit)
+        {
+            string source =
+                "long acc = 0;"
+                "void loop(long i, long n) { switch (n - i) { case 0: break; default: acc = acc + i; loop(i + 1, n); } }"
+                "void main() { loop(0, 200000); }";
+
+            Assert::AreEqual((int64_t)199999 * 200000 / 2, RunProgram(source, "acc", RUN_AST, 10).v);
+            Assert::AreEqual((int64_t)199999 * 200000 / 2, RunProgram(source, "acc", RUN_VM, 10).v);
+            Tree::reset();
+        }
+
+        // 32. Не хвостовая рекурсия глубиной 100000 исполняется без роста стека C++
+        TEST_METHOD(TestDeepRecursion)
+        {
+            string source =
+                "int depth = 0;"
+                "void down(int n) { switch (n) { case 0: break; default: down(n - 1); depth = depth + 1; } }"
+                "void main() { down(100000); }";
+
+            Assert::AreEqual((int64_t)100000, RunProgram(source, "depth", RUN_AST, 100000).v);
+            Assert::AreEqual((int64_t)100000, RunProgram(source, "depth", RUN_VM, 100000).v);
+            Tree::reset();
+        }
+
+        // 33. Превышение предела глубины по-прежнему обнаруживается
+        TEST_METHOD(TestDepthLimitExceeded)
+        {
+            string source =
+                "int depth = 0;"
+                "void down(int n) { switch (n) { case 0: break; default: down(n - 1); depth = depth + 1; } }"
+                "void main() { down(100000); }";
+
+            Assert::ExpectException<runtime_error>([&]() { RunProgram(source, "depth", RUN_AST, 99999); });
+            Assert::ExpectException<runtime_error>([&]() { RunProgram(source, "depth", RUN_VM, 99999); });
+            Tree::reset();
+        }
+    };
+
+    // Тесты JIT
+    TEST_CLASS(JitTests)
+    {
+    public:
+        // 34. Функции, вызванные больше CALL_THRESHOLD раз (step и loop), компилируются в машинный код
+        TEST_METHOD(TestHotFunctionsCompiled)
+        {
+            ParsedProgram parsed(
+                "long sum = 0;"
+                "void step(int k) { sum = sum + k * k; }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default: step(k); loop(k + 1, n); } }"
+                "void main() { loop(0, 300); }");
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+            VM vm(bytecode, true);
+            vm.run();
+
+            Assert::AreEqual(JitCode::supported() ? (size_t)2 : (size_t)0, vm.compiledFunctions());
+            Assert::AreEqual((int64_t)299 * 300 * 599 / 6, vm.globalValue("sum").v);
+            delete bytecode;
+            Tree::reset();
+        }
+
+        // 35. Арифметика с переполнением, деление и остаток (в том числе на -1) и сдвиги — как на VM
+        TEST_METHOD(TestJitArithmetic)
+        {
+            string source =
+                "long sum = 0; int wide = 0;"
+                "void step(int k) { int a = k * 1000003 - 7; long b = a; int m = a / -1 + a % -1;"
+                "  b = b * b * b + (b << 20) - (b >> 3);"
+                "  wide = wide + a / (k % 7 * 2 - 7) + a % (k % 5 * 2 - 5) + (a << (k % 40)) - (a >> (k % 9));"
+                "  sum = sum + b / 3 + m + wide; }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default: step(k); loop(k + 1, n); } }"
+                "void main() { loop(0, 300); }";
+
+            Assert::AreEqual(RunProgram(source, "wide", RUN_VM).v, RunProgram(source, "wide", RUN_JIT).v);
+            Assert::AreEqual(RunProgram(source, "sum", RUN_VM).v, RunProgram(source, "sum", RUN_JIT).v);
+            Tree::reset();
+        }
+
+        // 36. switch с проваливанием и обрезка int до short при присваивании — как на VM
+        TEST_METHOD(TestJitSwitchAndTruncation)
+        {
+            string source =
+                "int m = 0; short narrow = 0;"
+                "void step(int k) { short s = 0; int a = k * 1000003 - 7;"
+                "  switch (k % 6) { case 0: m = m - k; case 1: m = m + 5; break; case 3: m = m * 3; break; default: m = -k; }"
+                "  s = a; narrow = narrow + s; }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default: step(k); loop(k + 1, n); } }"
+                "void main() { loop(0, 300); }";
+
+            Assert::AreEqual(RunProgram(source, "m", RUN_VM).v, RunProgram(source, "m", RUN_JIT).v);
+            Assert::AreEqual(RunProgram(source, "narrow", RUN_VM).v, RunProgram(source, "narrow", RUN_JIT).v);
+            Tree::reset();
+        }
+
+        // 37. Сравнения long и bool — как на VM
+        TEST_METHOD(TestJitComparisons)
+        {
+            string source =
+                "bool flag = false; bool other = false;"
+                "void step(int k) { int a = k * 1000003 - 7; long b = a; b = b * b;"
+                "  flag = (a < b) == (k >= 150) == flag;"
+                "  other = b != a * 2 == (a <= k); }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default: step(k); loop(k + 1, n); } }"
+                "void main() { loop(0, 300); }";
+
+            Assert::AreEqual(RunProgram(source, "flag", RUN_VM).v, RunProgram(source, "flag", RUN_JIT).v);
+            Assert::AreEqual(RunProgram(source, "other", RUN_VM).v, RunProgram(source, "other", RUN_JIT).v);
+            Tree::reset();
+        }
+
+        // 38. Деление на ноль в скомпилированной функции по-прежнему ошибка
+        TEST_METHOD(TestJitDivisionByZero)
+        {
+            string source =
+                "int z = 0;"
+                "void d(int k) { z = 1000 / (k - 200); }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default: d(k); loop(k + 1, n); } }"
+                "void main() { loop(0, 300); }";
+
+            Assert::ExpectException<runtime_error>([&]() { RunProgram(source, "z", RUN_JIT); });
+            Tree::reset();
+        }
+
+        // 39. Чтение неинициализированной переменной в скомпилированной функции по-прежнему ошибка
+        TEST_METHOD(TestJitUninitializedRead)
+        {
+            string source =
+                "int z = 0;"
+                "void u(int k) { int x; switch (k) { case 250: break; default: x = k; } z = x; }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default: u(k); loop(k + 1, n); } }"
+                "void main() { loop(0, 300); }";
+
+            Assert::ExpectException<runtime_error>([&]() { RunProgram(source, "z", RUN_JIT); });
+            Tree::reset();
+        }
+    };
+
+    // Тесты AOT-компиляции
+    TEST_CLASS(AotTests)
+    {
+    public:
+        // 40. Программа, переведённая в C++ и загруженная из библиотеки, даёт те же значения, что и VM:
+        // переполнение, деление на -1, сдвиги, switch, обрезка
+        TEST_METHOD(TestAotMatchesVM)
+        {
+            if (!AotModule::supported()) return;
+            string source =
+                "long sum = 0; short narrow = 0;"
+                "void step(int k) { int a = k * 1000003 - 7; long b = a; short s = 0; int m = 0;"
+                "  b = b * b * b + (b << 20) - (b >> 3);"
+                "  switch (k % 6) { case 0: m = a / -1; case 1: m = m + 5; break; case 3: m = a % -1; break; default: m = -k; }"
+                "  s = a; narrow = narrow + s; sum = sum + b / 3 + m + narrow; }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default: step(k); loop(k + 1, n); } }"
+                "void main() { loop(0, 300); }";
+
+            Assert::AreEqual(RunProgramVM(source, "sum").v, RunProgram(source, "sum", RUN_AOT).v);
+            Assert::AreEqual(RunProgramVM(source, "narrow").v, RunProgram(source, "narrow", RUN_AOT).v);
+            Tree::reset();
+        }
+
+        // 41. Повторная загрузка того же байт-кода берёт библиотеку из кеша
+        TEST_METHOD(TestAotLibraryCached)
+        {
+            if (!AotModule::supported()) return;
+            BcProgram* bytecode = CompileProgram("int z = 0; void main() { z = 41; }");
+            string error;
+            delete AotModule::load(bytecode, error);
+            AotModule* aot = AotModule::load(bytecode, error);
+
+            Assert::IsNotNull(aot);
+            Assert::IsTrue(aot->fromCache());
+            aot->run();
+            Assert::AreEqual((int64_t)41, aot->globalValue("z").v);
+            delete aot;
+            delete bytecode;
+            Tree::reset();
+        }
+
+        // 42. Деление на ноль — ошибка, как на VM
+        TEST_METHOD(TestAotDivisionByZero)
+        {
+            if (!AotModule::supported()) return;
+            Assert::ExpectException<runtime_error>([]() {
+                RunProgram("int z = 0; void d(int k) { z = 1000 / (k - 200); } void main() { d(200); }", "z", RUN_AOT);
+            });
+            Tree::reset();
+        }
+
+        // 43. Чтение неинициализированной переменной — ошибка, как на VM
+        TEST_METHOD(TestAotUninitializedRead)
+        {
+            if (!AotModule::supported()) return;
+            Assert::ExpectException<runtime_error>([]() {
+                RunProgram("int z = 0; void main() { int x; z = x; }", "z", RUN_AOT);
+            });
+            Tree::reset();
+        }
+
+        // 44. Превышение глубины рекурсии — ошибка, как на VM
+        TEST_METHOD(TestAotRecursionLimit)
+        {
+            if (!AotModule::supported()) return;
+            Assert::ExpectException<runtime_error>([]() {
+                RunProgram("int z = 0; void r(int n) { r(n + 1); z = n; } void main() { r(0); }", "z", RUN_AOT);
+            });
+            Tree::reset();
+        }
+
+        // 45. Каталог кеша, доступный другим пользователям, не используется: библиотека из него
+        // была бы загружена без проверки
+        TEST_METHOD(TestAotRefusesSharedCacheDir)
+        {
+#if defined(__linux__)
+            string pattern = (getenv("TMPDIR") ? string(getenv("TMPDIR")) : string("/tmp")) + "/aot_shared_XXXXXX";
+            vector<char> root(pattern.begin(), pattern.end());
+            root.push_back('\0');
+            Assert::IsNotNull(mkdtemp(root.data()));
+            string dir = string(root.data()) + "/translator-aot";
+            mkdir(dir.c_str(), 0777);
+            chmod(dir.c_str(), 0777);
+
+            const char* previous = getenv("XDG_CACHE_HOME");
+            string saved = previous ? previous : "";
+            setenv("XDG_CACHE_HOME", root.data(), 1);
+            BcProgram* bytecode = CompileProgram("int z = 0; void main() { z = 45; }");
+            string error;
+            AotModule* aot = AotModule::load(bytecode, error);
+            if (previous) setenv("XDG_CACHE_HOME", saved.c_str(), 1);
+            else unsetenv("XDG_CACHE_HOME");
+
+            Assert::IsNull(aot);
+            Assert::IsFalse(error.empty());
+            delete bytecode;
+            rmdir(dir.c_str());
+            rmdir(root.data());
+#endif
+            Tree::reset();
+        }
+
+        // 46. Библиотека с тем же хешем, но другим сохранённым текстом не берётся из кеша, а пересобирается
+        TEST_METHOD(TestAotSourceMismatchRebuilds)
+        {
+#if defined(__linux__)
+            string pattern = (getenv("TMPDIR") ? string(getenv("TMPDIR")) : string("/tmp")) + "/aot_cache_XXXXXX";
+            vector<char> root(pattern.begin(), pattern.end());
+            root.push_back('\0');
+            Assert::IsNotNull(mkdtemp(root.data()));
+            string dir = string(root.data()) + "/translator-aot";
+
+            const char* previous = getenv("XDG_CACHE_HOME");
+            string saved = previous ? previous : "";
+            setenv("XDG_CACHE_HOME", root.data(), 1);
+            BcProgram* bytecode = CompileProgram("int z = 0; void main() { z = 46; }");
+            string error;
+            delete AotModule::load(bytecode, error);
+            // Сохранённый текст подменяется: библиотека рядом с ним собрана не по этой программе
+            DIR* listing = opendir(dir.c_str());
+            Assert::IsNotNull(listing);
+            while (dirent* entry = readdir(listing)) {
+                string name = entry->d_name;
+                if (name.size() > 4 && name.compare(name.size() - 4, 4, ".cpp") == 0) {
+                    FILE* file = fopen((dir + "/" + name).c_str(), "a");
+                    fputs("// другая программа\n", file);
+                    fclose(file);
+                }
+            }
+            closedir(listing);
+            AotModule* aot = AotModule::load(bytecode, error);
+            if (previous) setenv("XDG_CACHE_HOME", saved.c_str(), 1);
+            else unsetenv("XDG_CACHE_HOME");
+
+            Assert::IsNotNull(aot);
+            Assert::IsFalse(aot->fromCache());
+            aot->run();
+            Assert::AreEqual((int64_t)46, aot->globalValue("z").v);
+            delete aot;
+            delete bytecode;
+            listing = opendir(dir.c_str());
+            while (dirent* entry = readdir(listing)) {
+                if (entry->d_name[0] != '.') unlink((dir + "/" + entry->d_name).c_str());
+            }
+            closedir(listing);
+            rmdir(dir.c_str());
+            rmdir(root.data());
+#endif
+            Tree::reset();
+        }
+    };
+
+    // Тесты записи объектного файла
+    TEST_CLASS(ElfTests)
+    {
+    public:
+        // 47. Объектный файл — перемещаемый ELF x86-64
+        TEST_METHOD(TestElfHeader)
+        {
+            BcProgram* bytecode = CompileProgram("int z = 0; void main() { z = 1; }");
+            vector<uint8_t> object = ElfEmitter::emitObject(*bytecode, 100000);
+            delete bytecode;
+
+            Assert::IsTrue(object.size() > 64);
+            Assert::IsTrue(object[0] == 0x7F && object[1] == 'E' && object[2] == 'L' && object[3] == 'F');
+            Assert::AreEqual(2, (int)object[4]); // ELFCLASS64
+            Assert::AreEqual(1, (int)(object[16] | object[17] << 8)); // ET_REL
+            Assert::AreEqual(62, (int)(object[18] | object[19] << 8)); // EM_X86_64
+            Tree::reset();
+        }
+
+        // 48. В таблице символов есть _start, функции, глобальные переменные и секция данных
+        TEST_METHOD(TestElfSymbols)
+        {
+            BcProgram* bytecode = CompileProgram(
+                "long total = 0; short part = 0;"
+                "void add(long n) { total = total + n; part = total; }"
+                "void main() { add(1000); }");
+            vector<uint8_t> object = ElfEmitter::emitObject(*bytecode, 100000);
+            delete bytecode;
+
+            string text(object.begin(), object.end());
+            for (const char* name : { "_start", "add", "main", "total", "part", ".data" }) {
+                Assert::IsTrue(text.find(string(name) + '\0') != string::npos);
+            }
+            Tree::reset();
+        }
+
+        // 49. На Linux объектный файл компонуется системным компоновщиком, и программа завершается с кодом 0
+        TEST_METHOD(TestElfExecutableExitCode)
+        {
+#if defined(__linux__) && defined(__x86_64__)
+            string path = (getenv("TMPDIR") ? string(getenv("TMPDIR")) : string("/tmp")) + "/elf_ok";
+            BcProgram* bytecode = CompileProgram(
+                "long total = 0; short part = 0;"
+                "void add(long n) { switch (n) { case 0: break; default: total = total + n; part = total; add(n - 1); } }"
+                "void main() { add(1000); }");
+            string error;
+            Assert::IsTrue(ElfEmitter::writeExecutable(*bytecode, 100000, path, error));
+            delete bytecode;
+
+            Assert::AreEqual(0, system(("\"" + path + "\" 2>/dev/null").c_str()));
+#endif
+            Tree::reset();
+        }
+
+        // 50. При делении на ноль скомпонованная программа завершается с кодом 1
+        TEST_METHOD(TestElfDivisionByZeroExitCode)
+        {
+#if defined(__linux__) && defined(__x86_64__)
+            string path = (getenv("TMPDIR") ? string(getenv("TMPDIR")) : string("/tmp")) + "/elf_fail";
+            BcProgram* bytecode = CompileProgram("int z = 0; void f(int k) { z = 10 / k; } void main() { f(5); f(0); }");
+            string error;
+            Assert::IsTrue(ElfEmitter::writeExecutable(*bytecode, 100000, path, error));
+            delete bytecode;
+
+            Assert::AreEqual(1, WEXITSTATUS(system(("\"" + path + "\" 2>/dev/null").c_str())));
+#endif
+            Tree::reset();
+        }
+    };
+
+    // Тесты свёртки и распространения констант
+    TEST_CLASS(ConstFolderTests)
+    {
+    public:
+        // 51. Выражение с известными операндами сворачивается с разрядностью и переполнением,
+        // как при исполнении: int 2147483647 + 1 переполняется, short 32767 + 1 -> -32768
+        TEST_METHOD(TestFoldedExpressionOverflow)
+        {
+            ParsedProgram parsed(
+                "short lim = 32767; int big = 2147483647; long r = 0;"
+                "void main() { short choice = 2; r = big + 1 + (-(choice * 3)) + (lim + 1); }");
+            ConstFolder folder;
+            folder.run(parsed.program);
+            StmtNode* assign = parsed.program->main->body->body[1];
+
+            Assert::IsTrue(folder.foldedExpressions() >= 4);
+            Assert::AreEqual((int)EXPR_CONST, (int)assign->value->kind);
+            Assert::AreEqual((int)TYPE_INT, (int)assign->value->type);
+            Assert::AreEqual(toInt(toInt(2147483647LL + 1) - 6 - 32768), (long long)assign->value->value.v);
+            Tree::reset();
+        }
+
+        // 52. Неизменяемая переменная с константным инициализатором заменяется значением
+        TEST_METHOD(TestImmutableVariablePropagated)
+        {
+            ParsedProgram parsed("short lim = 32767; int s = 0; void main() { s = lim + 0; }");
+            ConstFolder folder;
+            folder.run(parsed.program);
+            StmtNode* assign = parsed.program->main->body->body[0];
+
+            Assert::AreEqual(1, folder.propagatedUses());
+            Assert::AreEqual((int)EXPR_CONST, (int)assign->value->kind);
+            Assert::AreEqual(32767LL, (long long)assign->value->value.v);
+            Tree::reset();
+        }
+
+        // 53. switch с константным селектором сразу получает ветвь
+        TEST_METHOD(TestConstantSwitchResolved)
+        {
+            ParsedProgram parsed(
+                "int z = 0;"
+                "void main() { short choice = 2; switch (choice - 1) { case 0: z = 1; break; case 1: z = 7; break; default: z = 9; } }");
+            ConstFolder folder;
+            folder.run(parsed.program);
+            StmtNode* sw = parsed.program->main->body->body[1];
+
+            Assert::AreEqual(1, folder.resolvedSwitches());
+            Assert::AreEqual(1, sw->table->find(12345));
+            Assert::AreEqual(7LL, RunParsed(parsed.program, "z", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 54. Переменная, которой присваивается, не сворачивается
+        TEST_METHOD(TestReassignedVariableNotFolded)
+        {
+            ParsedProgram parsed("int z = 0; void main() { int moved = 1; moved = moved + 1; z = moved; }");
+            ConstFolder folder;
+            folder.run(parsed.program);
+
+            Assert::AreEqual((int)EXPR_BINARY, (int)parsed.program->main->body->body[1]->value->kind);
+            Assert::AreEqual(2LL, RunParsed(parsed.program, "z", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 55. После свёртки значения на AST и VM те же, что и без неё
+        TEST_METHOD(TestFoldedResultsMatch)
+        {
+            string source =
+                "short lim = 32767; int big = 2147483647; long r = 0; int s = 0; int z = 0;"
+                "void sub(int n, int m) { r = r - (n + m); }"
+                "void main() {"
+                "    short choice = 2; int moved = 1;"
+                "    s = lim + 0;"
+                "    r = big + 1 + (-(choice * 3)) + (lim + 1);"
+                "    switch (choice - 1) { case 0: r = 100; break; case 1: sub(1, - 1); case 2: z = 7; break; default: z = 9; }"
+                "    moved = moved + 1; z = z + moved;"
+                "}"
+                "int after = s * 2;";
+            long long r = RunProgram(source, "r").v;
+
+            ParsedProgram folded(source);
+            ConstFolder().run(folded.program);
+            Executor executor(folded.program);
+            executor.run();
+            Assert::AreEqual(r, executor.globalValue("r").v);
+            Assert::AreEqual(9LL, executor.globalValue("z").v);
+            Assert::AreEqual(32767LL * 2, executor.globalValue("after").v);
+
+            ParsedProgram compiled(source);
+            ConstFolder().run(compiled.program);
+            Assert::AreEqual(r, RunParsed(compiled.program, "r", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 56. Деление на константный ноль не сворачивается и остаётся ошибкой исполнения
+        TEST_METHOD(TestDivisionByConstantZeroKept)
+        {
+            ParsedProgram parsed("int q = 0; void main() { q = 5 / (3 - 3); }");
+            ConstFolder().run(parsed.program);
+
+            Assert::ExpectException<runtime_error>([&parsed]() { RunParsed(parsed.program, "q", RUN_AST); });
+            Tree::reset();
+        }
+    };
+
+    // Тесты удаления недостижимого кода
+    TEST_CLASS(DeadCodeTests)
+    {
+    public:
+        // 57. switch с константным селектором становится блоком из операторов достижимых ветвей
+        TEST_METHOD(TestConstantSwitchBecomesBlock)
+        {
+            ParsedProgram parsed(
+                "int a = 2;"
+                "void mult(int n) { a = a * n; }"
+                "void sub(int n, int m) { a = a - (n + m); }"
+                "void main() { short choice = 2;"
+                "  switch (choice - 1) { case 0: a = 0; break; case 1: mult(-1); case 2: sub(1, - 1); break; a = 999; default: a = 5; } }");
+            ConstFolder().run(parsed.program);
+            DeadCodeEliminator dce;
+            dce.run(parsed.program);
+            StmtNode* block = parsed.program->main->body->body[1];
+
+            Assert::AreEqual(2, dce.removedBranches()); // case 0 и default
+            Assert::AreEqual((int)STMT_BLOCK, (int)block->kind);
+            Assert::AreEqual((size_t)2, block->body.size()); // mult(-1); sub(1, -1)
+            Assert::AreEqual(string("mult"), block->body[0]->name);
+            Assert::AreEqual(-2LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 58. Операторы ветви switch после break удаляются
+        TEST_METHOD(TestStatementsAfterBreakRemoved)
+        {
+            ParsedProgram parsed(
+                "int a = 3; int b = 0;"
+                "void main() { a = a * a - 8; switch (a) { case 1: b = 1; break; b = 2; b = 3; default: b = 4; } }");
+            DeadCodeEliminator dce;
+            dce.run(parsed.program);
+            StmtNode* sw = parsed.program->main->body->body[1];
+
+            Assert::AreEqual(2, dce.removedStatements());
+            Assert::AreEqual((size_t)2, sw->cases[0]->body.size());
+            Assert::AreEqual(1LL, RunParsed(parsed.program, "b", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 59. Функции, не вызываемые из main (прямо или через другие функции), удаляются
+        TEST_METHOD(TestUnusedFunctionsRemoved)
+        {
+            ParsedProgram parsed(
+                "int a = 0;"
+                "void unused(int n) { a = n; }"
+                "void alsoUnused() { unused(1); }"
+                "void used(int n) { a = n; }"
+                "void main() { used(3); }");
+            DeadCodeEliminator dce;
+            dce.run(parsed.program);
+
+            Assert::AreEqual(2, dce.removedFunctions());
+            Assert::AreEqual((size_t)2, parsed.program->functions.size());
+            Assert::AreEqual(string("used"), parsed.program->functions[0]->name);
+            Tree::reset();
+        }
+
+        // 60. После оптимизации результат выполнения не меняется
+        TEST_METHOD(TestDeadCodeResultsUnchanged)
+        {
+            string source =
+                "int a = 2; int b = 0;"
+                "void unused(int n) { a = n; }"
+                "void mult(int n) { a = a * n; }"
+                "void sub(int n, int m) { a = a - (n + m); }"
+                "void main() {"
+                "    short choice = 2;"
+                "    switch (choice - 1) { case 0: a = 0; break; case 1: mult(-1); case 2: sub(1, - 1); break; a = 999; default: a = 5; }"
+                "    switch (a) { case 1: b = 1; break; b = 2; b = 3; default: b = 4; }"
+                "}";
+            ParsedProgram parsed(source);
+            parsed.dg.Optimize(false);
+            Executor executor(parsed.program);
+            executor.run();
+
+            Assert::AreEqual(-2LL, executor.globalValue("a").v);
+            Assert::AreEqual(4LL, executor.globalValue("b").v);
+            Assert::AreEqual(RunProgram(source, "a").v, executor.globalValue("a").v);
+            Tree::reset();
+        }
+
+        // 61. Семантическая ошибка в недостижимом операторе после break по-прежнему сообщается при разборе
+        TEST_METHOD(TestErrorInDeadCodeReported)
+        {
+            Assert::ExpectException<runtime_error>([]() {
+                ParsedProgram bad("int a = 0; void main() { switch (1) { case 1: break; a = true; } }");
+            });
+            Tree::reset();
+        }
+    };
+
+    // Тесты встраивания функций
+    TEST_CLASS(InlinerTests)
+    {
+    public:
+        // 62. Небольшая функция встраивается в место вызова, вызов попадает в отчёт
+        TEST_METHOD(TestSmallFunctionInlined)
+        {
+            ParsedProgram parsed("int a = 1; void inc(int n) { a = a + n; } void main() { inc(2); inc(3); }");
+            Inliner inliner(16);
+            inliner.run(parsed.program);
+
+            Assert::AreEqual(2, inliner.inlinedCalls());
+            Assert::IsTrue(inliner.inlinedReport()[0].find("inc -> main") == 0);
+            Assert::AreEqual((int)STMT_BLOCK, (int)parsed.program->main->body->body[0]->kind);
+            Assert::AreEqual((int)STMT_BLOCK, (int)parsed.program->main->body->body[1]->kind);
+            Assert::AreEqual(6LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 63. Аргумент приводится к типу параметра, как castToType: обрезка без предупреждения
+        TEST_METHOD(TestArgumentCastToParameterType)
+        {
+            ParsedProgram parsed("long a = 0; void set(short n) { a = n; } void main() { set(70000); }");
+            Inliner(16).run(parsed.program);
+            StmtNode* param = parsed.program->main->body->body[0]->body[0];
+
+            Assert::AreEqual((int)STMT_VAR_DECL, (int)param->kind);
+            Assert::AreEqual((int)EXPR_CAST, (int)param->value->kind);
+            Assert::AreEqual((int)TYPE_SHORT_INT, (int)param->declType);
+            Assert::AreEqual(4464LL, RunParsed(parsed.program, "a", RUN_AST).v); // 70000 - 65536
+            Tree::reset();
+        }
+
+        // 64. Рекурсивная функция не встраивается, её хвостовой вызов остаётся хвостовым
+        TEST_METHOD(TestRecursiveNotInlined)
+        {
+            ParsedProgram parsed(
+                "int a = 0;"
+                "void down(int k) { switch (k) { case 0: break; default: a = a + k; down(k - 1); } }"
+                "void main() { down(4); }");
+            Inliner inliner(16);
+            inliner.run(parsed.program);
+            StmtNode* call = parsed.program->functions[0]->body->body[0]->cases[1]->body[1];
+
+            Assert::AreEqual(0, inliner.inlinedCalls());
+            Assert::AreEqual((int)STMT_CALL, (int)call->kind);
+            Assert::IsTrue(call->tail);
+            Assert::AreEqual(10LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 65. Функция больше предела встраивается только с большим пределом
+        TEST_METHOD(TestBudgetLimitsInlining)
+        {
+            string source =
+                "long a = 2;"
+                "void big(int n) { int t = n * 2; a = a + t * t - t / 3 + (t << 2) - (t >> 1) + t % 5; }"
+                "void main() { big(7); }";
+            ParsedProgram small(source);
+            Inliner tight(16);
+            tight.run(small.program);
+            Assert::AreEqual(0, tight.inlinedCalls());
+
+            ParsedProgram large(source);
+            Inliner generous(64);
+            generous.run(large.program);
+            Assert::AreEqual(1, generous.inlinedCalls());
+            Assert::AreEqual(RunProgram(source, "a").v, RunParsed(large.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 66. Вложенные встраивания: результаты на AST и VM совпадают с исполнением без встраивания
+        TEST_METHOD(TestInlinedResultsMatch)
+        {
+            string source =
+                "long a = 2; int hits = 0;"
+                "void add(short n) { a = a + n; }"
+                "void twice(int n) { add(n); add(n); hits = hits + 1; }"
+                "void main() { add(70000); twice(-3); twice(5); }";
+            long long expected = RunProgram(source, "a").v;
+            ParsedProgram parsed(source);
+            Inliner inliner(64);
+            inliner.run(parsed.program);
+
+            Assert::AreEqual(5, inliner.inlinedCalls());
+            Assert::AreEqual(expected, RunParsed(parsed.program, "a", RUN_AST).v);
+            Assert::AreEqual(expected, RunParsed(parsed.program, "a", RUN_VM).v);
+            Assert::AreEqual(2LL, RunParsed(parsed.program, "hits", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 67. Предел 0 — ничего не встраивается
+        TEST_METHOD(TestZeroBudgetInlinesNothing)
+        {
+            ParsedProgram parsed("int a = 1; void inc(int n) { a = a + n; } void main() { inc(2); }");
+            Inliner none(0);
+            none.run(parsed.program);
+            Assert::AreEqual(0, none.inlinedCalls());
+            Assert::AreEqual((int)STMT_CALL, (int)parsed.program->main->body->body[0]->kind);
+            Tree::reset();
+        }
+    };
+
+    // Тесты специализации функций по константным аргументам
+    TEST_CLASS(SpecializerTests)
+    {
+    public:
+        static int CountClones(ProgramNode* program, const string& name)
+        {
+            int count = 0;
+            for (FuncNode* f : program->functions) {
+                if (f->name.rfind(name + ".constprop.", 0) == 0) count++;
+            }
+            return count;
+        }
+
+        // 68. Для кортежа констант, встречающегося в нескольких вызовах, создаётся копия функции
+        TEST_METHOD(TestCloneForRepeatedTuple)
+        {
+            ParsedProgram parsed(
+                "int a = 0; void add(int n, int m) { a = a + n * m; }"
+                "void main() { add(2, 3); add(2, 3); add(a, 1); }");
+            Specializer spec;
+            spec.run(parsed.program);
+
+            // add(a, 1) встречается один раз и switch не задаёт — остаётся вызовом add
+            Assert::AreEqual(1, spec.clonesCreated());
+            Assert::AreEqual(2, spec.callsRedirected());
+            Assert::AreEqual(1, CountClones(parsed.program, "add"));
+            Assert::AreEqual(24LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 69. Параметр, от которого зависит селектор switch, специализируется даже в одном вызове;
+        // после свёртки и удаления недостижимого кода switch в копии исчезает
+        TEST_METHOD(TestSwitchSelectorFolded)
+        {
+            ParsedProgram parsed(
+                "int a = 0;"
+                "void step(short mode) { switch (mode) { case 0: a = a + 1; break; default: a = a * 2; } }"
+                "void main() { step(0); step(5); }");
+            Specializer spec;
+            spec.run(parsed.program);
+            ConstFolder().run(parsed.program);
+            DeadCodeEliminator().run(parsed.program);
+
+            Assert::AreEqual(2, CountClones(parsed.program, "step"));
+            for (FuncNode* f : parsed.program->functions) {
+                Assert::IsTrue(f->body->body[0]->kind != STMT_SWITCH);
+            }
+            Assert::AreEqual(2LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 70. Константа приводится к типу параметра, как при вызове (65536 как short — это 0)
+        TEST_METHOD(TestCloneArgumentConverted)
+        {
+            string source =
+                "long a = 0;"
+                "void set(short n) { switch (n) { case 0: a = 1; break; default: a = n; } }"
+                "void main() { set(65536); }";
+            ParsedProgram parsed(source);
+            Specializer().run(parsed.program);
+            ConstFolder().run(parsed.program);
+
+            Assert::AreEqual(1, CountClones(parsed.program, "set"));
+            Assert::AreEqual(1LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Assert::AreEqual(RunProgram(source, "a").v, 1LL);
+            Tree::reset();
+        }
+
+        // 71. Рекурсия не разворачивается в цепочку копий
+        TEST_METHOD(TestRecursionNotUnrolled)
+        {
+            ParsedProgram parsed(
+                "int res = 0;"
+                "void fib(int k) { switch (k) { case 0: break; case 1: res = res + 1; break; default: fib(k - 1); fib(k - 2); } }"
+                "void main() { fib(12); }");
+            Specializer spec;
+            for (int round = 0; round < Specializer::MAX_ROUNDS; round++) {
+                spec.run(parsed.program);
+                ConstFolder().run(parsed.program);
+            }
+
+            Assert::AreEqual(1, CountClones(parsed.program, "fib"));
+            Assert::AreEqual(144LL, RunParsed(parsed.program, "res", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 72. Число копий одной функции ограничено, вызовы сверх предела идут в исходную функцию
+        TEST_METHOD(TestClonesLimited)
+        {
+            ParsedProgram parsed(
+                "long acc = 1;"
+                "void step(short mode) { switch (mode) { case 0: acc = acc + 1; break; default: acc = acc * mode; } }"
+                "void main() { step(0); step(2); step(3); step(4); step(5); step(6); }");
+            Specializer spec;
+            spec.run(parsed.program);
+
+            Assert::AreEqual((int)Specializer::MAX_CLONES, CountClones(parsed.program, "step"));
+            Assert::AreEqual(string("step"), parsed.program->main->body->body[5]->callee->name);
+            Assert::AreEqual(1440LL, RunParsed(parsed.program, "acc", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 73. Параметр, которому присваивается в теле, не специализируется
+        TEST_METHOD(TestAssignedParameterNotSpecialized)
+        {
+            ParsedProgram parsed(
+                "int a = 0;"
+                "void f(int n) { n = n + 1; switch (n) { case 2: a = a + 10; break; default: a = a + 1; } }"
+                "void main() { f(1); f(1); }");
+            Specializer spec;
+            spec.run(parsed.program);
+
+            Assert::AreEqual(0, spec.clonesCreated());
+            Assert::AreEqual(20LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 74. После полной оптимизации результаты на AST и VM совпадают с исполнением без неё
+        TEST_METHOD(TestSpecializedResultsMatch)
+        {
+            string source =
+                "long acc = 1; int res = 0;"
+                "void step(short mode, long x) { switch (mode) { case 0: acc = acc + x; break;"
+                "  case 1: acc = acc - x; break; case 2: acc = acc * x % 1000003; break; default: acc = acc + x * x; } }"
+                "void fib(int k) { switch (k) { case 0: break; case 1: res = res + 1; break; default: fib(k - 1); fib(k - 2); } }"
+                "void loop(long i, long n) { step(2, i + 1); step(65536, i); step(7, 3); step(7, 3);"
+                "  switch (n - i) { case 0: break; default: loop(i + 1, n); } }"
+                "void main() { loop(0, 300); fib(12); step(1, 5); step(3, 1); }";
+            long long expected = RunProgram(source, "acc").v;
+            ParsedProgram parsed(source);
+            parsed.dg.Optimize(false);
+
+            Assert::AreEqual(expected, RunParsed(parsed.program, "acc", RUN_AST).v);
+            Assert::AreEqual(expected, RunParsed(parsed.program, "acc", RUN_VM).v);
+            Assert::AreEqual(144LL, RunParsed(parsed.program, "res", RUN_VM).v);
+            Tree::reset();
+        }
+    };
+
+    // Тесты мемоизации вызовов
+    TEST_CLASS(MemoizationTests)
+    {
+    public:
+        // 75. fib (ветвящаяся рекурсия, результат — только в r, который пишется на любом пути)
+        // размечается для запоминания по аргументу
+        TEST_METHOD(TestBranchingRecursionMarked)
+        {
+            ParsedProgram parsed(
+                "long r;"
+                "void fib(int n) { switch (n) { case 0: r = 0; break; case 1: r = 1; break;"
+                "  default: { long a; fib(n - 1); a = r; fib(n - 2); r = a + r; } } }"
+                "void main() { fib(10); }");
+            EffectAnalysis effects;
+            effects.run(parsed.program);
+            FuncNode* fib = parsed.program->functions[0];
+
+            Assert::AreEqual(1, effects.memoizedFunctions());
+            Assert::IsTrue(fib->memoId >= 0);
+            Assert::AreEqual((size_t)0, fib->memoReads.size());
+            Assert::AreEqual((size_t)1, fib->memoWrites.size());
+            Tree::reset();
+        }
+
+        // 76. Функция, которая читает и меняет счётчик, не мемоизируется: ключи не повторяются
+        TEST_METHOD(TestCounterNotMarked)
+        {
+            ParsedProgram parsed(
+                "int moves = 0;"
+                "void hanoi(int n) { switch (n) { case 0: break; default: hanoi(n - 1); moves = moves + 1; hanoi(n - 1); } }"
+                "void main() { hanoi(10); }");
+            EffectAnalysis effects;
+            effects.run(parsed.program);
+
+            Assert::AreEqual(-1, parsed.program->functions[0]->memoId);
+            Assert::AreEqual(1023LL, RunParsed(parsed.program, "moves", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 77. Функция, которая может напечатать предупреждение об обрезке, не мемоизируется
+        TEST_METHOD(TestNarrowingNotMarked)
+        {
+            ParsedProgram parsed(
+                "short s = 0;"
+                "void wide(int n) { switch (n) { case 0: break; default: s = n * 1000; wide(n - 1); wide(n - 1); } }"
+                "void main() { wide(3); }");
+            EffectAnalysis effects;
+            effects.run(parsed.program);
+
+            Assert::AreEqual(0, effects.memoizedFunctions());
+            Assert::AreEqual(-1, parsed.program->functions[0]->memoId);
+            Tree::reset();
+        }
+
+        // 78. На AST каждый fib(n) выполняется один раз, повторные вызовы берутся из кеша
+        TEST_METHOD(TestMemoHitsOnExecutor)
+        {
+            ParsedProgram parsed(
+                "long r;"
+                "void fib(int n) { switch (n) { case 0: r = 0; break; case 1: r = 1; break;"
+                "  default: { long a; fib(n - 1); a = r; fib(n - 2); r = a + r; } } }"
+                "void main() { fib(80); }");
+            EffectAnalysis().run(parsed.program);
+            Executor executor(parsed.program);
+            executor.run();
+
+            Assert::AreEqual(23416728348467685LL, executor.globalValue("r").v);
+            Assert::AreEqual((uint64_t)80, executor.memoStats().misses());
+            Assert::AreEqual((uint64_t)78, executor.memoStats().hits());
+            Tree::reset();
+        }
+
+        // 79. На VM и JIT запомненные вызовы так же не повторяются
+        TEST_METHOD(TestMemoHitsOnVMAndJit)
+        {
+            ParsedProgram parsed(
+                "long r;"
+                "void fib(int n) { switch (n) { case 0: r = 0; break; case 1: r = 1; break;"
+                "  default: { long a; fib(n - 1); a = r; fib(n - 2); r = a + r; } } }"
+                "void main() { fib(80); }");
+            EffectAnalysis().run(parsed.program);
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+            for (int jit = 0; jit < 2; ++jit) {
+                VM vm(bytecode, jit != 0);
+                vm.run();
+                Assert::AreEqual(23416728348467685LL, vm.globalValue("r").v);
+                Assert::AreEqual((uint64_t)78, vm.memoStats().hits());
+            }
+            delete bytecode;
+            Tree::reset();
+        }
+
+        // 80. Без мемоизации функции не размечаются, результат тот же
+        TEST_METHOD(TestMemoizationDisabled)
+        {
+            string source =
+                "long r;"
+                "void fib(int n) { switch (n) { case 0: r = 0; break; case 1: r = 1; break;"
+                "  default: { long a; fib(n - 1); a = r; fib(n - 2); r = a + r; } } }"
+                "void main() { fib(20); }";
+            ParsedProgram plain(source);
+            plain.dg.setMemoization(false, false);
+            plain.dg.Optimize(false);
+
+            for (FuncNode* f : plain.program->functions) {
+                Assert::AreEqual(-1, f->memoId);
+            }
+            Assert::AreEqual(6765LL, RunParsed(plain.program, "r", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 81. Запомненный вызов не повторяется там, где он превысил бы предел глубины рекурсии:
+        // fib(20) записан из main, из wrap(5) он начался бы на 5 уровней глубже
+        TEST_METHOD(TestMemoNotReusedBeyondDepthLimit)
+        {
+            string source =
+                "long r; int pad = 0;"
+                "void fib(int n) { switch (n) { case 0: r = 0; break; case 1: r = 1; break;"
+                "  default: { long a; fib(n - 1); a = r; fib(n - 2); r = a + r; } } }"
+                "void wrap(int d) { switch (d) { case 0: fib(20); break; default: wrap(d - 1); pad = 0; } }";
+            for (RUN_ENGINE engine : { RUN_AST, RUN_VM }) {
+                ParsedProgram shallow(source + "void main() { fib(20); }");
+                EffectAnalysis().run(shallow.program);
+                Tree::setMaxRecursionDepth(22);
+                Assert::AreEqual(6765LL, RunParsed(shallow.program, "r", engine).v);
+
+                ParsedProgram deep(source + "void main() { fib(20); wrap(5); }");
+                EffectAnalysis().run(deep.program);
+                Tree::setMaxRecursionDepth(22);
+                Assert::ExpectException<runtime_error>([&]() { RunParsed(deep.program, "r", engine); });
+            }
+            Tree::reset();
+        }
+    };
+
+    // Тесты межпроцедурного распространения констант
+    TEST_CLASS(ConstPropagatorTests)
+    {
+    public:
+        static int CountReads(const ExprNode* e, const string& name)
+        {
+            if (!e) return 0;
+            return (e->kind == EXPR_VAR && e->name == name ? 1 : 0) + CountReads(e->left, name) + CountReads(e->right, name);
+        }
+
+        static int CountReads(const StmtNode* s, const string& name)
+        {
+            int count = CountReads(s->value, name);
+            for (const ExprNode* a : s->args) count += CountReads(a, name);
+            for (const StmtNode* item : s->body) count += CountReads(item, name);
+            for (const CaseNode* c : s->cases) {
+                for (const StmtNode* item : c->body) count += CountReads(item, name);
+            }
+            return count;
+        }
+
+        // 82. Параметр, получающий во всех вызовах одно значение, заменяется этим значением
+        TEST_METHOD(TestParameterConstantInAllCalls)
+        {
+            ParsedProgram parsed(
+                "long acc = 0; void add(int k, long lim) { acc = acc + k * lim; }"
+                "void main() { add(1, 5); add(2, 5); }");
+            ConstPropagator propagator;
+            propagator.run(parsed.program);
+
+            Assert::AreEqual(1, propagator.constantParams());
+            Assert::AreEqual(0, CountReads(parsed.program->functions[0]->body, "lim"));
+            Assert::AreEqual(1, CountReads(parsed.program->functions[0]->body, "k"));
+            Assert::AreEqual(15LL, RunParsed(parsed.program, "acc", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 83. Значение доходит через параметр вызывающей функции и рекурсивный вызов
+        TEST_METHOD(TestParameterThroughWrapperAndRecursion)
+        {
+            ParsedProgram parsed(
+                "long acc = 0;"
+                "void step(int k, long lim) { acc = acc + k * lim; switch (k - lim) { case 0: break; default: step(k + 1, lim); } }"
+                "void run(long lim) { step(0, lim); step(1, lim); }"
+                "void main() { run(5); run(5); }");
+            ConstPropagator propagator;
+            propagator.run(parsed.program);
+            FuncNode* step = parsed.program->functions[0];
+
+            Assert::AreEqual(2, propagator.constantParams()); // run.lim и step.lim
+            Assert::AreEqual(0, CountReads(step->body, "lim"));
+            Assert::AreEqual(3, CountReads(step->body, "k"));
+            Assert::AreEqual(300LL, RunParsed(parsed.program, "acc", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 84. Значение приводится к типу параметра, как при вызове (70000 как short — это 4464)
+        TEST_METHOD(TestParameterConvertedToType)
+        {
+            ParsedProgram parsed("long a = 0; void f(short m) { a = a + m; } void main() { f(70000); f(70000); }");
+            ConstPropagator().run(parsed.program);
+            ConstFolder().run(parsed.program);
+            ExprNode* sum = parsed.program->functions[0]->body->body[0]->value;
+
+            Assert::AreEqual((int)EXPR_CONST, (int)sum->right->kind);
+            Assert::AreEqual(4464LL, sum->right->value.v);
+            Assert::AreEqual(8928LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 85. Глобальная переменная, которой присваивается одна константа, заменяется значением
+        // там, где присваивание заведомо выполнено
+        TEST_METHOD(TestOnceAssignedGlobalReplaced)
+        {
+            ParsedProgram parsed(
+                "int scale; long acc = 0;"
+                "void setup() { scale = 3; }"
+                "void step(int k) { acc = acc + k * scale; }"
+                "void main() { setup(); step(1); step(2); }");
+            ConstPropagator propagator;
+            propagator.run(parsed.program);
+
+            Assert::AreEqual(1, propagator.onceAssignedGlobals());
+            Assert::AreEqual(0, CountReads(parsed.program->functions[1]->body, "scale"));
+            Assert::AreEqual(9LL, RunParsed(parsed.program, "acc", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 86. Если функция может выполниться до присваивания, чтение остаётся (с проверкой
+        // неинициализированной переменной): первый вызов use — до set()
+        TEST_METHOD(TestReadBeforeAssignmentKept)
+        {
+            ParsedProgram parsed(
+                "int g; int out = 0; int seen = 0;"
+                "void set() { g = 7; }"
+                "void use(int w) { switch (seen) { case 0: break; default: out = out + g * w; } }"
+                "void main() { use(3); set(); seen = 1; use(3); }");
+            ConstPropagator propagator;
+            propagator.run(parsed.program);
+            FuncNode* use = parsed.program->functions[1];
+
+            Assert::AreEqual(1, CountReads(use->body, "g"));
+            Assert::AreEqual(0, CountReads(use->body, "w"));
+            Assert::AreEqual(21LL, RunParsed(parsed.program, "out", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 87. Параметр, которому присваивается в теле, не заменяется
+        TEST_METHOD(TestAssignedParameterKept)
+        {
+            ParsedProgram parsed("int a = 0; void f(int n) { n = n + 1; a = a + n; } void main() { f(1); f(1); }");
+            ConstPropagator propagator;
+            propagator.run(parsed.program);
+
+            Assert::AreEqual(0, propagator.constantParams());
+            Assert::AreEqual(4LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 88. Проходы чередуются со свёрткой; результаты на AST и VM совпадают с исполнением без них
+        TEST_METHOD(TestPropagatedResultsMatch)
+        {
+            string source =
+                "int scale; short mode; long acc = 0; int g; int out = 0; int seen = 0;"
+                "void setup() { scale = 3; mode = 70000; }"
+                "void step(int k, long lim, int m) { acc = acc + k * scale + lim * m;"
+                "  switch (k - lim) { case 0: break; default: step(k + 1, lim, m); } }"
+                "void run(long lim) { step(0, lim, mode); step(1, lim, mode); }"
+                "void set() { g = 7; }"
+                "void use(int w) { switch (seen) { case 0: break; default: out = out + g * w; } }"
+                "void main() { setup(); run(5); run(5); seen = 0; use(3); set(); seen = 1; use(3); }";
+            long long expected = RunProgram(source, "acc").v;
+            ParsedProgram parsed(source);
+            ConstFolder().run(parsed.program);
+            ConstPropagator propagator;
+            int rounds = 0;
+            for (; rounds < ConstPropagator::MAX_ROUNDS && propagator.run(parsed.program) > 0; ++rounds) {
+                ConstFolder().run(parsed.program);
+            }
+
+            // mode = 70000 становится 4464, и тогда константой становится и аргумент m
+            Assert::AreEqual(2, rounds);
+            Assert::AreEqual(0, CountReads(parsed.program->functions[1]->body, "m"));
+            Assert::AreEqual(expected, RunParsed(parsed.program, "acc", RUN_AST).v);
+            Assert::AreEqual(expected, RunParsed(parsed.program, "acc", RUN_VM).v);
+            Assert::AreEqual(21LL, RunParsed(parsed.program, "out", RUN_VM).v);
+            Tree::reset();
+        }
+    };
+
+    // Тесты анализа определённого присваивания
+    TEST_CLASS(DefiniteAssignmentTests)
+    {
+    public:
+        // 89. Переменная, присвоенная на всех путях switch (ветвь 0 проваливается в ветвь 1),
+        // читается без проверки; параметры и глобальные переменные с инициализатором — тоже
+        TEST_METHOD(TestAssignedOnAllPathsProven)
+        {
+            ParsedProgram parsed(
+                "int z = 0;"
+                "void f(int k) { int b; switch (k) { case 0: z = 1; case 1: b = 2; break; default: b = 4; } z = z + b; }"
+                "void main() { f(0); }");
+            DefiniteAssignment assignment;
+            assignment.run(parsed.program);
+
+            Assert::AreEqual(3, assignment.provenReads()); // k, z, b
+            Assert::AreEqual(0, assignment.checkedReads());
+            Assert::AreEqual(3LL, RunParsed(parsed.program, "z", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 90. Если присваивание есть не на всех путях, проверка остаётся
+        TEST_METHOD(TestMaybeUnassignedChecked)
+        {
+            ParsedProgram parsed(
+                "int g;"
+                "void f(int k) { int a; switch (k) { case 0: a = 1; break; default: break; } g = a; }"
+                "void main() { f(0); }");
+            DefiniteAssignment assignment;
+            assignment.run(parsed.program);
+
+            Assert::AreEqual(1, assignment.provenReads()); // k
+            Assert::AreEqual(1, assignment.checkedReads()); // a
+            Assert::AreEqual(1LL, RunParsed(parsed.program, "g", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 91. Глобальная переменная, которую вызванная функция присваивает на любом пути,
+        // после вызова читается без проверки
+        TEST_METHOD(TestGlobalAssignedByCallProven)
+        {
+            ParsedProgram parsed("int g; int z; void set() { g = 5; } void main() { set(); z = g; }");
+            DefiniteAssignment assignment;
+            assignment.run(parsed.program);
+
+            Assert::AreEqual(1, assignment.provenReads());
+            Assert::AreEqual(0, assignment.checkedReads());
+            Assert::AreEqual(5LL, RunParsed(parsed.program, "z", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 92. Байт-код содержит CHKL/CHKG только для непроверенных чтений, а признак
+        // инициализации записывают только присваивания переменных, которые потом проверяются
+        TEST_METHOD(TestBytecodeSkipsProvenChecks)
+        {
+            ParsedProgram parsed(
+                "int g; int h = 0;"
+                "void f(int k) { int a; int b;"
+                "  switch (k) { case 0: a = 1; case 1: b = 2; break; default: a = 3; b = 4; }"
+                "  h = h + b; g = a; }"
+                "void main() { f(0); }");
+            DefiniteAssignment().run(parsed.program);
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+            int checks = 0, flagged = 0;
+            for (const BcFunction& fn : bytecode->functions) {
+                for (const Instr& in : fn.code) {
+                    if (in.op == OP_CHKL || in.op == OP_CHKG) checks++;
+                    if (in.op == OP_STL) flagged++;
+                }
+            }
+
+            Assert::AreEqual(1, checks);
+            Assert::AreEqual(2, flagged); // присваивания a
+            Assert::AreEqual((size_t)1, bytecode->functions[0].checkedLocals.size());
+            delete bytecode;
+            Tree::reset();
+        }
+
+        // 93. Оставшаяся проверка по-прежнему сообщает об ошибке на всех способах исполнения
+        TEST_METHOD(TestRemainingCheckReportsError)
+        {
+            string source =
+                "int g; int h = 0; int z;"
+                "void f(int k) { int a; int b;"
+                "  switch (k) { case 0: a = 1; case 1: b = 2; break; default: a = 3; b = 4; }"
+                "  h = h + b; g = a; }"
+                "void main() { f(0); f(2); z = g + h; f(1); }";
+            for (RUN_ENGINE engine : { RUN_AST, RUN_VM, RUN_JIT }) {
+                ParsedProgram parsed(source);
+                DefiniteAssignment().run(parsed.program);
+                Assert::ExpectException<runtime_error>([&]() { RunParsed(parsed.program, "z", engine); });
+            }
+            Tree::reset();
+        }
+
+        // 94. Без ошибочного вызова результат тот же, что и без анализа
+        TEST_METHOD(TestResultsUnchanged)
+        {
+            string source =
+                "int g; int h = 0; int z;"
+                "void f(int k) { int a; int b;"
+                "  switch (k) { case 0: a = 1; case 1: b = 2; break; default: a = 3; b = 4; }"
+                "  h = h + b; g = a; }"
+                "void main() { f(0); f(2); z = g + h; f(0); }";
+            long long expected = RunProgram(source, "z").v;
+            ParsedProgram parsed(source);
+            DefiniteAssignment().run(parsed.program);
+
+            Assert::AreEqual(9LL, expected);
+            Assert::AreEqual(expected, RunParsed(parsed.program, "z", RUN_AST).v);
+            Assert::AreEqual(expected, RunParsed(parsed.program, "z", RUN_VM).v);
+            Assert::AreEqual(1LL, RunParsed(parsed.program, "g", RUN_JIT).v);
+            Tree::reset();
+        }
+    };
+
+    // Тесты анализа диапазонов значений
+    TEST_CLASS(RangeAnalysisTests)
+    {
+    public:
+        // Число команд программы с кодом из [first, last]
+        static int CountOps(const BcProgram* bytecode, OPCODE first, OPCODE last)
+        {
+            int count = 0;
+            for (const BcFunction& fn : bytecode->functions) {
+                for (const Instr& in : fn.code) {
+                    if (in.op >= first && in.op <= last) count++;
+                }
+            }
+            return count;
+        }
+
+        // 95. k % 1000 помещается в short — присваивание без проверки обрезки
+        TEST_METHOD(TestFittingStoreUnchecked)
+        {
+            ParsedProgram parsed("short w = 0; void f(int k) { w = k % 1000; } void main() { f(12345); f(7); }");
+            RangeAnalysis ranges;
+            ranges.run(parsed.program);
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::AreEqual(1, ranges.fittingStores());
+            Assert::AreEqual(0, CountOps(bytecode, OP_NARROW_S, OP_NARROW_I));
+            delete bytecode;
+            Assert::AreEqual(7LL, RunParsed(parsed.program, "w", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 96. Делитель k % 7 + 8 лежит в [2, 14] — деление без проверки (как и остаток
+        // от деления на константу 7)
+        TEST_METHOD(TestNonZeroDivisorUnchecked)
+        {
+            ParsedProgram parsed("int q = 0; void f(int k) { q = q + 1000 / (k % 7 + 8); } void main() { f(3); f(-3); }");
+            RangeAnalysis ranges;
+            ranges.run(parsed.program);
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::AreEqual(2, ranges.nonZeroDivisors());
+            Assert::AreEqual(0, CountOps(bytecode, OP_DIV_S, OP_MOD_L));
+            // Деление на константу Peephole объединяет с её загрузкой (QUOK / REMK)
+            Assert::AreEqual(2, CountOps(bytecode, OP_QUO_S, OP_REM_L) + CountOps(bytecode, OP_QUOK_S, OP_REMK_L));
+            delete bytecode;
+            Assert::AreEqual(290LL, RunParsed(parsed.program, "q", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 97. Делитель k - 5 может быть 0 — проверка остаётся
+        TEST_METHOD(TestPossibleZeroDivisorChecked)
+        {
+            ParsedProgram parsed("int d = 0; void f(int k) { d = d + 7 % (k - 5); } void main() { f(3); f(6); }");
+            RangeAnalysis ranges;
+            ranges.run(parsed.program);
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::AreEqual(0, ranges.nonZeroDivisors());
+            Assert::AreEqual(1, CountOps(bytecode, OP_DIV_S, OP_MOD_L));
+            delete bytecode;
+            Assert::AreEqual(1LL, RunParsed(parsed.program, "d", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 98. Счётчик рекурсии расширяется до диапазона типа: k + 100 может быть 0
+        TEST_METHOD(TestRecursionCounterWidened)
+        {
+            ParsedProgram parsed(
+                "int q = 0;"
+                "void loop(int k, int n) { q = q + 1000 / (k + 100); switch (n - k) { case 0: break; default: loop(k + 1, n); } }"
+                "void main() { loop(0, 5); }");
+            RangeAnalysis ranges;
+            ranges.run(parsed.program);
+
+            Assert::AreEqual(0, ranges.nonZeroDivisors());
+            Assert::AreEqual(55LL, RunParsed(parsed.program, "q", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 99. big (40 или 50) помещается в int — приведение аргумента встроенного вызова пустое
+        TEST_METHOD(TestFittingCastRemoved)
+        {
+            ParsedProgram parsed(
+                "long big = 40; int z = 0;"
+                "void add(int x) { z = z + x; }"
+                "void main() { big = 50; add(big); }");
+            Inliner(Inliner::DEFAULT_BUDGET).run(parsed.program);
+            RangeAnalysis ranges;
+            ranges.run(parsed.program);
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::AreEqual(1, ranges.fittingCasts());
+            Assert::AreEqual(0, CountOps(bytecode, OP_CAST_S, OP_CAST_I));
+            delete bytecode;
+            Assert::AreEqual(50LL, RunParsed(parsed.program, "z", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 100. Константа 70000 обрезается одинаково при каждом исполнении: предупреждение —
+        // одно, при компиляции, константа заменена обрезанным значением
+        TEST_METHOD(TestConstantTruncationWarnedAtCompileTime)
+        {
+            ParsedProgram parsed("short s; void f(int k) { s = 70000; } void main() { f(1); f(2); }");
+            RangeAnalysis ranges;
+            ranges.run(parsed.program);
+            ExprNode* value = parsed.program->functions[0]->body->body[0]->value;
+
+            Assert::AreEqual(1, ranges.compileTimeWarnings());
+            Assert::AreEqual((int)EXPR_CONST, (int)value->kind);
+            Assert::AreEqual(4464LL, value->value.v);
+            Assert::AreEqual(4464LL, RunParsed(parsed.program, "s", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 101. Копии f по константному аргументу (f.constprop.N) содержат тот же оператор
+        // s = 70000: предупреждение об обрезке выводится один раз, константа обрезана во всех копиях
+        TEST_METHOD(TestTruncationWarningOncePerStatement)
+        {
+            ParsedProgram parsed(
+                "short s = 0; int t = 0;"
+                "void f(int m) { switch (m) { case 1: s = 70000; break; default: t = t + m; } }"
+                "void main() { f(1); f(3); f(1); f(1); }");
+            Specializer specializer;
+            for (int round = 0; round < Specializer::MAX_ROUNDS && specializer.run(parsed.program) > 0; ++round) {
+                ConstFolder().run(parsed.program);
+            }
+            RangeAnalysis ranges;
+            ranges.run(parsed.program);
+
+            Assert::IsTrue(parsed.program->functions.size() > 2);
+            Assert::AreEqual(1, ranges.compileTimeWarnings());
+            Assert::AreEqual(4464LL, RunParsed(parsed.program, "s", RUN_VM).v);
+            Assert::AreEqual(3LL, RunParsed(parsed.program, "t", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 102. Результаты на AST и VM — как без анализа
+        TEST_METHOD(TestRangeResultsMatch)
+        {
+            string source =
+                "short s; short w = 0; int q = 0; long big = 40; int z = 0; int d = 0;"
+                "void add(int x) { z = z + x; }"
+                "void f(int k) { s = 70000; w = k % 1000; q = q + 1000 / (k % 7 + 8);"
+                "  d = d + 7 % (k - 5); big = 50; add(big); }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default: f(k); loop(k + 1, n); } }"
+                "void main() { loop(0, 5); }";
+            vector<long long> expected;
+            for (const char* name : { "s", "w", "q", "d", "z" }) {
+                expected.push_back(RunProgram(source, name).v);
+            }
+            ParsedProgram parsed(source);
+            Inliner(Inliner::DEFAULT_BUDGET).run(parsed.program);
+            RangeAnalysis().run(parsed.program);
+
+            int i = 0;
+            for (const char* name : { "s", "w", "q", "d", "z" }) {
+                Assert::AreEqual(expected[i], RunParsed(parsed.program, name, RUN_AST).v);
+                Assert::AreEqual(expected[i], RunParsed(parsed.program, name, RUN_VM).v);
+                i++;
+            }
+            Tree::reset();
+        }
+    };
+
+    // Тесты алгебраических упрощений
+    TEST_CLASS(SimplifierTests)
+    {
+    public:
+        // Число команд программы с кодом из [first, last]
+        static int CountOps(const BcProgram* bytecode, OPCODE first, OPCODE last)
+        {
+            int count = 0;
+            for (const BcFunction& fn : bytecode->functions) {
+                for (const Instr& in : fn.code) {
+                    if (in.op >= first && in.op <= last) count++;
+                }
+            }
+            return count;
+        }
+
+        // 103. Частное и остаток от деления на 2^k округляются к нулю и для отрицательных делимых
+        TEST_METHOD(TestPow2Kernels)
+        {
+            const int64_t values[] = { INT64_MIN, INT64_MIN + 1, -1025, -9, -8, -7, -1, 0, 1, 7, 8, 9, 1025, INT64_MAX };
+            for (int64_t v : values) {
+                for (int k : { 1, 3, 10, 62 }) {
+                    int64_t d = int64_t(1) << k;
+                    Assert::AreEqual(v / d, divPow2(v, k));
+                    Assert::AreEqual(v % d, modPow2(v, k));
+                }
+            }
+        }
+
+        // 104. Деление и остаток на 2^k заменяются командами DIVP2 / MODP2
+        TEST_METHOD(TestPow2DivisionsRewritten)
+        {
+            ParsedProgram parsed("int q = 0; int r = 0; void f(int x) { q = x / 8; r = x % 8; } void main() { f(-13); }");
+            Simplifier simplifier;
+            simplifier.run(parsed.program);
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::AreEqual(2, simplifier.pow2Divisions());
+            Assert::AreEqual(2, CountOps(bytecode, OP_DIVP2, OP_MODP2));
+            Assert::AreEqual(0, CountOps(bytecode, OP_MUL_S, OP_REM_L));
+            delete bytecode;
+            Assert::AreEqual(-1LL, RunParsed(parsed.program, "q", RUN_VM).v);
+            Assert::AreEqual(-5LL, RunParsed(parsed.program, "r", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 105. Умножение и деление на -1 и вычитание из 0 заменяются отрицанием; переполнение —
+        // как у исходных операций (-h при h = -32768 снова -32768)
+        TEST_METHOD(TestNegationsRewritten)
+        {
+            ParsedProgram parsed(
+                "int z = 0; short t = 0;"
+                "void f(int x, short h) { z = (0 - x) + x * (-1) + x / (-1); t = -h; }"
+                "void main() { f(5, -32768); }");
+            Simplifier simplifier;
+            simplifier.run(parsed.program);
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::AreEqual(4, simplifier.negations());
+            Assert::AreEqual(4, CountOps(bytecode, OP_NEG_S, OP_NEG_L));
+            delete bytecode;
+            Assert::AreEqual(-15LL, RunParsed(parsed.program, "z", RUN_VM).v);
+            Assert::AreEqual(-32768LL, RunParsed(parsed.program, "t", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 106. Умножение и деление на 1, сложение с 0, сдвиг на 0 и двойное отрицание заменяются операндом
+        TEST_METHOD(TestIdentitiesRemoved)
+        {
+            string source =
+                "int a = 0; short h2 = 0;"
+                "void f(int x, short h) { a = x * 1 + (x + 0) + (x << 0) + x / 1; h2 = -(-h); }"
+                "void main() { f(3, -32768); }";
+            long long expected = RunProgram(source, "h2").v;
+            ParsedProgram parsed(source);
+            Simplifier simplifier;
+            simplifier.run(parsed.program);
+
+            Assert::AreEqual(5, simplifier.identities());
+            Assert::AreEqual(12LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Assert::AreEqual(expected, RunParsed(parsed.program, "h2", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 107. Умножение на 2^k заменяется сдвигом (y * 2^62 — по модулю 2^64)
+        TEST_METHOD(TestMultiplicationsBecomeShifts)
+        {
+            ParsedProgram parsed(
+                "int a = 0; long w = 0;"
+                "void f(int x, long y) { a = x * 16 + 2 * x; w = y * 4611686018427387904; }"
+                "void main() { f(3, 3); }");
+            Simplifier simplifier;
+            simplifier.run(parsed.program);
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::AreEqual(3, simplifier.shifts());
+            Assert::AreEqual(3, CountOps(bytecode, OP_SHLK_S, OP_SHLK_L));
+            Assert::AreEqual(0, CountOps(bytecode, OP_MUL_S, OP_MUL_L));
+            delete bytecode;
+            Assert::AreEqual(54LL, RunParsed(parsed.program, "a", RUN_VM).v);
+            Assert::AreEqual(-4611686018427387904LL, RunParsed(parsed.program, "w", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 108. Результаты на AST и VM — как без прохода, в том числе на границах short, int и long
+        TEST_METHOD(TestSimplifiedResultsMatch)
+        {
+            string source =
+                "int q = 0; int r = 0; long m = 0; long n = 0; int z = 0; int a = 0; long w = 0;"
+                "short t = 0; short h2 = 0; int u = 0; long big = 3000000000;"
+                "void f(int x, long y, short h) {"
+                "  q = q + x / 8; r = r + x % 8; m = m + y / 4; n = n + y % 1024;"
+                "  z = z + (0 - x) + x * 1 + (x + 0) * (-1) + x / (-1);"
+                "  a = a + x * 16 + h * 4 + (x << 0);"
+                "  w = w + y * 4611686018427387904 + y / 1;"
+                "  t = -h; h2 = -(-h); u = u + 2 * x - x * 1024; }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default:"
+                "  loop(k + 1, n); f(k * 7 - 20, big * (k - 3), k * 9000 - 32768); } }"
+                "void main() { loop(0, 6); }";
+            const char* names[] = { "q", "r", "m", "n", "z", "a", "w", "t", "h2", "u" };
+            vector<long long> expected;
+            for (const char* name : names) {
+                expected.push_back(RunProgram(source, name).v);
+            }
+            ParsedProgram parsed(source);
+            Simplifier().run(parsed.program);
+
+            for (size_t i = 0; i < expected.size(); i++) {
+                Assert::AreEqual(expected[i], RunParsed(parsed.program, names[i], RUN_AST).v);
+                Assert::AreEqual(expected[i], RunParsed(parsed.program, names[i], RUN_VM).v);
+            }
+            Tree::reset();
+        }
+    };
+
+    // Тесты устранения общих подвыражений
+    TEST_CLASS(CommonSubexpressionTests)
+    {
+    public:
+        // 109. (n + m) * 3 и (m + n) * 3 вычисляются один раз во временной переменной
+        TEST_METHOD(TestRepeatedExpressionEliminated)
+        {
+            ParsedProgram parsed(
+                "int s = 0; int t = 0;"
+                "void f(int n, int m) { s = (n + m) * 3; t = (m + n) * 3 + 1; }"
+                "void main() { f(2, 5); }");
+            DefiniteAssignment().run(parsed.program);
+            CommonSubexpressions pass;
+            pass.run(parsed.program);
+
+            Assert::AreEqual(1, pass.eliminatedExpressions());
+            Assert::AreEqual(1, pass.temporaries());
+            Assert::AreEqual(21LL, RunParsed(parsed.program, "s", RUN_AST).v);
+            Assert::AreEqual(22LL, RunParsed(parsed.program, "t", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 110. В ветвях switch используется значение, вычисленное до него
+        TEST_METHOD(TestValueReusedInSwitchBranches)
+        {
+            ParsedProgram parsed(
+                "int v = 0; int w = 0;"
+                "void f(int n, int m) { v = n + m;"
+                "  switch (n % 2) { case 0: w = (n + m) - 1; break; default: w = (n + m) + 1; } }"
+                "void main() { f(3, 4); }");
+            DefiniteAssignment().run(parsed.program);
+            CommonSubexpressions pass;
+            pass.run(parsed.program);
+
+            Assert::AreEqual(2, pass.eliminatedExpressions());
+            Assert::AreEqual(8LL, RunParsed(parsed.program, "w", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 111. Глобальная переменная читается из памяти один раз до присваивания,
+        // после присваивания константы чтение заменяется этой константой
+        TEST_METHOD(TestRepeatedLoadsEliminated)
+        {
+            ParsedProgram parsed(
+                "int g = 5; long u = 0;"
+                "void f(int n) { u = g * g + g; g = 7; u = u + g * n; }"
+                "void main() { f(3); }");
+            DefiniteAssignment().run(parsed.program);
+            CommonSubexpressions pass;
+            pass.run(parsed.program);
+
+            Assert::AreEqual(3, pass.eliminatedLoads()); // g дважды до присваивания и g после
+            Assert::AreEqual(51LL, RunParsed(parsed.program, "u", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 112. После вызова, который может изменить глобальную переменную, она читается заново
+        TEST_METHOD(TestCallInvalidatesLoad)
+        {
+            ParsedProgram parsed(
+                "int g = 5; int a = 0;"
+                "void set() { g = 7; }"
+                "void f() { a = g; set(); a = a + g; }"
+                "void main() { f(); }");
+            DefiniteAssignment().run(parsed.program);
+            CommonSubexpressions pass;
+            pass.run(parsed.program);
+
+            Assert::AreEqual(1, pass.eliminatedLoads()); // a, но не g
+            Assert::AreEqual(12LL, RunParsed(parsed.program, "a", RUN_AST).v);
+            Tree::reset();
+        }
+
+        // 113. Деление на значение, которое может быть 0, не объединяется: ошибка остаётся на месте
+        TEST_METHOD(TestCheckedDivisionKept)
+        {
+            ParsedProgram parsed(
+                "int a = 0; int b = 0;"
+                "void f(int x) { a = 10 / x; b = 10 / x; }"
+                "void main() { f(2); f(0); }");
+            DefiniteAssignment().run(parsed.program);
+            CommonSubexpressions pass;
+            pass.run(parsed.program);
+
+            Assert::AreEqual(0, pass.eliminatedExpressions());
+            Assert::ExpectException<runtime_error>([&]() { RunParsed(parsed.program, "a", RUN_VM); });
+            Tree::reset();
+        }
+
+        // 114. В SSA-дампе есть phi для w после switch и запись в g
+        TEST_METHOD(TestSsaDump)
+        {
+            ParsedProgram parsed(
+                "int g = 5; short w = 0;"
+                "void f(int n) { switch (n % 2) { case 0: w = n - g; break; default: w = n + g; } g = w; }"
+                "void main() { f(3); }");
+            DefiniteAssignment().run(parsed.program);
+            ostringstream dump;
+            CommonSubexpressions().run(parsed.program, &dump);
+
+            Assert::IsTrue(dump.str().find("short phi(b1: ") != string::npos);
+            Assert::IsTrue(dump.str().find("store g = ") != string::npos);
+            Tree::reset();
+        }
+
+        // 115. В байт-коде меньше сложений и чтений глобальных переменных, чем без прохода;
+        // результаты на AST и VM — как без прохода
+        TEST_METHOD(TestCseResultsMatch)
+        {
+            string source =
+                "int s = 0; int t = 0; long u = 0; int g = 5; short w = 0;"
+                "void f(int n, int m) {"
+                "  s = s + (n + m) * 3; t = t + (n + m) * 3 - g;"
+                "  u = u + (m + n) + g * g;"
+                "  switch (n % 2) { case 0: w = (n + m) - g; break; default: w = -(n + m) + g; }"
+                "  g = n - m; s = s + g * 2 + (n - m); }"
+                "void loop(int k, int n) { switch (n - k) { case 0: break; default:"
+                "  loop(k + 1, n); f(k * 7 - 20, k * k); } }"
+                "void main() { loop(0, 6); }";
+            const char* names[] = { "s", "t", "u", "g", "w" };
+            vector<long long> expected;
+            for (const char* name : names) {
+                expected.push_back(RunProgram(source, name).v);
+            }
+
+            int adds[2] = { 0, 0 }, loads[2] = { 0, 0 };
+            for (int cse = 0; cse < 2; cse++) {
+                ParsedProgram parsed(source);
+                DefiniteAssignment().run(parsed.program);
+                if (cse) CommonSubexpressions().run(parsed.program);
+                BytecodeCompiler compiler(false);
+                BcProgram* bytecode = compiler.compile(parsed.program);
+                for (const Instr& in : bytecode->functions[0].code) {
+                    if (in.op >= OP_ADD_S && in.op <= OP_ADD_L) adds[cse]++;
+                    if (in.op == OP_LOADG) loads[cse]++;
+                }
+                delete bytecode;
+
+                for (size_t i = 0; i < expected.size(); i++) {
+                    Assert::AreEqual(expected[i], RunParsed(parsed.program, names[i], RUN_AST).v);
+                    Assert::AreEqual(expected[i], RunParsed(parsed.program, names[i], RUN_VM).v);
+                }
+            }
+            Assert::IsTrue(adds[1] < adds[0]);
+            Assert::IsTrue(loads[1] < loads[0]);
+            Tree::reset();
+        }
+    };
+
+    // Тесты суперинструкций и удаления лишних приведений
+    TEST_CLASS(PeepholeTests)
+    {
+    public:
+        static bool UsesOp(const BcProgram* bytecode, OPCODE op)
+        {
+            for (const BcFunction& f : bytecode->functions)
+                for (const Instr& in : f.code)
+                    if (in.op == op) return true;
+            return false;
+        }
+
+        // 116. Константа в операнде (k * 3, k - 3) объединяется с операцией
+        TEST_METHOD(TestConstantOperandsFused)
+        {
+            ParsedProgram parsed("int a = 0; void f(int k) { a = k * 3 + (k - 3); } void main() { f(5); }");
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::IsTrue(compiler.peepholeStats().fusedConstants() >= 2);
+            Assert::IsTrue(UsesOp(bytecode, OP_ADDK_I));
+            Assert::IsTrue(UsesOp(bytecode, OP_MULK_I));
+            delete bytecode;
+            Assert::AreEqual(17LL, RunParsed(parsed.program, "a", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 117. switch с одной меткой объединяется с вычислением селектора в переход по сравнению
+        TEST_METHOD(TestCompareAndBranchFused)
+        {
+            ParsedProgram parsed(
+                "long acc = 0;"
+                "void f(int k, long n) { switch (n - k) { case 0: acc = 1000; break; default: acc = 1; }"
+                "  switch (k) { case 3: acc = acc + 5; break; default: break; } }"
+                "void main() { f(3, 17); }");
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::IsTrue(compiler.peepholeStats().fusedBranches() >= 2);
+            Assert::IsTrue(UsesOp(bytecode, OP_JNE));
+            Assert::IsTrue(UsesOp(bytecode, OP_JNEK));
+            delete bytecode;
+            Assert::AreEqual(6LL, RunParsed(parsed.program, "acc", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 118. Результат операции записывается сразу в переменную, без пересылки
+        TEST_METHOD(TestMovesRetargeted)
+        {
+            ParsedProgram parsed("int a = 0; void f(int k) { int d = k * k; a = d + k; } void main() { f(5); }");
+            BytecodeCompiler compiler(false);
+            delete compiler.compile(parsed.program);
+
+            Assert::IsTrue(compiler.peepholeStats().retargetedMoves() > 0);
+            Assert::AreEqual(30LL, RunParsed(parsed.program, "a", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 119. Сложение и вычитание с записью результата в глобальную переменную объединяются
+        TEST_METHOD(TestGlobalStoresFused)
+        {
+            ParsedProgram parsed(
+                "short s = 0; long acc = 0;"
+                "void f(short v, int k) { s = s + v; acc = acc - k; }"
+                "void main() { f(5, 7); }");
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+
+            Assert::AreEqual(2, compiler.peepholeStats().fusedStores());
+            Assert::IsTrue(UsesOp(bytecode, OP_ADDG_S));
+            Assert::IsTrue(UsesOp(bytecode, OP_SUBG_L));
+            delete bytecode;
+            Assert::AreEqual(5LL, RunParsed(parsed.program, "s", RUN_VM).v);
+            Assert::AreEqual(-7LL, RunParsed(parsed.program, "acc", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 120. Приведение k % 100 к short при передаче параметра удаляется: значение всегда помещается
+        TEST_METHOD(TestNeedlessCastRemoved)
+        {
+            ParsedProgram parsed(
+                "short s = 0; void put(short v) { s = s + v; }"
+                "void f(int k) { put(k % 100); } void main() { f(1234); }");
+            BytecodeCompiler compiler(false);
+            delete compiler.compile(parsed.program);
+
+            Assert::IsTrue(compiler.peepholeStats().removedCasts() > 0);
+            Assert::AreEqual(34LL, RunParsed(parsed.program, "s", RUN_VM).v);
+            Tree::reset();
+        }
+
+        // 121. Исполненных инструкций меньше, чем было бы без объединения; результаты на VM
+        // и JIT — как на AST
+        TEST_METHOD(TestFusedResultsMatch)
+        {
+            ParsedProgram parsed(
+                "long acc = 0; int hits = 0; short s = 0; int odd = 0;"
+                "void put(short v, int w) { s = s + v; acc = acc + w; }"
+                "void step(int k, long n) {"
+                "  int d = k - 3;"
+                "  switch (k % 4) { case 0: hits = hits + 2; break; default: odd = odd + 1; }"
+                "  switch (n - k) { case 0: acc = acc + 1000; break; default: acc = acc - k; }"
+                "  switch (d + 7) { case 9: hits = hits + 100; break; default: break; }"
+                "  put(5, k * 3); put(k % 100, 7);"
+                "  acc = acc + (k + 1) * 3 - k / 5 + k % 9;"
+                "  switch (k) { case 0: break; default: step(k - 1, n); } }"
+                "void main() { step(40, 17); }");
+            BytecodeCompiler compiler(false);
+            BcProgram* bytecode = compiler.compile(parsed.program);
+            Executor executor(parsed.program);
+            executor.run();
+            DispatchProfile profile;
+            for (int jit = 0; jit < 2; ++jit) {
+                VM vm(bytecode, jit != 0);
+                if (!jit) vm.setProfile(&profile);
+                vm.run();
+                for (const char* name : { "acc", "hits", "s", "odd" })
+                    Assert::AreEqual(executor.globalValue(name).v, vm.globalValue(name).v);
+            }
+            Assert::IsTrue(profile.dispatches > 0 && profile.original > profile.dispatches);
+            Assert::AreEqual(1025LL, executor.globalValue("s").v);
+            Assert::AreEqual(30LL, executor.globalValue("odd").v);
+            delete bytecode;
+            Tree::reset();
+        }
+
+        // 122. С отладочным выводом байт-код не объединяется
+        TEST_METHOD(TestDebugBuildNotFused)
+        {
+            ParsedProgram parsed("long acc = 0; void f(int k) { acc = acc + k * 3 - 1; } void main() { f(5); }");
+            BytecodeCompiler traced(true);
+            BcProgram* bytecode = traced.compile(parsed.program);
+
+            Assert::AreEqual(0, traced.peepholeStats().fusedConstants());
+            for (const BcFunction& f : bytecode->functions)
+                for (const Instr& in : f.code) Assert::IsFalse(in.op >= OP_ADDK_S && in.op <= OP_SUBG_L);
+            delete bytecode;
+            Tree::reset();
+        }
+
+        // 123. switch (x + 1) с меткой вне типа short: сумма никогда не равна 70000, а x == 70000 - 1,
+        // приведённое к short, при x = 4463 выполнялось бы. Сравнение не переносится на x
+        TEST_METHOD(TestAddConstantLabelOutOfRange)
+        {
+            string source =
+                "int y = 0; short g = 0;"
+                "void f(short x) { switch (x + 1) { case 70000: y = y + 1; break; default: y = y + 10; } }"
+                "void h(short a) { g = g + a; }"
+                "void main() { h(4000); h(463); f(g); h(5); f(g); }";
+            Assert::AreEqual(20LL, RunProgram(source, "y").v);
+            Assert::AreEqual(20LL, RunProgramVM(source, "y").v);
+            Tree::reset();
         }
     };
-}
\ No newline at end of file
+}